@@ -0,0 +1,222 @@
+#include "object-resources/object.hpp"
+#include "object-resources/registry.hpp"
+#include "object-resources/transform.hpp"
+#include "object-resources/primitives.hpp"
+#include "job-resources/jobs.hpp"
+#include "debug-resources/log.hpp"
+#include "debug-resources/cpu-profiler.hpp"
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace mage;
+
+// CPU-only scaling of the job system from one thread up to every hardware thread, no device or window needed.
+//
+//   mage-job-bench [--threads 1,2,4,8] [--objects N] [--meshes N] [--jobs N] [--iterations N] [--output results.json|-]
+//
+// Every thread count runs the same three workloads: a transform update with every object moving, decoding a batch of
+// cube meshes, and a flood of empty jobs that measures scheduling overhead on its own.
+
+namespace {
+
+  struct BenchOptions {
+    std::vector<uint32_t> thread_counts;
+    uint32_t objects = 1000000;
+    uint32_t meshes = 4096;
+    uint32_t jobs = 100000;
+    uint32_t iterations = 20;
+    std::string output = "job-bench.json";
+  };
+
+  struct BenchResult {
+    uint32_t threads;
+    double transform_ms;
+    double decode_ms;
+    double empty_jobs_ms;
+  };
+
+  // Sink for results so nothing measured can be optimized away
+  volatile float checksum_sink = 0.f;
+
+  std::vector<uint32_t> parse_list(const std::string &list) {
+    std::vector<uint32_t> values;
+    size_t start = 0;
+    while (start < list.size()) {
+      size_t end = list.find(',', start);
+      end = end == std::string::npos ? list.size() : end;
+      uint32_t value = static_cast<uint32_t>(std::strtoul(list.substr(start, end - start).c_str(), nullptr, 10));
+      if (value > 0) {
+        values.push_back(value);
+      }
+      start = end + 1;
+    }
+    return values;
+  }
+
+  // Powers of two up to the hardware thread count, plus the count itself
+  std::vector<uint32_t> default_thread_counts() {
+    uint32_t hardware = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<uint32_t> counts;
+    for (uint32_t count = 1; count < hardware; count *= 2) {
+      counts.push_back(count);
+    }
+    counts.push_back(hardware);
+    return counts;
+  }
+
+  BenchOptions parse_options(int argc, char **argv) {
+    BenchOptions options{};
+    for (int i = 1; i < argc; i++) {
+      std::string argument = argv[i];
+      bool has_value = i + 1 < argc;
+      if (argument == "--threads" && has_value) {
+        options.thread_counts = parse_list(argv[++i]);
+      } else if (argument == "--objects" && has_value) {
+        options.objects = std::max(1u, static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10)));
+      } else if (argument == "--meshes" && has_value) {
+        options.meshes = std::max(1u, static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10)));
+      } else if (argument == "--jobs" && has_value) {
+        options.jobs = std::max(1u, static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10)));
+      } else if (argument == "--iterations" && has_value) {
+        options.iterations = std::max(1u, static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10)));
+      } else if (argument == "--output" && has_value) {
+        options.output = argv[++i];
+      } else {
+        MAGE_WARN(game) << "Ignoring unknown argument " << argument;
+      }
+    }
+    if (options.thread_counts.empty()) {
+      options.thread_counts = default_thread_counts();
+    }
+    return options;
+  }
+
+  void build_objects(Registry &registry, uint32_t count) {
+    registry.clear();
+    EntityCommands commands{registry};
+    for (uint32_t i = 0; i < count; i++) {
+      Transform transform{};
+      transform.current.translation = {static_cast<float>(i % 100), static_cast<float>((i / 100) % 100), static_cast<float>(i / 10000)};
+      transform.current.rotation = {0.01f * static_cast<float>(i % 628), 0.02f * static_cast<float>(i % 314), 0.f};
+      transform.current.scale = {.5f, .5f, .5f};
+      transform.previous = transform.current;
+      commands.create(transform, Renderable{});
+    }
+    commands.apply();
+  }
+
+  double run_transforms(Registry &registry, uint32_t iterations) {
+    auto drawables = registry.view<Transform, Renderable>();
+    TransformSystem transforms;
+    transforms.update(drawables, 0.5f, glm::mat4{1.f});
+    uint64_t total = 0;
+    for (uint32_t iteration = 0; iteration < iterations; iteration++) {
+      registry.view<Transform>().each([](Entity, Transform &transform) {
+        transform.previous = transform.current;
+        transform.current.rotation.y += 0.01f;
+      });
+      glm::mat4 projection_view{1.f};
+      projection_view[3][2] = 1.f + 0.001f * static_cast<float>(iteration);
+      uint64_t start = CpuProfiler::now();
+      transforms.update(drawables, 0.5f, projection_view);
+      total += CpuProfiler::now() - start;
+      checksum_sink = checksum_sink + transforms.get_mvp(iteration % transforms.get_object_count())[3][0];
+    }
+    return total / 1e6 / iterations;
+  }
+
+  double run_decode(uint32_t meshes, uint32_t iterations) {
+    std::vector<std::vector<GameModel::Vertex>> vertices(meshes);
+    std::vector<std::vector<uint32_t>> indices(meshes);
+    uint64_t total = 0;
+    for (uint32_t iteration = 0; iteration < iterations; iteration++) {
+      uint64_t start = CpuProfiler::now();
+      JobSystem::get().parallel_for(0, meshes, [&](uint32_t first, uint32_t last) {
+        for (uint32_t i = first; i < last; i++) {
+          decode_cube_mesh({0.f, 0.f, 1e-4f * static_cast<float>(i)}, vertices[i], indices[i]);
+        }
+      });
+      total += CpuProfiler::now() - start;
+      checksum_sink = checksum_sink + static_cast<float>(indices[iteration % meshes].size());
+    }
+    return total / 1e6 / iterations;
+  }
+
+  double run_empty_jobs(uint32_t jobs, uint32_t iterations) {
+    JobSystem &system = JobSystem::get();
+    std::atomic<uint32_t> ran{0};
+    uint64_t total = 0;
+    for (uint32_t iteration = 0; iteration < iterations; iteration++) {
+      uint64_t start = CpuProfiler::now();
+      JobCounter counter;
+      for (uint32_t i = 0; i < jobs; i++) {
+        system.run([&ran] {ran.fetch_add(1, std::memory_order_relaxed);}, &counter);
+      }
+      system.wait(counter);
+      total += CpuProfiler::now() - start;
+    }
+    checksum_sink = checksum_sink + static_cast<float>(ran.load());
+    return total / 1e6 / iterations;
+  }
+
+  bool write_results(const BenchOptions &options, const std::vector<BenchResult> &results) {
+    Logger::get().flush();
+    FILE *file = options.output == "-" ? stdout : fopen(options.output.c_str(), "w");
+    if (file == nullptr) {
+      MAGE_ERROR(game) << "Failed to open benchmark output " << options.output;
+      return false;
+    }
+    // Speedups are against the first thread count measured, normally a single thread
+    const BenchResult &baseline = results.front();
+    auto speedup = [](double base, double value) {return value > 0.0 ? base / value : 0.0;};
+    fprintf(file, "{\n  \"objects\": %u,\n  \"meshes\": %u,\n  \"jobs\": %u,\n  \"hardware_threads\": %u,\n  \"results\": [\n",
+            options.objects, options.meshes, options.jobs, std::thread::hardware_concurrency());
+    for (size_t i = 0; i < results.size(); i++) {
+      const auto &result = results[i];
+      fprintf(file, "    {\"threads\": %u, \"transform_ms\": %.4f, \"transform_speedup\": %.2f, \"decode_ms\": %.4f, \"decode_speedup\": %.2f, "
+                    "\"empty_jobs_ms\": %.4f, \"ns_per_job\": %.1f}%s\n",
+              result.threads, result.transform_ms, speedup(baseline.transform_ms, result.transform_ms),
+              result.decode_ms, speedup(baseline.decode_ms, result.decode_ms),
+              result.empty_jobs_ms, result.empty_jobs_ms * 1e6 / options.jobs,
+              i + 1 < results.size() ? "," : "");
+    }
+    fprintf(file, "  ]\n}\n");
+    if (file != stdout) {
+      fclose(file);
+      MAGE_INFO(game) << "Wrote job benchmark results to " << options.output;
+    }
+    return true;
+  }
+
+}
+
+int main(int argc, char **argv) {
+  BenchOptions options = parse_options(argc, argv);
+  Registry registry;
+  build_objects(registry, options.objects);
+
+  std::vector<BenchResult> results;
+  for (uint32_t threads : options.thread_counts) {
+    JobSystem::get().start(threads - 1);
+    BenchResult result{threads, 0.0, 0.0, 0.0};
+    result.transform_ms = run_transforms(registry, options.iterations);
+    result.decode_ms = run_decode(options.meshes, options.iterations);
+    result.empty_jobs_ms = run_empty_jobs(options.jobs, options.iterations);
+    JobSystem::get().stop();
+    MAGE_INFO(game) << threads << " thread(s): transforms " << result.transform_ms << " ms, decode " << result.decode_ms
+                    << " ms, " << options.jobs << " empty jobs " << result.empty_jobs_ms << " ms";
+    results.push_back(result);
+  }
+  registry.clear();
+  return write_results(options, results) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,391 @@
+#include "pipeline-resources/device.hpp"
+#include "pipeline-resources/artist.hpp"
+#include "object-resources/transport.hpp"
+#include "object-resources/registry.hpp"
+#include "object-resources/primitives.hpp"
+#include "object-resources/mesh-cooked.hpp"
+#include "camera-resources/camera.hpp"
+#include "debug-resources/log.hpp"
+#include "debug-resources/cpu-profiler.hpp"
+#include "job-resources/jobs.hpp"
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace mage;
+
+// Fixed-size scene rendered for a fixed number of frames, the baseline every renderer change is measured against.
+//
+//   mage-stress-scene [--objects N] [--models M] [--camera static|animated] [--frames F] [--warmup W]
+//                     [--mesh file.mesh] [--instanced] [--gpu-driven] [--no-cull] [--no-sort] [--no-lod]
+//                     [--record-threads N] [--job-threads N] [--headless]
+//                     [--pacing low-latency|max-throughput] [--frames-in-flight N] [--swap-images N]
+//                     [--present-mode fifo|fifo-relaxed|mailbox|immediate] [--output results.json|-]
+//
+// Run from the repository root, or set MAGE_ASSET_ROOT to it, so the pipeline finds src/shaders. Results are written as JSON,
+// configure with -DMAGE_LOG_LEVEL=3 to keep startup logging out of the way when writing to stdout.
+// With --gpu-driven the visible count is read back from the GPU a few frames late, and --no-cull turns off the GPU's frustum test.
+// --mesh replaces the cube with a cooked mesh, its levels of detail are picked per object unless --no-lod is given. Triangle
+// counts are of the levels picked, before GPU culling with --gpu-driven.
+
+namespace {
+
+  const uint64_t MAX_OBJECTS = 1000000;
+  const int WIDTH = 1520;
+  const int HEIGHT = 1000;
+  const float OBJECT_SPACING = 1.5f;
+  const float ORBIT_FRAMES = 600.f;
+
+  struct StressOptions {
+    uint64_t objects = 10000;
+    uint32_t models = 1;
+    bool animated_camera = false;
+    bool instanced = false;
+    bool gpu_driven = false;
+    bool cull = true;
+    bool sort = true;
+    bool lod = true;
+    std::string mesh;
+    uint32_t record_threads = 1;
+    uint32_t job_threads = std::max(1u, std::thread::hardware_concurrency()) - 1;
+    uint32_t frames = 600;
+    uint32_t warmup = 60;
+    bool headless = false;
+    FramePacing pacing;
+    std::string output = "stress-scene.json";
+  };
+
+  struct FrameSample {
+    double frame_milliseconds;
+    double fence_wait_milliseconds;
+    uint32_t draw_calls;
+    uint32_t visible;
+    uint32_t culled;
+    uint32_t binds_saved;
+    uint64_t triangles;
+  };
+
+  StressOptions parse_options(int argc, char **argv) {
+    StressOptions options{};
+    for (int i = 1; i < argc; i++) {
+      std::string argument = argv[i];
+      bool has_value = i + 1 < argc;
+      if (argument == "--objects" && has_value) {
+        options.objects = std::strtoull(argv[++i], nullptr, 10);
+      } else if (argument == "--models" && has_value) {
+        options.models = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+      } else if (argument == "--camera" && has_value) {
+        options.animated_camera = std::string(argv[++i]) == "animated";
+      } else if (argument == "--frames" && has_value) {
+        options.frames = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+      } else if (argument == "--warmup" && has_value) {
+        options.warmup = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+      } else if (argument == "--instanced") {
+        options.instanced = true;
+      } else if (argument == "--gpu-driven") {
+        options.gpu_driven = true;
+      } else if (argument == "--no-cull") {
+        options.cull = false;
+      } else if (argument == "--no-sort") {
+        options.sort = false;
+      } else if (argument == "--no-lod") {
+        options.lod = false;
+      } else if (argument == "--mesh" && has_value) {
+        options.mesh = argv[++i];
+      } else if (argument == "--record-threads" && has_value) {
+        options.record_threads = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+        if (options.record_threads == 0) {
+          options.record_threads = std::max(1u, std::thread::hardware_concurrency());
+        }
+      } else if (argument == "--job-threads" && has_value) {
+        options.job_threads = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+      } else if (argument == "--headless") {
+        options.headless = true;
+      } else if (argument == "--pacing" && has_value) {
+        std::string profile = argv[++i];
+        if (!FramePacing::from_profile(profile, options.pacing)) {
+          MAGE_WARN(game) << "Ignoring unknown pacing profile " << profile;
+        }
+      } else if (argument == "--frames-in-flight" && has_value) {
+        uint32_t frames = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+        options.pacing.frames_in_flight = std::min(std::max(frames, FramePacing::MIN_FRAMES_IN_FLIGHT), FramePacing::MAX_FRAMES_IN_FLIGHT);
+      } else if (argument == "--swap-images" && has_value) {
+        options.pacing.image_count = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+      } else if (argument == "--present-mode" && has_value) {
+        std::string mode = argv[++i];
+        if (!parse_present_mode(mode, options.pacing.present_mode)) {
+          MAGE_WARN(game) << "Ignoring unknown present mode " << mode;
+        }
+      } else if (argument == "--output" && has_value) {
+        options.output = argv[++i];
+      } else {
+        MAGE_WARN(game) << "Ignoring unknown argument " << argument;
+      }
+    }
+    options.objects = std::min(std::max<uint64_t>(options.objects, 1), MAX_OBJECTS);
+    options.models = static_cast<uint32_t>(std::min<uint64_t>(std::max(options.models, 1u), options.objects));
+    options.frames = std::max(options.frames, 1u);
+    return options;
+  }
+
+  // Cubes (or the cooked mesh) on a centered lattice, models handed out round robin so every model gets drawn. Meshes are
+  // decoded on the job system, the uploads stay on this thread since they share the device's staging buffer.
+  std::vector<std::shared_ptr<GameModel>> build_scene(DeviceHandling &device, Registry &registry, const StressOptions &options, uint32_t &side) {
+    std::shared_ptr<const CookedMesh> cooked;
+    if (!options.mesh.empty()) {
+      cooked = CookedMesh::load(options.mesh);
+      if (cooked == nullptr) {
+        MAGE_WARN(game) << "Falling back to cubes";
+      }
+    }
+    std::vector<std::vector<GameModel::Vertex>> vertices(options.models);
+    std::vector<std::vector<uint32_t>> indices(options.models);
+    if (cooked == nullptr) {
+      JobSystem::get().parallel_for(0, options.models, [&](uint32_t first, uint32_t last) {
+        for (uint32_t i = first; i < last; i++) {
+          // A tiny offset keeps each model a distinct vertex buffer without changing what is drawn
+          decode_cube_mesh({0.f, 0.f, 1e-4f * static_cast<float>(i)}, vertices[i], indices[i]);
+        }
+      });
+    }
+    std::vector<std::shared_ptr<GameModel>> models;
+    models.reserve(options.models);
+    device.begin_upload_batch();
+    for (uint32_t i = 0; i < options.models; i++) {
+      if (cooked != nullptr) {
+        models.push_back(std::make_shared<GameModel>(device, cooked->get_view()));
+      } else {
+        models.push_back(std::make_shared<GameModel>(device, vertices[i], indices[i]));
+      }
+    }
+    device.end_upload_batch();
+    device.get_memory().log_statistics();
+    // Meshes are scaled to about the size of the cubes so the lattice spacing still fits them
+    float scale = cooked != nullptr && cooked->get_view().bounds.radius > 0.f ? 0.45f / cooked->get_view().bounds.radius : .5f;
+
+    side = static_cast<uint32_t>(std::ceil(std::cbrt(static_cast<double>(options.objects))));
+    float half = 0.5f * OBJECT_SPACING * static_cast<float>(side - 1);
+
+    EntityCommands commands{registry};
+    for (uint64_t i = 0; i < options.objects; i++) {
+      Transform transform{};
+      transform.current.translation = {
+        OBJECT_SPACING * static_cast<float>(i % side) - half,
+        OBJECT_SPACING * static_cast<float>((i / side) % side) - half,
+        OBJECT_SPACING * static_cast<float>(i / (static_cast<uint64_t>(side) * side)) - half};
+      transform.current.scale = {scale, scale, scale};
+      transform.current.rotation = {0.3f * static_cast<float>(i % 7), 0.2f * static_cast<float>(i % 11), 0.f};
+      transform.previous = transform.current;
+      commands.create(transform, Renderable{models[i % options.models].get(), {}});
+    }
+    commands.apply();
+    registry.log_statistics();
+    return models;
+  }
+
+  // Nearest-rank percentile over an already sorted sample
+  double percentile(const std::vector<double> &sorted, double p) {
+    size_t rank = static_cast<size_t>(std::ceil(p / 100.0 * static_cast<double>(sorted.size())));
+    return sorted[std::min(sorted.size() - 1, rank == 0 ? 0 : rank - 1)];
+  }
+
+  // pacing is what the render target ended up with, not what was asked for
+  bool write_results(const StressOptions &options, const FramePacing &pacing, const std::vector<FrameSample> &samples, double wall_seconds) {
+    std::vector<double> frame_times;
+    double frame_sum = 0.0;
+    double fence_sum = 0.0;
+    uint64_t draw_sum = 0;
+    uint64_t visible_sum = 0;
+    uint64_t culled_sum = 0;
+    uint64_t binds_saved_sum = 0;
+    uint64_t triangle_sum = 0;
+    for (const auto &sample : samples) {
+      frame_times.push_back(sample.frame_milliseconds);
+      frame_sum += sample.frame_milliseconds;
+      fence_sum += sample.fence_wait_milliseconds;
+      draw_sum += sample.draw_calls;
+      visible_sum += sample.visible;
+      culled_sum += sample.culled;
+      binds_saved_sum += sample.binds_saved;
+      triangle_sum += sample.triangles;
+    }
+    std::sort(frame_times.begin(), frame_times.end());
+    double count = static_cast<double>(samples.size());
+
+    Logger::get().flush();
+    FILE *file = options.output == "-" ? stdout : fopen(options.output.c_str(), "w");
+    if (file == nullptr) {
+      MAGE_ERROR(game) << "Failed to open benchmark output " << options.output;
+      return false;
+    }
+    fprintf(file, "{\n");
+    fprintf(file, "  \"objects\": %llu,\n", static_cast<unsigned long long>(options.objects));
+    fprintf(file, "  \"models\": %u,\n", options.models);
+    fprintf(file, "  \"camera\": \"%s\",\n", options.animated_camera ? "animated" : "static");
+    fprintf(file, "  \"instanced\": %s,\n", options.instanced ? "true" : "false");
+    fprintf(file, "  \"gpu_driven\": %s,\n", options.gpu_driven ? "true" : "false");
+    fprintf(file, "  \"cull\": %s,\n", options.cull ? "true" : "false");
+    fprintf(file, "  \"sort\": %s,\n", options.sort ? "true" : "false");
+    fprintf(file, "  \"lod\": %s,\n", options.lod ? "true" : "false");
+    fprintf(file, "  \"record_threads\": %u,\n", options.record_threads);
+    fprintf(file, "  \"job_threads\": %u,\n", JobSystem::get().get_thread_count());
+    fprintf(file, "  \"headless\": %s,\n", options.headless ? "true" : "false");
+    fprintf(file, "  \"frames_in_flight\": %u,\n", pacing.frames_in_flight);
+    fprintf(file, "  \"swap_images\": %u,\n", pacing.image_count);
+    fprintf(file, "  \"present_mode\": \"%s\",\n", present_mode_name(pacing.present_mode));
+    fprintf(file, "  \"frames\": %zu,\n", samples.size());
+    fprintf(file, "  \"warmup_frames\": %u,\n", options.warmup);
+    fprintf(file, "  \"frame_ms\": {\"mean\": %.4f, \"p50\": %.4f, \"p95\": %.4f, \"p99\": %.4f, \"max\": %.4f},\n",
+            frame_sum / count, percentile(frame_times, 50.0), percentile(frame_times, 95.0),
+            percentile(frame_times, 99.0), frame_times.back());
+    fprintf(file, "  \"fence_wait_ms\": {\"mean\": %.4f, \"total\": %.4f},\n", fence_sum / count, fence_sum);
+    fprintf(file, "  \"draw_calls_per_frame\": %.1f,\n", static_cast<double>(draw_sum) / count);
+    fprintf(file, "  \"visible_per_frame\": %.1f,\n", static_cast<double>(visible_sum) / count);
+    fprintf(file, "  \"culled_per_frame\": %.1f,\n", static_cast<double>(culled_sum) / count);
+    fprintf(file, "  \"binds_saved_per_frame\": %.1f,\n", static_cast<double>(binds_saved_sum) / count);
+    fprintf(file, "  \"triangles_per_frame\": %.1f,\n", static_cast<double>(triangle_sum) / count);
+    fprintf(file, "  \"objects_per_second\": %.1f\n", static_cast<double>(options.objects) * count / wall_seconds);
+    fprintf(file, "}\n");
+    if (file != stdout) {
+      fclose(file);
+      MAGE_INFO(game) << "Wrote stress scene results to " << options.output;
+    }
+    return true;
+  }
+
+}
+
+int main(int argc, char **argv) {
+  StressOptions options = parse_options(argc, argv);
+  MAGE_INFO(game) << "=== STRESS SCENE: " << options.objects << " object(s), " << options.models << " model(s) ===";
+  JobSystem::get().start(options.job_threads);
+
+  std::unique_ptr<Window> window;
+  std::unique_ptr<DeviceHandling> device;
+  std::unique_ptr<DrawHandling> artist;
+  if (options.headless) {
+    OffscreenInfo offscreen_info{};
+    offscreen_info.frames_in_flight = options.pacing.frames_in_flight;
+    device = std::make_unique<DeviceHandling>(nullptr);
+    artist = std::make_unique<DrawHandling>(*device, VkExtent2D{WIDTH, HEIGHT}, offscreen_info);
+  } else {
+    window = std::make_unique<Window>(WIDTH, HEIGHT, "Mage Stress Scene");
+    device = std::make_unique<DeviceHandling>(*window);
+    artist = std::make_unique<DrawHandling>(*window, *device, options.pacing);
+  }
+
+  uint32_t side = 1;
+  Registry registry;
+  std::vector<std::shared_ptr<GameModel>> models = build_scene(*device, registry, options, side);
+  std::vector<FrameSample> samples;
+  samples.reserve(options.frames);
+  {
+    RenderTarget *target = artist->get_render_target();
+    TransportPass transport{*device, artist->get_swapchain_render_pass(), static_cast<uint32_t>(target->get_max_frames())};
+    transport.get_culling().set_enabled(options.cull);
+    transport.get_queue().set_enabled(options.sort);
+    transport.get_lods().set_enabled(options.lod);
+    artist->set_record_threads(options.record_threads);
+    transport.set_recorder(artist->get_recorder());
+    if (options.gpu_driven && !transport.supports_gpu_driven()) {
+      MAGE_WARN(game) << "Device lacks drawIndirectFirstInstance, running --gpu-driven as --instanced";
+      options.gpu_driven = false;
+      options.instanced = true;
+    }
+    CameraHandling camera{};
+    float radius = OBJECT_SPACING * static_cast<float>(side) * 1.5f + 2.f;
+    VkExtent2D extent = target->get_swap_extent();
+    camera.set_perspective_projection(glm::radians(50.f), static_cast<float>(extent.width) / static_cast<float>(extent.height), 0.1f, radius * 3.f);
+
+    uint32_t total_frames = options.warmup + options.frames;
+    uint64_t measure_start = 0;
+    for (uint32_t frame = 0; frame < total_frames; frame++) {
+      if (window != nullptr) {
+        glfwPollEvents();
+        if (window->close_window()) {
+          break;
+        }
+      }
+      if (frame == options.warmup) {
+        measure_start = CpuProfiler::now();
+      }
+      uint64_t frame_start = CpuProfiler::now();
+      // A resize swaps the render target, the replacement carries the fence wait total over
+      uint64_t fence_start = artist->get_render_target()->get_fence_wait_nanoseconds();
+
+      float angle = options.animated_camera ? glm::two_pi<float>() * static_cast<float>(frame) / ORBIT_FRAMES : 0.f;
+      camera.set_view_target(glm::vec3(radius * glm::sin(angle), -0.4f * radius, -radius * glm::cos(angle)), glm::vec3(0.f), glm::vec3{0.f, -1.f, 0.f});
+
+      uint32_t draw_calls = 0;
+      uint32_t visible = 0;
+      uint32_t culled = 0;
+      uint32_t binds_saved = 0;
+      uint64_t triangles = 0;
+      if (auto command_buffer = artist->draw_start()) {
+        if (options.gpu_driven) {
+          transport.cull_on_gpu(command_buffer, *artist, registry, camera);
+        }
+        artist->swapchain_render_start(command_buffer);
+        if (options.gpu_driven) {
+          transport.render_game_objects_indirect(command_buffer, static_cast<uint32_t>(artist->get_frame_index()));
+        } else if (options.instanced) {
+          transport.render_game_objects_instanced(command_buffer, static_cast<uint32_t>(artist->get_frame_index()), registry, camera);
+        } else {
+          transport.render_game_objects(command_buffer, static_cast<uint32_t>(artist->get_frame_index()), registry, camera);
+          binds_saved = transport.get_queue().get_statistics().get_binds_saved();
+        }
+        draw_calls = transport.get_draw_count();
+        triangles = transport.get_lods().get_triangle_count();
+        if (options.gpu_driven) {
+          visible = transport.get_gpu_scene()->get_visible_count();
+          culled = static_cast<uint32_t>(options.objects) - visible;
+        } else {
+          visible = transport.get_culling().get_visible_count();
+          culled = transport.get_culling().get_culled_count();
+        }
+        artist->swapchain_render_end(command_buffer);
+        artist->draw_end();
+      }
+
+      if (frame >= options.warmup) {
+        samples.push_back({
+          (CpuProfiler::now() - frame_start) / 1e6,
+          (artist->get_render_target()->get_fence_wait_nanoseconds() - fence_start) / 1e6,
+          draw_calls,
+          visible,
+          culled,
+          binds_saved,
+          triangles});
+      }
+    }
+    double wall_seconds = (CpuProfiler::now() - measure_start) / 1e9;
+    vkDeviceWaitIdle(device->get_device());
+
+    if (samples.empty()) {
+      MAGE_ERROR(game) << "No frames were measured";
+      return EXIT_FAILURE;
+    }
+    if (!write_results(options, artist->get_frame_pacing(), samples, wall_seconds)) {
+      return EXIT_FAILURE;
+    }
+  }
+
+  // Models must go before the device they were allocated from
+  registry.clear();
+  models.clear();
+  artist.reset();
+  device.reset();
+  JobSystem::get().stop();
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,195 @@
+#include "object-resources/object.hpp"
+#include "object-resources/registry.hpp"
+#include "object-resources/transform.hpp"
+#include "debug-resources/log.hpp"
+#include "debug-resources/cpu-profiler.hpp"
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+using namespace mage;
+
+// CPU-only comparison of per-object tranform_components::mat4 plus a separate projection-view multiply
+// against the batched TransformSystem, no device or window needed.
+//
+//   mage-transform-bench [--objects 10000,1000000] [--iterations N] [--output results.json|-]
+//
+// Each scene size is measured with every object moving, with only the camera moving, and fully static.
+
+namespace {
+
+  struct BenchOptions {
+    std::vector<uint32_t> object_counts = {10000, 1000000};
+    uint32_t iterations = 0;
+    std::string output = "transform-bench.json";
+  };
+
+  struct BenchResult {
+    uint32_t objects;
+    const char *scenario;
+    double per_object_ms;
+    double batched_ms;
+    uint32_t rebuilt;
+  };
+
+  // Sink for matrices so the per-object path cannot be optimized away
+  volatile float checksum_sink = 0.f;
+
+  BenchOptions parse_options(int argc, char **argv) {
+    BenchOptions options{};
+    for (int i = 1; i < argc; i++) {
+      std::string argument = argv[i];
+      bool has_value = i + 1 < argc;
+      if (argument == "--objects" && has_value) {
+        options.object_counts.clear();
+        std::string list = argv[++i];
+        size_t start = 0;
+        while (start < list.size()) {
+          size_t end = list.find(',', start);
+          end = end == std::string::npos ? list.size() : end;
+          uint32_t count = static_cast<uint32_t>(std::strtoul(list.substr(start, end - start).c_str(), nullptr, 10));
+          if (count > 0) {
+            options.object_counts.push_back(count);
+          }
+          start = end + 1;
+        }
+      } else if (argument == "--iterations" && has_value) {
+        options.iterations = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+      } else if (argument == "--output" && has_value) {
+        options.output = argv[++i];
+      } else {
+        MAGE_WARN(game) << "Ignoring unknown argument " << argument;
+      }
+    }
+    return options;
+  }
+
+  // Entities carry a Renderable so they land in the same view TransportPass feeds the transform system, no model is needed here
+  void build_objects(Registry &registry, uint32_t count) {
+    registry.clear();
+    EntityCommands commands{registry};
+    for (uint32_t i = 0; i < count; i++) {
+      Transform transform{};
+      transform.current.translation = {static_cast<float>(i % 100), static_cast<float>((i / 100) % 100), static_cast<float>(i / 10000)};
+      transform.current.rotation = {0.01f * static_cast<float>(i % 628), 0.02f * static_cast<float>(i % 314), 0.f};
+      transform.current.scale = {.5f, .5f, .5f};
+      transform.previous = transform.current;
+      commands.create(transform, Renderable{});
+    }
+    commands.apply();
+  }
+
+  glm::mat4 camera_matrix(uint32_t iteration) {
+    glm::mat4 projection_view{1.f};
+    projection_view[3][2] = 1.f + 0.001f * static_cast<float>(iteration);
+    return projection_view;
+  }
+
+  void step_objects(Registry &registry) {
+    registry.view<Transform>().each([](Entity, Transform &transform) {
+      transform.previous = transform.current;
+      transform.current.rotation.y += 0.01f;
+    });
+  }
+
+  // The path TransportPass used before TransformSystem: full interpolation, trig and two matrix products per object
+  double run_per_object(Registry &registry, uint32_t count, uint32_t iterations, bool move_objects, bool move_camera) {
+    build_objects(registry, count);
+    auto drawables = registry.view<Transform, Renderable>();
+    std::vector<glm::mat4> mvps(count);
+    uint64_t total = 0;
+    for (uint32_t iteration = 0; iteration < iterations; iteration++) {
+      if (move_objects) {
+        step_objects(registry);
+      }
+      glm::mat4 projection_view = camera_matrix(move_camera ? iteration : 0);
+      uint64_t start = CpuProfiler::now();
+      uint32_t i = 0;
+      drawables.each([&](Entity, Transform &transform, Renderable &) {
+        mvps[i++] = projection_view * tranform_components::interpolate(transform.previous, transform.current, 0.5f).mat4();
+      });
+      total += CpuProfiler::now() - start;
+      checksum_sink = checksum_sink + mvps[iteration % mvps.size()][3][0];
+    }
+    return total / 1e6 / iterations;
+  }
+
+  double run_batched(Registry &registry, uint32_t count, uint32_t iterations, bool move_objects, bool move_camera, uint32_t &rebuilt) {
+    build_objects(registry, count);
+    auto drawables = registry.view<Transform, Renderable>();
+    TransformSystem transforms;
+    // The first update builds everything, it is a load cost rather than a per-frame one
+    transforms.update(drawables, 0.5f, camera_matrix(0));
+    uint64_t total = 0;
+    rebuilt = 0;
+    for (uint32_t iteration = 0; iteration < iterations; iteration++) {
+      if (move_objects) {
+        step_objects(registry);
+      }
+      glm::mat4 projection_view = camera_matrix(move_camera ? iteration + 1 : 0);
+      uint64_t start = CpuProfiler::now();
+      transforms.update(drawables, 0.5f, projection_view);
+      total += CpuProfiler::now() - start;
+      rebuilt = std::max(rebuilt, transforms.get_rebuilt_count());
+      checksum_sink = checksum_sink + transforms.get_mvp(iteration % transforms.get_object_count())[3][0];
+    }
+    return total / 1e6 / iterations;
+  }
+
+  bool write_results(const BenchOptions &options, const std::vector<BenchResult> &results) {
+    Logger::get().flush();
+    FILE *file = options.output == "-" ? stdout : fopen(options.output.c_str(), "w");
+    if (file == nullptr) {
+      MAGE_ERROR(game) << "Failed to open benchmark output " << options.output;
+      return false;
+    }
+    fprintf(file, "{\n  \"results\": [\n");
+    for (size_t i = 0; i < results.size(); i++) {
+      const auto &result = results[i];
+      fprintf(file, "    {\"objects\": %u, \"scenario\": \"%s\", \"per_object_ms\": %.4f, \"batched_ms\": %.4f, \"speedup\": %.2f, \"rebuilt\": %u}%s\n",
+              result.objects, result.scenario, result.per_object_ms, result.batched_ms,
+              result.batched_ms > 0.0 ? result.per_object_ms / result.batched_ms : 0.0, result.rebuilt,
+              i + 1 < results.size() ? "," : "");
+    }
+    fprintf(file, "  ]\n}\n");
+    if (file != stdout) {
+      fclose(file);
+      MAGE_INFO(game) << "Wrote transform benchmark results to " << options.output;
+    }
+    return true;
+  }
+
+}
+
+int main(int argc, char **argv) {
+  BenchOptions options = parse_options(argc, argv);
+  struct Scenario {
+    const char *name;
+    bool move_objects;
+    bool move_camera;
+  };
+  const Scenario scenarios[] = {{"all_moving", true, true}, {"camera_moving", false, true}, {"static", false, false}};
+
+  std::vector<BenchResult> results;
+  Registry registry;
+  for (uint32_t count : options.object_counts) {
+    // Roughly the same total work per size unless the caller pins it
+    uint32_t iterations = options.iterations > 0 ? options.iterations : std::max(5u, 20000000u / count);
+    for (const auto &scenario : scenarios) {
+      BenchResult result{count, scenario.name, 0.0, 0.0, 0};
+      result.per_object_ms = run_per_object(registry, count, iterations, scenario.move_objects, scenario.move_camera);
+      result.batched_ms = run_batched(registry, count, iterations, scenario.move_objects, scenario.move_camera, result.rebuilt);
+      MAGE_INFO(game) << count << " object(s), " << scenario.name << ": per-object " << result.per_object_ms
+                      << " ms, batched " << result.batched_ms << " ms";
+      results.push_back(result);
+    }
+  }
+  return write_results(options, results) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -2,3 +2,6 @@
 
 /usr/bin/glslc src/shaders/shader.vert -o src/shaders/vert.spv
 /usr/bin/glslc src/shaders/shader.frag -o src/shaders/frag.spv
+/usr/bin/glslc src/shaders/instanced.vert -o src/shaders/instanced-vert.spv
+/usr/bin/glslc src/shaders/gpu-cull.comp -o src/shaders/gpu-cull-comp.spv
+/usr/bin/glslc src/shaders/gpu-compact.comp -o src/shaders/gpu-compact-comp.spv
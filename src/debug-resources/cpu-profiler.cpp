@@ -0,0 +1,130 @@
+#include "cpu-profiler.hpp"
+#include "log.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+using namespace mage;
+
+CpuProfiler &CpuProfiler::get(){
+	static CpuProfiler profiler;
+	return profiler;
+}
+
+// Nanoseconds on the steady clock, only differences and the trace's relative origin matter
+uint64_t CpuProfiler::now(){
+	return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+// Registers the calling thread on first use; the mutex is only taken once per thread
+CpuProfiler::ThreadBuffer &CpuProfiler::thread_buffer(){
+	thread_local ThreadBuffer *buffer = nullptr;
+	if (buffer == nullptr) {
+		auto created = std::make_unique<ThreadBuffer>();
+		created->events.resize(EVENTS_PER_THREAD);
+		std::lock_guard<std::mutex> lock(registry_mutex);
+		created->thread_id = static_cast<uint32_t>(buffers.size());
+		created->thread_name = created->thread_id == 0 ? "main" : "worker " + std::to_string(created->thread_id);
+		buffer = created.get();
+		buffers.push_back(std::move(created));
+	}
+	return *buffer;
+}
+
+void CpuProfiler::set_thread_name(const std::string &name){
+	ThreadBuffer &buffer = thread_buffer();
+	std::lock_guard<std::mutex> lock(registry_mutex);
+	buffer.thread_name = name;
+}
+
+// Start capturing on the next frame, the trace is written after `frames` calls to frame_mark()
+void CpuProfiler::request_capture(uint32_t frames, const std::string &path){
+	if (capturing.load(std::memory_order_relaxed) || frames == 0) {
+		return;
+	}
+	MAGE_INFO(profile) << "Capturing " << frames << " frame(s) of CPU zones to " << path << "...";
+	output_path = path;
+	frames_remaining = frames;
+	dropped.store(0, std::memory_order_relaxed);
+	generation.fetch_add(1, std::memory_order_relaxed);
+	capturing.store(true, std::memory_order_release);
+}
+
+void CpuProfiler::frame_mark(){
+	if (!capturing.load(std::memory_order_relaxed)) {
+		return;
+	}
+	if (--frames_remaining == 0) {
+		capturing.store(false, std::memory_order_release);
+		write_trace(output_path);
+	}
+}
+
+// Buffers from an older capture are rewound lazily by their own thread, so no writer is ever reset from outside
+void CpuProfiler::record(const char *name, uint64_t start, uint64_t end){
+	ThreadBuffer &buffer = thread_buffer();
+	uint32_t current_generation = generation.load(std::memory_order_relaxed);
+	if (buffer.generation.load(std::memory_order_relaxed) != current_generation) {
+		buffer.count.store(0, std::memory_order_relaxed);
+		buffer.generation.store(current_generation, std::memory_order_release);
+	}
+	size_t index = buffer.count.load(std::memory_order_relaxed);
+	if (index >= EVENTS_PER_THREAD) {
+		dropped.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+	buffer.events[index] = {name, start, end};
+	buffer.count.store(index + 1, std::memory_order_release);
+}
+
+bool CpuProfiler::write_trace(const std::string &path){
+	FILE *file = fopen(path.c_str(), "w");
+	if (file == nullptr) {
+		MAGE_ERROR(profile) << "Failed to open CPU trace file " << path;
+		return false;
+	}
+
+	std::lock_guard<std::mutex> lock(registry_mutex);
+	uint32_t current_generation = generation.load(std::memory_order_relaxed);
+	uint64_t origin = UINT64_MAX;
+	for (const auto &buffer : buffers) {
+		if (buffer->generation.load(std::memory_order_acquire) != current_generation) {
+			continue;
+		}
+		size_t count = buffer->count.load(std::memory_order_acquire);
+		for (size_t i = 0; i < count; i++) {
+			origin = std::min(origin, buffer->events[i].start);
+		}
+	}
+
+	size_t written = 0;
+	fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+	bool first = true;
+	for (const auto &buffer : buffers) {
+		fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+		        first ? "" : ",\n", buffer->thread_id, buffer->thread_name.c_str());
+		first = false;
+		if (buffer->generation.load(std::memory_order_acquire) != current_generation) {
+			continue;
+		}
+		size_t count = buffer->count.load(std::memory_order_acquire);
+		for (size_t i = 0; i < count; i++) {
+			const ProfileEvent &event = buffer->events[i];
+			fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+			        event.name, buffer->thread_id,
+			        (event.start - origin) / 1000.0, (event.end - event.start) / 1000.0);
+		}
+		written += count;
+	}
+	fprintf(file, "\n]}\n");
+	fclose(file);
+
+	MAGE_INFO(profile) << " - wrote " << written << " CPU zone(s) to " << path;
+	uint64_t lost = dropped.load(std::memory_order_relaxed);
+	if (lost > 0) {
+		MAGE_WARN(profile) << " - " << lost << " zone(s) dropped, per-thread buffer was full";
+	}
+	return true;
+}
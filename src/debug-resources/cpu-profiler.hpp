@@ -0,0 +1,91 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Set to 0 through CMake's MAGE_ENABLE_PROFILER to strip every zone out of the build
+#ifndef MAGE_PROFILER
+#define MAGE_PROFILER 1
+#endif
+
+namespace mage {
+
+	// Zone names are stored by pointer, so they must be string literals (or otherwise outlive the capture)
+	struct ProfileEvent {
+		const char *name;
+		uint64_t start;
+		uint64_t end;
+	};
+
+	// Records RAII zones into per-thread buffers while a capture is running and writes them out as a
+	// chrome://tracing / Perfetto JSON file once the requested number of frames has been marked.
+	class CpuProfiler {
+	private:
+		static constexpr size_t EVENTS_PER_THREAD = 1 << 16;
+		// Only the owning thread writes events; count is published with release so the exporter can read it
+		struct ThreadBuffer {
+			std::vector<ProfileEvent> events;
+			std::atomic<size_t> count{0};
+			std::atomic<uint32_t> generation{0};
+			uint32_t thread_id = 0;
+			std::string thread_name;
+		};
+		std::mutex registry_mutex;
+		std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+		std::atomic<bool> capturing{false};
+		std::atomic<uint32_t> generation{1};
+		std::atomic<uint64_t> dropped{0};
+		uint32_t frames_remaining = 0;
+		std::string output_path;
+		CpuProfiler() = default;
+		ThreadBuffer &thread_buffer();
+	public:
+		CpuProfiler(const CpuProfiler&) = delete;
+		CpuProfiler &operator=(const CpuProfiler&) = delete;
+		static CpuProfiler &get();
+		static uint64_t now();
+		void request_capture(uint32_t frames, const std::string &path);
+		void frame_mark();
+		void record(const char *name, uint64_t start, uint64_t end);
+		void set_thread_name(const std::string &name);
+		bool write_trace(const std::string &path);
+
+		bool is_capturing() const {return capturing.load(std::memory_order_relaxed);}
+	};
+
+	class ProfileZone {
+	private:
+		const char *name;
+		uint64_t start = 0;
+		bool active;
+	public:
+		explicit ProfileZone(const char *name_pass) : name{name_pass}, active{CpuProfiler::get().is_capturing()} {
+			if (active) {
+				start = CpuProfiler::now();
+			}
+		}
+		~ProfileZone() {
+			if (active) {
+				CpuProfiler::get().record(name, start, CpuProfiler::now());
+			}
+		}
+		ProfileZone(const ProfileZone&) = delete;
+		ProfileZone &operator=(const ProfileZone&) = delete;
+	};
+
+}
+
+#define MAGE_PROFILE_CONCAT_INNER(a, b) a##b
+#define MAGE_PROFILE_CONCAT(a, b) MAGE_PROFILE_CONCAT_INNER(a, b)
+
+#if MAGE_PROFILER
+#define MAGE_PROFILE_ZONE(name) mage::ProfileZone MAGE_PROFILE_CONCAT(profile_zone_, __LINE__){name}
+#define MAGE_PROFILE_FRAME() mage::CpuProfiler::get().frame_mark()
+#else
+#define MAGE_PROFILE_ZONE(name) do {} while (0)
+#define MAGE_PROFILE_FRAME() do {} while (0)
+#endif
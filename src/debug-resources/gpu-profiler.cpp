@@ -0,0 +1,176 @@
+#include "gpu-profiler.hpp"
+#include "log.hpp"
+
+#include <cstdio>
+#include <cstring>
+
+using namespace mage;
+
+GpuProfiler::GpuProfiler(DeviceHandling &device_pass, uint32_t frames_in_flight, uint32_t max_queries_per_frame) : device{device_pass}, max_queries{max_queries_per_frame} {
+	MAGE_INFO(profile) << "Attempting to create GPU profiler...";
+
+	// Timestamps need a non-zero period on the device and valid bits on the graphics family
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(device.get_card(), &properties);
+	uint32_t family_count = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(device.get_card(), &family_count, nullptr);
+	std::vector<VkQueueFamilyProperties> families(family_count);
+	vkGetPhysicalDeviceQueueFamilyProperties(device.get_card(), &family_count, families.data());
+	uint32_t valid_bits = families[device.get_queue_families().graphics_family].timestampValidBits;
+	if (properties.limits.timestampPeriod <= 0.0f || valid_bits == 0) {
+		MAGE_WARN(profile) << " - timestamps not supported on " << properties.deviceName << ", GPU profiling disabled";
+		return;
+	}
+	nanoseconds_per_tick = properties.limits.timestampPeriod;
+	timestamp_mask = valid_bits >= 64 ? ~0ull : ((1ull << valid_bits) - 1);
+
+	MAGE_INFO(profile) << " - creating " << frames_in_flight << " timestamp query pool(s)...";
+	frames.resize(frames_in_flight);
+	for (auto &frame : frames) {
+		VkQueryPoolCreateInfo pool_info{};
+		pool_info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		pool_info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+		pool_info.queryCount = max_queries;
+		if (vkCreateQueryPool(device.get_device(), &pool_info, nullptr, &frame.pool) != VK_SUCCESS) {
+			MAGE_ERROR(profile) << "Failed to create timestamp query pool, GPU profiling disabled";
+			return;
+		}
+		frame.scopes.reserve(max_queries / 2);
+	}
+	query_data.resize(static_cast<size_t>(max_queries) * 2);
+	supported = true;
+	MAGE_INFO(profile) << " - GPU profiler creation successful!";
+}
+
+// Read back this slot's previous frame (its fence has already been waited on), then reset the pool.
+// Must be called outside a render pass, right after the command buffer begins.
+void GpuProfiler::begin_frame(VkCommandBuffer command_buffer, uint32_t frame_index){
+	if (!supported) {
+		return;
+	}
+	current_frame = frame_index;
+	current_depth = 0;
+	FrameQueries &frame = frames[current_frame];
+	if (frame.recorded) {
+		collect(frame);
+	}
+
+	vkCmdResetQueryPool(command_buffer, frame.pool, 0, max_queries);
+	frame.scopes.clear();
+	frame.query_count = 0;
+	frame.frame_number = frame_number++;
+	frame.recorded = true;
+}
+
+uint32_t GpuProfiler::begin_scope(VkCommandBuffer command_buffer, const char *name){
+	if (!supported) {
+		return INVALID_SCOPE;
+	}
+	FrameQueries &frame = frames[current_frame];
+	if (frame.query_count + 2 > max_queries) {
+		return INVALID_SCOPE;
+	}
+	Scope scope{name, current_depth++, frame.query_count, frame.query_count + 1};
+	frame.query_count += 2;
+	vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, frame.pool, scope.begin_query);
+	frame.scopes.push_back(scope);
+	return static_cast<uint32_t>(frame.scopes.size() - 1);
+}
+
+void GpuProfiler::end_scope(VkCommandBuffer command_buffer, uint32_t scope){
+	if (!supported || scope == INVALID_SCOPE) {
+		return;
+	}
+	FrameQueries &frame = frames[current_frame];
+	current_depth--;
+	vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, frame.pool, frame.scopes[scope].end_query);
+}
+
+// Non-blocking readback: queries that aren't available yet are skipped rather than waited on
+void GpuProfiler::collect(FrameQueries &frame){
+	if (frame.query_count == 0) {
+		return;
+	}
+	VkResult result = vkGetQueryPoolResults(device.get_device(), frame.pool, 0, frame.query_count,
+	                                        sizeof(uint64_t) * 2 * frame.query_count, query_data.data(), sizeof(uint64_t) * 2,
+	                                        VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+	if (result != VK_SUCCESS && result != VK_NOT_READY) {
+		return;
+	}
+
+	latest_results.clear();
+	for (const auto &scope : frame.scopes) {
+		const uint64_t *begin = &query_data[scope.begin_query * 2];
+		const uint64_t *end = &query_data[scope.end_query * 2];
+		if (begin[1] == 0 || end[1] == 0) {
+			continue;
+		}
+		uint64_t ticks = ((end[0] & timestamp_mask) - (begin[0] & timestamp_mask)) & timestamp_mask;
+		latest_results.push_back({scope.name, scope.depth, ticks * nanoseconds_per_tick / 1000000.0});
+	}
+	latest_frame = frame.frame_number;
+	if (csv.is_open()) {
+		write_csv();
+	}
+}
+
+double GpuProfiler::get_scope_milliseconds(const char *name) const {
+	double total = 0.0;
+	for (const auto &timing : latest_results) {
+		if (strcmp(timing.name, name) == 0) {
+			total += timing.milliseconds;
+		}
+	}
+	return total;
+}
+
+// Append every resolved frame to a CSV; once max_rows is reached the file rolls over to <path>.1
+void GpuProfiler::open_csv(const std::string &path, size_t max_rows){
+	csv_path = path;
+	csv_max_rows = max_rows;
+	csv_rows = 0;
+	csv.open(csv_path, std::ios::out | std::ios::trunc);
+	if (!csv.is_open()) {
+		MAGE_ERROR(profile) << "Failed to open GPU profile CSV " << csv_path;
+		return;
+	}
+	csv << "frame,scope,depth,milliseconds\n";
+}
+
+void GpuProfiler::write_csv(){
+	if (csv_max_rows > 0 && csv_rows >= csv_max_rows) {
+		csv.close();
+		std::string rolled = csv_path + ".1";
+		std::remove(rolled.c_str());
+		std::rename(csv_path.c_str(), rolled.c_str());
+		open_csv(csv_path, csv_max_rows);
+	}
+	for (const auto &timing : latest_results) {
+		csv << latest_frame << ',' << timing.name << ',' << timing.depth << ',' << timing.milliseconds << '\n';
+		csv_rows++;
+	}
+}
+
+GpuProfiler::~GpuProfiler(){
+	if (csv.is_open()) {
+		csv.close();
+	}
+	for (auto &frame : frames) {
+		if (frame.pool != VK_NULL_HANDLE) {
+			vkDestroyQueryPool(device.get_device(), frame.pool, nullptr);
+		}
+	}
+}
+
+
+GpuScope::GpuScope(GpuProfiler *profiler_pass, VkCommandBuffer command_buffer_pass, const char *name) : profiler{profiler_pass}, command_buffer{command_buffer_pass} {
+	if (profiler != nullptr) {
+		scope = profiler->begin_scope(command_buffer, name);
+	}
+}
+
+GpuScope::~GpuScope(){
+	if (profiler != nullptr) {
+		profiler->end_scope(command_buffer, scope);
+	}
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "../pipeline-resources/device.hpp"
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace mage {
+
+	// Scope names are stored by pointer, so they must outlive the profiler (string literals in practice)
+	struct GpuScopeTiming {
+		const char *name;
+		uint32_t depth;
+		double milliseconds;
+	};
+
+	// Timestamp-query profiler with one query pool per frame in flight. A frame's queries are read back
+	// the next time that frame slot comes around, after its fence has been waited on, so reading results
+	// never stalls the queue.
+	class GpuProfiler {
+	private:
+		struct Scope {
+			const char *name;
+			uint32_t depth;
+			uint32_t begin_query;
+			uint32_t end_query;
+		};
+		struct FrameQueries {
+			VkQueryPool pool = VK_NULL_HANDLE;
+			std::vector<Scope> scopes;
+			uint32_t query_count = 0;
+			uint64_t frame_number = 0;
+			bool recorded = false;
+		};
+		DeviceHandling &device;
+		std::vector<FrameQueries> frames;
+		std::vector<uint64_t> query_data;
+		uint32_t max_queries;
+		uint32_t current_frame = 0;
+		uint32_t current_depth = 0;
+		uint64_t frame_number = 0;
+		uint64_t timestamp_mask = ~0ull;
+		double nanoseconds_per_tick = 1.0;
+		bool supported = false;
+		std::vector<GpuScopeTiming> latest_results;
+		uint64_t latest_frame = 0;
+		std::ofstream csv;
+		std::string csv_path;
+		size_t csv_rows = 0;
+		size_t csv_max_rows = 0;
+		void collect(FrameQueries &frame);
+		void write_csv();
+	public:
+		static const uint32_t INVALID_SCOPE = ~0u;
+		GpuProfiler(DeviceHandling &device_pass, uint32_t frames_in_flight, uint32_t max_queries_per_frame = 512);
+		~GpuProfiler();
+		void begin_frame(VkCommandBuffer command_buffer, uint32_t frame_index);
+		uint32_t begin_scope(VkCommandBuffer command_buffer, const char *name);
+		void end_scope(VkCommandBuffer command_buffer, uint32_t scope);
+		void open_csv(const std::string &path, size_t max_rows = 100000);
+		double get_scope_milliseconds(const char *name) const;
+
+		bool is_supported() const {return supported;}
+		const std::vector<GpuScopeTiming> &get_results() const {return latest_results;}
+		uint64_t get_results_frame() const {return latest_frame;}
+	};
+
+	// Wraps a render pass, a TransportPass call or a single draw; a null profiler makes it a no-op
+	class GpuScope {
+	private:
+		GpuProfiler *profiler;
+		VkCommandBuffer command_buffer;
+		uint32_t scope = GpuProfiler::INVALID_SCOPE;
+	public:
+		GpuScope(GpuProfiler *profiler_pass, VkCommandBuffer command_buffer_pass, const char *name);
+		~GpuScope();
+		GpuScope(const GpuScope&) = delete;
+		GpuScope &operator=(const GpuScope&) = delete;
+	};
+
+}
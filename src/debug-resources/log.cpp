@@ -0,0 +1,182 @@
+#include "log.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+using namespace mage;
+
+namespace {
+
+	const char *level_names[] = {"trace", "debug", "info", "warn", "error"};
+	const char *category_names[] = {"device", "swapchain", "pipeline", "model", "frame", "game", "profile", "jobs"};
+
+}
+
+void LogLine::append(const char *data, size_t size){
+	size_t space = LINE_SIZE - length;
+	size_t count = std::min(size, space);
+	memcpy(text + length, data, count);
+	length += count;
+}
+
+LogLine &LogLine::operator<<(const char *value){
+	if (value == nullptr) {
+		value = "(null)";
+	}
+	append(value, strlen(value));
+	return *this;
+}
+
+LogLine &LogLine::operator<<(double value){
+	char buffer[32];
+	int size = snprintf(buffer, sizeof(buffer), "%g", value);
+	append(buffer, static_cast<size_t>(std::max(size, 0)));
+	return *this;
+}
+
+LogLine &LogLine::operator<<(const void *value){
+	char buffer[32];
+	int size = snprintf(buffer, sizeof(buffer), "%p", value);
+	append(buffer, static_cast<size_t>(std::max(size, 0)));
+	return *this;
+}
+
+LogLine &LogLine::write_signed(long long value){
+	char buffer[24];
+	int size = snprintf(buffer, sizeof(buffer), "%lld", value);
+	append(buffer, static_cast<size_t>(std::max(size, 0)));
+	return *this;
+}
+
+LogLine &LogLine::write_unsigned(unsigned long long value){
+	char buffer[24];
+	int size = snprintf(buffer, sizeof(buffer), "%llu", value);
+	append(buffer, static_cast<size_t>(std::max(size, 0)));
+	return *this;
+}
+
+LogLine::~LogLine(){
+	Logger::get().push(level, category, text, length);
+}
+
+
+Logger::Logger(){
+	for (size_t i = 0; i < RING_SIZE; i++) {
+		ring[i].sequence.store(i, std::memory_order_relaxed);
+	}
+	drain_thread = std::thread(&Logger::drain_loop, this);
+}
+
+// Constructed on first use so programs that never log never start the drain thread
+Logger &Logger::get(){
+	static Logger logger;
+	return logger;
+}
+
+bool Logger::enabled(LogCategory category){
+	return (get().category_mask.load(std::memory_order_relaxed) >> static_cast<uint32_t>(category)) & 1u;
+}
+
+void Logger::set_category_enabled(LogCategory category, bool enable){
+	uint32_t bit = 1u << static_cast<uint32_t>(category);
+	if (enable) {
+		category_mask.fetch_or(bit, std::memory_order_relaxed);
+	} else {
+		category_mask.fetch_and(~bit, std::memory_order_relaxed);
+	}
+}
+
+// Bounded MPSC ring: producers claim a slot with a CAS on write_position and publish it through the
+// slot sequence. When the ring is full, trace and debug lines are dropped and
+// everything else spins until the drain thread frees a slot.
+void Logger::push(LogLevel level, LogCategory category, const char *text, size_t length){
+	size_t position = write_position.load(std::memory_order_relaxed);
+	Slot *slot;
+	while (true) {
+		slot = &ring[position % RING_SIZE];
+		size_t sequence = slot->sequence.load(std::memory_order_acquire);
+		intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+		if (difference == 0) {
+			if (write_position.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+				break;
+			}
+		} else if (difference < 0) {
+			if (level < LogLevel::info) {
+				dropped.fetch_add(1, std::memory_order_relaxed);
+				return;
+			}
+			std::this_thread::yield();
+			position = write_position.load(std::memory_order_relaxed);
+		} else {
+			position = write_position.load(std::memory_order_relaxed);
+		}
+	}
+
+	slot->level = level;
+	slot->category = category;
+	slot->length = static_cast<uint16_t>(std::min(length, MESSAGE_SIZE));
+	memcpy(slot->text, text, slot->length);
+	slot->sequence.store(position + 1, std::memory_order_release);
+}
+
+// Write out every published line, returns false when the ring was empty
+bool Logger::drain_once(){
+	bool wrote = false;
+	while (true) {
+		Slot &slot = ring[read_position % RING_SIZE];
+		if (slot.sequence.load(std::memory_order_acquire) != read_position + 1) {
+			break;
+		}
+		FILE *stream = slot.level >= LogLevel::warn ? stderr : stdout;
+		if (slot.level == LogLevel::info) {
+			fprintf(stream, "%.*s\n", static_cast<int>(slot.length), slot.text);
+		} else {
+			fprintf(stream, "[%s][%s] %.*s\n",
+			        level_names[static_cast<int>(slot.level)],
+			        category_names[static_cast<int>(slot.category)],
+			        static_cast<int>(slot.length), slot.text);
+		}
+		slot.sequence.store(read_position + RING_SIZE, std::memory_order_release);
+		read_position++;
+		wrote = true;
+	}
+	if (wrote) {
+		fflush(stdout);
+		fflush(stderr);
+	}
+	return wrote;
+}
+
+void Logger::drain_loop(){
+	while (running.load(std::memory_order_acquire)) {
+		if (!drain_once()) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+	}
+	drain_once();
+}
+
+// Blocks until everything pushed so far has been written
+void Logger::flush(){
+	size_t target = write_position.load(std::memory_order_acquire);
+	if (target == 0) {
+		return;
+	}
+	Slot &last = ring[(target - 1) % RING_SIZE];
+	while (last.sequence.load(std::memory_order_acquire) < target - 1 + RING_SIZE) {
+		std::this_thread::yield();
+	}
+}
+
+Logger::~Logger(){
+	running.store(false, std::memory_order_release);
+	if (drain_thread.joinable()) {
+		drain_thread.join();
+	}
+	uint64_t lost = dropped.load(std::memory_order_relaxed);
+	if (lost > 0) {
+		fprintf(stderr, "[warn][log] %llu log lines dropped, ring was full\n", static_cast<unsigned long long>(lost));
+	}
+}
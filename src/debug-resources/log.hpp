@@ -0,0 +1,99 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <type_traits>
+
+// Lowest severity that is compiled in at all (0 = trace ... 4 = error).
+// Anything below it is removed by the compiler, set through CMake's MAGE_LOG_LEVEL.
+#ifndef MAGE_LOG_LEVEL
+#define MAGE_LOG_LEVEL 2
+#endif
+
+namespace mage {
+
+	enum class LogLevel : uint8_t {trace = 0, debug = 1, info = 2, warn = 3, error = 4};
+
+	enum class LogCategory : uint8_t {device = 0, swapchain, pipeline, model, frame, game, profile, jobs, count};
+
+	// Single formatted line, built on the stack and handed to the logger when it goes out of scope
+	class LogLine {
+	private:
+		static constexpr size_t LINE_SIZE = 240;
+		char text[LINE_SIZE];
+		size_t length = 0;
+		LogLevel level;
+		LogCategory category;
+		void append(const char *data, size_t size);
+	public:
+		LogLine(LogLevel level_pass, LogCategory category_pass) : level{level_pass}, category{category_pass} {}
+		~LogLine();
+		LogLine(const LogLine&) = delete;
+		LogLine &operator=(const LogLine&) = delete;
+
+		LogLine &operator<<(const char *value);
+		LogLine &operator<<(const std::string &value) {append(value.data(), value.size()); return *this;}
+		LogLine &operator<<(char value) {append(&value, 1); return *this;}
+		LogLine &operator<<(bool value) {return *this << (value ? "true" : "false");}
+		LogLine &operator<<(double value);
+		LogLine &operator<<(const void *value);
+		template <typename T, typename = std::enable_if_t<std::is_integral<T>::value>>
+		LogLine &operator<<(T value) {
+			if (std::is_signed<T>::value) {
+				return write_signed(static_cast<long long>(value));
+			}
+			return write_unsigned(static_cast<unsigned long long>(value));
+		}
+		LogLine &write_signed(long long value);
+		LogLine &write_unsigned(unsigned long long value);
+	};
+
+	// Owns a lock-free multi-producer ring of log lines and the background thread that drains it
+	class Logger {
+	private:
+		static constexpr size_t RING_SIZE = 1024;
+		static constexpr size_t MESSAGE_SIZE = 240;
+		struct Slot {
+			std::atomic<size_t> sequence;
+			LogLevel level;
+			LogCategory category;
+			uint16_t length;
+			char text[MESSAGE_SIZE];
+		};
+		Slot ring[RING_SIZE];
+		alignas(64) std::atomic<size_t> write_position{0};
+		alignas(64) size_t read_position = 0;
+		std::atomic<uint32_t> category_mask{~0u};
+		std::atomic<uint64_t> dropped{0};
+		std::atomic<bool> running{true};
+		std::thread drain_thread;
+		Logger();
+		void drain_loop();
+		bool drain_once();
+	public:
+		~Logger();
+		Logger(const Logger&) = delete;
+		Logger &operator=(const Logger&) = delete;
+		static Logger &get();
+		static bool enabled(LogCategory category);
+		void push(LogLevel level, LogCategory category, const char *text, size_t length);
+		void flush();
+		void set_category_enabled(LogCategory category, bool enable);
+		uint64_t get_dropped_count() const {return dropped.load(std::memory_order_relaxed);}
+	};
+
+}
+
+#define MAGE_LOG(level, category) \
+	if (static_cast<int>(mage::LogLevel::level) < MAGE_LOG_LEVEL) {} \
+	else if (!mage::Logger::enabled(mage::LogCategory::category)) {} \
+	else mage::LogLine(mage::LogLevel::level, mage::LogCategory::category)
+
+#define MAGE_TRACE(category) MAGE_LOG(trace, category)
+#define MAGE_DEBUG(category) MAGE_LOG(debug, category)
+#define MAGE_INFO(category) MAGE_LOG(info, category)
+#define MAGE_WARN(category) MAGE_LOG(warn, category)
+#define MAGE_ERROR(category) MAGE_LOG(error, category)
@@ -0,0 +1,269 @@
+#include "jobs.hpp"
+#include "../debug-resources/log.hpp"
+#include "../debug-resources/cpu-profiler.hpp"
+
+#include <string>
+
+using namespace mage;
+
+namespace {
+
+	thread_local int32_t thread_index = -1;
+
+	// Jobs go back to whichever thread finished them, so a list only ever grows to what that thread has been running
+	struct FreeJobs {
+		std::vector<Job*> jobs;
+		~FreeJobs() {
+			for (Job *job : jobs) {
+				delete job;
+			}
+		}
+	};
+	thread_local FreeJobs free_jobs;
+
+}
+
+// Capacity is fixed, a full deque makes push fail instead of growing under the thieves
+bool WorkDeque::push(Job *job) {
+	int64_t b = bottom.load(std::memory_order_relaxed);
+	int64_t t = top.load(std::memory_order_acquire);
+	if (b - t >= CAPACITY) {
+		return false;
+	}
+	buffer[b & (CAPACITY - 1)].store(job, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	bottom.store(b + 1, std::memory_order_relaxed);
+	return true;
+}
+
+// Only the last job is contended, owner and thieves settle it with a CAS on top
+Job *WorkDeque::pop() {
+	int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+	bottom.store(b, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	int64_t t = top.load(std::memory_order_relaxed);
+	if (t > b) {
+		bottom.store(b + 1, std::memory_order_relaxed);
+		return nullptr;
+	}
+	Job *job = buffer[b & (CAPACITY - 1)].load(std::memory_order_relaxed);
+	if (t == b) {
+		if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+			job = nullptr;
+		}
+		bottom.store(b + 1, std::memory_order_relaxed);
+	}
+	return job;
+}
+
+Job *WorkDeque::steal() {
+	int64_t t = top.load(std::memory_order_acquire);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	int64_t b = bottom.load(std::memory_order_acquire);
+	if (t >= b) {
+		return nullptr;
+	}
+	Job *job = buffer[t & (CAPACITY - 1)].load(std::memory_order_relaxed);
+	if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+		return nullptr;
+	}
+	return job;
+}
+
+JobSystem &JobSystem::get() {
+	static JobSystem system;
+	return system;
+}
+
+int32_t JobSystem::get_thread_index() {
+	return thread_index;
+}
+
+void JobSystem::start(uint32_t worker_threads) {
+	if (running.load(std::memory_order_relaxed)) {
+		return;
+	}
+	MAGE_INFO(jobs) << "Attempting to start job system with " << worker_threads << " worker thread(s)...";
+	deques.clear();
+	for (uint32_t i = 0; i <= worker_threads; i++) {
+		deques.push_back(std::make_unique<WorkDeque>());
+	}
+	thread_index = 0;
+	queued.store(0, std::memory_order_relaxed);
+	running.store(true, std::memory_order_release);
+	for (uint32_t i = 1; i <= worker_threads; i++) {
+		workers.emplace_back(&JobSystem::worker_loop, this, i);
+	}
+	MAGE_INFO(jobs) << " - job system start successful!";
+}
+
+void JobSystem::stop() {
+	if (!running.load(std::memory_order_relaxed)) {
+		return;
+	}
+	run_main_thread_jobs();
+	{
+		std::lock_guard<std::mutex> lock{sleep_mutex};
+		running.store(false, std::memory_order_release);
+	}
+	wake.notify_all();
+	for (auto &worker : workers) {
+		worker.join();
+	}
+	workers.clear();
+	deques.clear();
+	thread_index = -1;
+	MAGE_INFO(jobs) << "Stopped job system";
+}
+
+JobSystem::~JobSystem() {
+	stop();
+}
+
+Job *JobSystem::allocate_job() {
+	if (free_jobs.jobs.empty()) {
+		return new Job{};
+	}
+	Job *job = free_jobs.jobs.back();
+	free_jobs.jobs.pop_back();
+	return job;
+}
+
+// Held-back jobs are parked on their dependency and resubmitted by whichever thread finishes it
+void JobSystem::submit(Job *job, JobCounter *dependency) {
+	if (dependency != nullptr) {
+		std::lock_guard<std::mutex> lock{dependency->mutex};
+		if (dependency->value.load(std::memory_order_acquire) != 0) {
+			dependency->dependents.push_back(job);
+			return;
+		}
+	}
+
+	// Before start there is nobody to hand the job to, and the same goes for ordinary jobs submitted from threads outside
+	// the pool or when the pool has no workers, since the main thread only runs its own deque while it waits
+	int32_t index = get_thread_index();
+	bool started = running.load(std::memory_order_acquire);
+	if (!started || (!job->main_thread && (index < 0 || workers.empty()))) {
+		execute(job);
+		return;
+	}
+	if (job->main_thread) {
+		std::lock_guard<std::mutex> lock{main_mutex};
+		main_jobs.push_back(job);
+		return;
+	}
+	if (!deques[index]->push(job)) {
+		execute(job);
+		return;
+	}
+	queued.fetch_add(1, std::memory_order_seq_cst);
+	if (sleeping.load(std::memory_order_seq_cst) > 0) {
+		// Taking the lock orders this notify after a sleeper's predicate check
+		{
+			std::lock_guard<std::mutex> lock{sleep_mutex};
+		}
+		wake.notify_one();
+	}
+}
+
+void JobSystem::execute(Job *job) {
+	job->invoke(*job);
+	JobCounter *counter = job->counter;
+	if (free_jobs.jobs.size() < MAX_FREE_JOBS) {
+		free_jobs.jobs.push_back(job);
+	} else {
+		delete job;
+	}
+	if (counter != nullptr) {
+		finish(*counter);
+	}
+}
+
+// The decrement happens under the counter's mutex, so once a waiter has taken that mutex after seeing zero
+// this thread is done with the counter and the waiter is free to destroy it
+void JobSystem::finish(JobCounter &counter) {
+	std::vector<Job*> released;
+	{
+		std::lock_guard<std::mutex> lock{counter.mutex};
+		if (counter.value.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+			released.swap(counter.dependents);
+		}
+	}
+	for (Job *job : released) {
+		submit(job, nullptr);
+	}
+}
+
+// Own deque first (newest job, still warm in cache), then steal the oldest job from the others
+Job *JobSystem::find_job(int32_t index) {
+	if (index < 0) {
+		return nullptr;
+	}
+	Job *job = deques[index]->pop();
+	if (job != nullptr) {
+		return job;
+	}
+	uint32_t count = static_cast<uint32_t>(deques.size());
+	for (uint32_t offset = 1; offset < count; offset++) {
+		job = deques[(index + offset) % count]->steal();
+		if (job != nullptr) {
+			return job;
+		}
+	}
+	return nullptr;
+}
+
+// Workers spin for a little while before sleeping, so back-to-back parallel_for calls in a frame do not pay for a wake-up
+void JobSystem::worker_loop(uint32_t index) {
+	thread_index = static_cast<int32_t>(index);
+	CpuProfiler::get().set_thread_name("job " + std::to_string(index));
+	uint32_t idle_rounds = 0;
+	while (running.load(std::memory_order_acquire)) {
+		Job *job = find_job(thread_index);
+		if (job != nullptr) {
+			queued.fetch_sub(1, std::memory_order_relaxed);
+			execute(job);
+			idle_rounds = 0;
+			continue;
+		}
+		if (++idle_rounds < SPIN_ROUNDS) {
+			std::this_thread::yield();
+			continue;
+		}
+		std::unique_lock<std::mutex> lock{sleep_mutex};
+		sleeping.fetch_add(1, std::memory_order_seq_cst);
+		wake.wait(lock, [&] {return queued.load(std::memory_order_seq_cst) > 0 || !running.load(std::memory_order_acquire);});
+		sleeping.fetch_sub(1, std::memory_order_relaxed);
+		idle_rounds = 0;
+	}
+}
+
+// The waiting thread keeps running jobs, so a job may wait on the jobs it spawned without tying up a worker
+void JobSystem::wait(JobCounter &counter) {
+	MAGE_PROFILE_ZONE("JobSystem::wait");
+	int32_t index = get_thread_index();
+	while (!counter.done()) {
+		Job *job = find_job(index);
+		if (job != nullptr) {
+			queued.fetch_sub(1, std::memory_order_relaxed);
+			execute(job);
+			continue;
+		}
+		if (index == 0) {
+			run_main_thread_jobs();
+		}
+		std::this_thread::yield();
+	}
+	std::lock_guard<std::mutex> lock{counter.mutex};
+}
+
+void JobSystem::run_main_thread_jobs() {
+	std::vector<Job*> jobs;
+	{
+		std::lock_guard<std::mutex> lock{main_mutex};
+		jobs.swap(main_jobs);
+	}
+	for (Job *job : jobs) {
+		execute(job);
+	}
+}
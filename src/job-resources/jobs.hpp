@@ -0,0 +1,157 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace mage {
+
+	class JobCounter;
+
+	// A unit of work with its callable stored inline, recycled through per-thread free lists
+	struct Job {
+		static constexpr size_t STORAGE = 64;
+		alignas(16) unsigned char storage[STORAGE];
+		void (*invoke)(Job &job) = nullptr;
+		JobCounter *counter = nullptr;
+		bool main_thread = false;
+	};
+
+	// Counts unfinished jobs. Waiting on it runs other jobs instead of blocking, and jobs submitted with it as their
+	// dependency are held back until it reaches zero.
+	class JobCounter {
+	private:
+		friend class JobSystem;
+		std::atomic<uint32_t> value{0};
+		std::mutex mutex;
+		std::vector<Job*> dependents;
+	public:
+		JobCounter() = default;
+		JobCounter(const JobCounter &) = delete;
+		JobCounter &operator=(const JobCounter &) = delete;
+		bool done() const {return value.load(std::memory_order_acquire) == 0;}
+	};
+
+	// Chase-Lev deque: the owning thread pushes and pops at the bottom, any other thread steals from the top
+	class WorkDeque {
+	private:
+		static constexpr int64_t CAPACITY = 4096;
+		alignas(64) std::atomic<int64_t> top{0};
+		alignas(64) std::atomic<int64_t> bottom{0};
+		std::unique_ptr<std::atomic<Job*>[]> buffer;
+	public:
+		WorkDeque() : buffer{new std::atomic<Job*>[CAPACITY]} {}
+		// False when full, the caller runs the job itself
+		bool push(Job *job);
+		Job *pop();
+		Job *steal();
+	};
+
+	// Fixed pool of worker threads with one deque each, idle workers steal from the others. The thread that calls start
+	// becomes the main thread: it has a deque of its own, helps out whenever it waits, and is the only thread that runs
+	// jobs submitted with run_on_main (anything touching GLFW). Until start is called everything runs inline.
+	class JobSystem {
+	private:
+		static constexpr uint32_t SPIN_ROUNDS = 64;
+		static constexpr size_t MAX_FREE_JOBS = 1024;
+		std::vector<std::unique_ptr<WorkDeque>> deques;
+		std::vector<std::thread> workers;
+		std::atomic<bool> running{false};
+		std::atomic<int32_t> queued{0};
+		std::atomic<uint32_t> sleeping{0};
+		std::mutex sleep_mutex;
+		std::condition_variable wake;
+		std::mutex main_mutex;
+		std::vector<Job*> main_jobs;
+
+		JobSystem() = default;
+		void worker_loop(uint32_t index);
+		Job *find_job(int32_t index);
+		Job *allocate_job();
+		void submit(Job *job, JobCounter *dependency);
+		void execute(Job *job);
+		void finish(JobCounter &counter);
+	public:
+		static JobSystem &get();
+		~JobSystem();
+		JobSystem(const JobSystem &) = delete;
+		JobSystem &operator=(const JobSystem &) = delete;
+
+		// worker_threads in addition to the calling thread, 0 keeps everything on the calling thread
+		void start(uint32_t worker_threads);
+		// Only call once every submitted job has been waited on
+		void stop();
+		bool is_running() const {return running.load(std::memory_order_acquire);}
+		// Workers plus the main thread, 1 when not started
+		uint32_t get_thread_count() const {return static_cast<uint32_t>(std::max<size_t>(deques.size(), 1));}
+		// -1 on threads that are not part of the pool
+		static int32_t get_thread_index();
+		static bool is_main_thread() {return get_thread_index() == 0;}
+
+		// function runs on any thread, after dependency (if given) reaches zero; counter (if given) drops when it finishes
+		template<typename F>
+		void run(F &&function, JobCounter *counter = nullptr, JobCounter *dependency = nullptr) {
+			submit(make_job(std::forward<F>(function), counter, false), dependency);
+		}
+		template<typename F>
+		void run_on_main(F &&function, JobCounter *counter = nullptr, JobCounter *dependency = nullptr) {
+			submit(make_job(std::forward<F>(function), counter, true), dependency);
+		}
+		void wait(JobCounter &counter);
+		// Runs queued main-thread jobs, the game loop calls this once per frame
+		void run_main_thread_jobs();
+
+		// function(first, last) over [begin, end) in about four ranges per thread so stealing evens out uneven work.
+		// Ranges never go below min_grain items. Returns once every range has run.
+		template<typename F>
+		void parallel_for(uint32_t begin, uint32_t end, F &&function, uint32_t min_grain = 1) {
+			if (end <= begin) {
+				return;
+			}
+			uint32_t count = end - begin;
+			uint32_t threads = get_thread_count();
+			uint32_t grain = std::max(std::max(min_grain, 1u), (count + threads * 4 - 1) / (threads * 4));
+			if (threads == 1 || grain >= count || get_thread_index() < 0) {
+				function(begin, end);
+				return;
+			}
+			JobCounter counter;
+			for (uint32_t first = begin; first < end; first += grain) {
+				uint32_t last = first + std::min(grain, end - first);
+				run([&function, first, last] {function(first, last);}, &counter);
+			}
+			wait(counter);
+		}
+
+	private:
+		template<typename F>
+		Job *make_job(F &&function, JobCounter *counter, bool main_thread) {
+			using Function = typename std::decay<F>::type;
+			static_assert(sizeof(Function) <= Job::STORAGE, "job captures too large, capture a pointer to the state instead");
+			static_assert(alignof(Function) <= 16, "job captures over-aligned");
+			Job *job = allocate_job();
+			new (job->storage) Function(std::forward<F>(function));
+			job->invoke = [](Job &self) {
+				Function *stored = std::launder(reinterpret_cast<Function*>(self.storage));
+				(*stored)();
+				stored->~Function();
+			};
+			job->counter = counter;
+			job->main_thread = main_thread;
+			if (counter != nullptr) {
+				counter->value.fetch_add(1, std::memory_order_relaxed);
+			}
+			return job;
+		}
+	};
+
+}
@@ -4,9 +4,9 @@
 #include <stdexcept>
 #include <cstdlib>
 
-int main() {
+int main(int argc, char **argv) {
 
-	mage::TestGame program{};
+	mage::TestGame program{mage::GameOptions::parse(argc, argv)};
 	program.run();
 
 }
@@ -0,0 +1,192 @@
+#include "culling.hpp"
+#include "../debug-resources/log.hpp"
+#include "../debug-resources/cpu-profiler.hpp"
+#include "../job-resources/jobs.hpp"
+#include "../pipeline-resources/bits.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define MAGE_CULL_AVX 1
+#elif defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define MAGE_CULL_SSE 1
+#endif
+
+using namespace mage;
+
+namespace {
+
+	// Every SoA array is padded to a whole number of the widest batch, padding lanes can never pass
+	const uint32_t BATCH_WIDTH = 8;
+	// Smaller ranges cost more to hand out than testing them takes
+	const uint32_t MIN_BATCHES_PER_JOB = 512;
+
+	glm::vec4 normalize_plane(const glm::vec4 &plane) {
+		float length = std::sqrt(plane.x * plane.x + plane.y * plane.y + plane.z * plane.z);
+		return plane * (1.f / length);
+	}
+
+	float column_length_squared(const glm::mat4 &matrix, int column) {
+		return matrix[column].x * matrix[column].x + matrix[column].y * matrix[column].y + matrix[column].z * matrix[column].z;
+	}
+
+}
+
+// Gribb-Hartmann extraction, near plane uses the zero-to-one depth range the engine projects into
+Frustum Frustum::from_matrix(const glm::mat4 &projection_view) {
+	auto row = [&](int index) {
+		return glm::vec4{projection_view[0][index], projection_view[1][index], projection_view[2][index], projection_view[3][index]};
+	};
+	glm::vec4 x = row(0);
+	glm::vec4 y = row(1);
+	glm::vec4 z = row(2);
+	glm::vec4 w = row(3);
+	Frustum frustum{};
+	frustum.planes[0] = normalize_plane(w + x);
+	frustum.planes[1] = normalize_plane(w - x);
+	frustum.planes[2] = normalize_plane(w + y);
+	frustum.planes[3] = normalize_plane(w - y);
+	frustum.planes[4] = normalize_plane(z);
+	frustum.planes[5] = normalize_plane(w - z);
+	return frustum;
+}
+
+void CullingStage::cull(const DrawableView &drawables, const TransformSystem &transforms, const glm::mat4 &projection_view) {
+	MAGE_PROFILE_ZONE("CullingStage::cull");
+	gather(drawables, transforms);
+	if (enabled) {
+		test_spheres(Frustum::from_matrix(projection_view));
+	} else {
+		visible.resize(object_count);
+		for (uint32_t i = 0; i < object_count; i++) {
+			visible[i] = i;
+		}
+	}
+	MAGE_TRACE(frame) << " - culling kept " << get_visible_count() << " object(s), culled " << get_culled_count();
+}
+
+// World spheres come from the model matrices the transform system already built for drawing
+void CullingStage::gather(const DrawableView &drawables, const TransformSystem &transforms) {
+	object_count = transforms.get_object_count();
+	uint32_t padded_count = (object_count + BATCH_WIDTH - 1) / BATCH_WIDTH * BATCH_WIDTH;
+	center_x.assign(padded_count, 0.f);
+	center_y.assign(padded_count, 0.f);
+	center_z.assign(padded_count, 0.f);
+	radius.assign(padded_count, -std::numeric_limits<float>::infinity());
+
+	chunks.clear();
+	uint32_t first = 0;
+	drawables.each_chunk([&](const Entity *, uint32_t rows, Transform *, Renderable *renderables) {
+		chunks.push_back({renderables, rows, first});
+		first += rows;
+	});
+	JobSystem::get().parallel_for(0, static_cast<uint32_t>(chunks.size()), [&](uint32_t first_chunk, uint32_t last_chunk) {
+		for (uint32_t chunk = first_chunk; chunk < last_chunk; chunk++) {
+			const Renderable *renderables = chunks[chunk].renderables;
+			for (uint32_t row = 0, i = chunks[chunk].first; row < chunks[chunk].rows; row++, i++) {
+				const glm::mat4 &transform = transforms.get_model(i);
+				const ModelBounds &bounds = renderables[row].model->get_bounds();
+				glm::vec4 center = transform * glm::vec4{bounds.center, 1.f};
+				float scale_squared = std::max({column_length_squared(transform, 0), column_length_squared(transform, 1), column_length_squared(transform, 2)});
+				center_x[i] = center.x;
+				center_y[i] = center.y;
+				center_z[i] = center.z;
+				radius[i] = bounds.radius * std::sqrt(scale_squared);
+			}
+		}
+	});
+}
+
+// A sphere survives when it is not entirely behind any plane. Batches are tested on the job system into one lane mask
+// each, survivors are then compacted in order straight from the masks.
+void CullingStage::test_spheres(const Frustum &frustum) {
+	uint32_t batch_count = static_cast<uint32_t>(radius.size()) / BATCH_WIDTH;
+	masks.resize(batch_count);
+
+#if defined(MAGE_CULL_AVX)
+	__m256 plane_x[6], plane_y[6], plane_z[6], plane_w[6];
+	for (int p = 0; p < 6; p++) {
+		plane_x[p] = _mm256_set1_ps(frustum.planes[p].x);
+		plane_y[p] = _mm256_set1_ps(frustum.planes[p].y);
+		plane_z[p] = _mm256_set1_ps(frustum.planes[p].z);
+		plane_w[p] = _mm256_set1_ps(frustum.planes[p].w);
+	}
+	const __m256 zero = _mm256_setzero_ps();
+	JobSystem::get().parallel_for(0, batch_count, [&](uint32_t first_batch, uint32_t last_batch) {
+		for (uint32_t batch = first_batch; batch < last_batch; batch++) {
+			uint32_t i = batch * BATCH_WIDTH;
+			__m256 x = _mm256_loadu_ps(&center_x[i]);
+			__m256 y = _mm256_loadu_ps(&center_y[i]);
+			__m256 z = _mm256_loadu_ps(&center_z[i]);
+			__m256 negative_radius = _mm256_sub_ps(zero, _mm256_loadu_ps(&radius[i]));
+			__m256 inside = _mm256_cmp_ps(zero, zero, _CMP_EQ_OQ);
+			for (int p = 0; p < 6; p++) {
+				__m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(plane_x[p], x), _mm256_mul_ps(plane_y[p], y)),
+				                                _mm256_add_ps(_mm256_mul_ps(plane_z[p], z), plane_w[p]));
+				inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, negative_radius, _CMP_GT_OQ));
+			}
+			masks[batch] = static_cast<uint8_t>(_mm256_movemask_ps(inside));
+		}
+	}, MIN_BATCHES_PER_JOB);
+#elif defined(MAGE_CULL_SSE)
+	__m128 plane_x[6], plane_y[6], plane_z[6], plane_w[6];
+	for (int p = 0; p < 6; p++) {
+		plane_x[p] = _mm_set1_ps(frustum.planes[p].x);
+		plane_y[p] = _mm_set1_ps(frustum.planes[p].y);
+		plane_z[p] = _mm_set1_ps(frustum.planes[p].z);
+		plane_w[p] = _mm_set1_ps(frustum.planes[p].w);
+	}
+	const __m128 zero = _mm_setzero_ps();
+	JobSystem::get().parallel_for(0, batch_count, [&](uint32_t first_batch, uint32_t last_batch) {
+		for (uint32_t batch = first_batch; batch < last_batch; batch++) {
+			// Two four-wide halves make up each batch's mask
+			uint32_t mask = 0;
+			for (uint32_t half = 0; half < 2; half++) {
+				uint32_t i = batch * BATCH_WIDTH + half * 4;
+				__m128 x = _mm_loadu_ps(&center_x[i]);
+				__m128 y = _mm_loadu_ps(&center_y[i]);
+				__m128 z = _mm_loadu_ps(&center_z[i]);
+				__m128 negative_radius = _mm_sub_ps(zero, _mm_loadu_ps(&radius[i]));
+				__m128 inside = _mm_cmpeq_ps(zero, zero);
+				for (int p = 0; p < 6; p++) {
+					__m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(plane_x[p], x), _mm_mul_ps(plane_y[p], y)),
+					                             _mm_add_ps(_mm_mul_ps(plane_z[p], z), plane_w[p]));
+					inside = _mm_and_ps(inside, _mm_cmpgt_ps(distance, negative_radius));
+				}
+				mask |= static_cast<uint32_t>(_mm_movemask_ps(inside)) << (half * 4);
+			}
+			masks[batch] = static_cast<uint8_t>(mask);
+		}
+	}, MIN_BATCHES_PER_JOB);
+#else
+	JobSystem::get().parallel_for(0, batch_count, [&](uint32_t first_batch, uint32_t last_batch) {
+		for (uint32_t batch = first_batch; batch < last_batch; batch++) {
+			uint32_t mask = 0;
+			for (uint32_t lane = 0; lane < BATCH_WIDTH; lane++) {
+				uint32_t i = batch * BATCH_WIDTH + lane;
+				bool inside = true;
+				for (const auto &plane : frustum.planes) {
+					inside = inside && plane.x * center_x[i] + plane.y * center_y[i] + plane.z * center_z[i] + plane.w > -radius[i];
+				}
+				mask |= (inside ? 1u : 0u) << lane;
+			}
+			masks[batch] = static_cast<uint8_t>(mask);
+		}
+	}, MIN_BATCHES_PER_JOB);
+#endif
+
+	visible.resize(object_count);
+	uint32_t visible_count = 0;
+	for (uint32_t batch = 0; batch < batch_count; batch++) {
+		uint32_t mask = masks[batch];
+		while (mask != 0) {
+			visible[visible_count++] = batch * BATCH_WIDTH + lowest_bit(mask);
+			mask &= mask - 1;
+		}
+	}
+	visible.resize(visible_count);
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "object.hpp"
+#include "transform.hpp"
+#include <glm/glm.hpp>
+#include <vector>
+
+namespace mage {
+
+	// Six normalized planes, inside is where every plane's distance is positive
+	struct Frustum {
+		glm::vec4 planes[6];
+		static Frustum from_matrix(const glm::mat4 &projection_view);
+	};
+
+	// Tests world-space bounding spheres against the camera frustum ahead of the draw loop. Bounds are kept
+	// structure-of-arrays so one SIMD register holds the same component of four (SSE) or eight (AVX) objects.
+	// Gathering and testing split across the job system, only the final compaction is serial.
+	class CullingStage {
+	private:
+		struct ChunkRows {
+			const Renderable *renderables;
+			uint32_t rows;
+			uint32_t first;
+		};
+		bool enabled = true;
+		std::vector<ChunkRows> chunks;
+		std::vector<float> center_x;
+		std::vector<float> center_y;
+		std::vector<float> center_z;
+		std::vector<float> radius;
+		// One bit per object, eight objects per entry
+		std::vector<uint8_t> masks;
+		std::vector<uint32_t> visible;
+		uint32_t object_count = 0;
+		void gather(const DrawableView &drawables, const TransformSystem &transforms);
+		void test_spheres(const Frustum &frustum);
+	public:
+		void cull(const DrawableView &drawables, const TransformSystem &transforms, const glm::mat4 &projection_view);
+
+		void set_enabled(bool enable) {enabled = enable;}
+		bool is_enabled() const {return enabled;}
+		// Positions in the culled view, in ascending order
+		const std::vector<uint32_t> &get_visible() const {return visible;}
+		uint32_t get_visible_count() const {return static_cast<uint32_t>(visible.size());}
+		uint32_t get_culled_count() const {return object_count - get_visible_count();}
+	};
+
+}
@@ -0,0 +1,413 @@
+#include "gpu-scene.hpp"
+#include "culling.hpp"
+#include "../debug-resources/log.hpp"
+#include "../debug-resources/cpu-profiler.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <numeric>
+
+using namespace mage;
+
+namespace {
+
+	// Bindings of gpu-cull.comp and gpu-compact.comp
+	enum Binding : uint32_t {
+		MODELS = 0,
+		OBJECTS = 1,
+		MESHES = 2,
+		COMMANDS = 3,
+		INSTANCES = 4,
+		COMPACTED = 5,
+		COUNTS = 6,
+		BINDING_COUNT = 7
+	};
+
+	// Shared by both dispatches, compaction only reads the counts and wide_start
+	struct gpu_cull_push {
+		glm::vec4 planes[6];
+		uint32_t object_count;
+		uint32_t command_count;
+		uint32_t wide_start;
+		uint32_t cull;
+	};
+
+	constexpr VkDeviceSize COMMAND_STRIDE = sizeof(VkDrawIndexedIndirectCommand);
+
+}
+
+GpuScene::GpuScene(DeviceHandling &device_pass, uint32_t frames_in_flight) : device{device_pass} {
+	MAGE_INFO(pipeline) << "Attempting to create GPU scene...";
+	create_descriptors(frames_in_flight);
+	create_pipelines();
+	MAGE_INFO(pipeline) << " - GPU scene creation successful!";
+}
+
+void GpuScene::create_descriptors(uint32_t frames_in_flight){
+	std::array<VkDescriptorSetLayoutBinding, BINDING_COUNT> bindings{};
+	for (uint32_t binding = 0; binding < BINDING_COUNT; binding++) {
+		bindings[binding].binding = binding;
+		bindings[binding].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		bindings[binding].descriptorCount = 1;
+		bindings[binding].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	}
+	VkDescriptorSetLayoutCreateInfo layout_info{};
+	layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layout_info.bindingCount = static_cast<uint32_t>(bindings.size());
+	layout_info.pBindings = bindings.data();
+	if (vkCreateDescriptorSetLayout(device.get_device(), &layout_info, nullptr, &descriptor_set_layout) != VK_SUCCESS) {
+		MAGE_ERROR(pipeline) << "Failed to create GPU scene descriptor set layout";
+		exit(EXIT_FAILURE);
+	}
+
+	VkDescriptorPoolSize pool_size{};
+	pool_size.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	pool_size.descriptorCount = BINDING_COUNT * frames_in_flight;
+	VkDescriptorPoolCreateInfo pool_info{};
+	pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	pool_info.maxSets = frames_in_flight;
+	pool_info.poolSizeCount = 1;
+	pool_info.pPoolSizes = &pool_size;
+	if (vkCreateDescriptorPool(device.get_device(), &pool_info, nullptr, &descriptor_pool) != VK_SUCCESS) {
+		MAGE_ERROR(pipeline) << "Failed to create GPU scene descriptor pool";
+		exit(EXIT_FAILURE);
+	}
+
+	frames.resize(frames_in_flight);
+	std::vector<VkDescriptorSetLayout> layouts(frames_in_flight, descriptor_set_layout);
+	std::vector<VkDescriptorSet> sets(frames_in_flight);
+	VkDescriptorSetAllocateInfo allocate_info{};
+	allocate_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocate_info.descriptorPool = descriptor_pool;
+	allocate_info.descriptorSetCount = frames_in_flight;
+	allocate_info.pSetLayouts = layouts.data();
+	if (vkAllocateDescriptorSets(device.get_device(), &allocate_info, sets.data()) != VK_SUCCESS) {
+		MAGE_ERROR(pipeline) << "Failed to allocate GPU scene descriptor sets";
+		exit(EXIT_FAILURE);
+	}
+	for (uint32_t frame = 0; frame < frames_in_flight; frame++) {
+		frames[frame].descriptor_set = sets[frame];
+	}
+}
+
+void GpuScene::create_pipelines(){
+	VkPushConstantRange push_constant_range{};
+	push_constant_range.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	push_constant_range.offset = 0;
+	push_constant_range.size = sizeof(gpu_cull_push);
+
+	VkPipelineLayoutCreateInfo pipeline_layout_info{};
+	pipeline_layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipeline_layout_info.setLayoutCount = 1;
+	pipeline_layout_info.pSetLayouts = &descriptor_set_layout;
+	pipeline_layout_info.pushConstantRangeCount = 1;
+	pipeline_layout_info.pPushConstantRanges = &push_constant_range;
+	if (vkCreatePipelineLayout(device.get_device(), &pipeline_layout_info, nullptr, &pipeline_layout) != VK_SUCCESS) {
+		MAGE_ERROR(pipeline) << "Failed to create GPU scene pipeline layout";
+		exit(EXIT_FAILURE);
+	}
+	cull_pipeline = std::make_unique<ComputePipeline>(device, "src/shaders/gpu-cull-comp.spv", pipeline_layout, "gpu-cull");
+	compact_pipeline = std::make_unique<ComputePipeline>(device, "src/shaders/gpu-compact-comp.spv", pipeline_layout, "gpu-compact");
+}
+
+// Copies the model's buffers into the shared ones with device-side copies, nothing goes back through the CPU.
+// Unindexed models get a generated 0..n-1 index range so every mesh can be drawn with an indexed command.
+// Returns the mesh of the full level, every level gets one, in order, pointing into the same copy.
+uint32_t GpuScene::add_mesh(GameModel &model){
+	MAGE_PROFILE_ZONE("GpuScene::add_mesh");
+	bool wide = !model.is_indexed() || model.get_index_type() == VK_INDEX_TYPE_UINT32;
+	uint32_t index_count = model.is_indexed() ? model.get_index_count() : model.get_vertex_count();
+	int32_t vertex_offset = static_cast<int32_t>(vertices_used / sizeof(GameModel::Vertex));
+
+	VkDeviceSize vertex_bytes = sizeof(GameModel::Vertex) * static_cast<VkDeviceSize>(model.get_vertex_count());
+	VkDeviceSize index_size = wide ? sizeof(uint32_t) : sizeof(uint16_t);
+	VkDeviceSize index_bytes = index_size * index_count;
+	Buffer &indices = wide ? wide_indices : narrow_indices;
+	VkDeviceSize &indices_used = wide ? wide_indices_used : narrow_indices_used;
+	uint32_t first_index = static_cast<uint32_t>(indices_used / index_size);
+	grow_geometry(vertices, vertices_used, vertices_used + vertex_bytes, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+	grow_geometry(indices, indices_used, indices_used + index_bytes, VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
+
+	// In-flight frames only read ranges below the used marks, so appending past them needs no wait
+	VkCommandBuffer command_buffer = device.begin_single_time_commands();
+	device.copy_buffers(command_buffer, model.get_vertex_buffer(), {{vertices.buffer, {0, vertices_used, vertex_bytes}}});
+	if (model.is_indexed()) {
+		device.copy_buffers(command_buffer, model.get_index_buffer(), {{indices.buffer, {0, indices_used, index_bytes}}});
+	}
+	device.end_single_time_commands(command_buffer);
+	if (!model.is_indexed()) {
+		std::vector<uint32_t> generated(index_count);
+		std::iota(generated.begin(), generated.end(), 0u);
+		device.upload_buffer(indices.buffer, generated.data(), index_bytes, indices_used);
+	}
+	vertices_used += vertex_bytes;
+	indices_used += index_bytes;
+
+	uint32_t mesh_id = static_cast<uint32_t>(meshes.size());
+	for (uint32_t lod = 0; lod < model.get_lod_count(); lod++) {
+		const ModelLod &level = model.get_lod(lod);
+		Mesh mesh{};
+		mesh.wide = wide;
+		mesh.index_count = level.index_count;
+		mesh.first_index = first_index + level.first_index;
+		mesh.vertex_offset = vertex_offset;
+		mesh.bounds = model.get_bounds();
+		meshes.push_back(mesh);
+	}
+	MAGE_DEBUG(model) << " - GPU scene mesh " << mesh_id << ": " << index_count << (wide ? " 32-bit" : " 16-bit") << " indices, "
+	                  << model.get_lod_count() << " level(s)";
+	return mesh_id;
+}
+
+// Shared geometry outlives frames, so growing it waits for the device before the old buffer goes away
+void GpuScene::grow_geometry(Buffer &geometry, VkDeviceSize used, VkDeviceSize required, VkBufferUsageFlags usage){
+	if (required <= geometry.capacity) {
+		return;
+	}
+	VkDeviceSize capacity = std::max(geometry.capacity, MIN_GEOMETRY_SIZE);
+	while (capacity < required) {
+		capacity *= 2;
+	}
+	Buffer grown{};
+	device.create_buffer(
+	  capacity,
+	  usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+	  VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+	  grown.buffer,
+	  grown.allocation);
+	grown.capacity = capacity;
+	if (geometry.buffer != VK_NULL_HANDLE) {
+		if (used > 0) {
+			device.copy_buffer(geometry.buffer, grown.buffer, used);
+		}
+		vkDeviceWaitIdle(device.get_device());
+		destroy(geometry);
+	}
+	geometry = grown;
+}
+
+// Per-frame buffers grow to the next power of two, only for the slot being recorded whose last submission has finished
+void GpuScene::reserve(Buffer &buffer, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties){
+	if (size <= buffer.capacity) {
+		return;
+	}
+	VkDeviceSize capacity = std::max(buffer.capacity, MIN_FRAME_BUFFER_SIZE);
+	while (capacity < size) {
+		capacity *= 2;
+	}
+	destroy(buffer);
+	device.create_buffer(capacity, usage, properties, buffer.buffer, buffer.allocation);
+	buffer.capacity = capacity;
+}
+
+void GpuScene::destroy(Buffer &buffer){
+	if (buffer.buffer == VK_NULL_HANDLE) {
+		return;
+	}
+	device.destroy_buffer(buffer.buffer, buffer.allocation);
+	buffer = {};
+}
+
+void GpuScene::update_descriptor_set(const FrameBuffers &frame){
+	const Buffer *buffers[BINDING_COUNT] = {};
+	buffers[MODELS] = &frame.models;
+	buffers[OBJECTS] = &frame.objects;
+	buffers[MESHES] = &frame.meshes;
+	buffers[COMMANDS] = &frame.commands;
+	buffers[INSTANCES] = &frame.instances;
+	buffers[COMPACTED] = &frame.compacted;
+	buffers[COUNTS] = &frame.counts;
+	std::array<VkDescriptorBufferInfo, BINDING_COUNT> buffer_infos{};
+	std::array<VkWriteDescriptorSet, BINDING_COUNT> writes{};
+	for (uint32_t binding = 0; binding < BINDING_COUNT; binding++) {
+		buffer_infos[binding].buffer = buffers[binding]->buffer;
+		buffer_infos[binding].offset = 0;
+		buffer_infos[binding].range = VK_WHOLE_SIZE;
+		writes[binding].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		writes[binding].dstSet = frame.descriptor_set;
+		writes[binding].dstBinding = binding;
+		writes[binding].descriptorCount = 1;
+		writes[binding].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		writes[binding].pBufferInfo = &buffer_infos[binding];
+	}
+	vkUpdateDescriptorSets(device.get_device(), static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+}
+
+// The CPU only writes what it already has: matrices, colors, mesh ids and one command template per mesh in use, with
+// each mesh's instance range sized for all of its objects. The cull pass fills the ranges and counts, compaction drops
+// the commands nothing survived for.
+void GpuScene::record_cull(VkCommandBuffer command_buffer, DrawHandling &artist, uint32_t frame_index, const DrawableView &drawables,
+                           const TransformSystem &transforms, LodSelector &lods, const glm::mat4 &projection_view, bool cull, GpuProfiler *profiler){
+	MAGE_PROFILE_ZONE("GpuScene::record_cull");
+	FrameBuffers &frame = frames[frame_index];
+
+	// The slot's fence has been waited on, so its commands hold the final instance counts of its last submission
+	if (frame.submitted) {
+		const auto *commands = static_cast<const VkDrawIndexedIndirectCommand*>(frame.commands.allocation.mapped);
+		visible_count = 0;
+		for (uint32_t i = 0; i < frame.command_count; i++) {
+			visible_count += commands[i].instanceCount;
+		}
+	}
+	frame.command_count = 0;
+	frame.wide_start = 0;
+	frame.submitted = false;
+	uint32_t object_count = transforms.get_object_count();
+	if (object_count == 0) {
+		return;
+	}
+
+	const VkMemoryPropertyFlags host = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+	reserve(frame.models, sizeof(glm::mat4) * static_cast<VkDeviceSize>(object_count), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, host);
+	reserve(frame.objects, sizeof(GpuObject) * static_cast<VkDeviceSize>(object_count), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, host);
+	reserve(frame.instances, sizeof(GameModel::Instance) * static_cast<VkDeviceSize>(object_count),
+	        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	static_assert(sizeof(GameModel::Instance) == INSTANCE_FLOATS * sizeof(float), "gpu-cull.comp writes instances as packed floats");
+	std::memcpy(frame.models.allocation.mapped, transforms.get_models(), sizeof(glm::mat4) * static_cast<size_t>(object_count));
+
+	for (Mesh &mesh : meshes) {
+		mesh.object_count = 0;
+	}
+	auto *objects = static_cast<GpuObject*>(frame.objects.allocation.mapped);
+	uint32_t object = 0;
+	drawables.each_chunk([&](const Entity *, uint32_t rows, Transform *, Renderable *renderables) {
+		for (uint32_t row = 0; row < rows; row++, object++) {
+			Renderable &renderable = renderables[row];
+			auto found = mesh_lookup.find(renderable.model->get_sort_id());
+			if (found == mesh_lookup.end()) {
+				found = mesh_lookup.emplace(renderable.model->get_sort_id(), add_mesh(*renderable.model)).first;
+			}
+			// Every object gets a level, culled or not, the GPU decides visibility later
+			renderable.lod = lods.select(*renderable.model, transforms.get_model(object), renderable.lod);
+			uint32_t mesh_id = found->second + renderable.lod;
+			meshes[mesh_id].object_count++;
+			objects[object] = {renderable.color, mesh_id};
+		}
+	});
+
+	// Commands for 16-bit meshes come first, so each index type is one contiguous range drawn with its own index buffer
+	uint32_t mesh_count = static_cast<uint32_t>(meshes.size());
+	reserve(frame.meshes, sizeof(GpuMesh) * static_cast<VkDeviceSize>(mesh_count), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, host);
+	reserve(frame.commands, COMMAND_STRIDE * mesh_count, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, host);
+	reserve(frame.compacted, COMMAND_STRIDE * mesh_count, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+	        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	reserve(frame.counts, 2 * sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, host);
+	auto *gpu_meshes = static_cast<GpuMesh*>(frame.meshes.allocation.mapped);
+	auto *commands = static_cast<VkDrawIndexedIndirectCommand*>(frame.commands.allocation.mapped);
+	uint32_t first_instance = 0;
+	for (bool wide : {false, true}) {
+		if (wide) {
+			frame.wide_start = frame.command_count;
+		}
+		for (uint32_t mesh_id = 0; mesh_id < mesh_count; mesh_id++) {
+			Mesh &mesh = meshes[mesh_id];
+			if (mesh.wide != wide || mesh.object_count == 0) {
+				continue;
+			}
+			mesh.command = frame.command_count++;
+			commands[mesh.command] = {mesh.index_count, 0, mesh.first_index, mesh.vertex_offset, first_instance};
+			first_instance += mesh.object_count;
+		}
+	}
+	for (uint32_t mesh_id = 0; mesh_id < mesh_count; mesh_id++) {
+		const Mesh &mesh = meshes[mesh_id];
+		gpu_meshes[mesh_id] = {glm::vec4{mesh.bounds.center, mesh.bounds.radius}, mesh.command, {}};
+	}
+	std::memset(frame.counts.allocation.mapped, 0, 2 * sizeof(uint32_t));
+	update_descriptor_set(frame);
+
+	gpu_cull_push push{};
+	Frustum frustum = Frustum::from_matrix(projection_view);
+	std::copy(std::begin(frustum.planes), std::end(frustum.planes), std::begin(push.planes));
+	push.object_count = object_count;
+	push.command_count = frame.command_count;
+	push.wide_start = frame.wide_start;
+	push.cull = cull ? 1 : 0;
+
+	GpuScope cull_scope{profiler, command_buffer, "gpu cull"};
+	vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_layout, 0, 1, &frame.descriptor_set, 0, nullptr);
+	vkCmdPushConstants(command_buffer, pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(gpu_cull_push), &push);
+	cull_pipeline->bind(command_buffer);
+	vkCmdDispatch(command_buffer, (object_count + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE, 1, 1);
+	DrawHandling::record_barriers(command_buffer, {
+	  {frame.commands.buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+	   VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT}});
+	compact_pipeline->bind(command_buffer);
+	vkCmdDispatch(command_buffer, (frame.command_count + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE, 1, 1);
+
+	// The commands are also read back on the CPU for the visible count once the slot comes around again
+	artist.queue_barrier({frame.commands.buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+	                      VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_HOST_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_HOST_READ_BIT});
+	artist.queue_barrier({frame.compacted.buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+	                      VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT});
+	artist.queue_barrier({frame.counts.buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+	                      VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT});
+	artist.queue_barrier({frame.instances.buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+	                      VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT});
+	frame.submitted = true;
+}
+
+// With VK_KHR_draw_indirect_count the compacted commands are drawn and the GPU supplies the count, with only
+// multiDrawIndirect every command is drawn including the empty ones, and without either one command per draw
+uint32_t GpuScene::record_draws(VkCommandBuffer command_buffer, uint32_t frame_index){
+	const FrameBuffers &frame = frames[frame_index];
+	if (frame.command_count == 0) {
+		return 0;
+	}
+	VkBuffer vertex_buffers[] = {vertices.buffer, frame.instances.buffer};
+	VkDeviceSize offsets[] = {0, 0};
+	vkCmdBindVertexBuffers(command_buffer, 0, 2, vertex_buffers, offsets);
+
+	auto draw_indexed_indirect_count = device.get_draw_indexed_indirect_count();
+	uint32_t draw_calls = 0;
+	const uint32_t ranges[2][2] = {{0, frame.wide_start}, {frame.wide_start, frame.command_count}};
+	for (uint32_t range = 0; range < 2; range++) {
+		uint32_t first = ranges[range][0];
+		uint32_t count = ranges[range][1] - first;
+		if (count == 0) {
+			continue;
+		}
+		if (range == 0) {
+			vkCmdBindIndexBuffer(command_buffer, narrow_indices.buffer, 0, VK_INDEX_TYPE_UINT16);
+		} else {
+			vkCmdBindIndexBuffer(command_buffer, wide_indices.buffer, 0, VK_INDEX_TYPE_UINT32);
+		}
+		if (draw_indexed_indirect_count != nullptr) {
+			draw_indexed_indirect_count(command_buffer, frame.compacted.buffer, first * COMMAND_STRIDE,
+			                            frame.counts.buffer, range * sizeof(uint32_t), count, COMMAND_STRIDE);
+			draw_calls++;
+		} else if (device.supports_multi_draw_indirect()) {
+			vkCmdDrawIndexedIndirect(command_buffer, frame.commands.buffer, first * COMMAND_STRIDE, count, COMMAND_STRIDE);
+			draw_calls++;
+		} else {
+			for (uint32_t command = first; command < first + count; command++) {
+				vkCmdDrawIndexedIndirect(command_buffer, frame.commands.buffer, command * COMMAND_STRIDE, 1, COMMAND_STRIDE);
+			}
+			draw_calls += count;
+		}
+	}
+	return draw_calls;
+}
+
+GpuScene::~GpuScene() {
+	for (auto &frame : frames) {
+		destroy(frame.models);
+		destroy(frame.objects);
+		destroy(frame.meshes);
+		destroy(frame.commands);
+		destroy(frame.compacted);
+		destroy(frame.counts);
+		destroy(frame.instances);
+	}
+	destroy(vertices);
+	destroy(narrow_indices);
+	destroy(wide_indices);
+	cull_pipeline.reset();
+	compact_pipeline.reset();
+	vkDestroyPipelineLayout(device.get_device(), pipeline_layout, nullptr);
+	vkDestroyDescriptorPool(device.get_device(), descriptor_pool, nullptr);
+	vkDestroyDescriptorSetLayout(device.get_device(), descriptor_set_layout, nullptr);
+}
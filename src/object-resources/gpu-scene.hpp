@@ -0,0 +1,112 @@
+#pragma once
+
+#include "../pipeline-resources/artist.hpp"
+#include "../pipeline-resources/device.hpp"
+#include "../pipeline-resources/pipeline.hpp"
+#include "../debug-resources/gpu-profiler.hpp"
+#include "model.hpp"
+#include "object.hpp"
+#include "transform.hpp"
+#include "lod-selection.hpp"
+#include <glm/glm.hpp>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace mage {
+
+	// GPU-driven drawing: every object's model matrix, color and mesh go into storage buffers, a compute pass frustum
+	// culls them and builds one VkDrawIndexedIndirectCommand per mesh, and the frame is drawn with one indirect draw
+	// per index width. Models keep their own buffers, their geometry is also copied into two shared buffers here the
+	// first time they are drawn, so one index buffer bind covers every mesh of the same index type. Each level of detail
+	// of a model is a mesh of its own over the same vertices, levels are picked on the CPU as the objects are written.
+	class GpuScene {
+	private:
+		static constexpr uint32_t WORKGROUP_SIZE = 64;
+		static constexpr VkDeviceSize MIN_FRAME_BUFFER_SIZE = 4 * 1024;
+		static constexpr VkDeviceSize MIN_GEOMETRY_SIZE = 1024 * 1024;
+		// GameModel::Instance without the padding a struct array would get in std430
+		static constexpr uint32_t INSTANCE_FLOATS = 19;
+		struct Buffer {
+			VkBuffer buffer = VK_NULL_HANDLE;
+			MemoryAllocation allocation;
+			VkDeviceSize capacity = 0;
+		};
+		// Where one level of a model's geometry landed in the shared buffers, wide meshes use 32-bit indices
+		struct Mesh {
+			uint32_t index_count;
+			uint32_t first_index;
+			int32_t vertex_offset;
+			bool wide;
+			ModelBounds bounds;
+			uint32_t command;
+			uint32_t object_count;
+		};
+		// Storage buffer layouts, matching gpu-cull.comp
+		struct GpuObject {
+			glm::vec3 color;
+			uint32_t mesh;
+		};
+		struct GpuMesh {
+			glm::vec4 sphere;
+			uint32_t command;
+			uint32_t padding[3];
+		};
+		// Host-visible buffers are rewritten every frame, the rest are only touched by the GPU
+		struct FrameBuffers {
+			Buffer models;
+			Buffer objects;
+			Buffer meshes;
+			Buffer commands;
+			Buffer compacted;
+			Buffer counts;
+			Buffer instances;
+			VkDescriptorSet descriptor_set = VK_NULL_HANDLE;
+			uint32_t command_count = 0;
+			uint32_t wide_start = 0;
+			bool submitted = false;
+		};
+		DeviceHandling &device;
+		VkDescriptorSetLayout descriptor_set_layout;
+		VkDescriptorPool descriptor_pool;
+		VkPipelineLayout pipeline_layout;
+		std::unique_ptr<ComputePipeline> cull_pipeline;
+		std::unique_ptr<ComputePipeline> compact_pipeline;
+		Buffer vertices;
+		Buffer narrow_indices;
+		Buffer wide_indices;
+		VkDeviceSize vertices_used = 0;
+		VkDeviceSize narrow_indices_used = 0;
+		VkDeviceSize wide_indices_used = 0;
+		std::vector<Mesh> meshes;
+		// Model sort id to the mesh of its full level, coarser levels follow it
+		std::unordered_map<uint32_t, uint32_t> mesh_lookup;
+		std::vector<FrameBuffers> frames;
+		uint32_t visible_count = 0;
+		void create_descriptors(uint32_t frames_in_flight);
+		void create_pipelines();
+		uint32_t add_mesh(GameModel &model);
+		void grow_geometry(Buffer &geometry, VkDeviceSize used, VkDeviceSize required, VkBufferUsageFlags usage);
+		void reserve(Buffer &buffer, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties);
+		void destroy(Buffer &buffer);
+		void update_descriptor_set(const FrameBuffers &frame);
+	public:
+		GpuScene(DeviceHandling &device_pass, uint32_t frames_in_flight);
+		~GpuScene();
+		GpuScene(const GpuScene&) = delete;
+		GpuScene &operator=(const GpuScene&) = delete;
+
+		// Fills this frame slot's buffers and records the cull and compaction dispatches, must come before the render pass.
+		// The barriers the draws need are queued on artist. Without cull every object is drawn.
+		void record_cull(VkCommandBuffer command_buffer, DrawHandling &artist, uint32_t frame_index, const DrawableView &drawables,
+		                 const TransformSystem &transforms, LodSelector &lods, const glm::mat4 &projection_view, bool cull, GpuProfiler *profiler);
+		// Binds the shared geometry and the culled instances at binding 1 and issues the indirect draws, inside the render
+		// pass with the instanced pipeline bound. Returns the draw calls recorded.
+		uint32_t record_draws(VkCommandBuffer command_buffer, uint32_t frame_index);
+
+		// Objects that survived culling, read back from the last submission of the slot being recorded, so a few frames old
+		uint32_t get_visible_count() const {return visible_count;}
+		uint32_t get_mesh_count() const {return static_cast<uint32_t>(meshes.size());}
+	};
+
+}
@@ -0,0 +1,45 @@
+#include "lod-selection.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+using namespace mage;
+
+// projection[1][1] is cot(fovy / 2) for perspective cameras and 2 / height for orthographic ones, either way half of it
+// turns a length into screen heights
+void LodSelector::begin(const CameraHandling &camera) {
+	const glm::mat4 &projection = camera.get_projection_matrix();
+	camera_position = glm::vec3{glm::inverse(camera.get_view_matrix())[3]};
+	projection_scale = 0.5f * std::abs(projection[1][1]);
+	perspective = projection[2][3] != 0.f;
+	level_counts.fill(0);
+	triangle_count = 0;
+}
+
+uint8_t LodSelector::select(const GameModel &model, const glm::mat4 &transform, uint8_t current) {
+	uint32_t levels = model.get_lod_count();
+	uint32_t lod = enabled ? std::min<uint32_t>(current, levels - 1) : 0;
+	if (enabled && levels > 1) {
+		const ModelBounds &bounds = model.get_bounds();
+		float scale = std::sqrt(std::max({glm::dot(glm::vec3{transform[0]}, glm::vec3{transform[0]}),
+		                                  glm::dot(glm::vec3{transform[1]}, glm::vec3{transform[1]}),
+		                                  glm::dot(glm::vec3{transform[2]}, glm::vec3{transform[2]})}));
+		// Screen heights per model unit, with the camera inside the bounds nothing but the full mesh will do
+		float screen_per_unit = scale * projection_scale;
+		if (perspective) {
+			glm::vec3 center = glm::vec3{transform * glm::vec4{bounds.center, 1.f}};
+			float distance = glm::length(center - camera_position) - bounds.radius * scale;
+			screen_per_unit = distance > 0.f ? screen_per_unit / distance : std::numeric_limits<float>::max();
+		}
+		while (lod > 0 && model.get_lod(lod).error * screen_per_unit > threshold) {
+			lod--;
+		}
+		while (lod + 1 < levels && model.get_lod(lod + 1).error * screen_per_unit <= threshold * (1.f - hysteresis)) {
+			lod++;
+		}
+	}
+	level_counts[lod]++;
+	triangle_count += model.get_lod(lod).index_count / 3;
+	return static_cast<uint8_t>(lod);
+}
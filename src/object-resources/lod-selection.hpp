@@ -0,0 +1,45 @@
+#pragma once
+
+#include "model.hpp"
+#include "../camera-resources/camera.hpp"
+#include <glm/glm.hpp>
+#include <array>
+#include <cstdint>
+
+namespace mage {
+
+	// Picks each object's level of detail from how large the level's error would look on screen. The error is scaled by
+	// the object's transform and projected at the distance of its bounding sphere's nearest point. The coarsest level
+	// whose projected error stays under the threshold wins. Going finer happens as soon as the current level's error
+	// shows. Going coarser waits until the next level is under the threshold by the hysteresis margin, so an object near
+	// a boundary doesn't switch back and forth every frame.
+	class LodSelector {
+	private:
+		bool enabled = true;
+		// Fraction of the screen height a level's error may cover, about a pixel on a 1000 pixel tall target
+		float threshold = 1.f / 1000.f;
+		float hysteresis = 0.25f;
+		glm::vec3 camera_position{};
+		// Screen heights per world unit at distance one, or at any distance for orthographic cameras
+		float projection_scale = 0.f;
+		bool perspective = true;
+		std::array<uint32_t, MAX_LODS> level_counts{};
+		uint64_t triangle_count = 0;
+	public:
+		// Once per frame before any select, also clears the statistics
+		void begin(const CameraHandling &camera);
+		// current is the level the object drew last frame, the returned level is the one to draw and remember
+		uint8_t select(const GameModel &model, const glm::mat4 &transform, uint8_t current);
+
+		// Disabled selectors always pick the full mesh, to measure what the levels buy
+		void set_enabled(bool enable) {enabled = enable;}
+		bool is_enabled() const {return enabled;}
+		void set_threshold(float screen_fraction) {threshold = screen_fraction;}
+		void set_hysteresis(float margin) {hysteresis = margin;}
+		// Objects given each level since begin
+		uint32_t get_level_count(uint32_t lod) const {return level_counts[lod];}
+		// Triangles of the levels handed out since begin, before any GPU culling
+		uint64_t get_triangle_count() const {return triangle_count;}
+	};
+
+}
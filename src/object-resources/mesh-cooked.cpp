@@ -0,0 +1,197 @@
+#include "mesh-cooked.hpp"
+#include "../pipeline-resources/hash.hpp"
+#include "../debug-resources/log.hpp"
+#include "../debug-resources/cpu-profiler.hpp"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <type_traits>
+
+using namespace mage;
+
+namespace {
+
+	uint64_t align_up(uint64_t value, uint64_t alignment) {
+		return (value + alignment - 1) / alignment * alignment;
+	}
+
+	// Blob bounds come from the file, so the check subtracts rather than adds to stay clear of wrapping around
+	bool blob_fits(uint64_t offset, uint64_t bytes, uint64_t size) {
+		return offset <= size && bytes <= size - offset;
+	}
+
+	template<typename Index>
+	bool indices_in_range(const char *indices, uint32_t index_count, uint32_t vertex_count) {
+		for (uint32_t i = 0; i < index_count; i++) {
+			Index index;
+			std::memcpy(&index, indices + static_cast<size_t>(i) * sizeof(Index), sizeof(Index));
+			if (index >= vertex_count) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+}
+
+std::shared_ptr<const CookedMesh> CookedMesh::load(const std::string &path) {
+	MAGE_PROFILE_ZONE("CookedMesh::load");
+	std::shared_ptr<CookedMesh> mesh{new CookedMesh{}};
+	mesh->path = path;
+	mesh->file = MappedFile{path};
+	if (!mesh->file.is_open()) {
+		MAGE_ERROR(model) << "Failed to map cooked mesh " << path;
+		return nullptr;
+	}
+
+	FileHeader header{};
+	size_t size = mesh->file.get_size();
+	const char *data = static_cast<const char*>(mesh->file.get_data());
+	if (size < sizeof(FileHeader)) {
+		MAGE_ERROR(model) << "Cooked mesh " << path << " is too small for its header";
+		return nullptr;
+	}
+	std::memcpy(&header, data, sizeof(FileHeader));
+	if (std::memcmp(header.magic, FILE_MAGIC, sizeof(FILE_MAGIC)) != 0 || header.version != FILE_VERSION) {
+		MAGE_ERROR(model) << path << " is not a version " << FILE_VERSION << " cooked mesh, cook it again";
+		return nullptr;
+	}
+	if (header.vertex_stride != sizeof(GameModel::Vertex) || (header.index_size != sizeof(uint16_t) && header.index_size != sizeof(uint32_t))) {
+		MAGE_ERROR(model) << "Cooked mesh " << path << " was written for a different vertex layout, cook it again";
+		return nullptr;
+	}
+	uint64_t vertex_bytes = static_cast<uint64_t>(header.vertex_count) * header.vertex_stride;
+	uint64_t index_bytes = static_cast<uint64_t>(header.index_count) * header.index_size;
+	uint64_t lod_bytes = static_cast<uint64_t>(header.lod_count) * sizeof(ModelLod);
+	// cook() refuses empty meshes, and a zero-sized vertex buffer is invalid to create
+	if (header.vertex_count == 0 || header.vertex_offset % BLOB_ALIGNMENT != 0 || header.index_offset % BLOB_ALIGNMENT != 0 || header.lod_offset % BLOB_ALIGNMENT != 0
+	    || header.vertex_offset < sizeof(FileHeader) || header.index_offset < sizeof(FileHeader) || header.lod_offset < sizeof(FileHeader)
+	    || !blob_fits(header.vertex_offset, vertex_bytes, size) || !blob_fits(header.index_offset, index_bytes, size)
+	    || !blob_fits(header.lod_offset, lod_bytes, size)) {
+		MAGE_ERROR(model) << "Cooked mesh " << path << " is empty, truncated or its blobs are misplaced";
+		return nullptr;
+	}
+	// Checked here rather than in verify() since an index past the vertices would have the GPU read outside the buffer
+	bool indices_valid = header.index_size == sizeof(uint16_t)
+	                     ? indices_in_range<uint16_t>(data + header.index_offset, header.index_count, header.vertex_count)
+	                     : indices_in_range<uint32_t>(data + header.index_offset, header.index_count, header.vertex_count);
+	if (!indices_valid) {
+		MAGE_ERROR(model) << "Cooked mesh " << path << " has indices past the end of its vertices";
+		return nullptr;
+	}
+	const ModelLod *lods = reinterpret_cast<const ModelLod*>(data + header.lod_offset);
+	for (uint32_t lod = 0; lod < header.lod_count; lod++) {
+		if (static_cast<uint64_t>(lods[lod].first_index) + lods[lod].index_count > header.index_count) {
+			MAGE_ERROR(model) << "Cooked mesh " << path << " has a level of detail past the end of its indices";
+			return nullptr;
+		}
+	}
+
+	GameModel::MeshView &view = mesh->view;
+	view.vertices = reinterpret_cast<const GameModel::Vertex*>(data + header.vertex_offset);
+	view.vertex_count = header.vertex_count;
+	view.indices = header.index_count > 0 ? data + header.index_offset : nullptr;
+	view.index_count = header.index_count;
+	view.index_type = header.index_size == sizeof(uint16_t) ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+	view.lods = header.lod_count > 0 ? lods : nullptr;
+	view.lod_count = header.lod_count;
+	view.bounds.aabb_min = {header.aabb_min[0], header.aabb_min[1], header.aabb_min[2]};
+	view.bounds.aabb_max = {header.aabb_max[0], header.aabb_max[1], header.aabb_max[2]};
+	view.bounds.center = {header.center[0], header.center[1], header.center[2]};
+	view.bounds.radius = header.radius;
+	MAGE_DEBUG(model) << "Mapped cooked mesh " << path << ": " << header.vertex_count << " vertices, " << header.index_count << " indices, "
+	                  << header.lod_count << " level(s) of detail";
+	return mesh;
+}
+
+bool CookedMesh::verify() const {
+	FileHeader header{};
+	std::memcpy(&header, file.get_data(), sizeof(FileHeader));
+	const char *data = static_cast<const char*>(file.get_data());
+	uint64_t checksum = hash_bytes(data + header.vertex_offset, static_cast<size_t>(header.vertex_count) * header.vertex_stride);
+	checksum ^= hash_bytes(data + header.index_offset, static_cast<size_t>(header.index_count) * header.index_size);
+	checksum ^= hash_bytes(data + header.lod_offset, static_cast<size_t>(header.lod_count) * sizeof(ModelLod));
+	if (checksum != header.checksum) {
+		MAGE_ERROR(model) << "Cooked mesh " << path << " failed its checksum";
+		return false;
+	}
+	return true;
+}
+
+// Indices are narrowed here rather than at load, so the file holds exactly the bytes the index buffer gets
+bool CookedMesh::cook(const MeshData &mesh, const std::string &path) {
+	MAGE_PROFILE_ZONE("CookedMesh::cook");
+	static_assert(std::is_trivially_copyable<GameModel::Vertex>::value, "cooked meshes store vertices as raw bytes");
+	static_assert(std::is_trivially_copyable<ModelLod>::value, "cooked meshes store levels of detail as raw bytes");
+	if (mesh.vertices.empty()) {
+		MAGE_ERROR(model) << "Refusing to cook an empty mesh to " << path;
+		return false;
+	}
+	FileHeader header{};
+	std::memcpy(header.magic, FILE_MAGIC, sizeof(FILE_MAGIC));
+	header.version = FILE_VERSION;
+	header.vertex_stride = sizeof(GameModel::Vertex);
+	header.vertex_count = static_cast<uint32_t>(mesh.vertices.size());
+	header.index_count = static_cast<uint32_t>(mesh.indices.size());
+	header.lod_count = static_cast<uint32_t>(mesh.lods.size());
+	header.index_size = header.vertex_count < std::numeric_limits<uint16_t>::max() ? sizeof(uint16_t) : sizeof(uint32_t);
+	header.vertex_offset = align_up(sizeof(FileHeader), BLOB_ALIGNMENT);
+	uint64_t vertex_bytes = static_cast<uint64_t>(header.vertex_count) * header.vertex_stride;
+	uint64_t index_bytes = static_cast<uint64_t>(header.index_count) * header.index_size;
+	header.index_offset = align_up(header.vertex_offset + vertex_bytes, BLOB_ALIGNMENT);
+	uint64_t lod_bytes = static_cast<uint64_t>(header.lod_count) * sizeof(ModelLod);
+	header.lod_offset = align_up(header.index_offset + index_bytes, BLOB_ALIGNMENT);
+
+	ModelBounds bounds = GameModel::compute_bounds(mesh.vertices);
+	for (int axis = 0; axis < 3; axis++) {
+		header.aabb_min[axis] = bounds.aabb_min[axis];
+		header.aabb_max[axis] = bounds.aabb_max[axis];
+		header.center[axis] = bounds.center[axis];
+	}
+	header.radius = bounds.radius;
+
+	std::vector<char> file(static_cast<size_t>(header.lod_offset + lod_bytes), 0);
+	std::memcpy(file.data() + header.vertex_offset, mesh.vertices.data(), static_cast<size_t>(vertex_bytes));
+	char *indices = file.data() + header.index_offset;
+	if (header.index_size == sizeof(uint16_t)) {
+		for (uint32_t i = 0; i < header.index_count; i++) {
+			uint16_t index = static_cast<uint16_t>(mesh.indices[i]);
+			std::memcpy(indices + i * sizeof(uint16_t), &index, sizeof(index));
+		}
+	} else if (index_bytes > 0) {
+		std::memcpy(indices, mesh.indices.data(), static_cast<size_t>(index_bytes));
+	}
+	if (lod_bytes > 0) {
+		std::memcpy(file.data() + header.lod_offset, mesh.lods.data(), static_cast<size_t>(lod_bytes));
+	}
+	header.checksum = hash_bytes(file.data() + header.vertex_offset, static_cast<size_t>(vertex_bytes))
+	                  ^ hash_bytes(indices, static_cast<size_t>(index_bytes))
+	                  ^ hash_bytes(file.data() + header.lod_offset, static_cast<size_t>(lod_bytes));
+	std::memcpy(file.data(), &header, sizeof(FileHeader));
+
+	// Written next to the target and renamed over it, so a running game never maps a half-written file
+	std::string temporary_path = path + ".tmp";
+	{
+		std::ofstream output(temporary_path, std::ios::binary | std::ios::trunc);
+		output.write(file.data(), static_cast<std::streamsize>(file.size()));
+		output.flush();
+		if (!output) {
+			MAGE_ERROR(model) << "Failed to write cooked mesh " << temporary_path;
+			std::error_code ignored;
+			std::filesystem::remove(temporary_path, ignored);
+			return false;
+		}
+	}
+	std::error_code error;
+	std::filesystem::rename(temporary_path, path, error);
+	if (error) {
+		MAGE_ERROR(model) << "Failed to replace cooked mesh " << path << ": " << error.message();
+		std::filesystem::remove(temporary_path, error);
+		return false;
+	}
+	MAGE_INFO(model) << "Cooked " << path << ": " << header.vertex_count << " vertices, " << header.index_count << " indices, "
+	                 << header.lod_count << " level(s) of detail, " << static_cast<uint64_t>(file.size()) << " bytes";
+	return true;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "model.hpp"
+#include "mesh-import.hpp"
+#include "../pipeline-resources/shader-registry.hpp"
+#include <memory>
+#include <string>
+
+namespace mage {
+
+	// Mesh stored the way GameModel's buffers want it: a header, the vertex blob, the index blob and the level of detail
+	// table, each aligned.
+	// Loading maps the file and points a MeshView into the mapping, so nothing is parsed, converted or copied until the
+	// upload path copies it into staging. Written by cook(), normally offline through mage-mesh-cook.
+	class CookedMesh {
+	private:
+		static constexpr char FILE_MAGIC[8] = {'M', 'A', 'G', 'E', 'M', 'S', 'H', 'C'};
+		static constexpr uint32_t FILE_VERSION = 2;
+		static constexpr uint64_t BLOB_ALIGNMENT = 16;
+		// Native byte order, cooked files are meant for the machine type that cooked them
+		struct FileHeader {
+			char magic[8];
+			uint32_t version;
+			// sizeof(GameModel::Vertex) at cook time, a changed vertex layout makes old files fail to load instead of draw garbage
+			uint32_t vertex_stride;
+			uint32_t vertex_count;
+			uint32_t index_count;
+			// 2 or 4, chosen the same way GameModel picks its index type
+			uint32_t index_size;
+			// ModelLod entries, 0 for a mesh cooked without levels
+			uint32_t lod_count;
+			uint64_t vertex_offset;
+			uint64_t index_offset;
+			uint64_t lod_offset;
+			// Over every blob, only checked by verify() since reading every byte would defeat the mapping
+			uint64_t checksum;
+			float aabb_min[3];
+			float aabb_max[3];
+			float center[3];
+			float radius;
+		};
+		MappedFile file;
+		GameModel::MeshView view{};
+		std::string path;
+		CookedMesh() = default;
+	public:
+		// Null, with the reason logged, when the file is missing, truncated or from another format version
+		static std::shared_ptr<const CookedMesh> load(const std::string &path);
+		static bool cook(const MeshData &mesh, const std::string &path);
+
+		bool verify() const;
+		// Points into the mapping, valid for as long as this object is
+		const GameModel::MeshView &get_view() const {return view;}
+		const std::string &get_path() const {return path;}
+		size_t get_file_size() const {return file.get_size();}
+	};
+
+}
@@ -0,0 +1,1052 @@
+#include "mesh-import.hpp"
+#include "../debug-resources/log.hpp"
+#include "../debug-resources/cpu-profiler.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <unordered_map>
+
+using namespace mage;
+
+namespace {
+
+	bool read_file(const std::string &path, std::vector<char> &contents) {
+		FILE *file = fopen(path.c_str(), "rb");
+		if (file == nullptr) {
+			return false;
+		}
+		fseek(file, 0, SEEK_END);
+		long size = ftell(file);
+		fseek(file, 0, SEEK_SET);
+		contents.resize(size > 0 ? static_cast<size_t>(size) : 0);
+		size_t read = contents.empty() ? 0 : fread(contents.data(), 1, contents.size(), file);
+		fclose(file);
+		return read == contents.size();
+	}
+
+	std::string directory_of(const std::string &path) {
+		size_t slash = path.find_last_of("/\\");
+		return slash == std::string::npos ? std::string{} : path.substr(0, slash + 1);
+	}
+
+	std::string lower_extension(const std::string &path) {
+		size_t dot = path.find_last_of('.');
+		if (dot == std::string::npos || path.find_first_of("/\\", dot) != std::string::npos) {
+			return {};
+		}
+		std::string extension = path.substr(dot + 1);
+		std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) {return static_cast<char>(std::tolower(c));});
+		return extension;
+	}
+
+	const char *skip_spaces(const char *text) {
+		while (*text == ' ' || *text == '\t' || *text == '\r') {
+			text++;
+		}
+		return text;
+	}
+
+	// Reads up to count floats, returns how many were there
+	uint32_t parse_floats(const char *text, float *values, uint32_t count) {
+		for (uint32_t i = 0; i < count; i++) {
+			text = skip_spaces(text);
+			char *end = nullptr;
+			values[i] = std::strtof(text, &end);
+			if (end == text) {
+				return i;
+			}
+			text = end;
+		}
+		return count;
+	}
+
+	// Rest of the line without surrounding whitespace, material and file names may contain spaces
+	std::string rest_of_line(const char *text) {
+		std::string value = skip_spaces(text);
+		while (!value.empty() && std::isspace(static_cast<unsigned char>(value.back()))) {
+			value.pop_back();
+		}
+		return value;
+	}
+
+	// Calls line_function(keyword, arguments, line_number) for every non-empty line, comments stripped
+	template <typename LineFunction>
+	void for_each_line(std::vector<char> &contents, LineFunction line_function) {
+		contents.push_back('\n');
+		std::string line;
+		uint32_t line_number = 0;
+		size_t start = 0;
+		for (size_t i = 0; i < contents.size(); i++) {
+			if (contents[i] != '\n') {
+				continue;
+			}
+			line_number++;
+			line.assign(contents.data() + start, i - start);
+			start = i + 1;
+			size_t comment = line.find('#');
+			if (comment != std::string::npos) {
+				line.resize(comment);
+			}
+			const char *text = skip_spaces(line.c_str());
+			const char *keyword_end = text;
+			while (*keyword_end != '\0' && !std::isspace(static_cast<unsigned char>(*keyword_end))) {
+				keyword_end++;
+			}
+			if (keyword_end == text) {
+				continue;
+			}
+			line_function(std::string{text, keyword_end}, keyword_end, line_number);
+		}
+	}
+
+	void load_materials(const std::string &path, std::unordered_map<std::string, glm::vec3> &materials) {
+		std::vector<char> contents;
+		if (!read_file(path, contents)) {
+			MAGE_WARN(model) << "Failed to open material library " << path << ", using the default color";
+			return;
+		}
+		std::string current;
+		for_each_line(contents, [&](const std::string &keyword, const char *arguments, uint32_t) {
+			if (keyword == "newmtl") {
+				current = rest_of_line(arguments);
+				materials[current] = DEFAULT_MESH_COLOR;
+			} else if (keyword == "Kd" && !current.empty()) {
+				float values[3];
+				if (parse_floats(arguments, values, 3) == 3) {
+					materials[current] = {values[0], values[1], values[2]};
+				}
+			}
+		});
+	}
+
+	// Minimal JSON document tree, enough to walk a glTF file. Object members keep their file order.
+	struct JsonValue {
+		enum class Type : uint8_t {null, boolean, number, string, array, object};
+		Type type = Type::null;
+		bool boolean = false;
+		double number = 0.0;
+		std::string string;
+		std::vector<std::string> keys;
+		std::vector<JsonValue> values;
+
+		const JsonValue *find(const char *key) const {
+			if (type != Type::object) {
+				return nullptr;
+			}
+			for (size_t i = 0; i < keys.size(); i++) {
+				if (keys[i] == key) {
+					return &values[i];
+				}
+			}
+			return nullptr;
+		}
+		const JsonValue *at(size_t index) const {
+			return type == Type::array && index < values.size() ? &values[index] : nullptr;
+		}
+		size_t size() const {return type == Type::array ? values.size() : 0;}
+		double get_number(const char *key, double fallback) const {
+			const JsonValue *value = find(key);
+			return value != nullptr && value->type == Type::number ? value->number : fallback;
+		}
+		// Fractions and numbers out of int64_t's range give the fallback, casting them would be undefined
+		int64_t get_integer(const char *key, int64_t fallback) const {
+			double number = get_number(key, static_cast<double>(fallback));
+			if (!(number >= -9223372036854775808.0 && number < 9223372036854775808.0) || std::floor(number) != number) {
+				return fallback;
+			}
+			return static_cast<int64_t>(number);
+		}
+		// False unless this is a whole number in [0, max]
+		bool to_size(uint64_t max, uint64_t &size) const {
+			if (type != Type::number || !(number >= 0.0 && number < 18446744073709551616.0 && number <= static_cast<double>(max)) || std::floor(number) != number) {
+				return false;
+			}
+			size = static_cast<uint64_t>(number);
+			return true;
+		}
+		// For byte offsets, lengths and counts, false if present but not a whole number in [0, max]
+		bool get_size(const char *key, uint64_t fallback, uint64_t max, uint64_t &size) const {
+			const JsonValue *value = find(key);
+			if (value == nullptr) {
+				size = fallback;
+				return true;
+			}
+			return value->to_size(max, size);
+		}
+		const std::string *get_string(const char *key) const {
+			const JsonValue *value = find(key);
+			return value != nullptr && value->type == Type::string ? &value->string : nullptr;
+		}
+	};
+
+	// For indices into accessors, meshes and nodes held in members or array elements. False when the value is missing,
+	// not a number, fractional or past max, so a malformed reference fails instead of resolving to some other entry.
+	bool as_index(const JsonValue *value, uint64_t max, uint64_t &index) {
+		return value != nullptr && value->to_size(max, index);
+	}
+
+	// Recursive descent over a range that need not be null-terminated, such as the JSON chunk of a .glb
+	class JsonParser {
+	private:
+		static constexpr uint32_t MAX_DEPTH = 64;
+		const char *cursor;
+		const char *end;
+
+		void skip_whitespace() {
+			while (cursor < end && (*cursor == ' ' || *cursor == '\t' || *cursor == '\n' || *cursor == '\r')) {
+				cursor++;
+			}
+		}
+		bool consume(const char *literal) {
+			size_t length = strlen(literal);
+			if (static_cast<size_t>(end - cursor) < length || strncmp(cursor, literal, length) != 0) {
+				return false;
+			}
+			cursor += length;
+			return true;
+		}
+		static void append_utf8(std::string &out, uint32_t code_point) {
+			if (code_point < 0x80) {
+				out += static_cast<char>(code_point);
+			} else if (code_point < 0x800) {
+				out += static_cast<char>(0xC0 | (code_point >> 6));
+				out += static_cast<char>(0x80 | (code_point & 0x3F));
+			} else if (code_point < 0x10000) {
+				out += static_cast<char>(0xE0 | (code_point >> 12));
+				out += static_cast<char>(0x80 | ((code_point >> 6) & 0x3F));
+				out += static_cast<char>(0x80 | (code_point & 0x3F));
+			} else {
+				out += static_cast<char>(0xF0 | (code_point >> 18));
+				out += static_cast<char>(0x80 | ((code_point >> 12) & 0x3F));
+				out += static_cast<char>(0x80 | ((code_point >> 6) & 0x3F));
+				out += static_cast<char>(0x80 | (code_point & 0x3F));
+			}
+		}
+		bool parse_hex4(uint32_t &value) {
+			if (end - cursor < 4) {
+				return false;
+			}
+			value = 0;
+			for (int i = 0; i < 4; i++) {
+				char c = *cursor++;
+				value <<= 4;
+				if (c >= '0' && c <= '9') {
+					value |= static_cast<uint32_t>(c - '0');
+				} else if (c >= 'a' && c <= 'f') {
+					value |= static_cast<uint32_t>(c - 'a' + 10);
+				} else if (c >= 'A' && c <= 'F') {
+					value |= static_cast<uint32_t>(c - 'A' + 10);
+				} else {
+					return false;
+				}
+			}
+			return true;
+		}
+		bool parse_string(std::string &out) {
+			if (cursor >= end || *cursor != '"') {
+				return false;
+			}
+			cursor++;
+			while (cursor < end && *cursor != '"') {
+				char c = *cursor++;
+				if (c != '\\') {
+					out += c;
+					continue;
+				}
+				if (cursor >= end) {
+					return false;
+				}
+				char escape = *cursor++;
+				switch (escape) {
+					case '"': out += '"'; break;
+					case '\\': out += '\\'; break;
+					case '/': out += '/'; break;
+					case 'b': out += '\b'; break;
+					case 'f': out += '\f'; break;
+					case 'n': out += '\n'; break;
+					case 'r': out += '\r'; break;
+					case 't': out += '\t'; break;
+					case 'u': {
+						uint32_t code_point;
+						if (!parse_hex4(code_point)) {
+							return false;
+						}
+						// Surrogate pair for anything outside the basic multilingual plane
+						if (code_point >= 0xD800 && code_point < 0xDC00) {
+							uint32_t low;
+							if (!consume("\\u") || !parse_hex4(low) || low < 0xDC00 || low >= 0xE000) {
+								return false;
+							}
+							code_point = 0x10000 + ((code_point - 0xD800) << 10) + (low - 0xDC00);
+						}
+						append_utf8(out, code_point);
+						break;
+					}
+					default: return false;
+				}
+			}
+			if (cursor >= end) {
+				return false;
+			}
+			cursor++;
+			return true;
+		}
+		bool parse_number(double &out) {
+			char digits[64];
+			size_t length = 0;
+			while (cursor < end && length + 1 < sizeof(digits) && (std::isdigit(static_cast<unsigned char>(*cursor)) || *cursor == '-' || *cursor == '+' || *cursor == '.' || *cursor == 'e' || *cursor == 'E')) {
+				digits[length++] = *cursor++;
+			}
+			digits[length] = '\0';
+			char *number_end = nullptr;
+			out = std::strtod(digits, &number_end);
+			return length > 0 && number_end == digits + length;
+		}
+		bool parse_value(JsonValue &value, uint32_t depth) {
+			if (depth > MAX_DEPTH) {
+				return false;
+			}
+			skip_whitespace();
+			if (cursor >= end) {
+				return false;
+			}
+			switch (*cursor) {
+				case '{': {
+					value.type = JsonValue::Type::object;
+					cursor++;
+					skip_whitespace();
+					if (cursor < end && *cursor == '}') {
+						cursor++;
+						return true;
+					}
+					while (true) {
+						skip_whitespace();
+						value.keys.emplace_back();
+						if (!parse_string(value.keys.back())) {
+							return false;
+						}
+						skip_whitespace();
+						if (!consume(":")) {
+							return false;
+						}
+						value.values.emplace_back();
+						if (!parse_value(value.values.back(), depth + 1)) {
+							return false;
+						}
+						skip_whitespace();
+						if (consume("}")) {
+							return true;
+						}
+						if (!consume(",")) {
+							return false;
+						}
+					}
+				}
+				case '[': {
+					value.type = JsonValue::Type::array;
+					cursor++;
+					skip_whitespace();
+					if (cursor < end && *cursor == ']') {
+						cursor++;
+						return true;
+					}
+					while (true) {
+						value.values.emplace_back();
+						if (!parse_value(value.values.back(), depth + 1)) {
+							return false;
+						}
+						skip_whitespace();
+						if (consume("]")) {
+							return true;
+						}
+						if (!consume(",")) {
+							return false;
+						}
+					}
+				}
+				case '"':
+					value.type = JsonValue::Type::string;
+					return parse_string(value.string);
+				case 't':
+					value.type = JsonValue::Type::boolean;
+					value.boolean = true;
+					return consume("true");
+				case 'f':
+					value.type = JsonValue::Type::boolean;
+					return consume("false");
+				case 'n':
+					return consume("null");
+				default:
+					value.type = JsonValue::Type::number;
+					return parse_number(value.number);
+			}
+		}
+	public:
+		JsonParser(const char *begin, const char *end_pass) : cursor{begin}, end{end_pass} {}
+		bool parse(JsonValue &root) {
+			if (!parse_value(root, 0)) {
+				return false;
+			}
+			skip_whitespace();
+			// A .glb pads its JSON chunk with spaces, anything else after the document is an error
+			return cursor == end;
+		}
+	};
+
+	bool decode_base64(const char *text, size_t length, std::vector<char> &out) {
+		out.clear();
+		out.reserve(length / 4 * 3);
+		uint32_t bits = 0;
+		int bit_count = 0;
+		for (size_t i = 0; i < length; i++) {
+			char c = text[i];
+			uint32_t value;
+			if (c >= 'A' && c <= 'Z') {
+				value = static_cast<uint32_t>(c - 'A');
+			} else if (c >= 'a' && c <= 'z') {
+				value = static_cast<uint32_t>(c - 'a' + 26);
+			} else if (c >= '0' && c <= '9') {
+				value = static_cast<uint32_t>(c - '0' + 52);
+			} else if (c == '+' || c == '-') {
+				value = 62;
+			} else if (c == '/' || c == '_') {
+				value = 63;
+			} else if (c == '=') {
+				break;
+			} else {
+				return false;
+			}
+			bits = (bits << 6) | value;
+			bit_count += 6;
+			if (bit_count >= 8) {
+				bit_count -= 8;
+				out.push_back(static_cast<char>((bits >> bit_count) & 0xFF));
+			}
+		}
+		return true;
+	}
+
+	// Relative buffer URIs are percent-encoded
+	std::string decode_uri(const std::string &uri) {
+		std::string path;
+		for (size_t i = 0; i < uri.size(); i++) {
+			if (uri[i] == '%' && i + 2 < uri.size() && std::isxdigit(static_cast<unsigned char>(uri[i + 1])) && std::isxdigit(static_cast<unsigned char>(uri[i + 2]))) {
+				path += static_cast<char>(std::strtol(uri.substr(i + 1, 2).c_str(), nullptr, 16));
+				i += 2;
+			} else {
+				path += uri[i];
+			}
+		}
+		return path;
+	}
+
+	constexpr uint32_t GLB_MAGIC = 0x46546C67;
+	constexpr uint32_t GLB_CHUNK_JSON = 0x4E4F534A;
+	constexpr uint32_t GLB_CHUNK_BIN = 0x004E4942;
+
+	constexpr uint32_t GLTF_BYTE = 5120;
+	constexpr uint32_t GLTF_UNSIGNED_BYTE = 5121;
+	constexpr uint32_t GLTF_SHORT = 5122;
+	constexpr uint32_t GLTF_UNSIGNED_SHORT = 5123;
+	constexpr uint32_t GLTF_UNSIGNED_INT = 5125;
+	constexpr uint32_t GLTF_FLOAT = 5126;
+	constexpr int64_t GLTF_TRIANGLES = 4;
+
+	uint32_t read_u32(const char *data) {
+		uint32_t value;
+		memcpy(&value, data, sizeof(value));
+		return value;
+	}
+
+	// Everything the primitives point into, resolved once per file
+	struct GltfFile {
+		std::string path;
+		JsonValue root;
+		std::vector<char> binary_chunk;
+		std::vector<std::vector<char>> buffers;
+	};
+
+	// Strided view of one accessor's elements inside a loaded buffer
+	struct AccessorRange {
+		const unsigned char *data = nullptr;
+		uint32_t count = 0;
+		uint32_t stride = 0;
+		uint32_t components = 0;
+		uint32_t component_type = 0;
+		bool normalized = false;
+	};
+
+	uint32_t component_size(uint32_t component_type) {
+		switch (component_type) {
+			case GLTF_BYTE: case GLTF_UNSIGNED_BYTE: return 1;
+			case GLTF_SHORT: case GLTF_UNSIGNED_SHORT: return 2;
+			case GLTF_UNSIGNED_INT: case GLTF_FLOAT: return 4;
+			default: return 0;
+		}
+	}
+
+	uint32_t component_count(const std::string &type) {
+		if (type == "SCALAR") return 1;
+		if (type == "VEC2") return 2;
+		if (type == "VEC3") return 3;
+		if (type == "VEC4") return 4;
+		return 0;
+	}
+
+	bool load_buffers(GltfFile &file) {
+		const JsonValue *buffers = file.root.find("buffers");
+		size_t count = buffers != nullptr ? buffers->size() : 0;
+		file.buffers.resize(count);
+		for (size_t i = 0; i < count; i++) {
+			const JsonValue &buffer = *buffers->at(i);
+			const std::string *uri = buffer.get_string("uri");
+			std::vector<char> &data = file.buffers[i];
+			if (uri == nullptr) {
+				// Only the first buffer of a .glb may leave out its uri, it is the BIN chunk
+				if (i != 0 || file.binary_chunk.empty()) {
+					MAGE_ERROR(model) << "glTF buffer " << static_cast<uint64_t>(i) << " in " << file.path << " has no data";
+					return false;
+				}
+				data.swap(file.binary_chunk);
+			} else if (uri->compare(0, 5, "data:") == 0) {
+				size_t comma = uri->find(',');
+				if (comma == std::string::npos || uri->rfind(";base64", comma) == std::string::npos || !decode_base64(uri->data() + comma + 1, uri->size() - comma - 1, data)) {
+					MAGE_ERROR(model) << "glTF buffer " << static_cast<uint64_t>(i) << " in " << file.path << " has an unreadable data URI";
+					return false;
+				}
+			} else if (!read_file(directory_of(file.path) + decode_uri(*uri), data)) {
+				MAGE_ERROR(model) << "Failed to read glTF buffer " << *uri << " for " << file.path;
+				return false;
+			}
+			if (static_cast<double>(data.size()) < buffer.get_number("byteLength", 0.0)) {
+				MAGE_ERROR(model) << "glTF buffer " << static_cast<uint64_t>(i) << " in " << file.path << " is shorter than its byteLength";
+				return false;
+			}
+		}
+		return true;
+	}
+
+	bool resolve_accessor(const GltfFile &file, int64_t index, AccessorRange &range) {
+		const JsonValue *accessors = file.root.find("accessors");
+		const JsonValue *accessor = accessors != nullptr && index >= 0 ? accessors->at(static_cast<size_t>(index)) : nullptr;
+		if (accessor == nullptr) {
+			MAGE_ERROR(model) << "glTF accessor " << index << " in " << file.path << " does not exist";
+			return false;
+		}
+		if (accessor->find("sparse") != nullptr || accessor->find("bufferView") == nullptr) {
+			MAGE_ERROR(model) << "glTF accessor " << index << " in " << file.path << " is sparse or has no buffer view, which is not supported";
+			return false;
+		}
+		const std::string *type = accessor->get_string("type");
+		range.components = type != nullptr ? component_count(*type) : 0;
+		range.component_type = static_cast<uint32_t>(accessor->get_integer("componentType", 0));
+		uint64_t count = 0;
+		if (!accessor->get_size("count", 0, UINT32_MAX, count)) {
+			MAGE_ERROR(model) << "glTF accessor " << index << " in " << file.path << " has an invalid count";
+			return false;
+		}
+		range.count = static_cast<uint32_t>(count);
+		const JsonValue *normalized = accessor->find("normalized");
+		range.normalized = normalized != nullptr && normalized->boolean;
+		uint32_t element_size = range.components * component_size(range.component_type);
+		if (element_size == 0) {
+			MAGE_ERROR(model) << "glTF accessor " << index << " in " << file.path << " has an unknown type";
+			return false;
+		}
+
+		const JsonValue *views = file.root.find("bufferViews");
+		const JsonValue *view = views != nullptr ? views->at(static_cast<size_t>(accessor->get_integer("bufferView", -1))) : nullptr;
+		int64_t buffer_index = view != nullptr ? view->get_integer("buffer", -1) : -1;
+		if (buffer_index < 0 || static_cast<size_t>(buffer_index) >= file.buffers.size()) {
+			MAGE_ERROR(model) << "glTF accessor " << index << " in " << file.path << " points at a missing buffer view";
+			return false;
+		}
+		const std::vector<char> &buffer = file.buffers[static_cast<size_t>(buffer_index)];
+		uint64_t view_offset = 0;
+		uint64_t view_length = 0;
+		uint64_t accessor_offset = 0;
+		uint64_t stride = 0;
+		if (!view->get_size("byteOffset", 0, UINT64_MAX, view_offset) || !view->get_size("byteLength", 0, UINT64_MAX, view_length)
+		    || !accessor->get_size("byteOffset", 0, UINT64_MAX, accessor_offset) || !view->get_size("byteStride", 0, UINT32_MAX, stride)) {
+			MAGE_ERROR(model) << "glTF accessor " << index << " in " << file.path << " has a byte offset, length or stride that is not a whole number in range";
+			return false;
+		}
+		range.stride = stride == 0 ? element_size : static_cast<uint32_t>(stride);
+		// Written as subtractions so that no sum can wrap around, stride times count fits since both are 32 bits
+		uint64_t span = range.count == 0 ? 0 : static_cast<uint64_t>(range.stride) * (range.count - 1);
+		if (view_offset > buffer.size() || view_length > buffer.size() - view_offset || accessor_offset > view_length
+		    || (range.count != 0 && (span > view_length - accessor_offset || element_size > view_length - accessor_offset - span))) {
+			MAGE_ERROR(model) << "glTF accessor " << index << " in " << file.path << " reaches past the end of its buffer";
+			return false;
+		}
+		range.data = reinterpret_cast<const unsigned char*>(buffer.data()) + view_offset + accessor_offset;
+		return true;
+	}
+
+	float read_component(const AccessorRange &range, uint32_t element, uint32_t component) {
+		const unsigned char *data = range.data + static_cast<size_t>(range.stride) * element;
+		switch (range.component_type) {
+			case GLTF_FLOAT: {
+				float value;
+				memcpy(&value, data + component * sizeof(float), sizeof(value));
+				return value;
+			}
+			case GLTF_UNSIGNED_BYTE: {
+				float value = static_cast<float>(data[component]);
+				return range.normalized ? value / 255.f : value;
+			}
+			case GLTF_BYTE: {
+				float value = static_cast<float>(static_cast<int8_t>(data[component]));
+				return range.normalized ? std::max(value / 127.f, -1.f) : value;
+			}
+			case GLTF_UNSIGNED_SHORT: {
+				uint16_t value;
+				memcpy(&value, data + component * sizeof(value), sizeof(value));
+				return range.normalized ? value / 65535.f : static_cast<float>(value);
+			}
+			case GLTF_SHORT: {
+				int16_t value;
+				memcpy(&value, data + component * sizeof(value), sizeof(value));
+				return range.normalized ? std::max(value / 32767.f, -1.f) : static_cast<float>(value);
+			}
+			default: {
+				uint32_t value;
+				memcpy(&value, data + component * sizeof(value), sizeof(value));
+				return static_cast<float>(value);
+			}
+		}
+	}
+
+	uint32_t read_index(const AccessorRange &range, uint32_t element) {
+		const unsigned char *data = range.data + static_cast<size_t>(range.stride) * element;
+		switch (range.component_type) {
+			case GLTF_UNSIGNED_BYTE: return data[0];
+			case GLTF_UNSIGNED_SHORT: {
+				uint16_t value;
+				memcpy(&value, data, sizeof(value));
+				return value;
+			}
+			default: {
+				uint32_t value;
+				memcpy(&value, data, sizeof(value));
+				return value;
+			}
+		}
+	}
+
+	// False unless the first count elements of array are finite numbers, values is only written on success
+	bool read_floats(const JsonValue *array, uint32_t count, float *values) {
+		if (array == nullptr || array->size() < count) {
+			return false;
+		}
+		for (uint32_t i = 0; i < count; i++) {
+			const JsonValue *element = array->at(i);
+			if (element->type != JsonValue::Type::number || !std::isfinite(static_cast<float>(element->number))) {
+				return false;
+			}
+		}
+		for (uint32_t i = 0; i < count; i++) {
+			values[i] = static_cast<float>(array->at(i)->number);
+		}
+		return true;
+	}
+
+	// Column-major "matrix" when present, otherwise translation * rotation * scale. A property holding anything but
+	// numbers is left at its default, with a warning.
+	glm::mat4 node_matrix(const GltfFile &file, const JsonValue &node) {
+		const JsonValue *matrix = node.find("matrix");
+		if (matrix != nullptr && matrix->size() == 16) {
+			float values[16];
+			if (read_floats(matrix, 16, values)) {
+				glm::mat4 result{1.f};
+				for (int column = 0; column < 4; column++) {
+					for (int row = 0; row < 4; row++) {
+						result[column][row] = values[column * 4 + row];
+					}
+				}
+				return result;
+			}
+			MAGE_WARN(model) << "Ignoring a glTF node matrix with non-numeric elements in " << file.path;
+		}
+		auto read_vector = [&file, &node](const char *key, uint32_t size, glm::vec4 value) {
+			const JsonValue *array = node.find(key);
+			float values[4];
+			if (array != nullptr && array->size() == size) {
+				if (read_floats(array, size, values)) {
+					for (uint32_t i = 0; i < size; i++) {
+						value[i] = values[i];
+					}
+				} else {
+					MAGE_WARN(model) << "Ignoring a glTF node " << key << " with non-numeric elements in " << file.path;
+				}
+			}
+			return value;
+		};
+		glm::vec4 translation = read_vector("translation", 3, {0.f, 0.f, 0.f, 0.f});
+		glm::vec4 q = read_vector("rotation", 4, {0.f, 0.f, 0.f, 1.f});
+		glm::vec4 scale = read_vector("scale", 3, {1.f, 1.f, 1.f, 0.f});
+		// Unit quaternion (x, y, z, w) to a rotation matrix, columns scaled afterwards
+		glm::mat4 result{1.f};
+		result[0] = glm::vec4{1.f - 2.f * (q.y * q.y + q.z * q.z), 2.f * (q.x * q.y + q.z * q.w), 2.f * (q.x * q.z - q.y * q.w), 0.f} * scale.x;
+		result[1] = glm::vec4{2.f * (q.x * q.y - q.z * q.w), 1.f - 2.f * (q.x * q.x + q.z * q.z), 2.f * (q.y * q.z + q.x * q.w), 0.f} * scale.y;
+		result[2] = glm::vec4{2.f * (q.x * q.z + q.y * q.w), 2.f * (q.y * q.z - q.x * q.w), 1.f - 2.f * (q.x * q.x + q.y * q.y), 0.f} * scale.z;
+		result[3] = glm::vec4{translation.x, translation.y, translation.z, 1.f};
+		return result;
+	}
+
+	glm::vec3 material_color(const GltfFile &file, const JsonValue &primitive) {
+		const JsonValue *materials = file.root.find("materials");
+		const JsonValue *material = materials != nullptr ? materials->at(static_cast<size_t>(primitive.get_integer("material", -1))) : nullptr;
+		const JsonValue *pbr = material != nullptr ? material->find("pbrMetallicRoughness") : nullptr;
+		const JsonValue *factor = pbr != nullptr ? pbr->find("baseColorFactor") : nullptr;
+		float values[3];
+		if (factor == nullptr) {
+			return DEFAULT_MESH_COLOR;
+		}
+		if (!read_floats(factor, 3, values)) {
+			MAGE_WARN(model) << "Ignoring a glTF baseColorFactor with non-numeric elements in " << file.path;
+			return DEFAULT_MESH_COLOR;
+		}
+		return {values[0], values[1], values[2]};
+	}
+
+	bool append_primitive(const GltfFile &file, const JsonValue &primitive, const glm::mat4 &matrix, MeshData &mesh) {
+		if (primitive.get_integer("mode", GLTF_TRIANGLES) != GLTF_TRIANGLES) {
+			MAGE_WARN(model) << "Skipping a non-triangle glTF primitive in " << file.path;
+			return true;
+		}
+		const JsonValue *attributes = primitive.find("attributes");
+		const JsonValue *position_index = attributes != nullptr ? attributes->find("POSITION") : nullptr;
+		if (position_index == nullptr) {
+			MAGE_WARN(model) << "Skipping a glTF primitive without positions in " << file.path;
+			return true;
+		}
+		uint64_t accessor_index = 0;
+		AccessorRange positions;
+		if (!as_index(position_index, UINT32_MAX, accessor_index)) {
+			MAGE_ERROR(model) << "glTF POSITION in " << file.path << " is not a valid accessor index";
+			return false;
+		}
+		if (!resolve_accessor(file, static_cast<int64_t>(accessor_index), positions)) {
+			return false;
+		}
+		if (positions.components != 3 || positions.component_type != GLTF_FLOAT) {
+			MAGE_ERROR(model) << "glTF positions in " << file.path << " are not float VEC3";
+			return false;
+		}
+		AccessorRange colors;
+		const JsonValue *color_index = attributes->find("COLOR_0");
+		bool has_colors = color_index != nullptr;
+		if (has_colors && !as_index(color_index, UINT32_MAX, accessor_index)) {
+			MAGE_ERROR(model) << "glTF COLOR_0 in " << file.path << " is not a valid accessor index";
+			return false;
+		}
+		if (has_colors && !resolve_accessor(file, static_cast<int64_t>(accessor_index), colors)) {
+			return false;
+		}
+		if (has_colors && (colors.count != positions.count || colors.components < 3)) {
+			MAGE_ERROR(model) << "glTF COLOR_0 in " << file.path << " does not match its positions";
+			return false;
+		}
+
+		// Vertex colors are multiplied by the material's base color, as the glTF spec does
+		glm::vec3 base_color = material_color(file, primitive);
+		uint32_t first = static_cast<uint32_t>(mesh.vertices.size());
+		mesh.vertices.reserve(mesh.vertices.size() + positions.count);
+		for (uint32_t i = 0; i < positions.count; i++) {
+			GameModel::Vertex vertex{};
+			glm::vec4 position{read_component(positions, i, 0), read_component(positions, i, 1), read_component(positions, i, 2), 1.f};
+			vertex.position = glm::vec3{matrix * position};
+			vertex.color = base_color;
+			if (has_colors) {
+				vertex.color *= glm::vec3{read_component(colors, i, 0), read_component(colors, i, 1), read_component(colors, i, 2)};
+			}
+			mesh.vertices.push_back(vertex);
+		}
+
+		// Mirroring transforms turn the triangles inside out, swapping two corners puts the winding back
+		bool mirrored = glm::determinant(glm::mat3{matrix}) < 0.f;
+		size_t first_index = mesh.indices.size();
+		const JsonValue *indices_index = primitive.find("indices");
+		if (indices_index != nullptr) {
+			AccessorRange indices;
+			if (!as_index(indices_index, UINT32_MAX, accessor_index)) {
+				MAGE_ERROR(model) << "glTF indices in " << file.path << " do not name a valid accessor";
+				return false;
+			}
+			if (!resolve_accessor(file, static_cast<int64_t>(accessor_index), indices)) {
+				return false;
+			}
+			if (indices.components != 1 || (indices.component_type != GLTF_UNSIGNED_BYTE && indices.component_type != GLTF_UNSIGNED_SHORT && indices.component_type != GLTF_UNSIGNED_INT)) {
+				MAGE_ERROR(model) << "glTF indices in " << file.path << " are not unsigned scalars";
+				return false;
+			}
+			uint32_t count = indices.count - indices.count % 3;
+			for (uint32_t i = 0; i < count; i++) {
+				uint32_t index = read_index(indices, i);
+				if (index >= positions.count) {
+					MAGE_ERROR(model) << "glTF index " << index << " in " << file.path << " is out of range";
+					return false;
+				}
+				mesh.indices.push_back(first + index);
+			}
+		} else {
+			uint32_t count = positions.count - positions.count % 3;
+			for (uint32_t i = 0; i < count; i++) {
+				mesh.indices.push_back(first + i);
+			}
+		}
+		if (mirrored) {
+			for (size_t i = first_index; i + 2 < mesh.indices.size(); i += 3) {
+				std::swap(mesh.indices[i + 1], mesh.indices[i + 2]);
+			}
+		}
+		return true;
+	}
+
+	bool append_mesh(const GltfFile &file, int64_t index, const glm::mat4 &matrix, MeshData &mesh) {
+		const JsonValue *meshes = file.root.find("meshes");
+		const JsonValue *gltf_mesh = meshes != nullptr && index >= 0 ? meshes->at(static_cast<size_t>(index)) : nullptr;
+		const JsonValue *primitives = gltf_mesh != nullptr ? gltf_mesh->find("primitives") : nullptr;
+		if (primitives == nullptr) {
+			MAGE_ERROR(model) << "glTF mesh " << index << " in " << file.path << " does not exist";
+			return false;
+		}
+		for (size_t i = 0; i < primitives->size(); i++) {
+			if (!append_primitive(file, *primitives->at(i), matrix, mesh)) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	bool append_node(const GltfFile &file, int64_t index, const glm::mat4 &parent, MeshData &mesh, uint32_t depth) {
+		const JsonValue *nodes = file.root.find("nodes");
+		const JsonValue *node = nodes != nullptr && index >= 0 ? nodes->at(static_cast<size_t>(index)) : nullptr;
+		// The depth limit also catches node cycles, which the spec forbids but files can still contain
+		if (node == nullptr || depth > 64) {
+			MAGE_ERROR(model) << "glTF node " << index << " in " << file.path << " is missing or nested too deep";
+			return false;
+		}
+		glm::mat4 matrix = parent * node_matrix(file, *node);
+		uint64_t child_index = 0;
+		const JsonValue *mesh_index = node->find("mesh");
+		if (mesh_index != nullptr && !as_index(mesh_index, UINT32_MAX, child_index)) {
+			MAGE_ERROR(model) << "glTF node " << index << " in " << file.path << " has an invalid mesh index";
+			return false;
+		}
+		if (mesh_index != nullptr && !append_mesh(file, static_cast<int64_t>(child_index), matrix, mesh)) {
+			return false;
+		}
+		const JsonValue *children = node->find("children");
+		for (size_t i = 0; children != nullptr && i < children->size(); i++) {
+			if (!as_index(children->at(i), UINT32_MAX, child_index)) {
+				MAGE_ERROR(model) << "glTF node " << index << " in " << file.path << " has an invalid child index";
+				return false;
+			}
+			if (!append_node(file, static_cast<int64_t>(child_index), matrix, mesh, depth + 1)) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// Splits a .glb into its JSON text and BIN chunk
+	bool split_glb(GltfFile &file, const std::vector<char> &contents, const char *&json_begin, const char *&json_end) {
+		if (contents.size() < 20 || read_u32(contents.data() + 4) != 2 || read_u32(contents.data() + 8) > contents.size()) {
+			MAGE_ERROR(model) << file.path << " is not a glTF 2.0 binary";
+			return false;
+		}
+		size_t offset = 12;
+		size_t total = read_u32(contents.data() + 8);
+		json_begin = nullptr;
+		while (offset + 8 <= total) {
+			uint32_t length = read_u32(contents.data() + offset);
+			uint32_t type = read_u32(contents.data() + offset + 4);
+			const char *data = contents.data() + offset + 8;
+			if (offset + 8 + length > total) {
+				break;
+			}
+			if (type == GLB_CHUNK_JSON && json_begin == nullptr) {
+				json_begin = data;
+				json_end = data + length;
+			} else if (type == GLB_CHUNK_BIN && file.binary_chunk.empty()) {
+				file.binary_chunk.assign(data, data + length);
+			}
+			offset += 8 + length;
+		}
+		if (json_begin == nullptr) {
+			MAGE_ERROR(model) << file.path << " has no JSON chunk";
+			return false;
+		}
+		return true;
+	}
+
+	void log_import(const std::string &path, const MeshData &mesh) {
+		MAGE_INFO(model) << "Imported " << path << ": " << static_cast<uint64_t>(mesh.vertices.size()) << " vertices, "
+		                 << static_cast<uint64_t>(mesh.indices.size() / 3) << " triangles";
+	}
+
+}
+
+bool mage::import_mesh(const std::string &path, MeshData &mesh) {
+	std::string extension = lower_extension(path);
+	if (extension == "obj") {
+		return import_obj(path, mesh);
+	}
+	if (extension == "gltf" || extension == "glb") {
+		return import_gltf(path, mesh);
+	}
+	MAGE_ERROR(model) << "Unsupported mesh format for " << path << ", expected .obj, .gltf or .glb";
+	return false;
+}
+
+bool mage::import_obj(const std::string &path, MeshData &mesh) {
+	MAGE_PROFILE_ZONE("import_obj");
+	std::vector<char> contents;
+	if (!read_file(path, contents)) {
+		MAGE_ERROR(model) << "Failed to open mesh " << path;
+		return false;
+	}
+
+	std::vector<glm::vec3> positions;
+	// Per position, zero alpha means the file gave no color for it
+	std::vector<glm::vec4> colors;
+	std::unordered_map<std::string, glm::vec3> materials;
+	glm::vec3 current_color = DEFAULT_MESH_COLOR;
+	std::vector<GameModel::Vertex> triangle_soup;
+	std::vector<uint32_t> corners;
+	bool valid = true;
+	for_each_line(contents, [&](const std::string &keyword, const char *arguments, uint32_t line_number) {
+		if (!valid) {
+			return;
+		}
+		if (keyword == "v") {
+			float values[6];
+			uint32_t count = parse_floats(arguments, values, 6);
+			if (count < 3) {
+				MAGE_ERROR(model) << path << ":" << line_number << " has a vertex with fewer than three coordinates";
+				valid = false;
+				return;
+			}
+			positions.emplace_back(values[0], values[1], values[2]);
+			colors.push_back(count == 6 ? glm::vec4{values[3], values[4], values[5], 1.f} : glm::vec4{0.f});
+		} else if (keyword == "f") {
+			corners.clear();
+			const char *text = arguments;
+			while (*(text = skip_spaces(text)) != '\0') {
+				char *end = nullptr;
+				long index = std::strtol(text, &end, 10);
+				// Negative indices count back from the latest vertex
+				long resolved = index < 0 ? static_cast<long>(positions.size()) + index : index - 1;
+				if (end == text || resolved < 0 || resolved >= static_cast<long>(positions.size())) {
+					MAGE_ERROR(model) << path << ":" << line_number << " has a face corner that is not a valid vertex";
+					valid = false;
+					return;
+				}
+				corners.push_back(static_cast<uint32_t>(resolved));
+				// Texture coordinate and normal indices are not used
+				while (*end != '\0' && !std::isspace(static_cast<unsigned char>(*end))) {
+					end++;
+				}
+				text = end;
+			}
+			for (size_t corner = 1; corner + 1 < corners.size(); corner++) {
+				for (uint32_t position : {corners[0], corners[corner], corners[corner + 1]}) {
+					GameModel::Vertex vertex{};
+					vertex.position = positions[position];
+					vertex.color = colors[position].w > 0.f ? glm::vec3{colors[position]} : current_color;
+					triangle_soup.push_back(vertex);
+				}
+			}
+		} else if (keyword == "mtllib") {
+			load_materials(directory_of(path) + rest_of_line(arguments), materials);
+		} else if (keyword == "usemtl") {
+			auto found = materials.find(rest_of_line(arguments));
+			current_color = found != materials.end() ? found->second : DEFAULT_MESH_COLOR;
+		}
+	});
+	if (!valid) {
+		return false;
+	}
+	if (triangle_soup.empty()) {
+		MAGE_ERROR(model) << path << " has no faces";
+		return false;
+	}
+	GameModel::deduplicate_vertices(triangle_soup, mesh.vertices, mesh.indices);
+	mesh.lods.clear();
+	log_import(path, mesh);
+	return true;
+}
+
+bool mage::import_gltf(const std::string &path, MeshData &mesh) {
+	MAGE_PROFILE_ZONE("import_gltf");
+	GltfFile file;
+	file.path = path;
+	std::vector<char> contents;
+	if (!read_file(path, contents)) {
+		MAGE_ERROR(model) << "Failed to open mesh " << path;
+		return false;
+	}
+	const char *json_begin = contents.data();
+	const char *json_end = contents.data() + contents.size();
+	if (contents.size() >= 4 && read_u32(contents.data()) == GLB_MAGIC && !split_glb(file, contents, json_begin, json_end)) {
+		return false;
+	}
+	if (!JsonParser{json_begin, json_end}.parse(file.root) || file.root.type != JsonValue::Type::object) {
+		MAGE_ERROR(model) << "Failed to parse the glTF JSON in " << path;
+		return false;
+	}
+	const JsonValue *asset = file.root.find("asset");
+	const std::string *version = asset != nullptr ? asset->get_string("version") : nullptr;
+	if (version == nullptr || version->compare(0, 2, "2.") != 0) {
+		MAGE_ERROR(model) << path << " is not a glTF 2.0 file";
+		return false;
+	}
+	if (!load_buffers(file)) {
+		return false;
+	}
+
+	mesh.vertices.clear();
+	mesh.indices.clear();
+	mesh.lods.clear();
+	// Without scenes there is nothing placing the meshes, so each is taken as-is
+	const JsonValue *scenes = file.root.find("scenes");
+	uint64_t scene_index = 0;
+	if (file.root.find("scene") != nullptr && (scenes == nullptr || scenes->size() == 0 || !file.root.get_size("scene", 0, scenes->size() - 1, scene_index))) {
+		MAGE_ERROR(model) << path << " names a scene that does not exist";
+		return false;
+	}
+	const JsonValue *scene = scenes != nullptr ? scenes->at(static_cast<size_t>(scene_index)) : nullptr;
+	if (scene != nullptr) {
+		const JsonValue *nodes = scene->find("nodes");
+		for (size_t i = 0; nodes != nullptr && i < nodes->size(); i++) {
+			uint64_t node_index = 0;
+			if (!as_index(nodes->at(i), UINT32_MAX, node_index)) {
+				MAGE_ERROR(model) << "glTF scene " << scene_index << " in " << path << " has an invalid node index";
+				return false;
+			}
+			if (!append_node(file, static_cast<int64_t>(node_index), glm::mat4{1.f}, mesh, 0)) {
+				return false;
+			}
+		}
+	} else {
+		const JsonValue *meshes = file.root.find("meshes");
+		for (size_t i = 0; meshes != nullptr && i < meshes->size(); i++) {
+			if (!append_mesh(file, static_cast<int64_t>(i), glm::mat4{1.f}, mesh)) {
+				return false;
+			}
+		}
+	}
+	if (mesh.indices.empty()) {
+		MAGE_ERROR(model) << path << " has no triangles";
+		return false;
+	}
+	log_import(path, mesh);
+	return true;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "model.hpp"
+#include <string>
+#include <vector>
+
+namespace mage {
+
+	// Indexed triangle list as the importers produce it, before cooking or upload
+	struct MeshData {
+		std::vector<GameModel::Vertex> vertices;
+		std::vector<uint32_t> indices;
+		// Ranges of indices, finest first, filled by generate_lods. Empty means one level covering every index.
+		std::vector<ModelLod> lods;
+	};
+
+	// Vertex color used when a file has neither vertex colors nor a material color
+	const glm::vec3 DEFAULT_MESH_COLOR{.8f, .8f, .8f};
+
+	// Positions are kept in the file's own coordinate system. Only what GameModel::Vertex can hold is read: positions
+	// plus vertex colors, falling back to the material's diffuse or base color. Every mesh in the file is merged into one.
+	// Each importer logs what went wrong and returns false on anything it cannot read.
+
+	// Picks the importer from the extension: .obj, .gltf or .glb
+	bool import_mesh(const std::string &path, MeshData &mesh);
+	// Polygons are fan-triangulated, colors come from "v x y z r g b" or the Kd of the mtllib material in use
+	bool import_obj(const std::string &path, MeshData &mesh);
+	// glTF 2.0, embedded or external buffers and binary .glb. Triangle primitives only, placed by the default scene's node transforms.
+	bool import_gltf(const std::string &path, MeshData &mesh);
+
+}
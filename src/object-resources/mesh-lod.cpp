@@ -0,0 +1,328 @@
+#include "mesh-lod.hpp"
+#include "../debug-resources/log.hpp"
+#include "../debug-resources/cpu-profiler.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <numeric>
+#include <unordered_map>
+
+using namespace mage;
+
+namespace {
+
+	// Coarser levels than this save too little to be worth an index range
+	constexpr uint32_t MIN_LOD_TRIANGLES = 8;
+
+	// Symmetric 4x4 matrix summing the squared distance to a set of planes, kept as its upper triangle. Each plane is
+	// weighted by the area of its triangle and error() divides the weight back out, so it returns the area-weighted mean
+	// squared distance. That orders collapses well but understates the worst case, which is measured separately.
+	struct Quadric {
+		double a00 = 0.0, a01 = 0.0, a02 = 0.0, a03 = 0.0;
+		double a11 = 0.0, a12 = 0.0, a13 = 0.0;
+		double a22 = 0.0, a23 = 0.0;
+		double a33 = 0.0;
+		double weight = 0.0;
+
+		// normal must be unit length, d is the plane's offset so that dot(normal, p) + d = 0 on it
+		static Quadric from_plane(const glm::dvec3 &normal, double d, double weight) {
+			Quadric quadric{};
+			quadric.a00 = weight * normal.x * normal.x;
+			quadric.a01 = weight * normal.x * normal.y;
+			quadric.a02 = weight * normal.x * normal.z;
+			quadric.a03 = weight * normal.x * d;
+			quadric.a11 = weight * normal.y * normal.y;
+			quadric.a12 = weight * normal.y * normal.z;
+			quadric.a13 = weight * normal.y * d;
+			quadric.a22 = weight * normal.z * normal.z;
+			quadric.a23 = weight * normal.z * d;
+			quadric.a33 = weight * d * d;
+			quadric.weight = weight;
+			return quadric;
+		}
+
+		void add(const Quadric &other) {
+			a00 += other.a00; a01 += other.a01; a02 += other.a02; a03 += other.a03;
+			a11 += other.a11; a12 += other.a12; a13 += other.a13;
+			a22 += other.a22; a23 += other.a23;
+			a33 += other.a33;
+			weight += other.weight;
+		}
+
+		double error(const glm::vec3 &point) const {
+			double x = point.x, y = point.y, z = point.z;
+			double sum = a00 * x * x + 2.0 * a01 * x * y + 2.0 * a02 * x * z + 2.0 * a03 * x
+			           + a11 * y * y + 2.0 * a12 * y * z + 2.0 * a13 * y
+			           + a22 * z * z + 2.0 * a23 * z
+			           + a33;
+			return weight > 0.0 ? std::max(sum, 0.0) / weight : 0.0;
+		}
+	};
+
+	// Bit patterns with -0 folded into +0, only positions that compare equal are welded
+	struct PositionHash {
+		size_t operator()(const glm::vec3 &position) const {
+			size_t seed = 0;
+			for (int axis = 0; axis < 3; axis++) {
+				float value = position[axis] == 0.f ? 0.f : position[axis];
+				uint32_t bits;
+				std::memcpy(&bits, &value, sizeof(bits));
+				seed ^= std::hash<uint32_t>{}(bits) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+			}
+			return seed;
+		}
+	};
+
+	struct Collapse {
+		uint32_t from;
+		uint32_t to;
+		double error;
+	};
+
+	// xyz is the unit normal, w the offset
+	double plane_distance(const glm::dvec4 &plane, const glm::vec3 &point) {
+		return std::abs(plane.x * point.x + plane.y * point.y + plane.z * point.z + plane.w);
+	}
+
+	uint64_t edge_key(uint32_t a, uint32_t b) {
+		return a < b ? (static_cast<uint64_t>(a) << 32) | b : (static_cast<uint64_t>(b) << 32) | a;
+	}
+
+}
+
+// Works in passes: every edge is costed, the cheapest collapses are applied as long as they don't touch anything an
+// earlier collapse of the same pass changed, then the triangles are rewritten and the next pass starts over. Slower than
+// keeping a heap up to date, but the adjacency never has to be patched and cooking is offline anyway.
+float mage::simplify_mesh(const std::vector<GameModel::Vertex> &vertices, const std::vector<uint32_t> &indices,
+                          uint32_t target_index_count, float max_error, std::vector<uint32_t> &result) {
+	MAGE_PROFILE_ZONE("simplify_mesh");
+	result = indices;
+
+	// Collapses work on positions, each keeps the first vertex found there as the one moved corners are pointed at
+	std::vector<uint32_t> position_of(vertices.size());
+	std::vector<glm::vec3> positions;
+	std::vector<uint32_t> representative;
+	std::unordered_map<glm::vec3, uint32_t, PositionHash> welded;
+	welded.reserve(vertices.size());
+	for (uint32_t vertex = 0; vertex < static_cast<uint32_t>(vertices.size()); vertex++) {
+		auto found = welded.emplace(vertices[vertex].position, static_cast<uint32_t>(positions.size()));
+		if (found.second) {
+			positions.push_back(vertices[vertex].position);
+			representative.push_back(vertex);
+		}
+		position_of[vertex] = found.first->second;
+	}
+	uint32_t position_count = static_cast<uint32_t>(positions.size());
+	auto corner = [&](size_t index) {return position_of[result[index]];};
+
+	// Besides its quadric, each position keeps the original triangles whose planes it has gathered. A collapse moves
+	// from onto to, so its true error is how far to lies from the planes from gathered, to's own were checked earlier.
+	std::vector<Quadric> quadrics(position_count);
+	std::vector<glm::dvec4> planes;
+	std::vector<std::vector<uint32_t>> gathered(position_count);
+	for (size_t triangle = 0; triangle + 2 < result.size(); triangle += 3) {
+		glm::dvec3 p0 = positions[corner(triangle)];
+		glm::dvec3 p1 = positions[corner(triangle + 1)];
+		glm::dvec3 p2 = positions[corner(triangle + 2)];
+		glm::dvec3 normal = glm::cross(p1 - p0, p2 - p0);
+		double length = glm::length(normal);
+		if (length == 0.0) {
+			continue;
+		}
+		normal /= length;
+		double d = -glm::dot(normal, p0);
+		Quadric plane = Quadric::from_plane(normal, d, 0.5 * length);
+		for (size_t i = 0; i < 3; i++) {
+			quadrics[corner(triangle + i)].add(plane);
+			gathered[corner(triangle + i)].push_back(static_cast<uint32_t>(planes.size()));
+		}
+		planes.push_back({normal.x, normal.y, normal.z, d});
+	}
+
+	const double mean_limit = static_cast<double>(max_error) * static_cast<double>(max_error);
+	const uint32_t target_triangles = target_index_count / 3;
+	double worst = 0.0;
+	std::vector<uint32_t> remap(position_count);
+	std::vector<uint8_t> locked(position_count);
+	std::vector<uint8_t> touched(position_count);
+	std::vector<uint32_t> triangle_offsets;
+	std::vector<uint32_t> triangle_list;
+	std::unordered_map<uint64_t, uint32_t> edge_uses;
+	std::vector<Collapse> collapses;
+	while (result.size() / 3 > target_triangles) {
+		uint32_t triangle_count = static_cast<uint32_t>(result.size() / 3);
+
+		// An edge with one triangle is an open border, with more than two it is non-manifold, neither end of either moves
+		edge_uses.clear();
+		for (size_t triangle = 0; triangle < result.size(); triangle += 3) {
+			for (size_t i = 0; i < 3; i++) {
+				edge_uses[edge_key(corner(triangle + i), corner(triangle + (i + 1) % 3))]++;
+			}
+		}
+		std::fill(locked.begin(), locked.end(), 0);
+		for (const auto &edge : edge_uses) {
+			if (edge.second != 2) {
+				locked[edge.first >> 32] = 1;
+				locked[edge.first & 0xffffffffu] = 1;
+			}
+		}
+
+		// Triangles around each position, for the flip test
+		triangle_offsets.assign(position_count + 1, 0);
+		for (size_t index = 0; index < result.size(); index++) {
+			triangle_offsets[corner(index) + 1]++;
+		}
+		std::partial_sum(triangle_offsets.begin(), triangle_offsets.end(), triangle_offsets.begin());
+		triangle_list.resize(result.size());
+		std::vector<uint32_t> cursor(triangle_offsets.begin(), triangle_offsets.end() - 1);
+		for (size_t index = 0; index < result.size(); index++) {
+			triangle_list[cursor[corner(index)]++] = static_cast<uint32_t>(index / 3);
+		}
+
+		// Each edge collapses whichever way moves the surface less
+		collapses.clear();
+		for (const auto &edge : edge_uses) {
+			uint32_t a = static_cast<uint32_t>(edge.first >> 32);
+			uint32_t b = static_cast<uint32_t>(edge.first & 0xffffffffu);
+			if (locked[a] && locked[b]) {
+				continue;
+			}
+			Quadric combined = quadrics[a];
+			combined.add(quadrics[b]);
+			double a_to_b = locked[a] ? std::numeric_limits<double>::max() : combined.error(positions[b]);
+			double b_to_a = locked[b] ? std::numeric_limits<double>::max() : combined.error(positions[a]);
+			collapses.push_back(a_to_b <= b_to_a ? Collapse{a, b, a_to_b} : Collapse{b, a, b_to_a});
+		}
+		// Ties broken by position so the same mesh always simplifies the same way
+		std::sort(collapses.begin(), collapses.end(), [](const Collapse &left, const Collapse &right) {
+			if (left.error != right.error) {
+				return left.error < right.error;
+			}
+			return left.from != right.from ? left.from < right.from : left.to < right.to;
+		});
+
+		std::iota(remap.begin(), remap.end(), 0u);
+		std::fill(touched.begin(), touched.end(), 0);
+		uint32_t removed = 0;
+		uint32_t applied = 0;
+		for (const Collapse &collapse : collapses) {
+			// A mean over the limit means the worst case is too, nothing after this one can pass
+			if (triangle_count - removed <= target_triangles || collapse.error > mean_limit) {
+				break;
+			}
+			if (touched[collapse.from] || touched[collapse.to]) {
+				continue;
+			}
+			double deviation = 0.0;
+			for (uint32_t plane : gathered[collapse.from]) {
+				deviation = std::max(deviation, plane_distance(planes[plane], positions[collapse.to]));
+			}
+			if (deviation > static_cast<double>(max_error)) {
+				continue;
+			}
+			// Triangles sharing the edge disappear, every other one around from must keep facing the same way
+			uint32_t collapsing = 0;
+			bool flips = false;
+			for (uint32_t i = triangle_offsets[collapse.from]; i < triangle_offsets[collapse.from + 1] && !flips; i++) {
+				size_t triangle = static_cast<size_t>(triangle_list[i]) * 3;
+				uint32_t ids[3] = {corner(triangle), corner(triangle + 1), corner(triangle + 2)};
+				if (ids[0] == collapse.to || ids[1] == collapse.to || ids[2] == collapse.to) {
+					collapsing++;
+					continue;
+				}
+				glm::vec3 before[3] = {positions[ids[0]], positions[ids[1]], positions[ids[2]]};
+				glm::vec3 after[3] = {before[0], before[1], before[2]};
+				for (uint32_t k = 0; k < 3; k++) {
+					if (ids[k] == collapse.from) {
+						after[k] = positions[collapse.to];
+					}
+				}
+				glm::vec3 normal_before = glm::cross(before[1] - before[0], before[2] - before[0]);
+				glm::vec3 normal_after = glm::cross(after[1] - after[0], after[2] - after[0]);
+				flips = glm::dot(normal_before, normal_after) <= 0.f;
+			}
+			if (flips) {
+				continue;
+			}
+
+			remap[collapse.from] = collapse.to;
+			quadrics[collapse.to].add(quadrics[collapse.from]);
+			std::vector<uint32_t> &into = gathered[collapse.to];
+			into.insert(into.end(), gathered[collapse.from].begin(), gathered[collapse.from].end());
+			std::sort(into.begin(), into.end());
+			into.erase(std::unique(into.begin(), into.end()), into.end());
+			worst = std::max(worst, deviation);
+			removed += collapsing;
+			applied++;
+			// Everything around from changes shape, it stays still for the rest of the pass so later flip tests hold
+			for (uint32_t i = triangle_offsets[collapse.from]; i < triangle_offsets[collapse.from + 1]; i++) {
+				size_t triangle = static_cast<size_t>(triangle_list[i]) * 3;
+				for (size_t k = 0; k < 3; k++) {
+					touched[corner(triangle + k)] = 1;
+				}
+			}
+		}
+		if (applied == 0) {
+			break;
+		}
+
+		// Corners on a collapsed position take the representative vertex of where it went, triangles that lost an
+		// edge are dropped
+		size_t write = 0;
+		for (size_t triangle = 0; triangle < result.size(); triangle += 3) {
+			uint32_t moved[3];
+			uint32_t ids[3];
+			for (size_t k = 0; k < 3; k++) {
+				uint32_t position = corner(triangle + k);
+				moved[k] = remap[position] != position ? representative[remap[position]] : result[triangle + k];
+				ids[k] = remap[position];
+			}
+			if (ids[0] == ids[1] || ids[1] == ids[2] || ids[0] == ids[2]) {
+				continue;
+			}
+			for (size_t k = 0; k < 3; k++) {
+				result[write++] = moved[k];
+			}
+		}
+		result.resize(write);
+	}
+	return static_cast<float>(worst);
+}
+
+// Every level is simplified from the full mesh, so its error is measured against what it stands in for
+uint32_t mage::generate_lods(MeshData &mesh, const LodSettings &settings) {
+	MAGE_PROFILE_ZONE("generate_lods");
+	uint32_t full_count = static_cast<uint32_t>(mesh.indices.size());
+	mesh.lods.assign(1, {0, full_count, 0.f});
+	uint32_t max_lods = std::min(settings.max_lods, MAX_LODS);
+	if (full_count == 0 || max_lods < 2) {
+		return static_cast<uint32_t>(mesh.lods.size());
+	}
+
+	float max_error = settings.max_error * GameModel::compute_bounds(mesh.vertices).radius;
+	const std::vector<uint32_t> full = mesh.indices;
+	std::vector<uint32_t> simplified;
+	uint32_t previous_count = full_count;
+	while (mesh.lods.size() < max_lods) {
+		uint32_t target = static_cast<uint32_t>(static_cast<float>(previous_count) * settings.reduction) / 3 * 3;
+		if (target < MIN_LOD_TRIANGLES * 3) {
+			break;
+		}
+		float error = simplify_mesh(mesh.vertices, full, target, max_error, simplified);
+		// A level that barely shrank costs index memory without saving vertex work
+		if (simplified.empty() || static_cast<uint64_t>(simplified.size()) * 10 > static_cast<uint64_t>(previous_count) * 9) {
+			break;
+		}
+		// Selection assumes coarser levels never look better than finer ones
+		error = std::max(error, mesh.lods.back().error);
+		mesh.lods.push_back({static_cast<uint32_t>(mesh.indices.size()), static_cast<uint32_t>(simplified.size()), error});
+		mesh.indices.insert(mesh.indices.end(), simplified.begin(), simplified.end());
+		previous_count = static_cast<uint32_t>(simplified.size());
+		MAGE_DEBUG(model) << " - LOD " << static_cast<uint64_t>(mesh.lods.size() - 1) << ": " << previous_count / 3 << " triangles, error " << error;
+	}
+	MAGE_INFO(model) << "Generated " << static_cast<uint64_t>(mesh.lods.size()) << " level(s) of detail from " << full_count / 3
+	                 << " triangles down to " << mesh.lods.back().index_count / 3;
+	return static_cast<uint32_t>(mesh.lods.size());
+}
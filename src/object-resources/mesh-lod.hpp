@@ -0,0 +1,32 @@
+#pragma once
+
+#include "model.hpp"
+#include "mesh-import.hpp"
+#include <cstdint>
+#include <vector>
+
+namespace mage {
+
+	struct LodSettings {
+		// Levels to aim for including the full mesh, clamped to MAX_LODS
+		uint32_t max_lods = 4;
+		// Share of the previous level's triangles each level aims to keep
+		float reduction = 0.5f;
+		// Largest error a level may reach, as a fraction of the mesh's bounding radius
+		float max_error = 0.25f;
+	};
+
+	// Quadric error edge collapse (Garland and Heckbert). Each position collapses onto a neighbour, so result indexes
+	// the same vertices and no new ones are made. Vertices that share a position but differ in color move together. Open
+	// borders and non-manifold edges stay put, and a collapse that would flip a triangle is refused, so the result may
+	// stop short of target_index_count. Returns the largest distance, in model units, from a moved vertex to the plane of
+	// any original triangle it was collapsed across. That is a worst case, not a mean, so it can bound screen error.
+	float simplify_mesh(const std::vector<GameModel::Vertex> &vertices, const std::vector<uint32_t> &indices,
+	                    uint32_t target_index_count, float max_error, std::vector<uint32_t> &result);
+
+	// Offline, ahead of cooking: appends each simplified level to mesh.indices and records every level, the full mesh
+	// first, in mesh.lods. Vertices are left alone so all levels share one vertex buffer. Stops early once a level no
+	// longer shrinks by much. Returns the number of levels.
+	uint32_t generate_lods(MeshData &mesh, const LodSettings &settings = {});
+
+}
@@ -1,43 +1,253 @@
 #include "model.hpp"
+#include "../debug-resources/log.hpp"
+#include "../debug-resources/cpu-profiler.hpp"
 
-#include <iostream>
+#include <stdexcept>
 #include <cstring>
+#include <functional>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <limits>
+#include <unordered_map>
 
 using namespace mage;
 
+namespace {
+
+	// Hashes the bit patterns with -0 folded into +0, since the two compare equal and equal keys must hash equally
+	struct VertexHash {
+		size_t operator()(const GameModel::Vertex &vertex) const {
+			const float values[] = {vertex.position.x, vertex.position.y, vertex.position.z, vertex.color.x, vertex.color.y, vertex.color.z};
+			size_t seed = 0;
+			for (float value : values) {
+				value = value == 0.f ? 0.f : value;
+				uint32_t bits;
+				memcpy(&bits, &value, sizeof(bits));
+				seed ^= std::hash<uint32_t>{}(bits) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+			}
+			return seed;
+		}
+	};
+
+}
+
+// Atomic so models may be created off the main thread
+uint32_t GameModel::allocate_sort_id(){
+	static std::atomic<uint32_t> next_id{0};
+	return next_id.fetch_add(1, std::memory_order_relaxed);
+}
+
 GameModel::GameModel(DeviceHandling &device_pass, const std::vector<Vertex> &vertices) : device{device_pass} {
-	std::cout << std::endl << "=== GAME MODEL CREATION ===" << std::endl; 
+	MAGE_DEBUG(model) << "=== GAME MODEL CREATION ==="; 
 	create_vertex_buffers(vertices);
-	std::cout << "=== GAME MODEL FINISHED ===" << std::endl;
+	set_lods(nullptr, 0);
+	MAGE_DEBUG(model) << "=== GAME MODEL FINISHED ===";
 }
 
+GameModel::GameModel(DeviceHandling &device_pass, const std::vector<Vertex> &vertices, const std::vector<uint32_t> &indices) : device{device_pass} {
+	MAGE_DEBUG(model) << "=== INDEXED GAME MODEL CREATION ===";
+	create_vertex_buffers(vertices);
+	create_index_buffers(indices);
+	set_lods(nullptr, 0);
+	MAGE_DEBUG(model) << "=== INDEXED GAME MODEL FINISHED ===";
+}
+
+GameModel::GameModel(DeviceHandling &device_pass, const std::vector<Vertex> &triangle_soup, Deduplicate) : device{device_pass} {
+	MAGE_DEBUG(model) << "=== DEDUPLICATED GAME MODEL CREATION ===";
+	std::vector<Vertex> vertices;
+	std::vector<uint32_t> indices;
+	deduplicate_vertices(triangle_soup, vertices, indices);
+	MAGE_DEBUG(model) << " - " << static_cast<uint64_t>(triangle_soup.size()) << " soup vertices became " << static_cast<uint64_t>(vertices.size()) << " unique";
+	create_vertex_buffers(vertices);
+	create_index_buffers(indices);
+	set_lods(nullptr, 0);
+	MAGE_DEBUG(model) << "=== DEDUPLICATED GAME MODEL FINISHED ===";
+}
+
+GameModel::GameModel(DeviceHandling &device_pass, const std::vector<Vertex> &vertices, const std::vector<uint32_t> &indices, const BufferWriter &writer) : device{device_pass} {
+	MAGE_DEBUG(model) << "=== STAGED GAME MODEL CREATION ===";
+	create_vertex_buffers(vertices, writer);
+	create_index_buffers(indices, writer);
+	set_lods(nullptr, 0);
+	MAGE_DEBUG(model) << "=== STAGED GAME MODEL FINISHED ===";
+}
+
+GameModel::GameModel(DeviceHandling &device_pass, const MeshView &mesh) : GameModel{device_pass, mesh, [this](VkBuffer destination, const void *data, VkDeviceSize size) {
+	device.upload_buffer(destination, data, size);
+}} {}
+
+// Counts, index type and bounds are taken as given, the view's memory goes to the writer untouched
+GameModel::GameModel(DeviceHandling &device_pass, const MeshView &mesh, const BufferWriter &writer) : device{device_pass} {
+	MAGE_DEBUG(model) << "=== MESH VIEW GAME MODEL CREATION ===";
+	vertex_count = mesh.vertex_count;
+	bounds = mesh.bounds;
+	write_vertex_buffer(mesh.vertices, writer);
+	index_count = mesh.index_count;
+	index_type = mesh.index_type;
+	write_index_buffer(mesh.indices, writer);
+	set_lods(mesh.lods, mesh.lod_count);
+	MAGE_DEBUG(model) << "=== MESH VIEW GAME MODEL FINISHED ===";
+}
+
+// Without levels of its own the model gets one covering the whole index buffer, or every vertex when unindexed
+void GameModel::set_lods(const ModelLod *levels, uint32_t count){
+	if (count == 0 || !is_indexed()) {
+		lods.assign(1, {0, is_indexed() ? index_count : vertex_count, 0.f});
+		return;
+	}
+	lods.assign(levels, levels + std::min(count, MAX_LODS));
+	MAGE_DEBUG(model) << " - " << count << " level(s) of detail, coarsest has " << lods.back().index_count << " indices";
+}
+
+// Keeps the first occurrence of every vertex and points each soup entry at it, preserving triangle order
+void GameModel::deduplicate_vertices(const std::vector<Vertex> &triangle_soup, std::vector<Vertex> &vertices, std::vector<uint32_t> &indices){
+	MAGE_PROFILE_ZONE("GameModel::deduplicate_vertices");
+	std::unordered_map<Vertex, uint32_t, VertexHash> unique_vertices;
+	unique_vertices.reserve(triangle_soup.size());
+	vertices.clear();
+	indices.clear();
+	indices.reserve(triangle_soup.size());
+	for (const auto &vertex : triangle_soup) {
+		auto found = unique_vertices.emplace(vertex, static_cast<uint32_t>(vertices.size()));
+		if (found.second) {
+			vertices.push_back(vertex);
+		}
+		indices.push_back(found.first->second);
+	}
+}
+
+// Computed once at upload, culling only ever transforms the sphere
+ModelBounds GameModel::compute_bounds(const std::vector<Vertex> &vertices){
+	ModelBounds result{};
+	if (vertices.empty()) {
+		return result;
+	}
+	result.aabb_min = vertices[0].position;
+	result.aabb_max = vertices[0].position;
+	for (const auto &vertex : vertices) {
+		result.aabb_min = glm::min(result.aabb_min, vertex.position);
+		result.aabb_max = glm::max(result.aabb_max, vertex.position);
+	}
+	result.center = (result.aabb_min + result.aabb_max) * 0.5f;
+	float radius_squared = 0.f;
+	for (const auto &vertex : vertices) {
+		glm::vec3 offset = vertex.position - result.center;
+		radius_squared = std::max(radius_squared, glm::dot(offset, offset));
+	}
+	result.radius = std::sqrt(radius_squared);
+	return result;
+}
+
+// Index size is not known until the vertex count is, so this assumes 32-bit indices
+VkDeviceSize GameModel::upload_size(const std::vector<Vertex> &vertices, const std::vector<uint32_t> &indices){
+	return sizeof(Vertex) * static_cast<VkDeviceSize>(vertices.size()) + sizeof(uint32_t) * static_cast<VkDeviceSize>(indices.size());
+}
+
+VkDeviceSize GameModel::upload_size(const MeshView &mesh){
+	VkDeviceSize index_size = mesh.index_type == VK_INDEX_TYPE_UINT16 ? sizeof(uint16_t) : sizeof(uint32_t);
+	return sizeof(Vertex) * static_cast<VkDeviceSize>(mesh.vertex_count) + index_size * static_cast<VkDeviceSize>(mesh.index_count);
+}
 
 void GameModel::create_vertex_buffers(const std::vector<Vertex> &vertices){
+	create_vertex_buffers(vertices, [this](VkBuffer destination, const void *data, VkDeviceSize size) {
+		device.upload_buffer(destination, data, size);
+	});
+}
+
+void GameModel::create_vertex_buffers(const std::vector<Vertex> &vertices, const BufferWriter &writer){
+	MAGE_PROFILE_ZONE("GameModel::create_vertex_buffers");
 	vertex_count = static_cast<uint32_t>(vertices.size());
-	VkDeviceSize buffer_size = sizeof(vertices[0]) * vertex_count;
+	bounds = compute_bounds(vertices);
+	write_vertex_buffer(vertices.data(), writer);
+}
+
+void GameModel::write_vertex_buffer(const void *vertices, const BufferWriter &writer){
+	VkDeviceSize buffer_size = sizeof(Vertex) * static_cast<VkDeviceSize>(vertex_count);
+	// Vertices live in device-local memory and arrive through the device's staging buffer,
+	// wrap many model creations in begin/end_upload_batch to upload them in one submission
+	// Transfer source as well, GpuScene copies every model into its shared geometry buffers
 	device.create_buffer(
 	  buffer_size,
-	  VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-	  VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+	  VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+	  VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
 	  vertex_buffer,
-	  vertex_buffer_memory);
-  	void *data;
-  	vkMapMemory(device.get_device(), vertex_buffer_memory, 0, buffer_size, 0, &data);
-  	memcpy(data, vertices.data(), static_cast<size_t>(buffer_size));
-  	vkUnmapMemory(device.get_device(), vertex_buffer_memory);
+	  vertex_buffer_allocation);
+	writer(vertex_buffer, vertices, buffer_size);
+}
+
+void GameModel::create_index_buffers(const std::vector<uint32_t> &indices){
+	create_index_buffers(indices, [this](VkBuffer destination, const void *data, VkDeviceSize size) {
+		device.upload_buffer(destination, data, size);
+	});
+}
+
+// 16-bit indices whenever every vertex fits, halving index memory and bandwidth for most meshes
+void GameModel::create_index_buffers(const std::vector<uint32_t> &indices, const BufferWriter &writer){
+	MAGE_PROFILE_ZONE("GameModel::create_index_buffers");
+	index_count = static_cast<uint32_t>(indices.size());
+	if (index_count == 0) {
+		return;
+	}
+
+	// 0xFFFF stays free in case primitive restart is ever turned on
+	std::vector<uint16_t> short_indices;
+	const void *index_data = indices.data();
+	index_type = VK_INDEX_TYPE_UINT32;
+	if (vertex_count < std::numeric_limits<uint16_t>::max()) {
+		short_indices.assign(indices.begin(), indices.end());
+		index_data = short_indices.data();
+		index_type = VK_INDEX_TYPE_UINT16;
+	}
+	write_index_buffer(index_data, writer);
+}
+
+void GameModel::write_index_buffer(const void *indices, const BufferWriter &writer){
+	if (index_count == 0) {
+		return;
+	}
+	VkDeviceSize index_size = index_type == VK_INDEX_TYPE_UINT16 ? sizeof(uint16_t) : sizeof(uint32_t);
+	VkDeviceSize buffer_size = index_size * static_cast<VkDeviceSize>(index_count);
+	device.create_buffer(
+	  buffer_size,
+	  VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+	  VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+	  index_buffer,
+	  index_buffer_allocation);
+	writer(index_buffer, indices, buffer_size);
 }
 
 void GameModel::bind(VkCommandBuffer command_buffer){
 	VkBuffer buffers[] = {vertex_buffer};
 	VkDeviceSize offsets[] = {0};
 	vkCmdBindVertexBuffers(command_buffer, 0, 1, buffers, offsets);
+	if (is_indexed()) {
+		vkCmdBindIndexBuffer(command_buffer, index_buffer, 0, index_type);
+	}
+}
+
+void GameModel::draw(VkCommandBuffer command_buffer, uint32_t lod){
+	if (is_indexed()) {
+		const ModelLod &level = get_lod(lod);
+		vkCmdDrawIndexed(command_buffer, level.index_count, 1, level.first_index, 0, 0);
+	} else {
+		vkCmdDraw(command_buffer, vertex_count, 1, 0, 0);
+	}
 }
 
-void GameModel::draw(VkCommandBuffer command_buffer){
-	vkCmdDraw(command_buffer, vertex_count, 1, 0, 0);
+// Instance data has to be bound at binding 1 before this is called
+void GameModel::draw_instanced(VkCommandBuffer command_buffer, uint32_t instance_count, uint32_t first_instance, uint32_t lod){
+	if (is_indexed()) {
+		const ModelLod &level = get_lod(lod);
+		vkCmdDrawIndexed(command_buffer, level.index_count, instance_count, level.first_index, 0, first_instance);
+	} else {
+		vkCmdDraw(command_buffer, vertex_count, instance_count, 0, first_instance);
+	}
 }
 
 GameModel::~GameModel(){
-	vkDestroyBuffer(device.get_device(), vertex_buffer, nullptr);
-	vkFreeMemory(device.get_device(), vertex_buffer_memory, nullptr);
+	if (index_buffer != VK_NULL_HANDLE) {
+		device.destroy_buffer(index_buffer, index_buffer_allocation);
+	}
+	device.destroy_buffer(vertex_buffer, vertex_buffer_allocation);
 }
\ No newline at end of file
@@ -2,6 +2,8 @@
 
 #include "../pipeline-resources/device.hpp"
 #include "../pipeline-resources/swapchain.hpp"
+#include <algorithm>
+#include <functional>
 #include <vector>
 #include <glm/glm.hpp>
 
@@ -10,16 +12,44 @@
 
 namespace mage{
 
+	// Model-space bounds, the sphere is centered on the box but sized to the farthest vertex
+	struct ModelBounds {
+		glm::vec3 aabb_min{};
+		glm::vec3 aabb_max{};
+		glm::vec3 center{};
+		float radius = 0.f;
+	};
+
+	// Levels a model can carry, the full mesh included
+	constexpr uint32_t MAX_LODS = 8;
+
+	// One level of detail: a range of the model's index buffer, drawn against the vertex buffer every level shares.
+	// error is how far, in model units, the level's surface strays from the full mesh, zero for the full mesh itself.
+	struct ModelLod {
+		uint32_t first_index = 0;
+		uint32_t index_count = 0;
+		float error = 0.f;
+	};
+
 	class GameModel{
 		private:
 			DeviceHandling &device;
 			VkBuffer vertex_buffer;
-			VkDeviceMemory vertex_buffer_memory;
+			MemoryAllocation vertex_buffer_allocation;
 			uint32_t vertex_count;
+			VkBuffer index_buffer = VK_NULL_HANDLE;
+			MemoryAllocation index_buffer_allocation;
+			uint32_t index_count = 0;
+			VkIndexType index_type = VK_INDEX_TYPE_UINT32;
+			ModelBounds bounds{};
+			uint32_t sort_id = allocate_sort_id();
+			std::vector<ModelLod> lods;
+			static uint32_t allocate_sort_id();
 		public:
 			struct Vertex {
 				glm::vec3 position{};
 				glm::vec3 color{};
+				bool operator==(const Vertex &other) const {return position == other.position && color == other.color;}
 				static std::vector<VkVertexInputBindingDescription> get_binding_descriptions(){
 					std::vector<VkVertexInputBindingDescription> binding_descriptions(1);
 					binding_descriptions[0].binding = 0;
@@ -34,19 +64,101 @@ namespace mage{
 					attribute_descriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;
 					attribute_descriptions[0].offset = offsetof(Vertex, position);
 
-					attribute_descriptions[0].binding = 0;
-					attribute_descriptions[0].location = 1;
-					attribute_descriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;
-					attribute_descriptions[0].offset = offsetof(Vertex, color);
+					attribute_descriptions[1].binding = 0;
+					attribute_descriptions[1].location = 1;
+					attribute_descriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
+					attribute_descriptions[1].offset = offsetof(Vertex, color);
 					return attribute_descriptions;
 				}
 			};
 
+			// Per-instance data for instanced draws, fed through binding 1 right after the Vertex attributes
+			struct Instance {
+				glm::mat4 transform{1.f};
+				glm::vec3 color{};
+				static std::vector<VkVertexInputBindingDescription> get_binding_descriptions(){
+					std::vector<VkVertexInputBindingDescription> binding_descriptions(1);
+					binding_descriptions[0].binding = 1;
+					binding_descriptions[0].stride = sizeof(Instance);
+					binding_descriptions[0].inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+					return binding_descriptions;
+				}
+				// A mat4 attribute takes one location per column
+				static std::vector<VkVertexInputAttributeDescription> get_attribute_descriptions(){
+					std::vector<VkVertexInputAttributeDescription> attribute_descriptions(5);
+					for (uint32_t column = 0; column < 4; column++) {
+						attribute_descriptions[column].binding = 1;
+						attribute_descriptions[column].location = 2 + column;
+						attribute_descriptions[column].format = VK_FORMAT_R32G32B32A32_SFLOAT;
+						attribute_descriptions[column].offset = offsetof(Instance, transform) + column * sizeof(glm::vec4);
+					}
+					attribute_descriptions[4].binding = 1;
+					attribute_descriptions[4].location = 6;
+					attribute_descriptions[4].format = VK_FORMAT_R32G32B32_SFLOAT;
+					attribute_descriptions[4].offset = offsetof(Instance, color);
+					return attribute_descriptions;
+				}
+			};
+
+			// Tag for the constructor that turns raw triangle soup into unique vertices plus indices
+			struct Deduplicate {};
+			static constexpr Deduplicate deduplicate{};
+			// Fills a freshly created buffer, data only has to stay valid for the duration of the call
+			using BufferWriter = std::function<void(VkBuffer destination, const void *data, VkDeviceSize size)>;
+			// Vertex and index data already laid out the way the buffers want it, such as a mapped cooked mesh,
+			// so nothing is converted or copied on the CPU before the writer sees it
+			struct MeshView {
+				const Vertex *vertices = nullptr;
+				uint32_t vertex_count = 0;
+				const void *indices = nullptr;
+				uint32_t index_count = 0;
+				VkIndexType index_type = VK_INDEX_TYPE_UINT32;
+				ModelBounds bounds{};
+				// Finest first, none means one level covering every index
+				const ModelLod *lods = nullptr;
+				uint32_t lod_count = 0;
+			};
+
 			GameModel(DeviceHandling &device_pass, const std::vector<Vertex> &vertices);
+			GameModel(DeviceHandling &device_pass, const std::vector<Vertex> &vertices, const std::vector<uint32_t> &indices);
+			GameModel(DeviceHandling &device_pass, const std::vector<Vertex> &triangle_soup, Deduplicate);
+			// Buffers are created here but their contents go through writer, which is how UploadService stages them
+			GameModel(DeviceHandling &device_pass, const std::vector<Vertex> &vertices, const std::vector<uint32_t> &indices, const BufferWriter &writer);
+			GameModel(DeviceHandling &device_pass, const MeshView &mesh);
+			GameModel(DeviceHandling &device_pass, const MeshView &mesh, const BufferWriter &writer);
 			~GameModel();
+			GameModel(const GameModel&) = delete;
+			GameModel &operator=(const GameModel&) = delete;
 			void bind(VkCommandBuffer command_buffer);
-			void draw(VkCommandBuffer command_buffer);
+			// Levels past the coarsest one draw the coarsest
+			void draw(VkCommandBuffer command_buffer, uint32_t lod = 0);
+			void draw_instanced(VkCommandBuffer command_buffer, uint32_t instance_count, uint32_t first_instance, uint32_t lod = 0);
 			void create_vertex_buffers(const std::vector<Vertex> &vertices);
+			void create_vertex_buffers(const std::vector<Vertex> &vertices, const BufferWriter &writer);
+			void create_index_buffers(const std::vector<uint32_t> &indices);
+			void create_index_buffers(const std::vector<uint32_t> &indices, const BufferWriter &writer);
+			// Upper bound on the bytes the two create calls hand to a writer
+			static VkDeviceSize upload_size(const std::vector<Vertex> &vertices, const std::vector<uint32_t> &indices);
+			static VkDeviceSize upload_size(const MeshView &mesh);
+			static ModelBounds compute_bounds(const std::vector<Vertex> &vertices);
+			static void deduplicate_vertices(const std::vector<Vertex> &triangle_soup, std::vector<Vertex> &vertices, std::vector<uint32_t> &indices);
+
+			VkBuffer get_vertex_buffer() const {return vertex_buffer;}
+			VkBuffer get_index_buffer() const {return index_buffer;}
+			uint32_t get_vertex_count() const {return vertex_count;}
+			uint32_t get_index_count() const {return index_count;}
+			VkIndexType get_index_type() const {return index_type;}
+			bool is_indexed() const {return index_count > 0;}
+			const ModelBounds &get_bounds() const {return bounds;}
+			// Small id for render queue sort keys, handed out in creation order
+			uint32_t get_sort_id() const {return sort_id;}
+			// At least one level, unindexed models have exactly one covering every vertex
+			uint32_t get_lod_count() const {return static_cast<uint32_t>(lods.size());}
+			const ModelLod &get_lod(uint32_t lod) const {return lods[std::min(lod, get_lod_count() - 1)];}
+		private:
+			void set_lods(const ModelLod *levels, uint32_t count);
+			void write_vertex_buffer(const void *vertices, const BufferWriter &writer);
+			void write_index_buffer(const void *indices, const BufferWriter &writer);
 	};
 
 }
\ No newline at end of file
@@ -1,7 +1,9 @@
 #pragma once
 
 #include "model.hpp"
+#include "registry.hpp"
 #include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/constants.hpp>
 #include <memory>
 
 namespace mage {
@@ -40,19 +42,39 @@ namespace mage {
 		    },
 		    {translation.x, translation.y, translation.z, 1.0f}};
 		}
+
+		// Blend between two simulation states, rotations take the short way around the 2pi wrap
+		static tranform_components interpolate(const tranform_components &previous, const tranform_components &current, float alpha) {
+			tranform_components result{};
+			result.translation = glm::mix(previous.translation, current.translation, alpha);
+			result.scale = glm::mix(previous.scale, current.scale, alpha);
+			glm::vec3 rotation_delta = current.rotation - previous.rotation;
+			rotation_delta -= glm::two_pi<float>() * glm::round(rotation_delta / glm::two_pi<float>());
+			result.rotation = previous.rotation + rotation_delta * alpha;
+			return result;
+		}
+	};
+
+	// Components of a scene entity, see Registry. The simulation writes current, previous is where it was one step ago.
+	struct Transform {
+		tranform_components current{};
+		tranform_components previous{};
 	};
 
-	class GameObject{
-		private:
-			unsigned int object_id;
-		public:
-			GameObject(unsigned int id);
-			~GameObject();
-			static GameObject create_game_object();
-			unsigned int get_object_id() {return object_id;}
-			tranform_components transform{};
-			glm::vec3 color{};
-			std::shared_ptr<GameModel> model{};
+	// The registry does not own models, whoever creates the entities keeps them alive
+	struct Renderable {
+		GameModel *model = nullptr;
+		glm::vec3 color{};
+		// Level of detail drawn last frame, LodSelector starts from it so levels only change past the hysteresis band
+		uint8_t lod = 0;
 	};
 
+	// Constant rotation in radians per second
+	struct Spin {
+		glm::vec3 speed{};
+	};
+
+	// Everything TransportPass draws, TransformSystem and CullingStage index their output by position in this view
+	using DrawableView = View<Transform, Renderable>;
+
 }
\ No newline at end of file
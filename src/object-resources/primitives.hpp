@@ -0,0 +1,13 @@
+#pragma once
+
+#include "model.hpp"
+#include <memory>
+
+namespace mage {
+
+	// Unit cube with a different color per face, every vertex shifted by offset
+	std::unique_ptr<GameModel> create_cube_model(DeviceHandling &device, glm::vec3 offset);
+	// The CPU half of create_cube_model, touches no device state so it can run on any job thread
+	void decode_cube_mesh(glm::vec3 offset, std::vector<GameModel::Vertex> &vertices, std::vector<uint32_t> &indices);
+
+}
@@ -0,0 +1,336 @@
+#include "registry.hpp"
+#include "../debug-resources/log.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <mutex>
+
+using namespace mage;
+
+namespace {
+
+	// Reserved up front so references handed out by get_component_info stay valid while other types register
+	std::vector<ComponentInfo> &component_infos() {
+		static std::vector<ComponentInfo> infos = [] {
+			std::vector<ComponentInfo> reserved;
+			reserved.reserve(MAX_COMPONENTS);
+			return reserved;
+		}();
+		return infos;
+	}
+
+	uint32_t align_up(uint32_t value, uint32_t alignment) {
+		return (value + alignment - 1) / alignment * alignment;
+	}
+
+}
+
+uint32_t detail::register_component(uint32_t size, uint32_t alignment) {
+	static std::mutex mutex;
+	std::lock_guard<std::mutex> lock{mutex};
+	auto &infos = component_infos();
+	if (infos.size() >= MAX_COMPONENTS) {
+		MAGE_ERROR(game) << "More than " << MAX_COMPONENTS << " component types registered";
+		exit(EXIT_FAILURE);
+	}
+	infos.push_back({size, alignment});
+	return static_cast<uint32_t>(infos.size() - 1);
+}
+
+const ComponentInfo &mage::get_component_info(uint32_t component) {
+	return component_infos()[component];
+}
+
+// The empty archetype always exists, it is where bare entities live
+Registry::Registry() {
+	find_archetype(0);
+}
+
+// Lays out a new archetype so as many rows as possible fit a chunk, each column starting on a 16 byte boundary
+uint32_t Registry::find_archetype(ComponentMask mask) {
+	auto found = archetype_lookup.find(mask);
+	if (found != archetype_lookup.end()) {
+		return found->second;
+	}
+
+	Archetype archetype{};
+	archetype.mask = mask;
+	std::fill(std::begin(archetype.columns), std::end(archetype.columns), int8_t{-1});
+	uint32_t row_size = sizeof(Entity);
+	for (uint32_t component = 0; component < MAX_COMPONENTS; component++) {
+		if ((mask >> component) & 1) {
+			archetype.columns[component] = static_cast<int8_t>(archetype.components.size());
+			archetype.components.push_back(component);
+			archetype.sizes.push_back(get_component_info(component).size);
+			row_size += get_component_info(component).size;
+		}
+	}
+
+	auto layout = [&](uint32_t capacity) {
+		archetype.offsets.clear();
+		uint32_t offset = capacity * static_cast<uint32_t>(sizeof(Entity));
+		for (uint32_t component : archetype.components) {
+			const ComponentInfo &info = get_component_info(component);
+			offset = align_up(offset, std::max(COLUMN_ALIGNMENT, info.alignment));
+			archetype.offsets.push_back(offset);
+			offset += capacity * info.size;
+		}
+		return offset <= Chunk::SIZE;
+	};
+	uint32_t capacity = Chunk::SIZE / row_size;
+	while (capacity > 0 && !layout(capacity)) {
+		capacity--;
+	}
+	if (capacity == 0) {
+		MAGE_ERROR(game) << "Components of " << row_size << " byte(s) per entity do not fit a " << Chunk::SIZE << " byte chunk";
+		exit(EXIT_FAILURE);
+	}
+	archetype.chunk_capacity = capacity;
+	MAGE_DEBUG(game) << " - new archetype with " << archetype.components.size() << " component(s), " << capacity << " row(s) per chunk";
+
+	archetypes.push_back(std::move(archetype));
+	uint32_t index = static_cast<uint32_t>(archetypes.size() - 1);
+	archetype_lookup.emplace(mask, index);
+	return index;
+}
+
+unsigned char *Registry::component_address(const Archetype &archetype, uint32_t row, uint32_t component) const {
+	uint32_t column = static_cast<uint32_t>(archetype.columns[component]);
+	return archetype.chunks[row / archetype.chunk_capacity]->data + archetype.offsets[column] + (row % archetype.chunk_capacity) * archetype.sizes[column];
+}
+
+// Chunks are not zeroed, every column of a new row is written before it is read
+uint32_t Registry::push_row(uint32_t archetype_index, Entity entity) {
+	Archetype &archetype = archetypes[archetype_index];
+	uint32_t row = archetype.count;
+	if (row == archetype.chunks.size() * archetype.chunk_capacity) {
+		archetype.chunks.push_back(std::unique_ptr<Chunk>(new Chunk));
+	}
+	archetype.entities(row / archetype.chunk_capacity)[row % archetype.chunk_capacity] = entity;
+	archetype.count++;
+	return row;
+}
+
+// Swap-remove, the last row fills the hole so every chunk stays dense. A trailing chunk that empties is freed.
+void Registry::remove_row(uint32_t archetype_index, uint32_t row) {
+	Archetype &archetype = archetypes[archetype_index];
+	uint32_t last = archetype.count - 1;
+	if (row != last) {
+		Entity moved = archetype.entities(last / archetype.chunk_capacity)[last % archetype.chunk_capacity];
+		archetype.entities(row / archetype.chunk_capacity)[row % archetype.chunk_capacity] = moved;
+		for (size_t column = 0; column < archetype.components.size(); column++) {
+			uint32_t component = archetype.components[column];
+			std::memcpy(component_address(archetype, row, component), component_address(archetype, last, component), archetype.sizes[column]);
+		}
+		slots[moved.index()].row = row;
+	}
+	archetype.count--;
+	size_t needed = (archetype.count + archetype.chunk_capacity - 1) / archetype.chunk_capacity;
+	while (archetype.chunks.size() > needed) {
+		archetype.chunks.pop_back();
+	}
+}
+
+// Copies the components both archetypes share, new components are left for the caller to write
+void Registry::move_entity(Entity entity, ComponentMask mask) {
+	Slot &slot = slots[entity.index()];
+	uint32_t source = slot.archetype;
+	uint32_t source_row = slot.row;
+	uint32_t destination = find_archetype(mask);
+	uint32_t row = push_row(destination, entity);
+
+	const Archetype &from = archetypes[source];
+	const Archetype &to = archetypes[destination];
+	for (size_t column = 0; column < to.components.size(); column++) {
+		uint32_t component = to.components[column];
+		if (from.columns[component] >= 0) {
+			std::memcpy(component_address(to, row, component), component_address(from, source_row, component), to.sizes[column]);
+		}
+	}
+	remove_row(source, source_row);
+	slots[entity.index()].archetype = destination;
+	slots[entity.index()].row = row;
+}
+
+void Registry::destroy(Entity entity) {
+	if (!alive(entity)) {
+		return;
+	}
+	Slot &slot = slots[entity.index()];
+	remove_row(slot.archetype, slot.row);
+	slot.archetype = NO_ARCHETYPE;
+	slot.generation = (slot.generation + 1) & Entity::GENERATION_MASK;
+	free_slots.push_back(entity.index());
+	entity_count--;
+}
+
+bool Registry::alive(Entity entity) const {
+	uint32_t index = entity.index();
+	return index < slots.size() && slots[index].generation == entity.generation() && slots[index].archetype != NO_ARCHETYPE;
+}
+
+// Archetypes and their layouts survive, only the rows go. Every slot moves to the next generation so no old handle matches.
+void Registry::clear() {
+	for (auto &archetype : archetypes) {
+		archetype.chunks.clear();
+		archetype.count = 0;
+	}
+	free_slots.clear();
+	for (uint32_t index = 0; index < slots.size(); index++) {
+		slots[index].generation = (slots[index].generation + 1) & Entity::GENERATION_MASK;
+		slots[index].archetype = NO_ARCHETYPE;
+		free_slots.push_back(index);
+	}
+	entity_count = 0;
+}
+
+Entity Registry::reserve() {
+	uint32_t index;
+	if (!free_slots.empty()) {
+		index = free_slots.back();
+		free_slots.pop_back();
+	} else {
+		if (slots.size() >= Entity::INDEX_MASK) {
+			MAGE_ERROR(game) << "Out of entity handles, at most " << Entity::INDEX_MASK << " can be alive";
+			exit(EXIT_FAILURE);
+		}
+		index = static_cast<uint32_t>(slots.size());
+		slots.emplace_back();
+	}
+	return Entity::make(index, slots[index].generation);
+}
+
+void Registry::release(Entity entity) {
+	uint32_t index = entity.index();
+	if (index >= slots.size() || slots[index].generation != entity.generation() || slots[index].archetype != NO_ARCHETYPE) {
+		return;
+	}
+	slots[index].generation = (slots[index].generation + 1) & Entity::GENERATION_MASK;
+	free_slots.push_back(index);
+}
+
+bool Registry::place(Entity entity, ComponentMask mask) {
+	uint32_t index = entity.index();
+	if (index >= slots.size() || slots[index].generation != entity.generation() || slots[index].archetype != NO_ARCHETYPE) {
+		return false;
+	}
+	uint32_t archetype = find_archetype(mask);
+	uint32_t row = push_row(archetype, entity);
+	slots[index].archetype = archetype;
+	slots[index].row = row;
+	entity_count++;
+	return true;
+}
+
+void *Registry::add_component(Entity entity, uint32_t component, const void *data) {
+	if (!alive(entity)) {
+		return nullptr;
+	}
+	if (archetypes[slots[entity.index()].archetype].columns[component] < 0) {
+		move_entity(entity, archetypes[slots[entity.index()].archetype].mask | (ComponentMask{1} << component));
+	}
+	const Slot &slot = slots[entity.index()];
+	unsigned char *address = component_address(archetypes[slot.archetype], slot.row, component);
+	std::memcpy(address, data, get_component_info(component).size);
+	return address;
+}
+
+void Registry::remove_component(Entity entity, uint32_t component) {
+	if (!alive(entity)) {
+		return;
+	}
+	const Archetype &archetype = archetypes[slots[entity.index()].archetype];
+	if (archetype.columns[component] >= 0) {
+		move_entity(entity, archetype.mask & ~(ComponentMask{1} << component));
+	}
+}
+
+void *Registry::get_component(Entity entity, uint32_t component) const {
+	if (!alive(entity)) {
+		return nullptr;
+	}
+	const Slot &slot = slots[entity.index()];
+	const Archetype &archetype = archetypes[slot.archetype];
+	if (archetype.columns[component] < 0) {
+		return nullptr;
+	}
+	return component_address(archetype, slot.row, component);
+}
+
+uint32_t Registry::get_chunk_count() const {
+	uint32_t total = 0;
+	for (const auto &archetype : archetypes) {
+		total += static_cast<uint32_t>(archetype.chunks.size());
+	}
+	return total;
+}
+
+void Registry::log_statistics() const {
+	MAGE_INFO(game) << "Registry: " << entity_count << " entit(ies) in " << archetypes.size() << " archetype(s), "
+	                << get_chunk_count() << " chunk(s) of " << Chunk::SIZE << " byte(s)";
+	for (const auto &archetype : archetypes) {
+		if (archetype.count == 0) {
+			continue;
+		}
+		MAGE_INFO(game) << " - " << archetype.components.size() << " component(s): " << archetype.count << " row(s) over "
+		                << archetype.chunks.size() << " chunk(s), " << archetype.chunk_capacity << " per chunk";
+	}
+}
+
+uint32_t EntityCommands::push_payload(const void *data, uint32_t size) {
+	uint32_t offset = static_cast<uint32_t>(payload.size());
+	payload.resize(offset + size);
+	std::memcpy(payload.data() + offset, data, size);
+	return offset;
+}
+
+// A create and the adds recorded right behind it for the same entity are placed in their final archetype in one step
+void EntityCommands::apply() {
+	for (size_t i = 0; i < commands.size(); i++) {
+		const Command &command = commands[i];
+		switch (command.operation) {
+			case Operation::create: {
+				size_t end = i + 1;
+				ComponentMask mask = 0;
+				while (end < commands.size() && commands[end].operation == Operation::add && commands[end].entity == command.entity) {
+					mask |= ComponentMask{1} << commands[end].component;
+					end++;
+				}
+				if (registry.place(command.entity, mask)) {
+					for (size_t add = i + 1; add < end; add++) {
+						uint32_t component = commands[add].component;
+						std::memcpy(registry.get_component(command.entity, component), payload.data() + commands[add].payload_offset, get_component_info(component).size);
+					}
+				}
+				i = end - 1;
+				break;
+			}
+			case Operation::destroy:
+				registry.destroy(command.entity);
+				break;
+			case Operation::add:
+				registry.add_component(command.entity, command.component, payload.data() + command.payload_offset);
+				break;
+			case Operation::remove:
+				registry.remove_component(command.entity, command.component);
+				break;
+		}
+	}
+	commands.clear();
+	payload.clear();
+}
+
+// Handles reserved by creates that never got applied go back to the registry
+void EntityCommands::clear() {
+	for (const auto &command : commands) {
+		if (command.operation == Operation::create) {
+			registry.release(command.entity);
+		}
+	}
+	commands.clear();
+	payload.clear();
+}
+
+EntityCommands::~EntityCommands() {
+	clear();
+}
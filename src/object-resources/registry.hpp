@@ -0,0 +1,243 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+namespace mage {
+
+	// Generational handle, the low bits index a slot and the high bits tell a recycled slot apart from the entity that used it before
+	struct Entity {
+		static constexpr uint32_t INDEX_BITS = 22;
+		static constexpr uint32_t INDEX_MASK = (1u << INDEX_BITS) - 1;
+		static constexpr uint32_t GENERATION_MASK = (1u << (32 - INDEX_BITS)) - 1;
+		static constexpr uint32_t NULL_ID = ~0u;
+		uint32_t id = NULL_ID;
+
+		static Entity make(uint32_t index, uint32_t generation) {return Entity{(generation << INDEX_BITS) | index};}
+		uint32_t index() const {return id & INDEX_MASK;}
+		uint32_t generation() const {return id >> INDEX_BITS;}
+		bool is_null() const {return id == NULL_ID;}
+		bool operator==(const Entity &other) const {return id == other.id;}
+		bool operator!=(const Entity &other) const {return id != other.id;}
+	};
+
+	using ComponentMask = uint64_t;
+	static constexpr uint32_t MAX_COMPONENTS = 64;
+
+	struct ComponentInfo {
+		uint32_t size;
+		uint32_t alignment;
+	};
+
+	namespace detail {
+		uint32_t register_component(uint32_t size, uint32_t alignment);
+	}
+	const ComponentInfo &get_component_info(uint32_t component);
+
+	// Components are moved between chunks with memcpy, so they have to be plain data
+	template<typename T>
+	uint32_t component_id() {
+		static_assert(std::is_trivially_copyable<T>::value, "components must be trivially copyable");
+		static const uint32_t id = detail::register_component(sizeof(T), alignof(T));
+		return id;
+	}
+
+	template<typename... T>
+	ComponentMask component_mask() {
+		return (ComponentMask{0} | ... | (ComponentMask{1} << component_id<T>()));
+	}
+
+	// Fixed-size block holding rows of one archetype. The entity handles come first, then one tightly packed array per component.
+	struct alignas(64) Chunk {
+		static constexpr uint32_t SIZE = 16 * 1024;
+		unsigned char data[SIZE];
+	};
+
+	// Every entity with exactly the same set of components lives in the same archetype. Rows are dense, chunk by chunk,
+	// and a removal moves the last row into the hole.
+	struct Archetype {
+		ComponentMask mask = 0;
+		std::vector<uint32_t> components;
+		std::vector<uint32_t> offsets;
+		std::vector<uint32_t> sizes;
+		int8_t columns[MAX_COMPONENTS];
+		uint32_t chunk_capacity = 0;
+		uint32_t count = 0;
+		std::vector<std::unique_ptr<Chunk>> chunks;
+
+		uint32_t rows(uint32_t chunk) const {
+			return chunk + 1 < chunks.size() ? chunk_capacity : count - chunk * chunk_capacity;
+		}
+		Entity *entities(uint32_t chunk) const {return reinterpret_cast<Entity*>(chunks[chunk]->data);}
+		unsigned char *column(uint32_t chunk, uint32_t component) const {
+			return chunks[chunk]->data + offsets[columns[component]];
+		}
+		template<typename T>
+		T *column(uint32_t chunk) const {return reinterpret_cast<T*>(column(chunk, component_id<T>()));}
+	};
+
+	template<typename... T>
+	class View;
+
+	// Entity and component storage. Structural changes (create, destroy, add, remove) move rows between archetypes and
+	// invalidate component pointers, queue them on an EntityCommands while a view is being walked.
+	class Registry {
+	private:
+		static constexpr uint32_t NO_ARCHETYPE = ~0u;
+		static constexpr uint32_t COLUMN_ALIGNMENT = 16;
+		struct Slot {
+			uint32_t generation = 0;
+			uint32_t archetype = NO_ARCHETYPE;
+			uint32_t row = 0;
+		};
+		std::vector<Slot> slots;
+		std::vector<uint32_t> free_slots;
+		std::vector<Archetype> archetypes;
+		std::unordered_map<ComponentMask, uint32_t> archetype_lookup;
+		uint32_t entity_count = 0;
+		uint32_t find_archetype(ComponentMask mask);
+		uint32_t push_row(uint32_t archetype, Entity entity);
+		void remove_row(uint32_t archetype, uint32_t row);
+		void move_entity(Entity entity, ComponentMask mask);
+		unsigned char *component_address(const Archetype &archetype, uint32_t row, uint32_t component) const;
+		template<typename... T>
+		friend class View;
+	public:
+		Registry();
+		Registry(const Registry &) = delete;
+		Registry &operator=(const Registry &) = delete;
+
+		template<typename... T>
+		Entity create(const T &...values) {
+			Entity entity = reserve();
+			place(entity, component_mask<T...>());
+			(std::memcpy(get_component(entity, component_id<T>()), &values, sizeof(T)), ...);
+			return entity;
+		}
+		void destroy(Entity entity);
+		bool alive(Entity entity) const;
+		// Drops every entity and chunk, handles taken before are stale afterwards
+		void clear();
+
+		// Hands out a handle that is not alive until place puts it in an archetype, lets command buffers return entities up front
+		Entity reserve();
+		void release(Entity entity);
+		// Component values are left uninitialized for the caller to fill, returns false if the handle was not reserved
+		bool place(Entity entity, ComponentMask mask);
+
+		// Type-erased access used by the templates below and by EntityCommands
+		void *add_component(Entity entity, uint32_t component, const void *data);
+		void remove_component(Entity entity, uint32_t component);
+		void *get_component(Entity entity, uint32_t component) const;
+
+		// Adding a component the entity already has overwrites it, dead handles are ignored and return nullptr
+		template<typename T>
+		T *add(Entity entity, const T &value) {return static_cast<T*>(add_component(entity, component_id<T>(), &value));}
+		template<typename T>
+		void remove(Entity entity) {remove_component(entity, component_id<T>());}
+		template<typename T>
+		T *get(Entity entity) const {return static_cast<T*>(get_component(entity, component_id<T>()));}
+		template<typename T>
+		bool has(Entity entity) const {return get_component(entity, component_id<T>()) != nullptr;}
+
+		template<typename... T>
+		View<T...> view() {return View<T...>{*this};}
+
+		uint32_t get_entity_count() const {return entity_count;}
+		uint32_t get_archetype_count() const {return static_cast<uint32_t>(archetypes.size());}
+		uint32_t get_chunk_count() const;
+		void log_statistics() const;
+	};
+
+	// Every entity that has at least the components T, walked archetype by archetype and chunk by chunk. Order is stable
+	// as long as nothing structural happens in between, so two walks over the same view line up index for index.
+	template<typename... T>
+	class View {
+	private:
+		Registry *registry;
+		ComponentMask mask;
+	public:
+		explicit View(Registry &registry_pass) : registry{&registry_pass}, mask{component_mask<T...>()} {}
+
+		// function(const Entity *entities, uint32_t count, T *...columns) once per chunk
+		template<typename F>
+		void each_chunk(F &&function) const {
+			for (const auto &archetype : registry->archetypes) {
+				if ((archetype.mask & mask) != mask || archetype.count == 0) {
+					continue;
+				}
+				for (uint32_t chunk = 0; chunk < archetype.chunks.size(); chunk++) {
+					function(static_cast<const Entity*>(archetype.entities(chunk)), archetype.rows(chunk), archetype.template column<T>(chunk)...);
+				}
+			}
+		}
+
+		// function(Entity entity, T &...components) once per entity
+		template<typename F>
+		void each(F &&function) const {
+			each_chunk([&](const Entity *entities, uint32_t count, T *...columns) {
+				for (uint32_t row = 0; row < count; row++) {
+					function(entities[row], columns[row]...);
+				}
+			});
+		}
+
+		uint32_t size() const {
+			uint32_t total = 0;
+			for (const auto &archetype : registry->archetypes) {
+				if ((archetype.mask & mask) == mask) {
+					total += archetype.count;
+				}
+			}
+			return total;
+		}
+	};
+
+	// Deferred structural changes, recorded while views are being walked and applied in order afterwards. Entities
+	// created here get their handle straight away, they become alive on apply. Unapplied commands are discarded.
+	class EntityCommands {
+	private:
+		enum class Operation : uint8_t {create, destroy, add, remove};
+		struct Command {
+			Operation operation;
+			Entity entity;
+			uint32_t component;
+			uint32_t payload_offset;
+		};
+		Registry &registry;
+		std::vector<Command> commands;
+		std::vector<unsigned char> payload;
+		uint32_t push_payload(const void *data, uint32_t size);
+	public:
+		EntityCommands(Registry &registry_pass) : registry{registry_pass} {}
+		~EntityCommands();
+		EntityCommands(const EntityCommands &) = delete;
+		EntityCommands &operator=(const EntityCommands &) = delete;
+
+		template<typename... T>
+		Entity create(const T &...values) {
+			Entity entity = registry.reserve();
+			commands.push_back({Operation::create, entity, 0, 0});
+			(add(entity, values), ...);
+			return entity;
+		}
+		void destroy(Entity entity) {commands.push_back({Operation::destroy, entity, 0, 0});}
+		template<typename T>
+		void add(Entity entity, const T &value) {
+			commands.push_back({Operation::add, entity, component_id<T>(), push_payload(&value, sizeof(T))});
+		}
+		template<typename T>
+		void remove(Entity entity) {commands.push_back({Operation::remove, entity, component_id<T>(), 0});}
+
+		void apply();
+		void clear();
+		bool empty() const {return commands.empty();}
+		uint32_t size() const {return static_cast<uint32_t>(commands.size());}
+	};
+
+}
@@ -0,0 +1,66 @@
+#include "render-queue.hpp"
+#include "../debug-resources/cpu-profiler.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace mage;
+
+uint64_t RenderQueue::make_key(DrawPass pass, uint32_t pipeline, uint32_t material, uint32_t mesh, float depth) {
+	// The bit pattern of a non-negative float grows with its value, so its top bits quantize depth without knowing
+	// the near and far planes, finer up close where ordering matters most
+	uint32_t depth_bits = 0;
+	if (depth > 0.f) {
+		std::memcpy(&depth_bits, &depth, sizeof(depth_bits));
+	}
+	uint64_t depth_mask = (1ull << DEPTH_BITS) - 1;
+	uint64_t quantized = (depth_bits >> (31 - DEPTH_BITS)) & depth_mask;
+	if (pass == DrawPass::transparent) {
+		quantized = depth_mask - quantized;
+	}
+	return (static_cast<uint64_t>(pass) & ((1ull << PASS_BITS) - 1)) << PASS_SHIFT
+	     | (static_cast<uint64_t>(pipeline) & ((1ull << PIPELINE_BITS) - 1)) << PIPELINE_SHIFT
+	     | (static_cast<uint64_t>(material) & ((1ull << MATERIAL_BITS) - 1)) << MATERIAL_SHIFT
+	     | (static_cast<uint64_t>(mesh) & ((1ull << MESH_BITS) - 1)) << MESH_SHIFT
+	     | quantized << DEPTH_SHIFT;
+}
+
+uint32_t RenderQueue::material_id(const glm::vec3 &color) {
+	auto channel = [](float value) {
+		return static_cast<uint32_t>(std::min(std::max(value, 0.f), 1.f) * 15.f + .5f);
+	};
+	return channel(color.r) << 8 | channel(color.g) << 4 | channel(color.b);
+}
+
+// Least significant byte first, eight counting passes at most. One sweep builds every byte's histogram,
+// and a byte that is the same in every key (unused pipeline bits, the pass) skips its pass entirely.
+void RenderQueue::sort() {
+	MAGE_PROFILE_ZONE("RenderQueue::sort");
+	if (!enabled || packets.size() < 2) {
+		return;
+	}
+	uint32_t histograms[8][256] = {};
+	for (const DrawPacket &packet : packets) {
+		for (uint32_t byte = 0; byte < 8; byte++) {
+			histograms[byte][(packet.key >> (byte * 8)) & 0xFF]++;
+		}
+	}
+	scratch.resize(packets.size());
+	uint32_t count = static_cast<uint32_t>(packets.size());
+	for (uint32_t byte = 0; byte < 8; byte++) {
+		uint32_t *histogram = histograms[byte];
+		if (histogram[(packets[0].key >> (byte * 8)) & 0xFF] == count) {
+			continue;
+		}
+		uint32_t offset = 0;
+		for (uint32_t bucket = 0; bucket < 256; bucket++) {
+			uint32_t bucket_count = histogram[bucket];
+			histogram[bucket] = offset;
+			offset += bucket_count;
+		}
+		for (const DrawPacket &packet : packets) {
+			scratch[histogram[(packet.key >> (byte * 8)) & 0xFF]++] = packet;
+		}
+		packets.swap(scratch);
+	}
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "object.hpp"
+#include <cstdint>
+#include <vector>
+
+namespace mage {
+
+	// Opaque draws sort front to back, transparent ones back to front
+	enum class DrawPass : uint8_t {opaque = 0, transparent = 1};
+
+	// One draw as collected for the frame, index is the object's position in the transform system's output
+	struct DrawPacket {
+		uint64_t key;
+		uint32_t index;
+		const Renderable *renderable;
+	};
+
+	// State changes issued while submitting the last frame. Saved counts are against binding every piece of state for
+	// every draw. Push constants count the per-material color, the per-object matrix is pushed for every draw regardless.
+	struct RenderQueueStatistics {
+		uint32_t packets = 0;
+		uint32_t pipeline_binds = 0;
+		uint32_t pipeline_binds_saved = 0;
+		uint32_t vertex_binds = 0;
+		uint32_t vertex_binds_saved = 0;
+		uint32_t push_constants = 0;
+		uint32_t push_constants_saved = 0;
+		uint32_t get_binds_saved() const {return pipeline_binds_saved + vertex_binds_saved + push_constants_saved;}
+	};
+
+	// Draw packets collected into a buffer that keeps its capacity from frame to frame, then radix sorted by a 64-bit key.
+	// From the most significant bit down the key holds pass, pipeline, material, mesh and depth, so sorted packets come out
+	// grouped by the state they need and each group is ordered by depth.
+	class RenderQueue {
+	private:
+		static constexpr uint32_t PASS_BITS = 2;
+		static constexpr uint32_t PIPELINE_BITS = 10;
+		static constexpr uint32_t MATERIAL_BITS = 12;
+		static constexpr uint32_t MESH_BITS = 16;
+		static constexpr uint32_t DEPTH_BITS = 24;
+		static constexpr uint32_t DEPTH_SHIFT = 0;
+		static constexpr uint32_t MESH_SHIFT = DEPTH_SHIFT + DEPTH_BITS;
+		static constexpr uint32_t MATERIAL_SHIFT = MESH_SHIFT + MESH_BITS;
+		static constexpr uint32_t PIPELINE_SHIFT = MATERIAL_SHIFT + MATERIAL_BITS;
+		static constexpr uint32_t PASS_SHIFT = PIPELINE_SHIFT + PIPELINE_BITS;
+		static_assert(PASS_SHIFT + PASS_BITS == 64, "sort key fields must fill 64 bits");
+		bool enabled = true;
+		std::vector<DrawPacket> packets;
+		std::vector<DrawPacket> scratch;
+		RenderQueueStatistics statistics{};
+	public:
+		// Fields wider than their slot are truncated, which only costs grouping, never correctness.
+		// depth is view depth, negative depths (behind the camera) sort as zero.
+		static uint64_t make_key(DrawPass pass, uint32_t pipeline, uint32_t material, uint32_t mesh, float depth);
+		static uint32_t get_pipeline(uint64_t key) {return static_cast<uint32_t>(key >> PIPELINE_SHIFT) & ((1u << PIPELINE_BITS) - 1);}
+		// Colors quantized to four bits a channel, objects that look alike end up next to each other
+		static uint32_t material_id(const glm::vec3 &color);
+
+		void clear() {packets.clear();}
+		void push(uint64_t key, uint32_t index, const Renderable *renderable) {packets.push_back({key, index, renderable});}
+		// Stable, so equal keys keep the order they were pushed in. Does nothing when sorting is disabled.
+		void sort();
+
+		// Disabled queues keep submission order, to measure what sorting buys
+		void set_enabled(bool enable) {enabled = enable;}
+		bool is_enabled() const {return enabled;}
+		const std::vector<DrawPacket> &get_packets() const {return packets;}
+		uint32_t get_packet_count() const {return static_cast<uint32_t>(packets.size());}
+		void set_statistics(const RenderQueueStatistics &statistics_pass) {statistics = statistics_pass;}
+		const RenderQueueStatistics &get_statistics() const {return statistics;}
+	};
+
+}
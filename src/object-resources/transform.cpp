@@ -0,0 +1,309 @@
+#include "transform.hpp"
+#include "../debug-resources/log.hpp"
+#include "../debug-resources/cpu-profiler.hpp"
+#include "../job-resources/jobs.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define MAGE_TRANSFORM_AVX 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MAGE_TRANSFORM_SSE 1
+#endif
+
+using namespace mage;
+
+namespace {
+
+#if defined(MAGE_TRANSFORM_AVX)
+	// Thin wrappers so the kernel below is written once for both register widths
+	struct Lanes {
+		using V = __m256;
+		static constexpr uint32_t width = 8;
+		static V set1(float value) {return _mm256_set1_ps(value);}
+		static V load(const float *source) {return _mm256_loadu_ps(source);}
+		static V add(V a, V b) {return _mm256_add_ps(a, b);}
+		static V sub(V a, V b) {return _mm256_sub_ps(a, b);}
+		static V mul(V a, V b) {return _mm256_mul_ps(a, b);}
+		static V round(V a) {return _mm256_round_ps(a, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);}
+		static V equal(V a, V b) {return _mm256_cmp_ps(a, b, _CMP_EQ_OQ);}
+		static V greater(V a, V b) {return _mm256_cmp_ps(a, b, _CMP_GT_OQ);}
+		static V greater_equal(V a, V b) {return _mm256_cmp_ps(a, b, _CMP_GE_OQ);}
+		static V and_(V a, V b) {return _mm256_and_ps(a, b);}
+		static V or_(V a, V b) {return _mm256_or_ps(a, b);}
+		static V xor_(V a, V b) {return _mm256_xor_ps(a, b);}
+		static V select(V mask, V a, V b) {return _mm256_blendv_ps(b, a, mask);}
+		// Four registers holding rows 0-3 of one column for eight objects, transposed into each object's column
+		static void store_column(float *const *destinations, V row0, V row1, V row2, V row3) {
+			__m128 low[4] = {_mm256_castps256_ps128(row0), _mm256_castps256_ps128(row1), _mm256_castps256_ps128(row2), _mm256_castps256_ps128(row3)};
+			__m128 high[4] = {_mm256_extractf128_ps(row0, 1), _mm256_extractf128_ps(row1, 1), _mm256_extractf128_ps(row2, 1), _mm256_extractf128_ps(row3, 1)};
+			_MM_TRANSPOSE4_PS(low[0], low[1], low[2], low[3]);
+			_MM_TRANSPOSE4_PS(high[0], high[1], high[2], high[3]);
+			for (int lane = 0; lane < 4; lane++) {
+				_mm_storeu_ps(destinations[lane], low[lane]);
+				_mm_storeu_ps(destinations[lane + 4], high[lane]);
+			}
+		}
+	};
+#elif defined(MAGE_TRANSFORM_SSE)
+	struct Lanes {
+		using V = __m128;
+		static constexpr uint32_t width = 4;
+		static V set1(float value) {return _mm_set1_ps(value);}
+		static V load(const float *source) {return _mm_loadu_ps(source);}
+		static V add(V a, V b) {return _mm_add_ps(a, b);}
+		static V sub(V a, V b) {return _mm_sub_ps(a, b);}
+		static V mul(V a, V b) {return _mm_mul_ps(a, b);}
+		// SSE2 has no round instruction, converting through int uses the default round-to-nearest mode
+		static V round(V a) {return _mm_cvtepi32_ps(_mm_cvtps_epi32(a));}
+		static V equal(V a, V b) {return _mm_cmpeq_ps(a, b);}
+		static V greater(V a, V b) {return _mm_cmpgt_ps(a, b);}
+		static V greater_equal(V a, V b) {return _mm_cmpge_ps(a, b);}
+		static V and_(V a, V b) {return _mm_and_ps(a, b);}
+		static V or_(V a, V b) {return _mm_or_ps(a, b);}
+		static V xor_(V a, V b) {return _mm_xor_ps(a, b);}
+		static V select(V mask, V a, V b) {return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));}
+		static void store_column(float *const *destinations, V row0, V row1, V row2, V row3) {
+			_MM_TRANSPOSE4_PS(row0, row1, row2, row3);
+			_mm_storeu_ps(destinations[0], row0);
+			_mm_storeu_ps(destinations[1], row1);
+			_mm_storeu_ps(destinations[2], row2);
+			_mm_storeu_ps(destinations[3], row3);
+		}
+	};
+#endif
+
+#if defined(MAGE_TRANSFORM_AVX) || defined(MAGE_TRANSFORM_SSE)
+	using V = Lanes::V;
+
+	// Cephes-style sincos: reduce by pi/2 in three parts, evaluate both polynomials on [-pi/4, pi/4] and
+	// swap or negate by quadrant. Accurate to a couple of ulp for the angle range game objects use.
+	void sincos(V x, V &sine, V &cosine) {
+		const V sign = Lanes::set1(-0.f);
+		const V one = Lanes::set1(1.f);
+		V quadrant_count = Lanes::round(Lanes::mul(x, Lanes::set1(0.636619772367581343f)));
+		V r = Lanes::sub(x, Lanes::mul(quadrant_count, Lanes::set1(1.5703125f)));
+		r = Lanes::sub(r, Lanes::mul(quadrant_count, Lanes::set1(4.837512969970703125e-4f)));
+		r = Lanes::sub(r, Lanes::mul(quadrant_count, Lanes::set1(7.54978995489188216e-8f)));
+		V r2 = Lanes::mul(r, r);
+
+		V s = Lanes::set1(-1.9515295891e-4f);
+		s = Lanes::add(Lanes::mul(s, r2), Lanes::set1(8.3321608736e-3f));
+		s = Lanes::add(Lanes::mul(s, r2), Lanes::set1(-1.6666654611e-1f));
+		s = Lanes::add(Lanes::mul(Lanes::mul(s, r2), r), r);
+
+		V c = Lanes::set1(2.443315711809948e-5f);
+		c = Lanes::add(Lanes::mul(c, r2), Lanes::set1(-1.388731625493765e-3f));
+		c = Lanes::add(Lanes::mul(c, r2), Lanes::set1(4.166664568298827e-2f));
+		c = Lanes::add(Lanes::mul(Lanes::mul(c, r2), r2), Lanes::sub(one, Lanes::mul(r2, Lanes::set1(0.5f))));
+
+		// quadrant = count mod 4, floor built from round since SSE2 has no floor
+		V quarter = Lanes::mul(quadrant_count, Lanes::set1(0.25f));
+		V quarter_floor = Lanes::round(quarter);
+		quarter_floor = Lanes::sub(quarter_floor, Lanes::and_(Lanes::greater(quarter_floor, quarter), one));
+		V quadrant = Lanes::sub(quadrant_count, Lanes::mul(quarter_floor, Lanes::set1(4.f)));
+		V is_one = Lanes::equal(quadrant, one);
+		V is_two = Lanes::equal(quadrant, Lanes::set1(2.f));
+		V is_odd = Lanes::or_(is_one, Lanes::equal(quadrant, Lanes::set1(3.f)));
+
+		sine = Lanes::select(is_odd, c, s);
+		cosine = Lanes::select(is_odd, s, c);
+		sine = Lanes::xor_(sine, Lanes::and_(Lanes::greater_equal(quadrant, Lanes::set1(2.f)), sign));
+		cosine = Lanes::xor_(cosine, Lanes::and_(Lanes::or_(is_one, is_two), sign));
+	}
+#endif
+
+}
+
+void TransformSystem::update(const DrawableView &drawables, float alpha, const glm::mat4 &projection_view) {
+	MAGE_PROFILE_ZONE("TransformSystem::update");
+	sync(drawables, alpha);
+	bool camera_changed = std::memcmp(&projection_view, &last_projection_view, sizeof(glm::mat4)) != 0;
+	last_projection_view = projection_view;
+	build(&projection_view, camera_changed);
+	MAGE_TRACE(frame) << " - rebuilt " << rebuilt_count << " of " << object_count << " transform(s)";
+}
+
+void TransformSystem::update(const DrawableView &drawables, float alpha) {
+	MAGE_PROFILE_ZONE("TransformSystem::update");
+	sync(drawables, alpha);
+	// MVPs of objects that don't move fall behind here, so the next full update has to rebuild every one of them
+	last_projection_view = glm::mat4{0.f};
+	build(nullptr, false);
+	MAGE_TRACE(frame) << " - rebuilt " << rebuilt_count << " of " << object_count << " model matrices";
+}
+
+void TransformSystem::invalidate() {
+	std::fill(dirty.begin(), dirty.end(), uint8_t{1});
+}
+
+// Storage is padded to whole batches, padding lanes carry an identity transform and are never read back
+void TransformSystem::resize(uint32_t count) {
+	object_count = count;
+	uint32_t padded_count = (count + BATCH_WIDTH - 1) / BATCH_WIDTH * BATCH_WIDTH;
+	for (auto *values : {&translation_x, &translation_y, &translation_z, &rotation_x, &rotation_y, &rotation_z}) {
+		values->assign(padded_count, 0.f);
+	}
+	for (auto *values : {&scale_x, &scale_y, &scale_z}) {
+		values->assign(padded_count, 1.f);
+	}
+	dirty.assign(padded_count, uint8_t{1});
+	models.assign(padded_count, glm::mat4{1.f});
+	mvps.assign(padded_count, glm::mat4{1.f});
+}
+
+// Blends each object between its simulation states and marks it dirty only if the result differs from last frame.
+// Chunks are listed first so each one knows where its rows land, then blended in parallel.
+void TransformSystem::sync(const DrawableView &drawables, float alpha) {
+	uint32_t count = drawables.size();
+	if (count != object_count || dirty.empty()) {
+		resize(count);
+	}
+	chunks.clear();
+	uint32_t first = 0;
+	drawables.each_chunk([&](const Entity *, uint32_t rows, Transform *transforms, Renderable *) {
+		chunks.push_back({transforms, rows, first});
+		first += rows;
+	});
+	float *const columns[9] = {
+		translation_x.data(), translation_y.data(), translation_z.data(),
+		rotation_x.data(), rotation_y.data(), rotation_z.data(),
+		scale_x.data(), scale_y.data(), scale_z.data()};
+	JobSystem::get().parallel_for(0, static_cast<uint32_t>(chunks.size()), [&](uint32_t first_chunk, uint32_t last_chunk) {
+		for (uint32_t chunk = first_chunk; chunk < last_chunk; chunk++) {
+			const Transform *transforms = chunks[chunk].transforms;
+			for (uint32_t row = 0, i = chunks[chunk].first; row < chunks[chunk].rows; row++, i++) {
+				const auto &current = transforms[row].current;
+				const auto &previous = transforms[row].previous;
+				// Objects that did not move this step skip the blend entirely, it would return the current state anyway
+				bool settled = previous.translation == current.translation && previous.rotation == current.rotation && previous.scale == current.scale;
+				tranform_components blended = settled ? current : tranform_components::interpolate(previous, current, alpha);
+				const float values[9] = {
+					blended.translation.x, blended.translation.y, blended.translation.z,
+					blended.rotation.x, blended.rotation.y, blended.rotation.z,
+					blended.scale.x, blended.scale.y, blended.scale.z};
+				bool changed = false;
+				for (int component = 0; component < 9; component++) {
+					changed |= columns[component][i] != values[component];
+					columns[component][i] = values[component];
+				}
+				dirty[i] |= changed;
+			}
+		}
+	});
+}
+
+// Model matrix follows tranform_components::mat4 exactly, MVP is projection_view * model with the known zero row folded out.
+// Batches never share an object, so ranges of them are built on the job system and only the rebuilt total is shared.
+void TransformSystem::build(const glm::mat4 *projection_view, bool camera_changed) {
+	const bool build_mvps = projection_view != nullptr;
+	uint32_t padded_count = static_cast<uint32_t>(dirty.size());
+	std::atomic<uint32_t> rebuilt{0};
+
+#if defined(MAGE_TRANSFORM_AVX) || defined(MAGE_TRANSFORM_SSE)
+	const uint32_t width = Lanes::width;
+	V pv[4][4];
+	for (int column = 0; column < 4; column++) {
+		for (int row = 0; row < 4; row++) {
+			pv[column][row] = Lanes::set1(build_mvps ? (*projection_view)[column][row] : 0.f);
+		}
+	}
+	const V zero = Lanes::set1(0.f);
+	const V one = Lanes::set1(1.f);
+
+	JobSystem::get().parallel_for(0, padded_count / width, [&](uint32_t first_batch, uint32_t last_batch) {
+		uint32_t range_rebuilt = 0;
+		for (uint32_t first = first_batch * width; first < last_batch * width; first += width) {
+			bool batch_dirty = camera_changed;
+			for (uint32_t lane = 0; lane < width && !batch_dirty; lane++) {
+				batch_dirty = dirty[first + lane] != 0;
+			}
+			if (!batch_dirty) {
+				continue;
+			}
+
+			V s1, c1, s2, c2, s3, c3;
+			sincos(Lanes::load(&rotation_y[first]), s1, c1);
+			sincos(Lanes::load(&rotation_x[first]), s2, c2);
+			sincos(Lanes::load(&rotation_z[first]), s3, c3);
+			V sx = Lanes::load(&scale_x[first]);
+			V sy = Lanes::load(&scale_y[first]);
+			V sz = Lanes::load(&scale_z[first]);
+			V s1s2 = Lanes::mul(s1, s2);
+			V c1s2 = Lanes::mul(c1, s2);
+
+			V model[4][4];
+			model[0][0] = Lanes::mul(sx, Lanes::add(Lanes::mul(c1, c3), Lanes::mul(s1s2, s3)));
+			model[0][1] = Lanes::mul(sx, Lanes::mul(c2, s3));
+			model[0][2] = Lanes::mul(sx, Lanes::sub(Lanes::mul(c1s2, s3), Lanes::mul(c3, s1)));
+			model[0][3] = zero;
+			model[1][0] = Lanes::mul(sy, Lanes::sub(Lanes::mul(c3, s1s2), Lanes::mul(c1, s3)));
+			model[1][1] = Lanes::mul(sy, Lanes::mul(c2, c3));
+			model[1][2] = Lanes::mul(sy, Lanes::add(Lanes::mul(c1s2, c3), Lanes::mul(s1, s3)));
+			model[1][3] = zero;
+			model[2][0] = Lanes::mul(sz, Lanes::mul(c2, s1));
+			model[2][1] = Lanes::mul(sz, Lanes::sub(zero, s2));
+			model[2][2] = Lanes::mul(sz, Lanes::mul(c1, c2));
+			model[2][3] = zero;
+			model[3][0] = Lanes::load(&translation_x[first]);
+			model[3][1] = Lanes::load(&translation_y[first]);
+			model[3][2] = Lanes::load(&translation_z[first]);
+			model[3][3] = one;
+
+			float *model_columns[Lanes::width];
+			for (int column = 0; column < 4; column++) {
+				for (uint32_t lane = 0; lane < width; lane++) {
+					model_columns[lane] = reinterpret_cast<float*>(&models[first + lane]) + column * 4;
+				}
+				Lanes::store_column(model_columns, model[column][0], model[column][1], model[column][2], model[column][3]);
+			}
+
+			if (build_mvps) {
+				V mvp[4][4];
+				for (int column = 0; column < 4; column++) {
+					for (int row = 0; row < 4; row++) {
+						V value = Lanes::add(Lanes::add(Lanes::mul(pv[0][row], model[column][0]), Lanes::mul(pv[1][row], model[column][1])),
+						                     Lanes::mul(pv[2][row], model[column][2]));
+						mvp[column][row] = column == 3 ? Lanes::add(value, pv[3][row]) : value;
+					}
+				}
+				float *mvp_columns[Lanes::width];
+				for (int column = 0; column < 4; column++) {
+					for (uint32_t lane = 0; lane < width; lane++) {
+						mvp_columns[lane] = reinterpret_cast<float*>(&mvps[first + lane]) + column * 4;
+					}
+					Lanes::store_column(mvp_columns, mvp[column][0], mvp[column][1], mvp[column][2], mvp[column][3]);
+				}
+			}
+			std::fill(dirty.begin() + first, dirty.begin() + first + width, uint8_t{0});
+			range_rebuilt += std::min(width, object_count - std::min(object_count, first));
+		}
+		rebuilt.fetch_add(range_rebuilt, std::memory_order_relaxed);
+	}, MIN_BATCHES_PER_JOB);
+#else
+	JobSystem::get().parallel_for(0, padded_count, [&](uint32_t first_object, uint32_t last_object) {
+		uint32_t range_rebuilt = 0;
+		for (uint32_t i = first_object; i < last_object; i++) {
+			if (!camera_changed && dirty[i] == 0) {
+				continue;
+			}
+			tranform_components components{};
+			components.translation = {translation_x[i], translation_y[i], translation_z[i]};
+			components.rotation = {rotation_x[i], rotation_y[i], rotation_z[i]};
+			components.scale = {scale_x[i], scale_y[i], scale_z[i]};
+			models[i] = components.mat4();
+			if (build_mvps) {
+				mvps[i] = *projection_view * models[i];
+			}
+			dirty[i] = 0;
+			range_rebuilt += i < object_count ? 1 : 0;
+		}
+		rebuilt.fetch_add(range_rebuilt, std::memory_order_relaxed);
+	}, MIN_BATCHES_PER_JOB * BATCH_WIDTH);
+#endif
+	rebuilt_count = rebuilt.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "object.hpp"
+#include <glm/glm.hpp>
+#include <vector>
+
+namespace mage {
+
+	// Builds model matrices, and optionally model-view-projection matrices, for a whole scene at once. The blended translation,
+	// rotation and scale of every object are kept structure-of-arrays, and a batch of four (SSE) or eight (AVX)
+	// objects is only rebuilt when one of them moved or the camera did. Both passes split across the job system.
+	class TransformSystem {
+	private:
+		static constexpr uint32_t BATCH_WIDTH = 8;
+		// Smaller ranges cost more to hand out than they take to build
+		static constexpr uint32_t MIN_BATCHES_PER_JOB = 256;
+		// Where each chunk of the view starts in the SoA arrays, rebuilt every sync
+		struct ChunkRows {
+			const Transform *transforms;
+			uint32_t rows;
+			uint32_t first;
+		};
+		std::vector<ChunkRows> chunks;
+		std::vector<float> translation_x, translation_y, translation_z;
+		std::vector<float> rotation_x, rotation_y, rotation_z;
+		std::vector<float> scale_x, scale_y, scale_z;
+		std::vector<uint8_t> dirty;
+		std::vector<glm::mat4> models;
+		std::vector<glm::mat4> mvps;
+		glm::mat4 last_projection_view{0.f};
+		uint32_t object_count = 0;
+		uint32_t rebuilt_count = 0;
+		void resize(uint32_t count);
+		void sync(const DrawableView &drawables, float alpha);
+		// Null projection_view builds model matrices only
+		void build(const glm::mat4 *projection_view, bool camera_changed);
+	public:
+		void update(const DrawableView &drawables, float alpha, const glm::mat4 &projection_view);
+		// Model matrices only, for shaders that apply the camera themselves. get_mvp is stale until the next full update,
+		// and a camera move rebuilds nothing.
+		void update(const DrawableView &drawables, float alpha);
+		// Forces every matrix to be rebuilt on the next update
+		void invalidate();
+
+		uint32_t get_object_count() const {return object_count;}
+		// Objects whose matrices were rebuilt by the last update, whole batches count even if one lane moved
+		uint32_t get_rebuilt_count() const {return rebuilt_count;}
+		const glm::mat4 &get_model(uint32_t object) const {return models[object];}
+		const glm::mat4 &get_mvp(uint32_t object) const {return mvps[object];}
+		// Contiguous, one matrix per object in view order
+		const glm::mat4 *get_models() const {return models.data();}
+		const glm::mat4 *get_mvps() const {return mvps.data();}
+	};
+
+}
@@ -1,86 +1,365 @@
 #include "transport.hpp"
+#include "../debug-resources/log.hpp"
+#include "../debug-resources/cpu-profiler.hpp"
 
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #include <glm/glm.hpp>
 #include <glm/gtc/constants.hpp>
 
-#include <iostream>
+#include <algorithm>
 #include <array>
+#include <cstddef>
 #include <cstdlib>
 #include <cstring>
-#include <iostream>
 #include <limits>
+#include <mutex>
 #include <set>
 #include <stdexcept>
 #include <chrono>
 
 using namespace mage;
 
+namespace {
+
+	// Visible positions come back ascending, so one walk over the view's chunks finds every survivor's renderable.
+	// The renderable is handed over writable so the level of detail it drew can be stored back.
+	template<typename F>
+	void for_each_visible(const DrawableView &drawables, const std::vector<uint32_t> &visible, F &&function) {
+		size_t cursor = 0;
+		uint32_t first = 0;
+		drawables.each_chunk([&](const Entity *, uint32_t rows, Transform *, Renderable *renderables) {
+			uint32_t end = first + rows;
+			for (; cursor < visible.size() && visible[cursor] < end; cursor++) {
+				function(visible[cursor], renderables[visible[cursor] - first]);
+			}
+			first = end;
+		});
+	}
+
+}
+
+// The camera comes from the uniform ring, each draw only pushes its own model matrix and color
 struct push_constant_data {
-  glm::mat4 transform{1.f};
+  glm::mat4 model{1.f};
   alignas(16) glm::vec3 color{};
 };
 
-TransportPass::TransportPass(DeviceHandling &device_pass, VkRenderPass render_pass) : device{device_pass} {
-	std::cout << std::endl << "=== TRANSPORT PASS START ===" << std::endl;
+TransportPass::TransportPass(DeviceHandling &device_pass, VkRenderPass render_pass, uint32_t frames_in_flight) : device{device_pass} {
+	MAGE_INFO(pipeline) << "=== TRANSPORT PASS START ===";
+  uniforms = std::make_unique<UniformRing>(device, frames_in_flight);
   create_pipeline(render_pass);
-  std::cout << "=== TRANSPORT PASS SUCCESSFUL ===" << std::endl;
+  create_instanced_pipeline(render_pass);
+  instance_buffers.resize(frames_in_flight);
+  MAGE_INFO(pipeline) << "=== TRANSPORT PASS SUCCESSFUL ===";
 }
 
 void TransportPass::create_pipeline(VkRenderPass render_pass){
-	std::cout << "Attempting to create pipeline..." << std::endl;
+	MAGE_INFO(pipeline) << "Attempting to create pipeline...";
 
-  std::cout << " - filling data for push constants..." << std::endl;
+  MAGE_INFO(pipeline) << " - filling data for push constants...";
   VkPushConstantRange push_constant_range{};
   push_constant_range.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
   push_constant_range.offset = 0;
   push_constant_range.size = sizeof(push_constant_data);
 
-	std::cout << " - creating info for pipeline layout..." << std::endl;
+	MAGE_INFO(pipeline) << " - creating info for pipeline layout...";
+	VkDescriptorSetLayout set_layout = uniforms->get_set_layout();
 	VkPipelineLayoutCreateInfo pipeline_layout_info{};
  	pipeline_layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
- 	pipeline_layout_info.setLayoutCount = 0;
-	pipeline_layout_info.pSetLayouts = nullptr;
+ 	pipeline_layout_info.setLayoutCount = 1;
+	pipeline_layout_info.pSetLayouts = &set_layout;
 	pipeline_layout_info.pushConstantRangeCount = 1;
 	pipeline_layout_info.pPushConstantRanges = &push_constant_range;
-	std::cout << " - creating pipeline layout..." << std::endl;
+	MAGE_INFO(pipeline) << " - creating pipeline layout...";
 	if (vkCreatePipelineLayout(device.get_device(), &pipeline_layout_info, nullptr, &pipeline_layout) != VK_SUCCESS) {
-		std::cerr << "Failed to create pipeline layout" << std::endl;
+		MAGE_ERROR(pipeline) << "Failed to create pipeline layout";
 	}
 
-	std::cout << " - generating default pipeline configuration info..." << std::endl;
+	MAGE_INFO(pipeline) << " - generating default pipeline configuration info...";
 	PipelineInfo pipeline_config{};
   GraphicsPipeline::default_pipeline_info(pipeline_config);
-  std::cout << " - grabbing swapchain render pass..." << std::endl;
+  MAGE_INFO(pipeline) << " - grabbing swapchain render pass...";
 	pipeline_config.render_pass = render_pass;
 	pipeline_config.pipeline_layout = pipeline_layout;
+	pipeline_config.name = "transport";
 	pipeline = std::make_unique<GraphicsPipeline>(device, pipeline_config);
-  std::cout << " - pipeline creation successful...!?" << std::endl;
+  MAGE_INFO(pipeline) << " - pipeline creation successful...!?";
 }
 
-void TransportPass::render_game_objects(VkCommandBuffer command_buffer, std::vector<GameObject> &game_objects, const CameraHandling &camera){
-	std::cout << " - rendering game object..." << std::endl;
-	pipeline->bind(command_buffer);
+void TransportPass::create_instanced_pipeline(VkRenderPass render_pass){
+	MAGE_INFO(pipeline) << "Attempting to create instanced pipeline...";
 
-	auto projection_view = camera.get_projection_matrix() * camera.get_view_matrix();
+	// Everything per draw arrives through the instance buffer and the uniform ring, no push constants
+	VkDescriptorSetLayout set_layout = uniforms->get_set_layout();
+	VkPipelineLayoutCreateInfo pipeline_layout_info{};
+ 	pipeline_layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+ 	pipeline_layout_info.setLayoutCount = 1;
+	pipeline_layout_info.pSetLayouts = &set_layout;
+	pipeline_layout_info.pushConstantRangeCount = 0;
+	pipeline_layout_info.pPushConstantRanges = nullptr;
+	MAGE_INFO(pipeline) << " - creating instanced pipeline layout...";
+	if (vkCreatePipelineLayout(device.get_device(), &pipeline_layout_info, nullptr, &instanced_pipeline_layout) != VK_SUCCESS) {
+		MAGE_ERROR(pipeline) << "Failed to create instanced pipeline layout";
+	}
+
+	// Same fixed-function state as the per-object pipeline, plus the instance-rate binding
+	PipelineInfo pipeline_config{};
+  GraphicsPipeline::default_pipeline_info(pipeline_config);
+	auto instance_bindings = GameModel::Instance::get_binding_descriptions();
+	auto instance_attributes = GameModel::Instance::get_attribute_descriptions();
+	pipeline_config.binding_descriptions.insert(pipeline_config.binding_descriptions.end(), instance_bindings.begin(), instance_bindings.end());
+	pipeline_config.attribute_descriptions.insert(pipeline_config.attribute_descriptions.end(), instance_attributes.begin(), instance_attributes.end());
+	pipeline_config.vertex_shader_path = "src/shaders/instanced-vert.spv";
+	pipeline_config.render_pass = render_pass;
+	pipeline_config.pipeline_layout = instanced_pipeline_layout;
+	pipeline_config.name = "transport-instanced";
+	instanced_pipeline = std::make_unique<GraphicsPipeline>(device, pipeline_config);
+  MAGE_INFO(pipeline) << " - instanced pipeline creation successful!";
+}
 
-	for (auto& object : game_objects){
-		object.transform.rotation.y = glm::mod(object.transform.rotation.y + 0.0003f, glm::two_pi<float>());
-		object.transform.rotation.x = glm::mod(object.transform.rotation.x + 0.00003f, glm::two_pi<float>());
+// Grows to the next power of two so a slowly growing scene doesn't reallocate every frame.
+// Only called for the frame slot being recorded, whose previous submission has already been waited on.
+void TransportPass::reserve_instances(InstanceBuffer &instances, uint32_t count){
+	if (count <= instances.capacity) {
+		return;
+	}
+	uint32_t capacity = std::max(instances.capacity, MIN_INSTANCE_CAPACITY);
+	while (capacity < count) {
+		capacity *= 2;
+	}
+	MAGE_DEBUG(model) << " - growing instance buffer to " << capacity << " instance(s)...";
+	destroy_instance_buffer(instances);
 
-		push_constant_data push{};
-		push.color = object.color;
-		push.transform = projection_view * object.transform.mat4();
+	VkDeviceSize buffer_size = sizeof(GameModel::Instance) * static_cast<VkDeviceSize>(capacity);
+	device.create_buffer(
+	  buffer_size,
+	  VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+	  VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+	  instances.buffer,
+	  instances.allocation);
+	instances.mapped = static_cast<GameModel::Instance*>(instances.allocation.mapped);
+	instances.capacity = capacity;
+}
 
-		vkCmdPushConstants(command_buffer, pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(push_constant_data), &push);
-		object.model->bind(command_buffer);
-		object.model->draw(command_buffer);
+glm::mat4 TransportPass::write_uniforms(uint32_t frame_index, const CameraHandling &camera){
+	GlobalUniforms global{};
+	global.projection = camera.get_projection_matrix();
+	global.view = camera.get_view_matrix();
+	global.projection_view = global.projection * global.view;
+	global.camera_position = glm::inverse(global.view)[3];
+	uniforms->write(frame_index, global);
+	return global.projection_view;
+}
 
+void TransportPass::destroy_instance_buffer(InstanceBuffer &instances){
+	if (instances.buffer == VK_NULL_HANDLE) {
+		return;
 	}
+	device.destroy_buffer(instances.buffer, instances.allocation);
+	instances = {};
 }
 
+// Record draws for every drawable entity inside the camera frustum, blending each transform between its last two simulation states by alpha.
+// Survivors go through the render queue, sorted so draws sharing a model and color are recorded back to back, nearest first.
+// With a recorder the sorted packets are recorded in slices on several threads.
+void TransportPass::render_game_objects(VkCommandBuffer command_buffer, uint32_t frame_index, Registry &registry, const CameraHandling &camera, float alpha){
+	MAGE_PROFILE_ZONE("TransportPass::render_game_objects");
+	MAGE_TRACE(frame) << " - rendering game objects...";
+	draw_count = 0;
+
+	auto projection_view = write_uniforms(frame_index, camera);
+	auto drawables = registry.view<Transform, Renderable>();
+	transforms.update(drawables, alpha);
+	culling.cull(drawables, transforms, projection_view);
+
+	// Clip-space w of the object's origin is its depth along the view direction, only that row of the camera is needed
+	const glm::vec4 depth_row{projection_view[0][3], projection_view[1][3], projection_view[2][3], projection_view[3][3]};
+	queue.clear();
+	lods.begin(camera);
+	for_each_visible(drawables, culling.get_visible(), [&](uint32_t index, Renderable &renderable){
+		renderable.lod = lods.select(*renderable.model, transforms.get_model(index), renderable.lod);
+		float depth = glm::dot(depth_row, transforms.get_model(index)[3]);
+		uint64_t key = RenderQueue::make_key(DrawPass::opaque, TRANSPORT_PIPELINE, RenderQueue::material_id(renderable.color), renderable.model->get_sort_id(), depth);
+		queue.push(key, index, &renderable);
+	});
+	queue.sort();
+
+	RenderQueueStatistics statistics{};
+	statistics.packets = queue.get_packet_count();
+	if (recorder != nullptr) {
+		// Every secondary starts with no state bound, slices count on their own and add up at the end
+		std::mutex statistics_mutex;
+		recorder->record(command_buffer, statistics.packets, [&](VkCommandBuffer secondary, uint32_t begin, uint32_t end){
+			RenderQueueStatistics counts{};
+			// The GPU profiler is single threaded, secondaries go without per-draw scopes
+			record_packets(secondary, frame_index, begin, end, nullptr, counts);
+			std::lock_guard<std::mutex> lock{statistics_mutex};
+			statistics.pipeline_binds += counts.pipeline_binds;
+			statistics.vertex_binds += counts.vertex_binds;
+			statistics.push_constants += counts.push_constants;
+		});
+	} else {
+		record_packets(command_buffer, frame_index, 0, statistics.packets, gpu_profiler, statistics);
+	}
+	statistics.pipeline_binds_saved = statistics.packets - statistics.pipeline_binds;
+	statistics.vertex_binds_saved = statistics.packets - statistics.vertex_binds;
+	statistics.push_constants_saved = statistics.packets - statistics.push_constants;
+	queue.set_statistics(statistics);
+	draw_count = statistics.packets;
+}
+
+// Pipeline, model buffers and color are only bound when they differ from the previous draw's, the matrix always changes.
+// The uniform set goes with the pipeline, it has to be bound again in every secondary.
+void TransportPass::record_packets(VkCommandBuffer command_buffer, uint32_t frame_index, uint32_t begin, uint32_t end, GpuProfiler *profiler, RenderQueueStatistics &counts){
+	const auto &packets = queue.get_packets();
+	const VkShaderStageFlags stages = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+	uint32_t bound_pipeline = ~0u;
+	GameModel *bound_model = nullptr;
+	bool color_pushed = false;
+	glm::vec3 pushed_color{};
+	for (uint32_t i = begin; i < end; i++) {
+		const DrawPacket &packet = packets[i];
+		const Renderable &renderable = *packet.renderable;
+		GpuScope draw_scope{profiler, command_buffer, "draw"};
+		uint32_t pipeline_id = RenderQueue::get_pipeline(packet.key);
+		if (pipeline_id != bound_pipeline) {
+			pipeline->bind(command_buffer);
+			uniforms->bind(command_buffer, pipeline_layout, frame_index);
+			bound_pipeline = pipeline_id;
+			counts.pipeline_binds++;
+		}
+		if (!color_pushed || renderable.color != pushed_color) {
+			vkCmdPushConstants(command_buffer, pipeline_layout, stages, offsetof(push_constant_data, color), sizeof(glm::vec3), &renderable.color);
+			pushed_color = renderable.color;
+			color_pushed = true;
+			counts.push_constants++;
+		}
+		vkCmdPushConstants(command_buffer, pipeline_layout, stages, offsetof(push_constant_data, model), sizeof(glm::mat4), &transforms.get_model(packet.index));
+		if (renderable.model != bound_model) {
+			renderable.model->bind(command_buffer);
+			bound_model = renderable.model;
+			counts.vertex_binds++;
+		}
+		renderable.model->draw(command_buffer, renderable.lod);
+	}
+}
+
+// Group objects by model and level of detail and draw each group with a single instanced draw.
+// Instances are laid out group by group in this frame's buffer, so each draw reads one contiguous range.
+void TransportPass::render_game_objects_instanced(VkCommandBuffer command_buffer, uint32_t frame_index, Registry &registry, const CameraHandling &camera, float alpha){
+	MAGE_PROFILE_ZONE("TransportPass::render_game_objects_instanced");
+	MAGE_TRACE(frame) << " - rendering instanced game objects...";
+	draw_count = 0;
+
+	auto projection_view = write_uniforms(frame_index, camera);
+	auto drawables = registry.view<Transform, Renderable>();
+	transforms.update(drawables, alpha);
+	culling.cull(drawables, transforms, projection_view);
+	const auto &visible = culling.get_visible();
+
+	// First pass picks levels and counts the visible instances of every model and level
+	auto group_key = [](const Renderable &renderable){
+		return (static_cast<uint64_t>(renderable.model->get_sort_id()) << 8) | renderable.lod;
+	};
+	instance_groups.clear();
+	group_lookup.clear();
+	lods.begin(camera);
+	for_each_visible(drawables, visible, [&](uint32_t index, Renderable &renderable){
+		renderable.lod = lods.select(*renderable.model, transforms.get_model(index), renderable.lod);
+		auto found = group_lookup.emplace(group_key(renderable), static_cast<uint32_t>(instance_groups.size()));
+		if (found.second) {
+			instance_groups.push_back({renderable.model, renderable.lod, 0, 0});
+		}
+		instance_groups[found.first->second].instance_count++;
+	});
+	if (instance_groups.empty()) {
+		return;
+	}
+
+	uint32_t instance_total = 0;
+	for (auto& group : instance_groups){
+		group.first_instance = instance_total;
+		instance_total += group.instance_count;
+		group.instance_count = 0;
+	}
+	InstanceBuffer &instances = instance_buffers[frame_index];
+	reserve_instances(instances, instance_total);
+
+	// Second pass writes each object into its group's range, the memory is coherent so no flush is needed
+	for_each_visible(drawables, visible, [&](uint32_t index, const Renderable &renderable){
+		InstanceGroup &group = instance_groups[group_lookup[group_key(renderable)]];
+		GameModel::Instance &instance = instances.mapped[group.first_instance + group.instance_count++];
+		instance.transform = transforms.get_model(index);
+		instance.color = renderable.color;
+	});
+
+	auto record_groups = [&](VkCommandBuffer target, uint32_t begin, uint32_t end, GpuProfiler *profiler){
+		instanced_pipeline->bind(target);
+		uniforms->bind(target, instanced_pipeline_layout, frame_index);
+		VkDeviceSize offsets[] = {0};
+		vkCmdBindVertexBuffers(target, 1, 1, &instances.buffer, offsets);
+		for (uint32_t i = begin; i < end; i++){
+			const InstanceGroup &group = instance_groups[i];
+			GpuScope draw_scope{profiler, target, "draw_instanced"};
+			group.model->bind(target);
+			group.model->draw_instanced(target, group.instance_count, group.first_instance, group.lod);
+		}
+	};
+	uint32_t group_count = static_cast<uint32_t>(instance_groups.size());
+	if (recorder != nullptr) {
+		recorder->record(command_buffer, group_count, [&](VkCommandBuffer secondary, uint32_t begin, uint32_t end){
+			record_groups(secondary, begin, end, nullptr);
+		});
+	} else {
+		record_groups(command_buffer, 0, group_count, gpu_profiler);
+	}
+	draw_count = group_count;
+}
+
+// Transforms are still built on the CPU, the frustum test and everything after it move to the GPU.
+// The CPU culling stage is skipped, its enabled flag decides whether the GPU tests the frustum.
+void TransportPass::cull_on_gpu(VkCommandBuffer command_buffer, DrawHandling &artist, Registry &registry, const CameraHandling &camera, float alpha){
+	MAGE_PROFILE_ZONE("TransportPass::cull_on_gpu");
+	if (gpu_scene == nullptr) {
+		gpu_scene = std::make_unique<GpuScene>(device, static_cast<uint32_t>(instance_buffers.size()));
+	}
+	uint32_t frame_index = static_cast<uint32_t>(artist.get_frame_index());
+	auto projection_view = write_uniforms(frame_index, camera);
+	auto drawables = registry.view<Transform, Renderable>();
+	transforms.update(drawables, alpha);
+	lods.begin(camera);
+	gpu_scene->record_cull(command_buffer, artist, frame_index, drawables, transforms, lods, projection_view, culling.is_enabled(), gpu_profiler);
+}
+
+// Same pipeline and instance layout as render_game_objects_instanced, only the instances and draw arguments come from the GPU
+void TransportPass::render_game_objects_indirect(VkCommandBuffer command_buffer, uint32_t frame_index){
+	MAGE_PROFILE_ZONE("TransportPass::render_game_objects_indirect");
+	draw_count = 0;
+	if (gpu_scene == nullptr) {
+		return;
+	}
+	auto record_draws = [&](VkCommandBuffer target, GpuProfiler *profiler){
+		GpuScope draw_scope{profiler, target, "draw_indirect"};
+		instanced_pipeline->bind(target);
+		uniforms->bind(target, instanced_pipeline_layout, frame_index);
+		return gpu_scene->record_draws(target, frame_index);
+	};
+	if (recorder != nullptr) {
+		recorder->record(command_buffer, 1, [&](VkCommandBuffer secondary, uint32_t, uint32_t){
+			draw_count = record_draws(secondary, nullptr);
+		});
+	} else {
+		draw_count = record_draws(command_buffer, gpu_profiler);
+	}
+}
 
 TransportPass::~TransportPass() {
+  gpu_scene.reset();
+	for (auto& instances : instance_buffers){
+		destroy_instance_buffer(instances);
+	}
+	vkDestroyPipelineLayout(device.get_device(), instanced_pipeline_layout, nullptr);
 	vkDestroyPipelineLayout(device.get_device(), pipeline_layout, nullptr);
+	uniforms.reset();
 }
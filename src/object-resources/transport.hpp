@@ -3,22 +3,92 @@
 #include "../pipeline-resources/pipeline.hpp"
 #include "../pipeline-resources/device.hpp"
 #include "../camera-resources/camera.hpp"
+#include "../debug-resources/gpu-profiler.hpp"
+#include "../pipeline-resources/recorder.hpp"
+#include "../pipeline-resources/uniform-ring.hpp"
 #include "object.hpp"
+#include "registry.hpp"
+#include "culling.hpp"
+#include "gpu-scene.hpp"
+#include "lod-selection.hpp"
+#include "render-queue.hpp"
+#include "transform.hpp"
 #include <vector>
 #include <memory>
+#include <unordered_map>
 
 namespace mage {
 
 	class TransportPass {
 	private:	
+		// One persistently mapped, host-visible instance buffer per frame in flight
+		struct InstanceBuffer {
+			VkBuffer buffer = VK_NULL_HANDLE;
+			MemoryAllocation allocation;
+			GameModel::Instance *mapped = nullptr;
+			uint32_t capacity = 0;
+		};
+		// One per model and level of detail in use
+		struct InstanceGroup {
+			GameModel *model;
+			uint32_t lod;
+			uint32_t first_instance;
+			uint32_t instance_count;
+		};
+		static constexpr uint32_t MIN_INSTANCE_CAPACITY = 1024;
+		// Pipeline slot in render queue keys, only the per-object pipeline draws through the queue so far
+		static constexpr uint32_t TRANSPORT_PIPELINE = 0;
   		VkPipelineLayout pipeline_layout;
+  		VkPipelineLayout instanced_pipeline_layout;
   		DeviceHandling &device;
+  		// Camera matrices for every pipeline's set 0, created before the pipelines that use its set layout
+  		std::unique_ptr<UniformRing> uniforms;
+  		GpuProfiler *gpu_profiler = nullptr;
+  		ParallelRecorder *recorder = nullptr;
+  		uint32_t draw_count = 0;
+  		TransformSystem transforms;
+  		CullingStage culling;
+  		LodSelector lods;
+  		std::vector<InstanceBuffer> instance_buffers;
+  		std::vector<InstanceGroup> instance_groups;
+  		// Keyed by model sort id and level
+  		std::unordered_map<uint64_t, uint32_t> group_lookup;
+  		RenderQueue queue;
+  		std::unique_ptr<GpuScene> gpu_scene;
+  		void reserve_instances(InstanceBuffer &instances, uint32_t count);
+  		void destroy_instance_buffer(InstanceBuffer &instances);
+  		void record_packets(VkCommandBuffer command_buffer, uint32_t frame_index, uint32_t begin, uint32_t end, GpuProfiler *profiler, RenderQueueStatistics &counts);
+  		// Writes this frame's slot of the uniform ring and returns the camera's projection * view
+  		glm::mat4 write_uniforms(uint32_t frame_index, const CameraHandling &camera);
 	public:
-		TransportPass(DeviceHandling &device_pass, VkRenderPass render_pass);
+		TransportPass(DeviceHandling &device_pass, VkRenderPass render_pass, uint32_t frames_in_flight);
 		~TransportPass();
 		std::unique_ptr<GraphicsPipeline> pipeline;
+		std::unique_ptr<GraphicsPipeline> instanced_pipeline;
 		void create_pipeline(VkRenderPass render_pass);
-		void render_game_objects(VkCommandBuffer command_buffer, std::vector<GameObject> &game_objects, const CameraHandling &camera);
+		void create_instanced_pipeline(VkRenderPass render_pass);
+		void set_gpu_profiler(GpuProfiler *profiler) {gpu_profiler = profiler;}
+		// Record through DrawHandling's recorder when it has one, must match how the render pass was begun
+		void set_recorder(ParallelRecorder *recorder_pass) {recorder = recorder_pass;}
+		// Draw calls recorded by the last render_game_objects call
+		uint32_t get_draw_count() const {return draw_count;}
+		// Visible and culled counts of the last render call
+		CullingStage &get_culling() {return culling;}
+		TransformSystem &get_transforms() {return transforms;}
+		// Levels picked and triangles they cost during the last render call
+		LodSelector &get_lods() {return lods;}
+		// Sort order and the binds it saved during the last render_game_objects call
+		RenderQueue &get_queue() {return queue;}
+		void render_game_objects(VkCommandBuffer command_buffer, uint32_t frame_index, Registry &registry, const CameraHandling &camera, float alpha = 1.f);
+		void render_game_objects_instanced(VkCommandBuffer command_buffer, uint32_t frame_index, Registry &registry, const CameraHandling &camera, float alpha = 1.f);
+		// GPU-driven drawing needs indirect draws that start past instance zero, otherwise use the instanced path
+		bool supports_gpu_driven() const {return device.supports_indirect_first_instance();}
+		// Culls and builds this frame's indirect draws on the GPU, recorded before swapchain_render_start
+		void cull_on_gpu(VkCommandBuffer command_buffer, DrawHandling &artist, Registry &registry, const CameraHandling &camera, float alpha = 1.f);
+		// Draws what the last cull_on_gpu for this frame slot produced, inside the render pass
+		void render_game_objects_indirect(VkCommandBuffer command_buffer, uint32_t frame_index);
+		// Null until cull_on_gpu first runs
+		GpuScene *get_gpu_scene() const {return gpu_scene.get();}
 	};
 
 }
@@ -0,0 +1,349 @@
+#include "upload-service.hpp"
+#include "../debug-resources/log.hpp"
+#include "../debug-resources/cpu-profiler.hpp"
+
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+
+using namespace mage;
+
+namespace {
+
+	VkDeviceSize align_up(VkDeviceSize value, VkDeviceSize alignment) {
+		return (value + alignment - 1) & ~(alignment - 1);
+	}
+
+}
+
+UploadService::UploadService(DeviceHandling &device_pass) : device{device_pass} {
+	MAGE_INFO(device) << "Attempting to create upload service...";
+	QueueIndices families = device.get_queue_families();
+	dedicated = families.dedicated_transfer() && device.get_transfer_queue() != VK_NULL_HANDLE;
+	graphics_family = families.graphics_family;
+	transfer_family = dedicated ? families.transfer_family : families.graphics_family;
+	transfer_queue = dedicated ? device.get_transfer_queue() : device.get_graphics_queue();
+	MAGE_INFO(device) << " - uploading on " << (dedicated ? "dedicated transfer" : "graphics") << " family " << transfer_family;
+
+	// Batches are recycled, so their command buffers are reset one by one when re-recorded
+	VkCommandPoolCreateInfo pool_info{};
+	pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	pool_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+	pool_info.queueFamilyIndex = transfer_family;
+	if (vkCreateCommandPool(device.get_device(), &pool_info, nullptr, &transfer_pool) != VK_SUCCESS) {
+		MAGE_ERROR(device) << "Failed to create upload command pool";
+		exit(EXIT_FAILURE);
+	}
+	if (dedicated) {
+		pool_info.queueFamilyIndex = graphics_family;
+		if (vkCreateCommandPool(device.get_device(), &pool_info, nullptr, &acquire_pool) != VK_SUCCESS) {
+			MAGE_ERROR(device) << "Failed to create ownership acquire command pool";
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	device.create_buffer(
+		STAGING_SIZE,
+		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		staging_buffer,
+		staging_allocation);
+	MAGE_INFO(device) << " - upload service creation successful!";
+}
+
+ModelUploadHandle UploadService::upload_model(std::vector<GameModel::Vertex> vertices, std::vector<uint32_t> indices) {
+	auto handle = std::make_shared<ModelUpload>();
+	std::lock_guard<std::mutex> lock{mutex};
+	pending.push_back({std::move(vertices), std::move(indices), nullptr, handle});
+	return handle;
+}
+
+ModelUploadHandle UploadService::upload_model(std::shared_ptr<const CookedMesh> mesh) {
+	auto handle = std::make_shared<ModelUpload>();
+	std::lock_guard<std::mutex> lock{mutex};
+	pending.push_back({{}, {}, std::move(mesh), handle});
+	return handle;
+}
+
+VkDeviceSize UploadService::request_size(const Request &request) {
+	if (request.cooked) {
+		return GameModel::upload_size(request.cooked->get_view());
+	}
+	return GameModel::upload_size(request.vertices, request.indices);
+}
+
+uint32_t UploadService::get_pending_count() {
+	std::lock_guard<std::mutex> lock{mutex};
+	return static_cast<uint32_t>(pending.size());
+}
+
+// Batches finish in submission order, so only the oldest has to be polled
+void UploadService::retire() {
+	while (!in_flight.empty() && vkGetFenceStatus(device.get_device(), in_flight.front().fence) == VK_SUCCESS) {
+		Batch &batch = in_flight.front();
+		for (auto &handle : batch.handles) {
+			handle->ready.store(true, std::memory_order_release);
+		}
+		MAGE_TRACE(device) << " - upload batch of " << static_cast<uint64_t>(batch.handles.size()) << " model(s) ready";
+		batch.handles.clear();
+		vkResetFences(device.get_device(), 1, &batch.fence);
+		tail = batch.staging_end;
+		free_batches.push_back(std::move(batch));
+		in_flight.pop_front();
+	}
+	if (in_flight.empty()) {
+		head = 0;
+		tail = 0;
+	}
+}
+
+// A request's staging range is contiguous. Strict comparisons keep head from catching up with tail, so head == tail
+// always means the ring is empty.
+bool UploadService::reserve(VkDeviceSize size, VkDeviceSize &offset) {
+	if (head >= tail) {
+		if (head + size <= STAGING_SIZE) {
+			offset = head;
+			head += size;
+			return true;
+		}
+		if (size < tail) {
+			offset = 0;
+			head = size;
+			return true;
+		}
+		return false;
+	}
+	if (head + size < tail) {
+		offset = head;
+		head += size;
+		return true;
+	}
+	return false;
+}
+
+UploadService::Batch UploadService::acquire_batch() {
+	if (!free_batches.empty()) {
+		Batch batch = std::move(free_batches.back());
+		free_batches.pop_back();
+		return batch;
+	}
+	Batch batch{};
+	VkCommandBufferAllocateInfo allocate_info{};
+	allocate_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	allocate_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	allocate_info.commandBufferCount = 1;
+	allocate_info.commandPool = transfer_pool;
+	if (vkAllocateCommandBuffers(device.get_device(), &allocate_info, &batch.transfer_commands) != VK_SUCCESS) {
+		MAGE_ERROR(device) << "Failed to allocate upload command buffer";
+		exit(EXIT_FAILURE);
+	}
+	if (dedicated) {
+		allocate_info.commandPool = acquire_pool;
+		if (vkAllocateCommandBuffers(device.get_device(), &allocate_info, &batch.acquire_commands) != VK_SUCCESS) {
+			MAGE_ERROR(device) << "Failed to allocate ownership acquire command buffer";
+			exit(EXIT_FAILURE);
+		}
+		VkSemaphoreCreateInfo semaphore_info{};
+		semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+		if (vkCreateSemaphore(device.get_device(), &semaphore_info, nullptr, &batch.transferred) != VK_SUCCESS) {
+			MAGE_ERROR(device) << "Failed to create upload semaphore";
+			exit(EXIT_FAILURE);
+		}
+	}
+	VkFenceCreateInfo fence_info{};
+	fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+	if (vkCreateFence(device.get_device(), &fence_info, nullptr, &batch.fence) != VK_SUCCESS) {
+		MAGE_ERROR(device) << "Failed to create upload fence";
+		exit(EXIT_FAILURE);
+	}
+	return batch;
+}
+
+void UploadService::update() {
+	MAGE_PROFILE_ZONE("UploadService::update");
+	retire();
+
+	Batch batch{};
+	bool started = false;
+	std::vector<StagedCopy> copies;
+	VkDeviceSize staged = 0;
+	while (staged < FRAME_BUDGET) {
+		Request request;
+		VkDeviceSize offset = 0;
+		VkDeviceSize size = 0;
+		bool oversized = false;
+		{
+			std::lock_guard<std::mutex> lock{mutex};
+			if (pending.empty()) {
+				break;
+			}
+			// Room for both buffers plus their alignment padding
+			size = request_size(pending.front()) + 2 * ALIGNMENT;
+			oversized = size > STAGING_SIZE;
+			if (!oversized && !reserve(size, offset)) {
+				break;
+			}
+			request = std::move(pending.front());
+			pending.pop_front();
+		}
+		if (oversized) {
+			upload_now(request);
+			continue;
+		}
+
+		if (!started) {
+			batch = acquire_batch();
+			VkCommandBufferBeginInfo begin_info{};
+			begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+			begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+			vkBeginCommandBuffer(batch.transfer_commands, &begin_info);
+			started = true;
+		}
+		VkDeviceSize cursor = offset;
+		auto writer = [&](VkBuffer destination, const void *data, VkDeviceSize bytes) {
+			cursor = align_up(cursor, ALIGNMENT);
+			memcpy(static_cast<char*>(staging_allocation.mapped) + cursor, data, static_cast<size_t>(bytes));
+			copies.push_back({destination, {cursor, 0, bytes}});
+			cursor += bytes;
+		};
+		if (request.cooked) {
+			request.handle->model = std::make_shared<GameModel>(device, request.cooked->get_view(), writer);
+		} else {
+			request.handle->model = std::make_shared<GameModel>(device, request.vertices, request.indices, writer);
+		}
+		batch.handles.push_back(std::move(request.handle));
+		staged += size;
+	}
+
+	if (started) {
+		batch.staging_end = head;
+		submit(batch, copies);
+		uploaded_bytes += staged;
+		MAGE_TRACE(device) << " - submitted " << static_cast<uint64_t>(batch.handles.size()) << " model upload(s), " << staged << " byte(s)";
+		in_flight.push_back(std::move(batch));
+	}
+}
+
+// Without a dedicated family the copies go to the graphics queue behind the same barrier synchronous uploads use.
+// Otherwise every destination is released by the transfer family and acquired by graphics before anything reads it.
+void UploadService::submit(Batch &batch, const std::vector<StagedCopy> &copies) {
+	if (!dedicated) {
+		device.copy_buffers(batch.transfer_commands, staging_buffer, copies);
+		vkEndCommandBuffer(batch.transfer_commands);
+		VkSubmitInfo submit_info{};
+		submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submit_info.commandBufferCount = 1;
+		submit_info.pCommandBuffers = &batch.transfer_commands;
+		if (vkQueueSubmit(transfer_queue, 1, &submit_info, batch.fence) != VK_SUCCESS) {
+			MAGE_ERROR(device) << "Failed to submit uploads";
+			exit(EXIT_FAILURE);
+		}
+		return;
+	}
+
+	std::vector<VkBufferMemoryBarrier> barriers;
+	barriers.reserve(copies.size());
+	for (const auto &copy : copies) {
+		vkCmdCopyBuffer(batch.transfer_commands, staging_buffer, copy.destination, 1, &copy.region);
+		VkBufferMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+		barrier.srcQueueFamilyIndex = transfer_family;
+		barrier.dstQueueFamilyIndex = graphics_family;
+		barrier.buffer = copy.destination;
+		barrier.offset = 0;
+		barrier.size = VK_WHOLE_SIZE;
+		barriers.push_back(barrier);
+	}
+
+	// Release: only the source half of the access masks applies on the transfer queue
+	for (auto &barrier : barriers) {
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = 0;
+	}
+	vkCmdPipelineBarrier(batch.transfer_commands, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+	                     0, 0, nullptr, static_cast<uint32_t>(barriers.size()), barriers.data(), 0, nullptr);
+	vkEndCommandBuffer(batch.transfer_commands);
+
+	// Acquire: the matching barrier on graphics, only the destination half applies
+	VkCommandBufferBeginInfo begin_info{};
+	begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	vkBeginCommandBuffer(batch.acquire_commands, &begin_info);
+	for (auto &barrier : barriers) {
+		barrier.srcAccessMask = 0;
+		// Transfer reads cover GpuScene copying the model into its shared buffers
+		barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT;
+	}
+	vkCmdPipelineBarrier(batch.acquire_commands, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+	                     0, 0, nullptr, static_cast<uint32_t>(barriers.size()), barriers.data(), 0, nullptr);
+	vkEndCommandBuffer(batch.acquire_commands);
+
+	VkSubmitInfo transfer_submit{};
+	transfer_submit.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	transfer_submit.commandBufferCount = 1;
+	transfer_submit.pCommandBuffers = &batch.transfer_commands;
+	transfer_submit.signalSemaphoreCount = 1;
+	transfer_submit.pSignalSemaphores = &batch.transferred;
+	if (vkQueueSubmit(transfer_queue, 1, &transfer_submit, VK_NULL_HANDLE) != VK_SUCCESS) {
+		MAGE_ERROR(device) << "Failed to submit uploads to the transfer queue";
+		exit(EXIT_FAILURE);
+	}
+
+	// The wait stage matches the acquire barrier's source stage so the two form one dependency chain
+	VkPipelineStageFlags wait_stage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+	VkSubmitInfo acquire_submit{};
+	acquire_submit.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	acquire_submit.waitSemaphoreCount = 1;
+	acquire_submit.pWaitSemaphores = &batch.transferred;
+	acquire_submit.pWaitDstStageMask = &wait_stage;
+	acquire_submit.commandBufferCount = 1;
+	acquire_submit.pCommandBuffers = &batch.acquire_commands;
+	if (vkQueueSubmit(device.get_graphics_queue(), 1, &acquire_submit, batch.fence) != VK_SUCCESS) {
+		MAGE_ERROR(device) << "Failed to submit ownership acquire";
+		exit(EXIT_FAILURE);
+	}
+}
+
+// A mesh bigger than the whole ring goes through the device's own synchronous staging path instead
+void UploadService::upload_now(Request &request) {
+	MAGE_WARN(device) << " - model upload of " << request_size(request) << " byte(s) exceeds the staging ring, uploading synchronously";
+	device.begin_upload_batch();
+	if (request.cooked) {
+		request.handle->model = std::make_shared<GameModel>(device, request.cooked->get_view());
+	} else {
+		request.handle->model = std::make_shared<GameModel>(device, request.vertices, request.indices);
+	}
+	device.end_upload_batch();
+	request.handle->ready.store(true, std::memory_order_release);
+}
+
+void UploadService::wait_idle() {
+	MAGE_PROFILE_ZONE("UploadService::wait_idle");
+	update();
+	while (!in_flight.empty() || get_pending_count() > 0) {
+		if (!in_flight.empty()) {
+			vkWaitForFences(device.get_device(), 1, &in_flight.front().fence, VK_TRUE, std::numeric_limits<uint64_t>::max());
+		}
+		update();
+	}
+}
+
+// Requests that were never submitted are dropped, in-flight ones are waited on so no copy outlives its buffers
+UploadService::~UploadService() {
+	for (auto &batch : in_flight) {
+		vkWaitForFences(device.get_device(), 1, &batch.fence, VK_TRUE, std::numeric_limits<uint64_t>::max());
+	}
+	retire();
+	for (auto &batch : free_batches) {
+		if (batch.transferred != VK_NULL_HANDLE) {
+			vkDestroySemaphore(device.get_device(), batch.transferred, nullptr);
+		}
+		vkDestroyFence(device.get_device(), batch.fence, nullptr);
+	}
+	// Destroying a pool frees every buffer allocated from it
+	vkDestroyCommandPool(device.get_device(), transfer_pool, nullptr);
+	if (acquire_pool != VK_NULL_HANDLE) {
+		vkDestroyCommandPool(device.get_device(), acquire_pool, nullptr);
+	}
+	device.destroy_buffer(staging_buffer, staging_allocation);
+}
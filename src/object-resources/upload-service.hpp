@@ -0,0 +1,99 @@
+#pragma once
+
+#include "model.hpp"
+#include "mesh-cooked.hpp"
+#include "../pipeline-resources/device.hpp"
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace mage {
+
+	// Handed back by UploadService::upload_model, the model is only drawable once is_ready() turns true
+	class ModelUpload {
+	private:
+		friend class UploadService;
+		std::atomic<bool> ready{false};
+		std::shared_ptr<GameModel> model;
+	public:
+		bool is_ready() const {return ready.load(std::memory_order_acquire);}
+		// Null until ready
+		std::shared_ptr<GameModel> get() const {return is_ready() ? model : nullptr;}
+	};
+	using ModelUploadHandle = std::shared_ptr<ModelUpload>;
+
+	// Streams meshes to device-local memory without stalling the frame. Requests come from any thread and are picked up
+	// by update() on the main thread, which stages up to a per-frame budget into a ring buffer and submits the copies on
+	// the dedicated transfer queue when there is one. Buffers then change queue family ownership to graphics with a
+	// release/acquire barrier pair chained by a semaphore. A fence per batch tells a later update() when it is done.
+	class UploadService {
+	private:
+		static constexpr VkDeviceSize STAGING_SIZE = 32 * 1024 * 1024;
+		// Bytes staged per update, keeps the memcpy and recording cost of a burst of requests off any single frame
+		static constexpr VkDeviceSize FRAME_BUDGET = 8 * 1024 * 1024;
+		static constexpr VkDeviceSize ALIGNMENT = 16;
+		struct Request {
+			std::vector<GameModel::Vertex> vertices;
+			std::vector<uint32_t> indices;
+			// Set instead of vertices and indices for a cooked mesh, its mapping is staged straight from the file
+			std::shared_ptr<const CookedMesh> cooked;
+			ModelUploadHandle handle;
+		};
+		// Command buffers, semaphore and fence are kept and reused once the batch retires
+		struct Batch {
+			VkCommandBuffer transfer_commands = VK_NULL_HANDLE;
+			VkCommandBuffer acquire_commands = VK_NULL_HANDLE;
+			VkSemaphore transferred = VK_NULL_HANDLE;
+			VkFence fence = VK_NULL_HANDLE;
+			VkDeviceSize staging_end = 0;
+			std::vector<ModelUploadHandle> handles;
+		};
+		DeviceHandling &device;
+		bool dedicated;
+		uint32_t graphics_family;
+		uint32_t transfer_family;
+		VkQueue transfer_queue;
+		VkCommandPool transfer_pool = VK_NULL_HANDLE;
+		VkCommandPool acquire_pool = VK_NULL_HANDLE;
+		VkBuffer staging_buffer = VK_NULL_HANDLE;
+		MemoryAllocation staging_allocation{};
+		// Staging ring: head is where the next write goes, tail is where the oldest in-flight batch starts
+		VkDeviceSize head = 0;
+		VkDeviceSize tail = 0;
+
+		std::mutex mutex;
+		std::deque<Request> pending;
+		std::deque<Batch> in_flight;
+		std::vector<Batch> free_batches;
+		uint64_t uploaded_bytes = 0;
+
+		void retire();
+		bool reserve(VkDeviceSize size, VkDeviceSize &offset);
+		Batch acquire_batch();
+		void submit(Batch &batch, const std::vector<StagedCopy> &copies);
+		void upload_now(Request &request);
+		static VkDeviceSize request_size(const Request &request);
+	public:
+		UploadService(DeviceHandling &device_pass);
+		~UploadService();
+		UploadService(const UploadService &) = delete;
+		UploadService &operator=(const UploadService &) = delete;
+
+		// Any thread. The data is moved in, so callers decoding on a job can hand over their buffers directly.
+		ModelUploadHandle upload_model(std::vector<GameModel::Vertex> vertices, std::vector<uint32_t> indices);
+		// Any thread. The mesh is held until its bytes are staged, then the mapping is let go.
+		ModelUploadHandle upload_model(std::shared_ptr<const CookedMesh> mesh);
+		// Main thread, once per frame: marks finished batches ready, then stages and submits what fits
+		void update();
+		// Main thread, blocks until every request made so far is ready
+		void wait_idle();
+
+		bool has_dedicated_transfer() const {return dedicated;}
+		uint32_t get_pending_count();
+		uint32_t get_in_flight_count() const {return static_cast<uint32_t>(in_flight.size());}
+		uint64_t get_uploaded_bytes() const {return uploaded_bytes;}
+	};
+
+}
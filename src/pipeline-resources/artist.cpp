@@ -1,10 +1,11 @@
 #include "artist.hpp"
+#include "../debug-resources/log.hpp"
+#include "../debug-resources/cpu-profiler.hpp"
 
-#include <iostream>
+#include <algorithm>
 #include <array>
 #include <cstdlib>
 #include <cstring>
-#include <iostream>
 #include <limits>
 #include <set>
 #include <stdexcept>
@@ -12,97 +13,165 @@
 
 using namespace mage;
 
-DrawHandling::DrawHandling(Window &window_pass, DeviceHandling &device_pass) : window{window_pass}, device{device_pass} {
-  std::cout << std::endl << "=== ARTIST HANDLING START ===" << std::endl;
+DrawHandling::DrawHandling(Window &window_pass, DeviceHandling &device_pass, FramePacing pacing) : requested_pacing{pacing}, window{&window_pass}, device{device_pass} {
+  MAGE_INFO(frame) << "=== ARTIST HANDLING START ===";
   create_swapchain();
   create_command_buffer();
-  std::cout << "=== ARTIST HANDLING SUCCESSFUL ===" << std::endl;
+  gpu_profiler = std::make_unique<GpuProfiler>(device, target->get_max_frames());
+  MAGE_INFO(frame) << "=== ARTIST HANDLING SUCCESSFUL ===";
+}
+
+// Headless variant, renders into offscreen images instead of a window's swapchain
+DrawHandling::DrawHandling(DeviceHandling &device_pass, VkExtent2D extent, OffscreenInfo offscreen_info) : device{device_pass} {
+  MAGE_INFO(frame) << "=== ARTIST HANDLING START (HEADLESS) ===";
+  offscreen = std::make_unique<OffscreenHandling>(device, extent, offscreen_info);
+  target = offscreen.get();
+  create_command_buffer();
+  gpu_profiler = std::make_unique<GpuProfiler>(device, target->get_max_frames());
+  MAGE_INFO(frame) << "=== ARTIST HANDLING SUCCESSFUL ===";
 }
 
 void DrawHandling::create_command_buffer(){
-  std::cout << "Attempting to create command buffer..." << std::endl;
-  std::cout << " - resizing commnad buffer..." << std::endl;
-  command_buffer.resize(swapchain->get_max_frames());
+  MAGE_INFO(frame) << "Attempting to create command buffer...";
+  MAGE_INFO(frame) << " - resizing commnad buffer...";
+  command_buffer.resize(target->get_max_frames());
 
-  std::cout << " - creating info for buffer allocation..." << std::endl;
+  MAGE_INFO(frame) << " - creating info for buffer allocation...";
   VkCommandBufferAllocateInfo allocate_info{};
   allocate_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
   allocate_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
   allocate_info.commandPool = device.get_command_pool();
   allocate_info.commandBufferCount = static_cast<uint32_t>(command_buffer.size());
 
-  std::cout << " - attempting to allocate command buffer..." << std::endl;
+  MAGE_INFO(frame) << " - attempting to allocate command buffer...";
   if (vkAllocateCommandBuffers(device.get_device(), &allocate_info, command_buffer.data()) != VK_SUCCESS) {
-    std::cerr << "Failed to allocate command buffer";
+    MAGE_ERROR(frame) << "Failed to allocate command buffer";
     exit(EXIT_FAILURE);
   }
-	std::cout << " - command buffer creation successful!" << std::endl;
+	MAGE_INFO(frame) << " - command buffer creation successful!";
+}
+
+void DrawHandling::set_record_threads(uint32_t thread_count) {
+  vkDeviceWaitIdle(device.get_device());
+  recorder.reset();
+  if (thread_count > 1) {
+    recorder = std::make_unique<ParallelRecorder>(device, static_cast<uint32_t>(target->get_max_frames()), thread_count);
+  }
 }
 
 void DrawHandling::create_swapchain() {
-  std::cout << "Attempting to create swapchain..." << std::endl;
-  auto extent = window.get_extent();
+  MAGE_INFO(swapchain) << "Attempting to create swapchain...";
+  auto extent = window->get_extent();
   while (extent.width == 0 || extent.height == 0) {
-    extent = window.get_extent();
+    extent = window->get_extent();
     glfwWaitEvents();
   }
-  vkDeviceWaitIdle(device.get_device());
+  swapchain = std::make_unique<SwapChainHandling>(device, extent, requested_pacing);
+  window->reset_resized_flag();
+  target = swapchain.get();
+  MAGE_INFO(swapchain) << " - swap chain creation successful!";
+}
 
-  if (swapchain == nullptr) {
-    swapchain = std::make_unique<SwapChainHandling>(device, extent);
-  } else {
-    std::shared_ptr<SwapChainHandling> oldSwapChain = std::move(swapchain);
-    swapchain = std::make_unique<SwapChainHandling>(device, extent, oldSwapChain);
+// Frames still in flight keep rendering into the old swapchain, it is destroyed by release_retired_swapchains
+void DrawHandling::recreate_swapchain() {
+  MAGE_PROFILE_ZONE("DrawHandling::recreate_swapchain");
+  MAGE_INFO(swapchain) << "Attempting to recreate swapchain...";
+  auto extent = window->get_extent();
+  while (extent.width == 0 || extent.height == 0) {
+    glfwWaitEvents();
+    extent = window->get_extent();
+  }
+  window->reset_resized_flag();
 
-    if (!oldSwapChain->compare_swap_formats(*swapchain.get())) {
-      throw std::runtime_error("Swap chain image(or depth) format has changed!");
-    }
+  std::shared_ptr<SwapChainHandling> previous = std::move(swapchain);
+  swapchain = std::make_unique<SwapChainHandling>(device, extent, previous, requested_pacing);
+  if (!previous->compare_swap_formats(*swapchain.get())) {
+    throw std::runtime_error("Swap chain image(or depth) format has changed!");
   }
-  std::cout << " - swap chain creation successful!" << std::endl;
+  target = swapchain.get();
+  retired_swapchains.push_back({std::move(previous), frame_count});
+  MAGE_INFO(swapchain) << " - swap chain recreation successful! (" << extent.width << "x" << extent.height << ")";
+}
+
+// Frame n waits on the fence of frame n - frames in flight, so once frames in flight more frames have started every
+// submission that used a retired swapchain is done. One frame more leaves room for its last present.
+void DrawHandling::release_retired_swapchains() {
+  uint64_t frames = static_cast<uint64_t>(target->get_max_frames());
+  retired_swapchains.erase(std::remove_if(retired_swapchains.begin(), retired_swapchains.end(), [&](const RetiredSwapchain &retired) {
+    return frame_count >= retired.retire_frame + frames;
+  }), retired_swapchains.end());
 }
 
 VkCommandBuffer DrawHandling::draw_start(){
-  std::cout << "Attempting to acquire next image..." << std::endl;
-  auto result = swapchain->acquire_next_image(&current_image);
+  MAGE_PROFILE_ZONE("DrawHandling::draw_start");
+  if (window != nullptr && window->was_resized()) {
+    recreate_swapchain();
+  }
+  MAGE_TRACE(frame) << "Attempting to acquire next image...";
+  auto result = target->acquire_next_image(&current_image);
+  if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+    // Nothing was acquired and no semaphore signaled, drop this frame and render the next one into the new swapchain
+    MAGE_DEBUG(frame) << "Swap chain out of date on acquire, skipping frame";
+    recreate_swapchain();
+    return VK_NULL_HANDLE;
+  }
   if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
-    std::cerr << "Failed to acquire next image" << std::endl;
+    MAGE_ERROR(frame) << "Failed to acquire next image";
+    exit(EXIT_FAILURE);
   }
+  // Acquire waited on this slot's fence, which may be the last frame a retired swapchain was waiting on
+  release_retired_swapchains();
 
   frame_started = true;
   auto current_command_buffer = get_current_command_buffer();
   VkCommandBufferBeginInfo beginInfo{};
   beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
   if (vkBeginCommandBuffer(current_command_buffer, &beginInfo) != VK_SUCCESS) {
-    std::cerr << "Failed to begin creating command_buffer" << std::endl;
+    MAGE_ERROR(frame) << "Failed to begin creating command_buffer";
+  }
+  gpu_profiler->begin_frame(current_command_buffer, current_frame);
+  if (recorder != nullptr) {
+    recorder->begin_frame(static_cast<uint32_t>(current_frame));
   }
 
   return current_command_buffer;
 }
 
 void DrawHandling::draw_end(){
+  MAGE_PROFILE_ZONE("DrawHandling::draw_end");
   auto current_command_buffer = get_current_command_buffer();
   if (vkEndCommandBuffer(current_command_buffer) != VK_SUCCESS) {
-    std::cerr << "Failed to end command buffer" << std::endl;
+    MAGE_ERROR(frame) << "Failed to end command buffer";
   }
 
-  auto result = swapchain->submit_command_buffers(&current_command_buffer, &current_image);
-  if (result != VK_SUCCESS){
-    std::cerr << "Failed to present image to swap chain";
+  auto result = target->submit_command_buffers(&current_command_buffer, &current_image);
+  // The frame was still submitted and presented as far as the surface allowed, so only the swapchain needs replacing
+  bool stale = result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR;
+  if (result != VK_SUCCESS && !stale){
+    MAGE_ERROR(frame) << "Failed to present image to swap chain";
     exit(EXIT_FAILURE);
   }
 
   frame_started = false;
-  current_frame = (current_frame + 1) % swapchain->get_max_frames();
+  current_frame = (current_frame + 1) % target->get_max_frames();
+  frame_count++;
+  if (stale && window != nullptr) {
+    recreate_swapchain();
+  }
 }
 
 void DrawHandling::swapchain_render_start(VkCommandBuffer current_command_buffer){
+  record_barriers(current_command_buffer, pending_barriers);
+  pending_barriers.clear();
+  render_pass_scope = gpu_profiler->begin_scope(current_command_buffer, "render pass");
+
   VkRenderPassBeginInfo render_pass_info{};
   render_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-  render_pass_info.renderPass = swapchain->get_render_pass();
-  render_pass_info.framebuffer = swapchain->get_framebuffers(current_image);
+  render_pass_info.renderPass = target->get_render_pass();
+  render_pass_info.framebuffer = target->get_framebuffers(current_image);
 
   render_pass_info.renderArea.offset = {0, 0};
-  render_pass_info.renderArea.extent = swapchain->get_swap_extent();
+  render_pass_info.renderArea.extent = target->get_swap_extent();
 
   std::array<VkClearValue, 2> clear_values{};
   clear_values[0].color = {0.2f, 0.2f, 0.2f, 1.0f};
@@ -110,26 +179,61 @@ void DrawHandling::swapchain_render_start(VkCommandBuffer current_command_buffer
   render_pass_info.clearValueCount = static_cast<uint32_t>(clear_values.size());
   render_pass_info.pClearValues = clear_values.data();
 
+  if (recorder != nullptr) {
+    // Secondaries set their own viewport and scissor, nothing else may be recorded into the primary inside the pass
+    recorder->begin_render_pass(render_pass_info.renderPass, render_pass_info.framebuffer, render_pass_info.renderArea.extent);
+    vkCmdBeginRenderPass(current_command_buffer, &render_pass_info, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+    return;
+  }
   vkCmdBeginRenderPass(current_command_buffer, &render_pass_info, VK_SUBPASS_CONTENTS_INLINE);
 
   VkViewport viewport{};
   viewport.x = 0.0f;
   viewport.y = 0.0f;
-  viewport.width = static_cast<float>(swapchain->get_swap_extent().width);
-  viewport.height = static_cast<float>(swapchain->get_swap_extent().height);
+  viewport.width = static_cast<float>(target->get_swap_extent().width);
+  viewport.height = static_cast<float>(target->get_swap_extent().height);
   viewport.minDepth = 0.0f;
   viewport.maxDepth = 1.0f;
-  VkRect2D scissor{{0, 0}, swapchain->get_swap_extent()};
+  VkRect2D scissor{{0, 0}, target->get_swap_extent()};
   vkCmdSetViewport(current_command_buffer, 0, 1, &viewport);
   vkCmdSetScissor(current_command_buffer, 0, 1, &scissor);
 }
 
 void DrawHandling::swapchain_render_end(VkCommandBuffer current_command_buffer){
   vkCmdEndRenderPass(current_command_buffer);
+  gpu_profiler->end_scope(current_command_buffer, render_pass_scope);
+  target->record_after_render(current_command_buffer, current_image);
 }
 
+// One vkCmdPipelineBarrier covering every buffer, its stage masks are the union of the barriers' own
+void DrawHandling::record_barriers(VkCommandBuffer command_buffer, const std::vector<BufferBarrier> &barriers){
+  if (barriers.empty()) {
+    return;
+  }
+  std::vector<VkBufferMemoryBarrier> buffer_barriers(barriers.size());
+  VkPipelineStageFlags src_stages = 0;
+  VkPipelineStageFlags dst_stages = 0;
+  for (size_t i = 0; i < barriers.size(); i++) {
+    VkBufferMemoryBarrier &buffer_barrier = buffer_barriers[i];
+    buffer_barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    buffer_barrier.srcAccessMask = barriers[i].src_access;
+    buffer_barrier.dstAccessMask = barriers[i].dst_access;
+    buffer_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    buffer_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    buffer_barrier.buffer = barriers[i].buffer;
+    buffer_barrier.offset = 0;
+    buffer_barrier.size = VK_WHOLE_SIZE;
+    src_stages |= barriers[i].src_stage;
+    dst_stages |= barriers[i].dst_stage;
+  }
+  vkCmdPipelineBarrier(command_buffer, src_stages, dst_stages, 0, 0, nullptr,
+                       static_cast<uint32_t>(buffer_barriers.size()), buffer_barriers.data(), 0, nullptr);
+}
 
 DrawHandling::~DrawHandling() {
+  retired_swapchains.clear();
+  recorder.reset();
+  gpu_profiler.reset();
 	vkFreeCommandBuffers(device.get_device(), device.get_command_pool(), static_cast<uint32_t>(command_buffer.size()), command_buffer.data());
   command_buffer.clear();
 }
@@ -3,37 +3,83 @@
 #include "../window-resources/window.hpp"
 #include "device.hpp"
 #include "swapchain.hpp"
+#include "offscreen.hpp"
+#include "recorder.hpp"
+#include "../debug-resources/gpu-profiler.hpp"
 #include <vector>
 #include <memory>
 
 namespace mage {
 
+	// Hands a buffer written by one pipeline stage over to the stages that read it next
+	struct BufferBarrier {
+		VkBuffer buffer;
+		VkPipelineStageFlags src_stage;
+		VkAccessFlags src_access;
+		VkPipelineStageFlags dst_stage;
+		VkAccessFlags dst_access;
+	};
+
 	class DrawHandling {
 	private:	
 		std::vector<VkCommandBuffer> command_buffer;
 		int current_frame{0};
 		uint32_t current_image;
 		bool frame_started = false;
+		uint32_t render_pass_scope = GpuProfiler::INVALID_SCOPE;
+		std::vector<BufferBarrier> pending_barriers;
+		// Swapchains replaced by a resize, kept until no frame in flight can still touch their images or framebuffers
+		struct RetiredSwapchain {
+			std::shared_ptr<SwapChainHandling> swapchain;
+			uint64_t retire_frame;
+		};
+		std::vector<RetiredSwapchain> retired_swapchains;
+		// Frames submitted so far, retired swapchains are timed against it
+		uint64_t frame_count = 0;
+		void release_retired_swapchains();
+		// Kept for swapchain recreation, a resize must not change the frame count everything else was sized for
+		FramePacing requested_pacing;
 	public:
-		DrawHandling(Window &window_pass, DeviceHandling &device_pass);
+		DrawHandling(Window &window_pass, DeviceHandling &device_pass, FramePacing pacing = {});
+		DrawHandling(DeviceHandling &device_pass, VkExtent2D extent, OffscreenInfo offscreen_info);
 		~DrawHandling();
-		Window &window;
+		Window *window = nullptr;
 		DeviceHandling &device;
 		std::unique_ptr<SwapChainHandling> swapchain;
+		std::unique_ptr<OffscreenHandling> offscreen;
+		RenderTarget *target = nullptr;
+		std::unique_ptr<GpuProfiler> gpu_profiler;
+		std::unique_ptr<ParallelRecorder> recorder;
 		void create_command_buffer();
+		// With more than one thread the render pass only accepts secondary command buffers, record draws through get_recorder
+		void set_record_threads(uint32_t thread_count);
 		void free_command_buffer();
+		// Returns null when the frame has to be skipped, e.g. the swapchain went out of date and was just recreated
 		VkCommandBuffer draw_start();
 		void draw_end();
 		void swapchain_render_start(VkCommandBuffer current_command_buffer);
 		void swapchain_render_end(VkCommandBuffer current_command_buffer);
+		// Barriers cannot be recorded inside the render pass, so work recorded ahead of it queues the barriers its
+		// results need here and swapchain_render_start issues them all at once before beginning the pass
+		void queue_barrier(const BufferBarrier &barrier) {pending_barriers.push_back(barrier);}
+		static void record_barriers(VkCommandBuffer command_buffer, const std::vector<BufferBarrier> &barriers);
 		void sync_objects();
 		void create_pipeline();
 		void create_swapchain();
+		// Swaps in a swapchain matching the window without waiting for the device, the old one is retired
+		void recreate_swapchain();
 
 		bool is_frame_in_progres() const {return frame_started;}
+		GpuProfiler *get_gpu_profiler() const {return gpu_profiler.get();}
+		ParallelRecorder *get_recorder() const {return recorder.get();}
 		VkCommandBuffer get_current_command_buffer() const {return command_buffer[current_frame];}
-		VkRenderPass get_swapchain_render_pass() const {return swapchain->get_render_pass();}
-		float get_aspect_ratio() const { return (swapchain->get_swap_extent().width / swapchain->get_swap_extent().height);}
+		int get_frame_index() const {return current_frame;}
+		OffscreenHandling *get_offscreen() const {return offscreen.get();}
+		RenderTarget *get_render_target() const {return target;}
+		// Frames in flight, swapchain images and present mode in effect, which may differ from what was requested
+		FramePacing get_frame_pacing() const {return target->get_frame_pacing();}
+		VkRenderPass get_swapchain_render_pass() const {return target->get_render_pass();}
+		float get_aspect_ratio() const { return static_cast<float>(target->get_swap_extent().width) / static_cast<float>(target->get_swap_extent().height);}
 	};
 
 }
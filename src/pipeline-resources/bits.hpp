@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace mage {
+
+	// Index of the highest set bit, value must be non-zero
+	inline uint32_t highest_bit(uint64_t value) {
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_ARM64))
+		unsigned long index;
+		_BitScanReverse64(&index, value);
+		return static_cast<uint32_t>(index);
+#elif defined(_MSC_VER)
+		unsigned long index;
+		if (_BitScanReverse(&index, static_cast<unsigned long>(value >> 32))) {
+			return static_cast<uint32_t>(index) + 32;
+		}
+		_BitScanReverse(&index, static_cast<unsigned long>(value));
+		return static_cast<uint32_t>(index);
+#else
+		return 63 - static_cast<uint32_t>(__builtin_clzll(value));
+#endif
+	}
+
+	// Index of the lowest set bit, value must be non-zero
+	inline uint32_t lowest_bit(uint64_t value) {
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_ARM64))
+		unsigned long index;
+		_BitScanForward64(&index, value);
+		return static_cast<uint32_t>(index);
+#elif defined(_MSC_VER)
+		unsigned long index;
+		if (_BitScanForward(&index, static_cast<unsigned long>(value))) {
+			return static_cast<uint32_t>(index);
+		}
+		_BitScanForward(&index, static_cast<unsigned long>(value >> 32));
+		return static_cast<uint32_t>(index) + 32;
+#else
+		return static_cast<uint32_t>(__builtin_ctzll(value));
+#endif
+	}
+
+}
@@ -1,33 +1,48 @@
 #include "device.hpp"
-#include <iostream>
+#include "../debug-resources/log.hpp"
+#include <stdexcept>
 #include <cstdlib>
 #include <vector>
 #include <unordered_set>
 #include <set>
 #include <limits>
 #include <algorithm>
+#include <cstring>
 
 using namespace mage;
 
 
 const std::vector<const char*> device_extensions = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
 
-DeviceHandling::DeviceHandling(Window &window_pass) : window(window_pass){
-	std::cout << std::endl << "=== DEVICE HANDLING ===" << std::endl;
+DeviceHandling::DeviceHandling(Window &window_pass) : DeviceHandling(&window_pass) {
+}
+
+// A null window runs headless: no GLFW, no surface, no swapchain extension, present queue aliases graphics
+DeviceHandling::DeviceHandling(Window *window_pass) : window(window_pass), headless(window_pass == nullptr) {
+	MAGE_INFO(device) << "=== DEVICE HANDLING ===";
 	init_vulkan_instance();
-	create_surface();
+	if (!headless) {
+		create_surface();
+	}
 	select_hardware();
 	logical_device();
+	memory = std::make_unique<MemoryHandling>(device, card);
+	// MAGE_PIPELINE_CACHE=<file> moves the on-disk pipeline cache, an empty value keeps it in memory only
+	const char *pipeline_cache_path = std::getenv("MAGE_PIPELINE_CACHE");
+	pipeline_cache = std::make_unique<PipelineCacheHandling>(device, card, pipeline_cache_path != nullptr ? pipeline_cache_path : PIPELINE_CACHE_DEFAULT_PATH, creation_feedback_supported);
+	// MAGE_ASSET_ROOT=<dir> loads shaders from outside the working directory
+	const char *asset_root = std::getenv("MAGE_ASSET_ROOT");
+	shaders = std::make_unique<ShaderRegistry>(device, asset_root != nullptr ? asset_root : "");
 	create_command_pool();
-	std:: cout << "=== DEVICE HANDLING SUCCESSFUL ===" << std::endl;
+	MAGE_INFO(device) << "=== DEVICE HANDLING SUCCESSFUL ===";
 }
 
 // Initialize Vulkan library
 void DeviceHandling::init_vulkan_instance(){
-	std::cout << "Attempting to initialize Vulkan instance..." << std::endl;
+	MAGE_INFO(device) << "Attempting to initialize Vulkan instance...";
 
 	// Creating data regarding the application (left pretty blank for now)
-	std::cout << " - creating application info..." << std::endl;
+	MAGE_INFO(device) << " - creating application info...";
 	VkApplicationInfo app_data{};
     app_data.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
     VkInstanceCreateInfo create_info{};
@@ -35,46 +50,44 @@ void DeviceHandling::init_vulkan_instance(){
     create_info.pApplicationInfo = &app_data;
 
     // Ensure glfw extensions are present
-    std::cout << " - ensuring GLFW extensions are present..." << std::endl;
-    uint32_t num_glfw_extensions = 0;
-    const char** glfw_extensions;
-    glfw_extensions = glfwGetRequiredInstanceExtensions(&num_glfw_extensions);
-    create_info.enabledExtensionCount = num_glfw_extensions;
-    create_info.ppEnabledExtensionNames = glfw_extensions;
+    MAGE_INFO(device) << " - ensuring GLFW extensions are present...";
+    auto required_extensions = get_required_extensions();
+    create_info.enabledExtensionCount = static_cast<uint32_t>(required_extensions.size());
+    create_info.ppEnabledExtensionNames = required_extensions.data();
     create_info.enabledLayerCount = 0;
 
     // Attempt to create instance
-    std::cout << " - attempting to create instance..." << std::endl;
+    MAGE_INFO(device) << " - attempting to create instance...";
     if (vkCreateInstance(&create_info, nullptr, &instance) != VK_SUCCESS) {
-	    std::cerr << "failed to create instance";
+	    MAGE_ERROR(device) << "failed to create instance";
 	    exit(EXIT_FAILURE);
 	}
 	check_glfw_extensions();
-	std::cout << " - Vulkan instance creation successful!" << std::endl;
+	MAGE_INFO(device) << " - Vulkan instance creation successful!";
 }
 
 
 // Search and select necessary graphics card from system
 void DeviceHandling::select_hardware(){
-	std::cout << "Attempting to locate physical hardware for graphics calculations..." << std::endl;
+	MAGE_INFO(device) << "Attempting to locate physical hardware for graphics calculations...";
 
-	std::cout << " - searching for any hardware whatsoever..." << std::endl;
+	MAGE_INFO(device) << " - searching for any hardware whatsoever...";
 	uint32_t num_devices = 0;
 	vkEnumeratePhysicalDevices(instance, &num_devices, nullptr);
 	if (num_devices == 0){
-		std::cerr << "Error finding any hardware.\n";
+		MAGE_ERROR(device) << "Error finding any hardware.";
 		exit(EXIT_FAILURE);
 	}
 
 	//This area can be fleshed out in the future to select optimal GPU when multiple are present
-	std::cout << " - selecting optimal device..." << std::endl;
+	MAGE_INFO(device) << " - selecting optimal device...";
 	VkPhysicalDeviceProperties properties;
 	std::vector<VkPhysicalDevice> devices(num_devices);
 	vkEnumeratePhysicalDevices(instance, &num_devices, devices.data());
-	std::cout << "   - found " << num_devices << " device(s)" << std::endl;
+	MAGE_INFO(device) << "   - found " << num_devices << " device(s)";
 	for (const auto& device : devices) {
 		vkGetPhysicalDeviceProperties(device, &properties);
-		std::cout << "     - currently checking " << properties.deviceName << "..." << std::endl;
+		MAGE_INFO(device) << "     - currently checking " << properties.deviceName << "...";
 		if (suitable_device(device)) {
             		card = device;
             		break;
@@ -82,36 +95,36 @@ void DeviceHandling::select_hardware(){
 	}
 
 	if (card == nullptr) {
-	    std::cerr << "Error finding capable hardware.\n";
+	    MAGE_ERROR(device) << "Error finding capable hardware.";
 		exit(EXIT_FAILURE);
 	} 
 
 	vkGetPhysicalDeviceProperties(card, &properties);
-	std::cout << " - selected device: " << properties.deviceName << std::endl;
+	MAGE_INFO(device) << " - selected device: " << properties.deviceName;
 
 }
 
 
 void DeviceHandling::check_glfw_extensions(){
-	std::cout << "   - checking GLFW extensions..." << std::endl;
+	MAGE_INFO(device) << "   - checking GLFW extensions...";
 	uint32_t num_extensions = 0;
 	vkEnumerateInstanceExtensionProperties(nullptr, &num_extensions, nullptr);
 	std::vector<VkExtensionProperties> extensions(num_extensions);
 	vkEnumerateInstanceExtensionProperties(nullptr, &num_extensions, extensions.data());
-	std::cout << "   - available extensions:" << std::endl;
+	MAGE_INFO(device) << "   - available extensions:";
 	std::unordered_set<std::string> list;
 	for (const auto &extension : extensions){
-		std::cout << "     - " << extension.extensionName << std::endl;
+		MAGE_INFO(device) << "     - " << extension.extensionName;
 		list.insert(extension.extensionName);
 	}
 
 	bool quit = false;
-	std::cout << "   - required extensions" << std::endl;
+	MAGE_INFO(device) << "   - required extensions";
 	auto required_extensions = get_required_extensions();
 	for (const auto &required_extension : required_extensions){
-		std::cout << "     - " << required_extension << std::endl;
+		MAGE_INFO(device) << "     - " << required_extension;
 		if (list.find(required_extension) == list.end()) {
-			std::cerr << "Missing required glfw extension: " << required_extension << std::endl;
+			MAGE_ERROR(device) << "Missing required glfw extension: " << required_extension;
 			quit = true;
 		}
 	}
@@ -123,6 +136,9 @@ void DeviceHandling::check_glfw_extensions(){
 
 
 std::vector<const char*> DeviceHandling::get_required_extensions(){
+	if (headless) {
+		return {};
+	}
 	uint32_t num_extensions = 0;
 	const char **glfw_extensions;
 	glfw_extensions = glfwGetRequiredInstanceExtensions(&num_extensions);
@@ -134,6 +150,9 @@ std::vector<const char*> DeviceHandling::get_required_extensions(){
 // Hub for various tests regarding device capabilities
 bool DeviceHandling::suitable_device(VkPhysicalDevice device){
 	QueueIndices indices = find_families(device);
+	if (headless) {
+		return indices.complete();
+	}
 	bool extensions_supported = check_extension_support(device);
 	bool swap_support = false;
 	if (extensions_supported) {
@@ -159,7 +178,22 @@ bool DeviceHandling::check_extension_support(VkPhysicalDevice device) {
 	return extensions_required.empty();
 }
 
-// Find queues supported by selected device
+// Optional extensions are enabled when present and the feature depending on them degrades otherwise
+bool DeviceHandling::supports_extension(VkPhysicalDevice device, const char *extension) {
+	uint32_t extension_count;
+	vkEnumerateDeviceExtensionProperties(device, nullptr, &extension_count, nullptr);
+	std::vector<VkExtensionProperties> extensions_available(extension_count);
+	vkEnumerateDeviceExtensionProperties(device, nullptr, &extension_count, extensions_available.data());
+	for (const auto& available : extensions_available) {
+		if (strcmp(available.extensionName, extension) == 0) {
+			return true;
+		}
+	}
+	return false;
+}
+
+// Find queues supported by selected device. The first graphics and present families win, a transfer family counts as
+// dedicated only without graphics, and one without compute as well is preferred since it usually maps to a DMA engine.
 QueueIndices DeviceHandling::find_families(VkPhysicalDevice device) {
     QueueIndices indices;
 
@@ -169,24 +203,33 @@ QueueIndices DeviceHandling::find_families(VkPhysicalDevice device) {
     std::vector<VkQueueFamilyProperties> families(family_count);
     vkGetPhysicalDeviceQueueFamilyProperties(device, &family_count, families.data());
 
+    bool transfer_only = false;
     int i = 0;
     for (const auto &queue_family : families){
-    	if (queue_family.queueCount > 0 && queue_family.queueFlags & VK_QUEUE_GRAPHICS_BIT) {
+    	if (!indices.graphics_family_has_value && queue_family.queueCount > 0 && queue_family.queueFlags & VK_QUEUE_GRAPHICS_BIT) {
             indices.graphics_family = i;
             indices.graphics_family_has_value = true;
         }
 
         VkBool32 presentSupport = false;
-	vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
+	if (headless) {
+		presentSupport = indices.graphics_family_has_value && indices.graphics_family == static_cast<uint32_t>(i);
+	} else {
+		vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
+	}
 
-	if (queue_family.queueCount > 0 && presentSupport) {
+	if (!indices.present_family_has_value && queue_family.queueCount > 0 && presentSupport) {
 		indices.present_family = i;
 		indices.present_family_has_value = true;
 	}
 
-        if (indices.complete()) {
-            break;
-        }
+	bool transfer_capable = queue_family.queueCount > 0 && (queue_family.queueFlags & VK_QUEUE_TRANSFER_BIT) && !(queue_family.queueFlags & VK_QUEUE_GRAPHICS_BIT);
+	bool without_compute = !(queue_family.queueFlags & VK_QUEUE_COMPUTE_BIT);
+	if (transfer_capable && (!indices.transfer_family_has_value || (without_compute && !transfer_only))) {
+		indices.transfer_family = i;
+		indices.transfer_family_has_value = true;
+		transfer_only = without_compute;
+	}
         i++;
     }
 
@@ -196,13 +239,16 @@ QueueIndices DeviceHandling::find_families(VkPhysicalDevice device) {
 
 // Interfaces physical device with queues
 void DeviceHandling::logical_device(){
-	std::cout << "Attempting to create logical Vulkan device..." << std::endl;
+	MAGE_INFO(device) << "Attempting to create logical Vulkan device...";
 	QueueIndices indices = find_families(card);
 
 	// Handled in a loop to account for multiple possible queues
-	std::cout << " - creating info for info_queue..." << std::endl;
+	MAGE_INFO(device) << " - creating info for info_queue...";
 	std::vector<VkDeviceQueueCreateInfo> create_info_queue{};
 	std::set<uint32_t> unique_queue_families = {indices.graphics_family, indices.present_family};
+	if (indices.dedicated_transfer()) {
+		unique_queue_families.insert(indices.transfer_family);
+	}
     float queue_priority = 1.0f;
     for(uint32_t queue_family : unique_queue_families){
     	VkDeviceQueueCreateInfo create_new_info{};
@@ -213,40 +259,69 @@ void DeviceHandling::logical_device(){
     	create_info_queue.push_back(create_new_info);
     }
 
-    std::cout << " - creating info for device..." << std::endl;
+    MAGE_INFO(device) << " - creating info for device...";
     VkDeviceCreateInfo create_info{};
     create_info.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
     create_info.queueCreateInfoCount = static_cast<uint32_t>(create_info_queue.size());
     create_info.pQueueCreateInfos = create_info_queue.data();
+    // Only what GPU-driven rendering can use is turned on, and only where the card has it
+    VkPhysicalDeviceFeatures supported_features{};
+    vkGetPhysicalDeviceFeatures(card, &supported_features);
+    device_features.multiDrawIndirect = supported_features.multiDrawIndirect;
+    device_features.drawIndirectFirstInstance = supported_features.drawIndirectFirstInstance;
     create_info.pEnabledFeatures = &device_features;
-    create_info.enabledExtensionCount = static_cast<uint32_t>(device_extensions.size());
-    create_info.ppEnabledExtensionNames = device_extensions.data();
+    std::vector<const char*> enabled_extensions;
+    if (!headless) {
+        enabled_extensions = device_extensions;
+    }
+    creation_feedback_supported = supports_extension(card, VK_EXT_PIPELINE_CREATION_FEEDBACK_EXTENSION_NAME);
+    if (creation_feedback_supported) {
+        enabled_extensions.push_back(VK_EXT_PIPELINE_CREATION_FEEDBACK_EXTENSION_NAME);
+    }
+    bool draw_indirect_count_supported = supports_extension(card, VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+    if (draw_indirect_count_supported) {
+        enabled_extensions.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+    }
+    create_info.enabledExtensionCount = static_cast<uint32_t>(enabled_extensions.size());
+    create_info.ppEnabledExtensionNames = enabled_extensions.data();
 
-    std::cout << " - attempting to create device..." << std::endl;
+    MAGE_INFO(device) << " - attempting to create device...";
     if (vkCreateDevice(card, &create_info, nullptr, &device) != VK_SUCCESS) {
         throw std::runtime_error("failed to create logical device!");
     }
 
-    std::cout << " - appending graphics_queue and present_queue..." << std::endl;
+    MAGE_INFO(device) << " - appending graphics_queue and present_queue...";
     vkGetDeviceQueue(device, indices.graphics_family, 0, &graphics_queue);
     vkGetDeviceQueue(device, indices.present_family, 0, &present_queue);
+    if (draw_indirect_count_supported) {
+        draw_indexed_indirect_count = reinterpret_cast<PFN_vkCmdDrawIndexedIndirectCountKHR>(vkGetDeviceProcAddr(device, "vkCmdDrawIndexedIndirectCountKHR"));
+    }
+    MAGE_INFO(device) << " - multi-draw indirect " << (device_features.multiDrawIndirect == VK_TRUE) << ", indirect first instance "
+                      << (device_features.drawIndirectFirstInstance == VK_TRUE) << ", indirect count " << (draw_indexed_indirect_count != nullptr);
+    if (indices.dedicated_transfer()) {
+        MAGE_INFO(device) << " - appending dedicated transfer_queue from family " << indices.transfer_family << "...";
+        vkGetDeviceQueue(device, indices.transfer_family, 0, &transfer_queue);
+    }
 
-    std::cout << " - link between physical card and logical device successful!" << std::endl;
+    MAGE_INFO(device) << " - link between physical card and logical device successful!";
 }
 
 
 // Attempts to create surface to connect Vulkan to window
 // Using GLFW API for maximum cross-platform support
 void DeviceHandling::create_surface() {
-	std::cout << "Attempting to connect Vulkan to window surface..." << std::endl;
-	window.create_surface(instance, &surface);
-	std::cout << " - surface creation successful!" << std::endl;
+	MAGE_INFO(device) << "Attempting to connect Vulkan to window surface...";
+	window->create_surface(instance, &surface);
+	MAGE_INFO(device) << " - surface creation successful!";
 }
 
 
 // Populate SwapChainSupport struct
 SwapChainSupport DeviceHandling::query_support(VkPhysicalDevice device) {
-	SwapChainSupport details;
+	SwapChainSupport details{};
+	if (headless) {
+		return details;
+	}
 
 	uint32_t format_count;
 	vkGetPhysicalDeviceSurfaceCapabilitiesKHR(device, surface, &details.capabilities);
@@ -268,17 +343,17 @@ SwapChainSupport DeviceHandling::query_support(VkPhysicalDevice device) {
 
 
 void DeviceHandling::create_command_pool(){
-	std::cout << "Attempting to create command pool..." << std::endl;
+	MAGE_INFO(device) << "Attempting to create command pool...";
 	QueueIndices indices = find_families(card);
 	VkCommandPoolCreateInfo pool_info{};
 	pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
 	pool_info.queueFamilyIndex = indices.graphics_family;
 	pool_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
 	if (vkCreateCommandPool(device, &pool_info, nullptr, &command_pool) != VK_SUCCESS){
-		std::cerr << "failed to create command pool" << std::endl;
+		MAGE_ERROR(device) << "failed to create command pool";
 		exit(EXIT_FAILURE);
 	}
-	std::cout << " - create pool creation successful!" << std::endl;
+	MAGE_INFO(device) << " - create pool creation successful!";
 
 }
 
@@ -298,25 +373,17 @@ VkFormat DeviceHandling::find_supported_format(const std::vector<VkFormat> &cand
 }
 
 uint32_t DeviceHandling::find_memory_type(uint32_t typeFilter, VkMemoryPropertyFlags properties) {
-  VkPhysicalDeviceMemoryProperties memProperties;
-  vkGetPhysicalDeviceMemoryProperties(card, &memProperties);
-  for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
-    if ((typeFilter & (1 << i)) &&
-        (memProperties.memoryTypes[i].propertyFlags & properties) == properties) {
-      return i;
-    }
-  }
-
-  throw std::runtime_error("failed to find suitable memory type!");
+  return memory->find_memory_type(typeFilter, properties);
 }
 
 
+// Buffers are sub-allocated from MemoryHandling's blocks, host-visible ones come back already mapped
 void DeviceHandling::create_buffer(
     VkDeviceSize size,
     VkBufferUsageFlags usage,
     VkMemoryPropertyFlags properties,
     VkBuffer &buffer,
-    VkDeviceMemory &bufferMemory) {
+    MemoryAllocation &allocation) {
   VkBufferCreateInfo bufferInfo{};
   bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
   bufferInfo.size = size;
@@ -329,23 +396,195 @@ void DeviceHandling::create_buffer(
 
   VkMemoryRequirements memRequirements;
   vkGetBufferMemoryRequirements(device, buffer, &memRequirements);
+  allocation = memory->allocate(memRequirements, properties, MemoryUsage::linear);
 
-  VkMemoryAllocateInfo allocInfo{};
-  allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-  allocInfo.allocationSize = memRequirements.size;
-  allocInfo.memoryTypeIndex = find_memory_type(memRequirements.memoryTypeBits, properties);
+  if (vkBindBufferMemory(device, buffer, allocation.memory, allocation.offset) != VK_SUCCESS) {
+    throw std::runtime_error("failed to bind vertex buffer memory!");
+  }
+}
+
+void DeviceHandling::destroy_buffer(VkBuffer &buffer, MemoryAllocation &allocation) {
+  if (buffer != VK_NULL_HANDLE) {
+    vkDestroyBuffer(device, buffer, nullptr);
+    buffer = VK_NULL_HANDLE;
+  }
+  memory->free(allocation);
+}
 
-  if (vkAllocateMemory(device, &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS) {
-    throw std::runtime_error("failed to allocate vertex buffer memory!");
+// Large images (full-screen attachments and up) get a dedicated allocation instead of pinning a whole block
+void DeviceHandling::create_image(const VkImageCreateInfo &image_info, VkMemoryPropertyFlags properties, VkImage &image, MemoryAllocation &allocation) {
+  MAGE_INFO(device) << "   - creating image....";
+  if (vkCreateImage(device, &image_info, nullptr, &image) != VK_SUCCESS) {
+    MAGE_ERROR(device) << "Failed to create image";
+  	exit(EXIT_FAILURE);
   }
 
-  vkBindBufferMemory(device, buffer, bufferMemory, 0);
+  MAGE_INFO(device) << "   - finding memory requirements and allocating space...";
+  VkMemoryRequirements memory_requirements;
+  vkGetImageMemoryRequirements(device, image, &memory_requirements);
+  MemoryUsage usage = image_info.tiling == VK_IMAGE_TILING_OPTIMAL ? MemoryUsage::optimal_image : MemoryUsage::linear;
+  allocation = memory->allocate(memory_requirements, properties, usage, memory->wants_dedicated_image(memory_requirements));
+
+  if (vkBindImageMemory(device, image, allocation.memory, allocation.offset) != VK_SUCCESS) {
+    MAGE_ERROR(device) << "Failed to bind image memory";
+  	exit(EXIT_FAILURE);
+  }
+
+  MAGE_INFO(device) << "   - image creation and memory allocation successful!";
 }
 
-// Free resources after closed window
+void DeviceHandling::destroy_image(VkImage &image, MemoryAllocation &allocation) {
+  if (image != VK_NULL_HANDLE) {
+    vkDestroyImage(device, image, nullptr);
+    image = VK_NULL_HANDLE;
+  }
+  memory->free(allocation);
+}
+
+// One-shot command buffer on the graphics queue, end_single_time_commands submits it and waits on its own fence
+VkCommandBuffer DeviceHandling::begin_single_time_commands() {
+  VkCommandBufferAllocateInfo allocate_info{};
+  allocate_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+  allocate_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  allocate_info.commandPool = command_pool;
+  allocate_info.commandBufferCount = 1;
+
+  VkCommandBuffer command_buffer;
+  if (vkAllocateCommandBuffers(device, &allocate_info, &command_buffer) != VK_SUCCESS) {
+    MAGE_ERROR(device) << "Failed to allocate single time command buffer";
+    exit(EXIT_FAILURE);
+  }
+
+  VkCommandBufferBeginInfo begin_info{};
+  begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  vkBeginCommandBuffer(command_buffer, &begin_info);
+  return command_buffer;
+}
+
+void DeviceHandling::end_single_time_commands(VkCommandBuffer command_buffer) {
+  vkEndCommandBuffer(command_buffer);
+
+  VkFenceCreateInfo fence_info{};
+  fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+  VkFence fence;
+  if (vkCreateFence(device, &fence_info, nullptr, &fence) != VK_SUCCESS) {
+    MAGE_ERROR(device) << "Failed to create single time command fence";
+    exit(EXIT_FAILURE);
+  }
+
+  VkSubmitInfo submit_info{};
+  submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  submit_info.commandBufferCount = 1;
+  submit_info.pCommandBuffers = &command_buffer;
+  if (vkQueueSubmit(graphics_queue, 1, &submit_info, fence) != VK_SUCCESS) {
+    MAGE_ERROR(device) << "Failed to submit single time commands";
+    exit(EXIT_FAILURE);
+  }
+  vkWaitForFences(device, 1, &fence, VK_TRUE, std::numeric_limits<uint64_t>::max());
+
+  vkDestroyFence(device, fence, nullptr);
+  vkFreeCommandBuffers(device, command_pool, 1, &command_buffer);
+}
+
+void DeviceHandling::copy_buffer(VkBuffer source, VkBuffer destination, VkDeviceSize size) {
+  VkCommandBuffer command_buffer = begin_single_time_commands();
+  copy_buffers(command_buffer, source, {{destination, {0, 0, size}}});
+  end_single_time_commands(command_buffer);
+}
+
+// Records every copy out of one source buffer, then makes the results visible to any later vertex/index/shader read,
+// or to a later copy out of the destination
+void DeviceHandling::copy_buffers(VkCommandBuffer command_buffer, VkBuffer source, const std::vector<StagedCopy> &copies) {
+  for (const auto &copy : copies) {
+    vkCmdCopyBuffer(command_buffer, source, copy.destination, 1, &copy.region);
+  }
+
+  VkMemoryBarrier barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_UNIFORM_READ_BIT | VK_ACCESS_SHADER_READ_BIT
+                          | VK_ACCESS_TRANSFER_READ_BIT;
+  vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT
+                       | VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+// Uploads issued between begin/end_upload_batch share one submission and one fence. Batches nest.
+void DeviceHandling::begin_upload_batch() {
+  upload_batch_depth++;
+}
+
+void DeviceHandling::end_upload_batch() {
+  if (upload_batch_depth > 0 && --upload_batch_depth == 0) {
+    flush_uploads();
+  }
+}
+
+// Copies data into the staging buffer and queues the device-side copy. Outside a batch the copy happens right away.
+void DeviceHandling::upload_buffer(VkBuffer destination, const void *data, VkDeviceSize size, VkDeviceSize destination_offset) {
+  // Keep every staged region 16 byte aligned, which covers any vertex or index format
+  VkDeviceSize aligned_offset = (staging_offset + 15) & ~static_cast<VkDeviceSize>(15);
+  if (aligned_offset + size > staging_capacity) {
+    flush_uploads();
+    reserve_staging(size);
+    aligned_offset = 0;
+  }
+  memcpy(static_cast<char*>(staging_allocation.mapped) + aligned_offset, data, static_cast<size_t>(size));
+  staged_copies.push_back({destination, {aligned_offset, destination_offset, size}});
+  staging_offset = aligned_offset + size;
+
+  if (upload_batch_depth == 0) {
+    flush_uploads();
+  }
+}
+
+// Submits every queued copy at once and waits, after which the whole staging buffer is free again
+void DeviceHandling::flush_uploads() {
+  if (staged_copies.empty()) {
+    return;
+  }
+  MAGE_DEBUG(device) << " - flushing " << static_cast<uint64_t>(staged_copies.size()) << " staged upload(s), " << staging_offset << " byte(s)...";
+  VkCommandBuffer command_buffer = begin_single_time_commands();
+  copy_buffers(command_buffer, staging_buffer, staged_copies);
+  end_single_time_commands(command_buffer);
+  staged_copies.clear();
+  staging_offset = 0;
+}
+
+// The staging buffer is reused across uploads and only replaced when a single upload doesn't fit
+void DeviceHandling::reserve_staging(VkDeviceSize size) {
+  if (size <= staging_capacity) {
+    return;
+  }
+  destroy_staging();
+  staging_capacity = std::max(size, STAGING_DEFAULT_SIZE);
+  MAGE_DEBUG(device) << " - creating " << staging_capacity << " byte staging buffer...";
+  create_buffer(
+    staging_capacity,
+    VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+    staging_buffer,
+    staging_allocation);
+}
+
+void DeviceHandling::destroy_staging() {
+  destroy_buffer(staging_buffer, staging_allocation);
+  staging_capacity = 0;
+}
+
+// Free resources after closed window, children before the device and the device before the instance
 DeviceHandling::~DeviceHandling(){
-	vkDestroyInstance(instance, nullptr);
-	vkDestroyDevice(device, nullptr);
-	vkDestroySurfaceKHR(instance, surface, nullptr);
+	flush_uploads();
+	destroy_staging();
+	shaders.reset();
+	pipeline_cache.reset();
+	memory.reset();
 	vkDestroyCommandPool(device, command_pool, nullptr);
+	vkDestroyDevice(device, nullptr);
+	if (surface != VK_NULL_HANDLE) {
+		vkDestroySurfaceKHR(instance, surface, nullptr);
+	}
+	vkDestroyInstance(instance, nullptr);
 }
@@ -1,17 +1,25 @@
 #pragma once
 
 #include "../window-resources/window.hpp"
+#include "memory.hpp"
+#include "pipeline-cache.hpp"
+#include "shader-registry.hpp"
+#include <memory>
 #include <string>
 #include <vector>
 
 namespace mage {
 
+	// The transfer family is only set when the device has one without graphics, uploads otherwise go through graphics
 	struct QueueIndices {
 	    uint32_t graphics_family;
 	    uint32_t present_family;
-	    std::optional<bool> graphics_family_has_value = false;
-	    std::optional<bool> present_family_has_value = false;
+	    uint32_t transfer_family;
+	    bool graphics_family_has_value = false;
+	    bool present_family_has_value = false;
+	    bool transfer_family_has_value = false;
 	    bool complete() {return graphics_family_has_value && present_family_has_value;}
+	    bool dedicated_transfer() const {return transfer_family_has_value;}
 	};
 
 	struct SwapChainSupport {
@@ -20,20 +28,44 @@ namespace mage {
 		std::vector<VkPresentModeKHR> present_modes;
 	};
 
+	// Copy queued from the staging buffer into a device-local destination
+	struct StagedCopy {
+		VkBuffer destination;
+		VkBufferCopy region;
+	};
+
 	class DeviceHandling {
 	private:
-		Window& window;
+		static constexpr const char *PIPELINE_CACHE_DEFAULT_PATH = "mage-pipeline-cache.bin";
+		static constexpr VkDeviceSize STAGING_DEFAULT_SIZE = 16 * 1024 * 1024;
+		Window* window;
+		bool headless;
 		VkInstance instance;
 		VkPhysicalDevice card = VK_NULL_HANDLE;
 		VkDevice device;
 		VkQueue graphics_queue;
-		VkSurfaceKHR surface;
+		VkSurfaceKHR surface = VK_NULL_HANDLE;
 		VkQueue present_queue;
+		VkQueue transfer_queue = VK_NULL_HANDLE;
 		VkSwapchainKHR swap_chain;
 		VkPhysicalDeviceFeatures device_features{};
+		bool creation_feedback_supported = false;
+		PFN_vkCmdDrawIndexedIndirectCountKHR draw_indexed_indirect_count = nullptr;
 		VkCommandPool command_pool;
+		std::unique_ptr<MemoryHandling> memory;
+		std::unique_ptr<PipelineCacheHandling> pipeline_cache;
+		std::unique_ptr<ShaderRegistry> shaders;
+		VkBuffer staging_buffer = VK_NULL_HANDLE;
+		MemoryAllocation staging_allocation{};
+		VkDeviceSize staging_capacity = 0;
+		VkDeviceSize staging_offset = 0;
+		std::vector<StagedCopy> staged_copies;
+		uint32_t upload_batch_depth = 0;
+		void reserve_staging(VkDeviceSize size);
+		void destroy_staging();
 	public:
 		DeviceHandling(Window &window_pass);
+		DeviceHandling(Window *window_pass);
 		~DeviceHandling();
 		void init_vulkan_instance();
 		void select_hardware();
@@ -42,6 +74,7 @@ namespace mage {
 		void logical_device();
 		void create_surface();
 		bool check_extension_support(VkPhysicalDevice);	
+		bool supports_extension(VkPhysicalDevice, const char *extension);
 		SwapChainSupport query_support(VkPhysicalDevice);
 		void create_swap_chain();
 		VkSurfaceFormatKHR choose_swap_format(const std::vector<VkSurfaceFormatKHR>&);
@@ -58,16 +91,38 @@ namespace mage {
 		    VkBufferUsageFlags usage,
 		    VkMemoryPropertyFlags properties,
 		    VkBuffer &buffer,
-		    VkDeviceMemory &bufferMemory);
+		    MemoryAllocation &allocation);
+		void destroy_buffer(VkBuffer &buffer, MemoryAllocation &allocation);
+		void create_image(const VkImageCreateInfo &image_info, VkMemoryPropertyFlags properties, VkImage &image, MemoryAllocation &allocation);
+		void destroy_image(VkImage &image, MemoryAllocation &allocation);
+		VkCommandBuffer begin_single_time_commands();
+		void end_single_time_commands(VkCommandBuffer command_buffer);
+		void copy_buffer(VkBuffer source, VkBuffer destination, VkDeviceSize size);
+		void copy_buffers(VkCommandBuffer command_buffer, VkBuffer source, const std::vector<StagedCopy> &copies);
+		void begin_upload_batch();
+		void upload_buffer(VkBuffer destination, const void *data, VkDeviceSize size, VkDeviceSize destination_offset = 0);
+		void end_upload_batch();
+		void flush_uploads();
 
+		MemoryHandling &get_memory(){return *memory;}
+		PipelineCacheHandling &get_pipeline_cache(){return *pipeline_cache;}
+		ShaderRegistry &get_shaders(){return *shaders;}
 		VkCommandPool get_command_pool(){return command_pool;}
 		VkQueue get_graphics_queue(){return graphics_queue;}
 		VkQueue get_present_queue(){return present_queue;}
+		// Null when the device has no dedicated transfer family
+		VkQueue get_transfer_queue(){return transfer_queue;}
 		SwapChainSupport get_swap_chain_support(){return query_support(card);}
 		QueueIndices get_queue_families(){return find_families(card);}
 		VkSurfaceKHR get_surface(){return surface;}
 		VkPhysicalDevice get_card(){return card;}
 		VkDevice get_device(){return device;}
+		bool is_headless() const {return headless;}
+		// Indirect draws may start past instance zero, GPU-driven rendering depends on it
+		bool supports_indirect_first_instance() const {return device_features.drawIndirectFirstInstance == VK_TRUE;}
+		bool supports_multi_draw_indirect() const {return device_features.multiDrawIndirect == VK_TRUE;}
+		// Null unless VK_KHR_draw_indirect_count is available
+		PFN_vkCmdDrawIndexedIndirectCountKHR get_draw_indexed_indirect_count() const {return draw_indexed_indirect_count;}
 	};
 
 }
@@ -0,0 +1,82 @@
+#include "frame-pacing.hpp"
+
+#include <algorithm>
+
+using namespace mage;
+
+FramePacing FramePacing::low_latency() {
+	FramePacing pacing{};
+	pacing.frames_in_flight = 1;
+	pacing.image_count = 1;
+	pacing.present_mode = PresentMode::mailbox;
+	return pacing;
+}
+
+FramePacing FramePacing::max_throughput() {
+	FramePacing pacing{};
+	pacing.frames_in_flight = 3;
+	pacing.image_count = 3;
+	pacing.present_mode = PresentMode::immediate;
+	return pacing;
+}
+
+bool FramePacing::from_profile(const std::string &name, FramePacing &pacing) {
+	if (name == "low-latency") {
+		pacing = low_latency();
+		return true;
+	}
+	if (name == "max-throughput") {
+		pacing = max_throughput();
+		return true;
+	}
+	return false;
+}
+
+bool mage::parse_present_mode(const std::string &name, PresentMode &mode) {
+	for (PresentMode candidate : {PresentMode::fifo, PresentMode::fifo_relaxed, PresentMode::mailbox, PresentMode::immediate}) {
+		if (name == present_mode_name(candidate)) {
+			mode = candidate;
+			return true;
+		}
+	}
+	return false;
+}
+
+const char *mage::present_mode_name(PresentMode mode) {
+	switch (mode) {
+		case PresentMode::fifo: return "fifo";
+		case PresentMode::fifo_relaxed: return "fifo-relaxed";
+		case PresentMode::mailbox: return "mailbox";
+		case PresentMode::immediate: return "immediate";
+	}
+	return "fifo";
+}
+
+VkPresentModeKHR mage::to_vulkan(PresentMode mode) {
+	switch (mode) {
+		case PresentMode::fifo: return VK_PRESENT_MODE_FIFO_KHR;
+		case PresentMode::fifo_relaxed: return VK_PRESENT_MODE_FIFO_RELAXED_KHR;
+		case PresentMode::mailbox: return VK_PRESENT_MODE_MAILBOX_KHR;
+		case PresentMode::immediate: return VK_PRESENT_MODE_IMMEDIATE_KHR;
+	}
+	return VK_PRESENT_MODE_FIFO_KHR;
+}
+
+// Immediate falls back to the other modes that don't block on vertical blank before giving in to vsync.
+// Mailbox falls straight back to FIFO, since both immediate and FIFO relaxed tear and a profile that asked for no
+// tearing keeps that.
+PresentMode mage::choose_present_mode(PresentMode requested, const std::vector<VkPresentModeKHR> &available) {
+	std::vector<PresentMode> chain;
+	switch (requested) {
+		case PresentMode::immediate: chain = {PresentMode::immediate, PresentMode::mailbox, PresentMode::fifo_relaxed}; break;
+		case PresentMode::mailbox: chain = {PresentMode::mailbox}; break;
+		case PresentMode::fifo_relaxed: chain = {PresentMode::fifo_relaxed}; break;
+		case PresentMode::fifo: break;
+	}
+	for (PresentMode mode : chain) {
+		if (std::find(available.begin(), available.end(), to_vulkan(mode)) != available.end()) {
+			return mode;
+		}
+	}
+	return PresentMode::fifo;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace mage {
+
+	enum class PresentMode : uint8_t {fifo, fifo_relaxed, mailbox, immediate};
+
+	// How far the CPU may run ahead of the GPU, how many images the swapchain holds and how they reach the screen.
+	// Chosen at startup and handed to DrawHandling; the render target reports back what it actually got.
+	struct FramePacing {
+		static constexpr uint32_t MIN_FRAMES_IN_FLIGHT = 1;
+		static constexpr uint32_t MAX_FRAMES_IN_FLIGHT = 4;
+		uint32_t frames_in_flight = 2;
+		// 0 asks for one more than the surface's minimum, anything else is clamped to what the surface allows
+		uint32_t image_count = 0;
+		PresentMode present_mode = PresentMode::mailbox;
+
+		// One frame in flight so input is read right before the GPU needs it, the fewest images the surface allows,
+		// and mailbox so a finished frame never queues behind an older one
+		static FramePacing low_latency();
+		// Three frames in flight and immediate present, nothing waits for vertical blank
+		static FramePacing max_throughput();
+		// "low-latency" or "max-throughput", false for anything else
+		static bool from_profile(const std::string &name, FramePacing &pacing);
+	};
+
+	// "fifo", "fifo-relaxed", "mailbox" or "immediate"
+	bool parse_present_mode(const std::string &name, PresentMode &mode);
+	const char *present_mode_name(PresentMode mode);
+	VkPresentModeKHR to_vulkan(PresentMode mode);
+	// requested when the surface has it, otherwise the closest mode it has. Every surface supports FIFO, where all chains end.
+	PresentMode choose_present_mode(PresentMode requested, const std::vector<VkPresentModeKHR> &available);
+
+}
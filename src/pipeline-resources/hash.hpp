@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace mage {
+
+	// FNV-1a over raw bytes, used to identify file contents rather than for hash tables
+	inline uint64_t hash_bytes(const void *data, size_t size) {
+		const unsigned char *bytes = static_cast<const unsigned char*>(data);
+		uint64_t hash = 14695981039346656037ull;
+		for (size_t i = 0; i < size; i++) {
+			hash ^= bytes[i];
+			hash *= 1099511628211ull;
+		}
+		return hash;
+	}
+
+}
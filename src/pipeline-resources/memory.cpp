@@ -0,0 +1,406 @@
+#include "memory.hpp"
+#include "bits.hpp"
+#include "../debug-resources/log.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+
+using namespace mage;
+
+namespace {
+
+	VkDeviceSize align_up(VkDeviceSize value, VkDeviceSize alignment) {
+		return (value + alignment - 1) / alignment * alignment;
+	}
+
+}
+
+MemoryBlock::MemoryBlock(VkDeviceMemory memory_pass, VkDeviceSize size_pass, void *mapped_pass, uint32_t pool_pass)
+	: memory{memory_pass}, size{size_pass}, mapped{mapped_pass}, pool{pool_pass} {
+	for (auto &heads : free_heads) {
+		std::fill(std::begin(heads), std::end(heads), NONE);
+	}
+	uint32_t whole = new_node();
+	nodes[whole] = {0, size, NONE, NONE, NONE, NONE, true};
+	insert_free(whole);
+}
+
+// Sizes below SMALL_SIZE share the first level in 16 byte steps, larger sizes get 16 subdivisions per power of two
+void MemoryBlock::mapping(VkDeviceSize size, uint32_t &fl, uint32_t &sl) {
+	if (size < SMALL_SIZE) {
+		fl = 0;
+		sl = static_cast<uint32_t>(size / (SMALL_SIZE / SL_COUNT));
+		return;
+	}
+	uint32_t bit = highest_bit(size);
+	fl = bit - SMALL_SHIFT + 1;
+	sl = static_cast<uint32_t>(size >> (bit - SL_BITS)) ^ SL_COUNT;
+}
+
+uint32_t MemoryBlock::new_node() {
+	if (!unused_nodes.empty()) {
+		uint32_t node = unused_nodes.back();
+		unused_nodes.pop_back();
+		return node;
+	}
+	nodes.push_back({});
+	return static_cast<uint32_t>(nodes.size() - 1);
+}
+
+void MemoryBlock::insert_free(uint32_t node) {
+	uint32_t fl, sl;
+	mapping(nodes[node].size, fl, sl);
+	uint32_t head = free_heads[fl][sl];
+	nodes[node].free = true;
+	nodes[node].prev_free = NONE;
+	nodes[node].next_free = head;
+	if (head != NONE) {
+		nodes[head].prev_free = node;
+	}
+	free_heads[fl][sl] = node;
+	fl_bitmap |= uint64_t{1} << fl;
+	sl_bitmap[fl] |= 1u << sl;
+}
+
+void MemoryBlock::remove_free(uint32_t node) {
+	uint32_t fl, sl;
+	mapping(nodes[node].size, fl, sl);
+	Node &current = nodes[node];
+	if (current.prev_free != NONE) {
+		nodes[current.prev_free].next_free = current.next_free;
+	} else {
+		free_heads[fl][sl] = current.next_free;
+	}
+	if (current.next_free != NONE) {
+		nodes[current.next_free].prev_free = current.prev_free;
+	}
+	if (free_heads[fl][sl] == NONE) {
+		sl_bitmap[fl] &= ~(1u << sl);
+		if (sl_bitmap[fl] == 0) {
+			fl_bitmap &= ~(uint64_t{1} << fl);
+		}
+	}
+	current.free = false;
+}
+
+// Rounds the request up to the next list boundary so the head of whichever list is found always fits
+uint32_t MemoryBlock::find_free(VkDeviceSize request) {
+	if (request < SMALL_SIZE) {
+		request = align_up(request, SMALL_SIZE / SL_COUNT);
+	} else {
+		request += (VkDeviceSize{1} << (highest_bit(request) - SL_BITS)) - 1;
+	}
+	uint32_t fl, sl;
+	mapping(request, fl, sl);
+	if (fl >= FL_COUNT) {
+		return NONE;
+	}
+
+	uint32_t sl_map = sl < SL_COUNT ? sl_bitmap[fl] & (~0u << sl) : 0;
+	if (sl_map == 0) {
+		uint64_t fl_map = fl + 1 < 64 ? fl_bitmap & (~uint64_t{0} << (fl + 1)) : 0;
+		if (fl_map == 0) {
+			return NONE;
+		}
+		fl = lowest_bit(fl_map);
+		sl_map = sl_bitmap[fl];
+	}
+	return free_heads[fl][lowest_bit(sl_map)];
+}
+
+// Cuts the tail past `keep` bytes off into a new free node, returns it
+uint32_t MemoryBlock::split(uint32_t node, VkDeviceSize keep) {
+	uint32_t tail = new_node();
+	Node &current = nodes[node];
+	nodes[tail] = {current.offset + keep, current.size - keep, node, current.next_physical, NONE, NONE, true};
+	if (current.next_physical != NONE) {
+		nodes[current.next_physical].prev_physical = tail;
+	}
+	current.next_physical = tail;
+	current.size = keep;
+	return tail;
+}
+
+bool MemoryBlock::allocate(VkDeviceSize request, VkDeviceSize alignment, uint32_t &node, VkDeviceSize &offset) {
+	alignment = std::max<VkDeviceSize>(alignment, 1);
+	uint32_t found = find_free(request + alignment - 1);
+	if (found == NONE) {
+		return false;
+	}
+	remove_free(found);
+
+	// Padding in front of the aligned offset becomes its own free range. The node before a free node is
+	// never free itself, so there is nothing to merge it with.
+	VkDeviceSize padding = align_up(nodes[found].offset, alignment) - nodes[found].offset;
+	if (padding > 0) {
+		uint32_t aligned = split(found, padding);
+		nodes[aligned].free = false;
+		insert_free(found);
+		found = aligned;
+	}
+	if (nodes[found].size - request >= MIN_SPLIT) {
+		insert_free(split(found, request));
+	}
+
+	nodes[found].free = false;
+	used_bytes += nodes[found].size;
+	allocation_count++;
+	node = found;
+	offset = nodes[found].offset;
+	return true;
+}
+
+void MemoryBlock::free(uint32_t node) {
+	used_bytes -= nodes[node].size;
+	allocation_count--;
+
+	uint32_t previous = nodes[node].prev_physical;
+	if (previous != NONE && nodes[previous].free) {
+		remove_free(previous);
+		nodes[previous].size += nodes[node].size;
+		nodes[previous].next_physical = nodes[node].next_physical;
+		if (nodes[node].next_physical != NONE) {
+			nodes[nodes[node].next_physical].prev_physical = previous;
+		}
+		unused_nodes.push_back(node);
+		node = previous;
+	}
+	uint32_t next = nodes[node].next_physical;
+	if (next != NONE && nodes[next].free) {
+		remove_free(next);
+		nodes[node].size += nodes[next].size;
+		nodes[node].next_physical = nodes[next].next_physical;
+		if (nodes[next].next_physical != NONE) {
+			nodes[nodes[next].next_physical].prev_physical = node;
+		}
+		unused_nodes.push_back(next);
+	}
+	insert_free(node);
+}
+
+// Only the highest non-empty list can hold the largest range, so only that list is walked
+VkDeviceSize MemoryBlock::largest_free() const {
+	if (fl_bitmap == 0) {
+		return 0;
+	}
+	uint32_t fl = highest_bit(fl_bitmap);
+	uint32_t sl = highest_bit(sl_bitmap[fl]);
+	VkDeviceSize largest = 0;
+	for (uint32_t node = free_heads[fl][sl]; node != NONE; node = nodes[node].next_free) {
+		largest = std::max(largest, nodes[node].size);
+	}
+	return largest;
+}
+
+MemoryHandling::MemoryHandling(VkDevice device_pass, VkPhysicalDevice card) : device{device_pass} {
+	MAGE_INFO(device) << "Attempting to create memory allocator...";
+	vkGetPhysicalDeviceMemoryProperties(card, &memory_properties);
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(card, &properties);
+	buffer_image_granularity = properties.limits.bufferImageGranularity;
+	max_allocation_count = properties.limits.maxMemoryAllocationCount;
+
+	// Two pools per memory type, linear resources and optimal images
+	pools.resize(memory_properties.memoryTypeCount * 2);
+	dedicated_bytes.resize(memory_properties.memoryHeapCount, 0);
+	dedicated_counts.resize(memory_properties.memoryHeapCount, 0);
+	MAGE_INFO(device) << " - " << memory_properties.memoryTypeCount << " memory type(s), bufferImageGranularity " << buffer_image_granularity;
+}
+
+// 64 MiB on large heaps, an eighth of the heap on small ones (integrated GPUs, host-visible BAR windows)
+VkDeviceSize MemoryHandling::block_size(uint32_t memory_type) const {
+	VkDeviceSize heap_size = memory_properties.memoryHeaps[memory_properties.memoryTypes[memory_type].heapIndex].size;
+	if (heap_size >= LARGE_HEAP_SIZE) {
+		return LARGE_HEAP_BLOCK_SIZE;
+	}
+	return align_up(std::max<VkDeviceSize>(heap_size / 8, 1), 32);
+}
+
+uint32_t MemoryHandling::find_memory_type(uint32_t type_filter, VkMemoryPropertyFlags properties) const {
+	for (uint32_t i = 0; i < memory_properties.memoryTypeCount; i++) {
+		if ((type_filter & (1u << i)) && (memory_properties.memoryTypes[i].propertyFlags & properties) == properties) {
+			return i;
+		}
+	}
+	MAGE_ERROR(device) << "Failed to find a suitable memory type";
+	exit(EXIT_FAILURE);
+}
+
+bool MemoryHandling::allocate_device_memory(VkDeviceSize size, uint32_t memory_type, VkDeviceMemory &memory, void **mapped) {
+	if (device_allocation_count >= max_allocation_count) {
+		MAGE_ERROR(device) << "Reached maxMemoryAllocationCount (" << max_allocation_count << ")";
+		return false;
+	}
+	VkMemoryAllocateInfo allocate_info{};
+	allocate_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocate_info.allocationSize = size;
+	allocate_info.memoryTypeIndex = memory_type;
+	if (vkAllocateMemory(device, &allocate_info, nullptr, &memory) != VK_SUCCESS) {
+		return false;
+	}
+	device_allocation_count++;
+
+	*mapped = nullptr;
+	if (memory_properties.memoryTypes[memory_type].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+		if (vkMapMemory(device, memory, 0, VK_WHOLE_SIZE, 0, mapped) != VK_SUCCESS) {
+			MAGE_ERROR(device) << "Failed to map host-visible memory";
+			exit(EXIT_FAILURE);
+		}
+	}
+	return true;
+}
+
+void MemoryHandling::free_device_memory(VkDeviceMemory memory, bool mapped) {
+	if (mapped) {
+		vkUnmapMemory(device, memory);
+	}
+	vkFreeMemory(device, memory, nullptr);
+	device_allocation_count--;
+}
+
+// Anything at least half a block (or flagged dedicated) gets its own VkDeviceMemory, the rest is sub-allocated
+MemoryAllocation MemoryHandling::allocate(const VkMemoryRequirements &requirements, VkMemoryPropertyFlags properties, MemoryUsage usage, bool dedicated) {
+	uint32_t memory_type = find_memory_type(requirements.memoryTypeBits, properties);
+	uint32_t heap = memory_properties.memoryTypes[memory_type].heapIndex;
+	VkDeviceSize pool_block_size = block_size(memory_type);
+	std::lock_guard<std::mutex> lock(memory_mutex);
+
+	MemoryAllocation allocation{};
+	allocation.memory_type = memory_type;
+	allocation.size = requirements.size;
+	if (!dedicated && requirements.size < pool_block_size / 2) {
+		// Optimal images only get their own pool when granularity could make them alias a neighbouring buffer's page
+		bool separate_images = usage == MemoryUsage::optimal_image && buffer_image_granularity > 1;
+		uint32_t pool_index = memory_type * 2 + (separate_images ? 1 : 0);
+		auto &pool = pools[pool_index];
+		for (auto &block : pool) {
+			if (block->allocate(requirements.size, requirements.alignment, allocation.node, allocation.offset)) {
+				allocation.block = block.get();
+				break;
+			}
+		}
+
+		if (allocation.block == nullptr) {
+			VkDeviceMemory memory;
+			void *mapped;
+			if (!allocate_device_memory(pool_block_size, memory_type, memory, &mapped)) {
+				MAGE_ERROR(device) << "Failed to allocate a " << pool_block_size << " byte memory block";
+				exit(EXIT_FAILURE);
+			}
+			MAGE_DEBUG(device) << " - new " << pool_block_size << " byte block for memory type " << memory_type;
+			pool.push_back(std::make_unique<MemoryBlock>(memory, pool_block_size, mapped, pool_index));
+			// A large alignment can keep even an empty block from fitting the request, the block stays for later ones
+			if (pool.back()->allocate(requirements.size, requirements.alignment, allocation.node, allocation.offset)) {
+				allocation.block = pool.back().get();
+			} else {
+				MAGE_DEBUG(device) << " - " << requirements.size << " byte(s) aligned to " << requirements.alignment << " don't fit a block, allocating them dedicated";
+			}
+		}
+	}
+
+	if (allocation.block == nullptr) {
+		if (!allocate_device_memory(requirements.size, memory_type, allocation.memory, &allocation.mapped)) {
+			MAGE_ERROR(device) << "Failed to allocate " << requirements.size << " byte(s) of dedicated memory";
+			exit(EXIT_FAILURE);
+		}
+		dedicated_bytes[heap] += requirements.size;
+		dedicated_counts[heap]++;
+		return allocation;
+	}
+
+	allocation.memory = allocation.block->memory;
+	if (allocation.block->mapped != nullptr) {
+		allocation.mapped = static_cast<char*>(allocation.block->mapped) + allocation.offset;
+	}
+	return allocation;
+}
+
+// Keeps at most one empty block per pool so a load/unload cycle doesn't thrash vkAllocateMemory
+void MemoryHandling::free(MemoryAllocation &allocation) {
+	if (allocation.memory == VK_NULL_HANDLE) {
+		return;
+	}
+	std::lock_guard<std::mutex> lock(memory_mutex);
+	if (allocation.block == nullptr) {
+		uint32_t heap = memory_properties.memoryTypes[allocation.memory_type].heapIndex;
+		free_device_memory(allocation.memory, allocation.mapped != nullptr);
+		dedicated_bytes[heap] -= allocation.size;
+		dedicated_counts[heap]--;
+		allocation = {};
+		return;
+	}
+
+	MemoryBlock *block = allocation.block;
+	block->free(allocation.node);
+	allocation = {};
+	if (!block->empty()) {
+		return;
+	}
+	auto &pool = pools[block->pool];
+	size_t empty_blocks = std::count_if(pool.begin(), pool.end(), [](const std::unique_ptr<MemoryBlock> &candidate) {return candidate->empty();});
+	if (empty_blocks > 1) {
+		auto found = std::find_if(pool.begin(), pool.end(), [block](const std::unique_ptr<MemoryBlock> &candidate) {return candidate.get() == block;});
+		free_device_memory(block->memory, block->mapped != nullptr);
+		pool.erase(found);
+	}
+}
+
+std::vector<HeapStatistics> MemoryHandling::get_statistics() {
+	std::lock_guard<std::mutex> lock(memory_mutex);
+	std::vector<HeapStatistics> statistics(memory_properties.memoryHeapCount);
+	for (uint32_t pool_index = 0; pool_index < pools.size(); pool_index++) {
+		uint32_t heap = memory_properties.memoryTypes[pool_index / 2].heapIndex;
+		for (const auto &block : pools[pool_index]) {
+			HeapStatistics &heap_statistics = statistics[heap];
+			VkDeviceSize free_bytes = block->size - block->get_used_bytes();
+			heap_statistics.block_bytes += block->size;
+			heap_statistics.used_bytes += block->get_used_bytes();
+			heap_statistics.free_bytes += free_bytes;
+			heap_statistics.fragmented_bytes += free_bytes - block->largest_free();
+			heap_statistics.block_count++;
+			heap_statistics.allocation_count += block->get_allocation_count();
+		}
+	}
+	for (uint32_t heap = 0; heap < statistics.size(); heap++) {
+		statistics[heap].dedicated_bytes = dedicated_bytes[heap];
+		statistics[heap].dedicated_count = dedicated_counts[heap];
+		statistics[heap].used_bytes += dedicated_bytes[heap];
+		statistics[heap].allocation_count += dedicated_counts[heap];
+	}
+	return statistics;
+}
+
+void MemoryHandling::log_statistics() {
+	auto statistics = get_statistics();
+	MAGE_INFO(device) << "Device memory: " << device_allocation_count << " vkAllocateMemory allocation(s) of " << max_allocation_count << " allowed";
+	for (uint32_t heap = 0; heap < statistics.size(); heap++) {
+		const HeapStatistics &heap_statistics = statistics[heap];
+		if (heap_statistics.block_count == 0 && heap_statistics.dedicated_count == 0) {
+			continue;
+		}
+		MAGE_INFO(device) << " - heap " << heap << ": " << heap_statistics.allocation_count << " allocation(s), "
+		                  << heap_statistics.used_bytes << " byte(s) used, "
+		                  << heap_statistics.block_count << " block(s) of " << heap_statistics.block_bytes << " byte(s) with "
+		                  << heap_statistics.free_bytes << " free and " << heap_statistics.fragmented_bytes << " fragmented, "
+		                  << heap_statistics.dedicated_count << " dedicated (" << heap_statistics.dedicated_bytes << " byte(s))";
+	}
+}
+
+// Anything still allocated here leaked, the blocks go regardless since the device is about to be destroyed
+MemoryHandling::~MemoryHandling() {
+	for (auto &pool : pools) {
+		for (auto &block : pool) {
+			if (!block->empty()) {
+				MAGE_WARN(device) << "Freeing a memory block with " << block->get_allocation_count() << " live allocation(s)";
+			}
+			free_device_memory(block->memory, block->mapped != nullptr);
+		}
+	}
+	uint32_t dedicated_left = 0;
+	for (uint32_t count : dedicated_counts) {
+		dedicated_left += count;
+	}
+	if (dedicated_left > 0) {
+		MAGE_WARN(device) << dedicated_left << " dedicated allocation(s) were never freed";
+	}
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace mage {
+
+	class MemoryBlock;
+
+	// A range of device memory handed out by MemoryHandling. Host-visible allocations stay mapped for their whole life.
+	struct MemoryAllocation {
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		VkDeviceSize offset = 0;
+		VkDeviceSize size = 0;
+		void *mapped = nullptr;
+		uint32_t memory_type = 0;
+		MemoryBlock *block = nullptr;
+		uint32_t node = 0;
+		bool is_dedicated() const {return memory != VK_NULL_HANDLE && block == nullptr;}
+	};
+
+	// Linear resources (buffers, linear images) and optimal images are kept in separate blocks when the
+	// device's bufferImageGranularity would otherwise force padding between neighbours
+	enum class MemoryUsage {linear, optimal_image};
+
+	struct HeapStatistics {
+		VkDeviceSize block_bytes = 0;
+		VkDeviceSize dedicated_bytes = 0;
+		VkDeviceSize used_bytes = 0;
+		VkDeviceSize free_bytes = 0;
+		// Free bytes outside each block's largest free range, i.e. free but unusable for one big allocation
+		VkDeviceSize fragmented_bytes = 0;
+		uint32_t block_count = 0;
+		uint32_t dedicated_count = 0;
+		uint32_t allocation_count = 0;
+	};
+
+	// Two-level segregated fit (TLSF) sub-allocator over one VkDeviceMemory block. O(1) allocate and free,
+	// neighbouring free ranges are merged immediately so a free range is never next to another free range.
+	class MemoryBlock {
+	private:
+		static constexpr uint32_t SL_BITS = 4;
+		static constexpr uint32_t SL_COUNT = 1u << SL_BITS;
+		static constexpr uint32_t SMALL_SHIFT = 8;
+		static constexpr VkDeviceSize SMALL_SIZE = VkDeviceSize{1} << SMALL_SHIFT;
+		static constexpr uint32_t FL_COUNT = 64 - SMALL_SHIFT + 1;
+		static constexpr VkDeviceSize MIN_SPLIT = 64;
+		static constexpr uint32_t NONE = UINT32_MAX;
+		struct Node {
+			VkDeviceSize offset;
+			VkDeviceSize size;
+			uint32_t prev_physical;
+			uint32_t next_physical;
+			uint32_t prev_free;
+			uint32_t next_free;
+			bool free;
+		};
+		std::vector<Node> nodes;
+		std::vector<uint32_t> unused_nodes;
+		uint64_t fl_bitmap = 0;
+		uint32_t sl_bitmap[FL_COUNT] = {};
+		uint32_t free_heads[FL_COUNT][SL_COUNT];
+		VkDeviceSize used_bytes = 0;
+		uint32_t allocation_count = 0;
+		static void mapping(VkDeviceSize size, uint32_t &fl, uint32_t &sl);
+		uint32_t new_node();
+		void insert_free(uint32_t node);
+		void remove_free(uint32_t node);
+		uint32_t find_free(VkDeviceSize size);
+		uint32_t split(uint32_t node, VkDeviceSize size);
+	public:
+		MemoryBlock(VkDeviceMemory memory_pass, VkDeviceSize size_pass, void *mapped_pass, uint32_t pool_pass);
+		const VkDeviceMemory memory;
+		const VkDeviceSize size;
+		void *const mapped;
+		const uint32_t pool;
+		bool allocate(VkDeviceSize size, VkDeviceSize alignment, uint32_t &node, VkDeviceSize &offset);
+		void free(uint32_t node);
+		VkDeviceSize largest_free() const;
+		VkDeviceSize get_used_bytes() const {return used_bytes;}
+		uint32_t get_allocation_count() const {return allocation_count;}
+		bool empty() const {return allocation_count == 0;}
+	};
+
+	// Owns every VkDeviceMemory the engine allocates. Small resources are packed into large per-type blocks,
+	// big ones get their own allocation, which keeps us far below maxMemoryAllocationCount.
+	class MemoryHandling {
+	private:
+		static constexpr VkDeviceSize LARGE_HEAP_BLOCK_SIZE = 64 * 1024 * 1024;
+		static constexpr VkDeviceSize LARGE_HEAP_SIZE = VkDeviceSize{1024} * 1024 * 1024;
+		static constexpr VkDeviceSize DEDICATED_IMAGE_SIZE = 16 * 1024 * 1024;
+		VkDevice device;
+		VkPhysicalDeviceMemoryProperties memory_properties;
+		VkDeviceSize buffer_image_granularity;
+		uint32_t max_allocation_count;
+		uint32_t device_allocation_count = 0;
+		std::vector<std::vector<std::unique_ptr<MemoryBlock>>> pools;
+		std::vector<VkDeviceSize> dedicated_bytes;
+		std::vector<uint32_t> dedicated_counts;
+		std::mutex memory_mutex;
+		VkDeviceSize block_size(uint32_t memory_type) const;
+		bool allocate_device_memory(VkDeviceSize size, uint32_t memory_type, VkDeviceMemory &memory, void **mapped);
+		void free_device_memory(VkDeviceMemory memory, bool mapped);
+	public:
+		MemoryHandling(VkDevice device_pass, VkPhysicalDevice card);
+		~MemoryHandling();
+		MemoryHandling(const MemoryHandling&) = delete;
+		MemoryHandling &operator=(const MemoryHandling&) = delete;
+		MemoryAllocation allocate(const VkMemoryRequirements &requirements, VkMemoryPropertyFlags properties, MemoryUsage usage, bool dedicated = false);
+		void free(MemoryAllocation &allocation);
+		uint32_t find_memory_type(uint32_t type_filter, VkMemoryPropertyFlags properties) const;
+		bool wants_dedicated_image(const VkMemoryRequirements &requirements) const {return requirements.size >= DEDICATED_IMAGE_SIZE;}
+		std::vector<HeapStatistics> get_statistics();
+		void log_statistics();
+	};
+
+}
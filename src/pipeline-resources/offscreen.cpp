@@ -0,0 +1,260 @@
+#include "offscreen.hpp"
+#include "../debug-resources/log.hpp"
+#include "../debug-resources/cpu-profiler.hpp"
+
+#include <array>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+
+using namespace mage;
+
+OffscreenHandling::OffscreenHandling(DeviceHandling &device_pass, VkExtent2D extent_pass, OffscreenInfo info) : device{device_pass}, extent{extent_pass}, frames_in_flight{info.frames_in_flight}, readback{info.readback} {
+	MAGE_INFO(swapchain) << "=== OFFSCREEN HANDLING ===";
+	color_format = device.find_supported_format({VK_FORMAT_B8G8R8A8_UNORM, VK_FORMAT_R8G8B8A8_UNORM},
+	                                            VK_IMAGE_TILING_OPTIMAL,
+	                                            VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT);
+	depth_format = device.find_supported_format({VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT},
+	                                            VK_IMAGE_TILING_OPTIMAL,
+	                                            VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT);
+	VkImageLayout final_layout = readback ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+	render_pass = RenderTarget::create_render_pass(device, color_format, depth_format, final_layout);
+	create_images();
+	create_framebuffers();
+	create_sync_objects();
+	if (readback) {
+		create_readback_buffers();
+	}
+	MAGE_INFO(swapchain) << "=== OFFSCREEN HANDLING SUCCESSFUL ===";
+}
+
+VkImageView OffscreenHandling::create_view(VkImage image, VkFormat format, VkImageAspectFlags aspect){
+	VkImageViewCreateInfo view_info{};
+	view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+	view_info.image = image;
+	view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+	view_info.format = format;
+	view_info.subresourceRange.aspectMask = aspect;
+	view_info.subresourceRange.baseMipLevel = 0;
+	view_info.subresourceRange.levelCount = 1;
+	view_info.subresourceRange.baseArrayLayer = 0;
+	view_info.subresourceRange.layerCount = 1;
+
+	VkImageView view;
+	if (vkCreateImageView(device.get_device(), &view_info, nullptr, &view) != VK_SUCCESS) {
+		MAGE_ERROR(swapchain) << "Failed to create offscreen image view";
+		exit(EXIT_FAILURE);
+	}
+	return view;
+}
+
+void OffscreenHandling::create_images(){
+	MAGE_INFO(swapchain) << "Attempting to create " << frames_in_flight << " offscreen color/depth image pair(s)...";
+	color_images.resize(frames_in_flight);
+	color_images_allocations.resize(frames_in_flight);
+	color_images_views.resize(frames_in_flight);
+	depth_images.resize(frames_in_flight);
+	depth_images_allocations.resize(frames_in_flight);
+	depth_images_views.resize(frames_in_flight);
+
+	for (uint32_t i = 0; i < frames_in_flight; i++) {
+		VkImageCreateInfo image_info{};
+		image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		image_info.imageType = VK_IMAGE_TYPE_2D;
+		image_info.extent.width = extent.width;
+		image_info.extent.height = extent.height;
+		image_info.extent.depth = 1;
+		image_info.mipLevels = 1;
+		image_info.arrayLayers = 1;
+		image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+		image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		image_info.samples = VK_SAMPLE_COUNT_1_BIT;
+		image_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+		image_info.format = color_format;
+		image_info.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+		device.create_image(image_info, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, color_images[i], color_images_allocations[i]);
+		color_images_views[i] = create_view(color_images[i], color_format, VK_IMAGE_ASPECT_COLOR_BIT);
+
+		image_info.format = depth_format;
+		image_info.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+		device.create_image(image_info, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, depth_images[i], depth_images_allocations[i]);
+		depth_images_views[i] = create_view(depth_images[i], depth_format, VK_IMAGE_ASPECT_DEPTH_BIT);
+	}
+	MAGE_INFO(swapchain) << " - offscreen image creation successful!";
+}
+
+void OffscreenHandling::create_framebuffers(){
+	MAGE_INFO(swapchain) << "Attempting to create offscreen framebuffers...";
+	framebuffers.resize(frames_in_flight);
+	for (uint32_t i = 0; i < frames_in_flight; i++) {
+		std::array<VkImageView, 2> attachments = {color_images_views[i], depth_images_views[i]};
+		VkFramebufferCreateInfo framebuffer_info = {};
+		framebuffer_info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+		framebuffer_info.renderPass = render_pass;
+		framebuffer_info.attachmentCount = static_cast<uint32_t>(attachments.size());
+		framebuffer_info.pAttachments = attachments.data();
+		framebuffer_info.width = extent.width;
+		framebuffer_info.height = extent.height;
+		framebuffer_info.layers = 1;
+		if (vkCreateFramebuffer(device.get_device(), &framebuffer_info, nullptr, &framebuffers[i]) != VK_SUCCESS) {
+			MAGE_ERROR(swapchain) << "Failed to create offscreen framebuffer";
+			exit(EXIT_FAILURE);
+		}
+	}
+	MAGE_INFO(swapchain) << " - offscreen framebuffer creation successful!";
+}
+
+void OffscreenHandling::create_sync_objects(){
+	in_flight_fences.resize(frames_in_flight);
+	VkFenceCreateInfo fence_info = {};
+	fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+	fence_info.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+	for (auto &fence : in_flight_fences) {
+		if (vkCreateFence(device.get_device(), &fence_info, nullptr, &fence) != VK_SUCCESS) {
+			MAGE_ERROR(swapchain) << "Failed to create offscreen fence";
+			exit(EXIT_FAILURE);
+		}
+	}
+}
+
+// One more buffer than frames in flight so the newest finished frame is never the one being overwritten
+void OffscreenHandling::create_readback_buffers(){
+	MAGE_INFO(swapchain) << "Attempting to create readback buffers...";
+	VkDeviceSize size = static_cast<VkDeviceSize>(extent.width) * extent.height * 4;
+	uint32_t count = frames_in_flight + 1;
+	readback_buffers.resize(count);
+	readback_allocations.resize(count);
+	frame_readback.assign(frames_in_flight, -1);
+	for (uint32_t i = 0; i < count; i++) {
+		device.create_buffer(size,
+		                     VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		                     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		                     readback_buffers[i],
+		                     readback_allocations[i]);
+	}
+	MAGE_INFO(swapchain) << " - readback buffer creation successful!";
+}
+
+VkResult OffscreenHandling::acquire_next_image(uint32_t *image_index) {
+	MAGE_PROFILE_ZONE("OffscreenHandling::acquire_next_image");
+	{
+		MAGE_PROFILE_ZONE("wait in_flight_fences");
+		uint64_t wait_start = CpuProfiler::now();
+		vkWaitForFences(device.get_device(), 1, &in_flight_fences[current_frame], VK_TRUE, std::numeric_limits<uint64_t>::max());
+		fence_wait_nanoseconds += CpuProfiler::now() - wait_start;
+	}
+	if (readback && frame_readback[current_frame] >= 0) {
+		latest_readback = frame_readback[current_frame];
+		frame_readback[current_frame] = -1;
+	}
+	*image_index = static_cast<uint32_t>(current_frame);
+	return VK_SUCCESS;
+}
+
+void OffscreenHandling::record_after_render(VkCommandBuffer command_buffer, uint32_t image_index){
+	if (!readback) {
+		return;
+	}
+	uint32_t buffer_index = next_readback;
+	next_readback = (next_readback + 1) % static_cast<uint32_t>(readback_buffers.size());
+	frame_readback[image_index] = static_cast<int>(buffer_index);
+
+	VkBufferImageCopy region{};
+	region.bufferOffset = 0;
+	region.bufferRowLength = 0;
+	region.bufferImageHeight = 0;
+	region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	region.imageSubresource.mipLevel = 0;
+	region.imageSubresource.baseArrayLayer = 0;
+	region.imageSubresource.layerCount = 1;
+	region.imageOffset = {0, 0, 0};
+	region.imageExtent = {extent.width, extent.height, 1};
+	vkCmdCopyImageToBuffer(command_buffer, color_images[image_index], VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, readback_buffers[buffer_index], 1, &region);
+
+	VkBufferMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.buffer = readback_buffers[buffer_index];
+	barrier.offset = 0;
+	barrier.size = VK_WHOLE_SIZE;
+	vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+}
+
+VkResult OffscreenHandling::submit_command_buffers(const VkCommandBuffer *buffers, uint32_t *image_index) {
+	MAGE_PROFILE_ZONE("OffscreenHandling::submit_command_buffers");
+	VkSubmitInfo submit_info = {};
+	submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submit_info.commandBufferCount = 1;
+	submit_info.pCommandBuffers = buffers;
+
+	vkResetFences(device.get_device(), 1, &in_flight_fences[current_frame]);
+	VkResult result;
+	{
+		MAGE_PROFILE_ZONE("vkQueueSubmit");
+		result = vkQueueSubmit(device.get_graphics_queue(), 1, &submit_info, in_flight_fences[current_frame]);
+	}
+	last_submitted = current_frame;
+	current_frame = (current_frame + 1) % frames_in_flight;
+	return result;
+}
+
+// Wait for everything in flight and promote the newest submitted frame's readback
+void OffscreenHandling::wait_idle(){
+	vkWaitForFences(device.get_device(), static_cast<uint32_t>(in_flight_fences.size()), in_flight_fences.data(), VK_TRUE, std::numeric_limits<uint64_t>::max());
+	if (readback && frame_readback[last_submitted] >= 0) {
+		latest_readback = frame_readback[last_submitted];
+		frame_readback.assign(frames_in_flight, -1);
+	}
+}
+
+// Dump the newest finished frame as a binary PPM, handy for eyeballing headless runs
+bool OffscreenHandling::write_ppm(const std::string &path){
+	const uint8_t *texels = static_cast<const uint8_t*>(get_latest_readback());
+	if (texels == nullptr) {
+		MAGE_WARN(swapchain) << "No offscreen frame has been read back yet, skipping " << path;
+		return false;
+	}
+	FILE *file = fopen(path.c_str(), "wb");
+	if (file == nullptr) {
+		MAGE_ERROR(swapchain) << "Failed to open " << path;
+		return false;
+	}
+	bool bgra = color_format == VK_FORMAT_B8G8R8A8_UNORM;
+	fprintf(file, "P6\n%u %u\n255\n", extent.width, extent.height);
+	std::vector<uint8_t> row(static_cast<size_t>(extent.width) * 3);
+	for (uint32_t y = 0; y < extent.height; y++) {
+		const uint8_t *source = texels + static_cast<size_t>(y) * extent.width * 4;
+		for (uint32_t x = 0; x < extent.width; x++) {
+			row[x * 3 + 0] = source[x * 4 + (bgra ? 2 : 0)];
+			row[x * 3 + 1] = source[x * 4 + 1];
+			row[x * 3 + 2] = source[x * 4 + (bgra ? 0 : 2)];
+		}
+		fwrite(row.data(), 1, row.size(), file);
+	}
+	fclose(file);
+	MAGE_INFO(swapchain) << " - wrote offscreen frame to " << path;
+	return true;
+}
+
+OffscreenHandling::~OffscreenHandling(){
+	for (size_t i = 0; i < readback_buffers.size(); i++) {
+		device.destroy_buffer(readback_buffers[i], readback_allocations[i]);
+	}
+	for (auto framebuffer : framebuffers) {
+		vkDestroyFramebuffer(device.get_device(), framebuffer, nullptr);
+	}
+	for (uint32_t i = 0; i < frames_in_flight; i++) {
+		vkDestroyImageView(device.get_device(), color_images_views[i], nullptr);
+		device.destroy_image(color_images[i], color_images_allocations[i]);
+		vkDestroyImageView(device.get_device(), depth_images_views[i], nullptr);
+		device.destroy_image(depth_images[i], depth_images_allocations[i]);
+	}
+	for (auto fence : in_flight_fences) {
+		vkDestroyFence(device.get_device(), fence, nullptr);
+	}
+	vkDestroyRenderPass(device.get_device(), render_pass, nullptr);
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "device.hpp"
+#include "render-target.hpp"
+#include <string>
+#include <vector>
+
+namespace mage {
+
+	struct OffscreenInfo {
+		uint32_t frames_in_flight = 2;
+		bool readback = false;
+	};
+
+	// Headless render target: one color + depth image pair per frame in flight, no surface or present.
+	// With readback enabled each frame is copied into one of frames_in_flight + 1 host-visible buffers, so the
+	// newest finished frame can be read while the GPU is still writing the next ones.
+	class OffscreenHandling : public RenderTarget {
+	private:
+		DeviceHandling &device;
+		VkExtent2D extent;
+		uint32_t frames_in_flight;
+		bool readback;
+		size_t current_frame = 0;
+		VkFormat color_format;
+		VkFormat depth_format;
+		VkRenderPass render_pass;
+		std::vector<VkImage> color_images;
+		std::vector<MemoryAllocation> color_images_allocations;
+		std::vector<VkImageView> color_images_views;
+		std::vector<VkImage> depth_images;
+		std::vector<MemoryAllocation> depth_images_allocations;
+		std::vector<VkImageView> depth_images_views;
+		std::vector<VkFramebuffer> framebuffers;
+		std::vector<VkFence> in_flight_fences;
+		std::vector<VkBuffer> readback_buffers;
+		std::vector<MemoryAllocation> readback_allocations;
+		std::vector<int> frame_readback;
+		uint32_t next_readback = 0;
+		int latest_readback = -1;
+		size_t last_submitted = 0;
+		void create_images();
+		void create_framebuffers();
+		void create_sync_objects();
+		void create_readback_buffers();
+		VkImageView create_view(VkImage image, VkFormat format, VkImageAspectFlags aspect);
+	public:
+		OffscreenHandling(DeviceHandling &device_pass, VkExtent2D extent_pass, OffscreenInfo info = {});
+		~OffscreenHandling();
+		OffscreenHandling(const OffscreenHandling&) = delete;
+		OffscreenHandling &operator=(const OffscreenHandling&) = delete;
+		VkResult acquire_next_image(uint32_t *image_index) override;
+		VkResult submit_command_buffers(const VkCommandBuffer *buffers, uint32_t *image_index) override;
+		void record_after_render(VkCommandBuffer command_buffer, uint32_t image_index) override;
+		void wait_idle();
+		bool write_ppm(const std::string &path);
+
+		int get_max_frames() override {return static_cast<int>(frames_in_flight);}
+		VkExtent2D get_swap_extent() override {return extent;}
+		VkRenderPass get_render_pass() override {return render_pass;}
+		VkFramebuffer get_framebuffers(int index) override {return framebuffers[index];}
+		size_t get_image_count() override {return frames_in_flight;}
+		// Nothing is presented, so nothing waits for vertical blank either
+		FramePacing get_frame_pacing() override {return {frames_in_flight, frames_in_flight, PresentMode::immediate};}
+		VkFormat get_color_format() const {return color_format;}
+		// Tightly packed 4-byte texels of the newest completed frame, null until one has finished
+		const void *get_latest_readback() const {return latest_readback < 0 ? nullptr : readback_allocations[latest_readback].mapped;}
+	};
+
+}
@@ -0,0 +1,242 @@
+#include "pipeline-cache.hpp"
+#include "hash.hpp"
+#include "../debug-resources/log.hpp"
+#include "../debug-resources/cpu-profiler.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+using namespace mage;
+
+namespace {
+
+	// Chains creation feedback into a copy of the create info when the device supports it, then times the call
+	template <typename CreateInfo, typename Create>
+	VkResult create_with_feedback(CreateInfo info, uint32_t stage_count, bool creation_feedback, Create create,
+	                              VkPipelineCreationFeedbackEXT &feedback, uint64_t &nanoseconds) {
+		std::vector<VkPipelineCreationFeedbackEXT> stage_feedback(stage_count);
+		VkPipelineCreationFeedbackCreateInfoEXT feedback_info{};
+		feedback = {};
+		if (creation_feedback) {
+			feedback_info.sType = VK_STRUCTURE_TYPE_PIPELINE_CREATION_FEEDBACK_CREATE_INFO_EXT;
+			feedback_info.pNext = info.pNext;
+			feedback_info.pPipelineCreationFeedback = &feedback;
+			feedback_info.pipelineStageCreationFeedbackCount = stage_count;
+			feedback_info.pPipelineStageCreationFeedbacks = stage_feedback.data();
+			info.pNext = &feedback_info;
+		}
+		uint64_t start = CpuProfiler::now();
+		VkResult result = create(info);
+		nanoseconds = CpuProfiler::now() - start;
+		return result;
+	}
+
+}
+
+constexpr char PipelineCacheHandling::FILE_MAGIC[8];
+
+PipelineCacheHandling::PipelineCacheHandling(VkDevice device_pass, VkPhysicalDevice card, std::string path_pass, bool creation_feedback_pass)
+	: device{device_pass}, path{std::move(path_pass)}, creation_feedback{creation_feedback_pass} {
+	MAGE_INFO(pipeline) << "Attempting to create pipeline cache...";
+	vkGetPhysicalDeviceProperties(card, &properties);
+
+	std::vector<char> file = path.empty() ? std::vector<char>{} : load_file();
+	VkPipelineCacheCreateInfo cache_info{};
+	cache_info.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+	if (validate(file)) {
+		cache_info.initialDataSize = file.size() - sizeof(FileHeader);
+		cache_info.pInitialData = file.data() + sizeof(FileHeader);
+		saved_checksum = hash_bytes(file.data() + sizeof(FileHeader), cache_info.initialDataSize);
+		MAGE_INFO(pipeline) << " - loaded " << cache_info.initialDataSize << " byte(s) from " << path;
+	}
+
+	if (vkCreatePipelineCache(device, &cache_info, nullptr, &cache) != VK_SUCCESS) {
+		// A driver that still refuses validated data gets an empty cache rather than no cache
+		MAGE_WARN(pipeline) << "Driver rejected pipeline cache data, starting empty";
+		cache_info.initialDataSize = 0;
+		cache_info.pInitialData = nullptr;
+		saved_checksum = 0;
+		if (vkCreatePipelineCache(device, &cache_info, nullptr, &cache) != VK_SUCCESS) {
+			MAGE_ERROR(pipeline) << "Failed to create pipeline cache";
+			exit(EXIT_FAILURE);
+		}
+	}
+	if (!creation_feedback) {
+		MAGE_INFO(pipeline) << " - " << VK_EXT_PIPELINE_CREATION_FEEDBACK_EXTENSION_NAME << " unavailable, cache hits will not be reported";
+	}
+}
+
+PipelineCacheHandling::~PipelineCacheHandling() {
+	save();
+	log_statistics();
+	vkDestroyPipelineCache(device, cache, nullptr);
+}
+
+std::vector<char> PipelineCacheHandling::load_file() const {
+	std::ifstream file(path, std::ios::ate | std::ios::binary);
+	if (!file.is_open()) {
+		MAGE_INFO(pipeline) << " - no pipeline cache at " << path << ", starting cold";
+		return {};
+	}
+	std::vector<char> data(static_cast<size_t>(file.tellg()));
+	file.seekg(0);
+	file.read(data.data(), static_cast<std::streamsize>(data.size()));
+	if (!file) {
+		MAGE_WARN(pipeline) << "Failed to read pipeline cache " << path;
+		return {};
+	}
+	return data;
+}
+
+// The Vulkan header identifies the GPU and driver build the blob came from; anything else is thrown away
+bool PipelineCacheHandling::validate(const std::vector<char> &file) const {
+	if (file.empty()) {
+		return false;
+	}
+	FileHeader header{};
+	VkPipelineCacheHeaderVersionOne vulkan_header{};
+	if (file.size() < sizeof(FileHeader) + sizeof(VkPipelineCacheHeaderVersionOne)) {
+		MAGE_WARN(pipeline) << "Pipeline cache " << path << " is truncated, discarding";
+		return false;
+	}
+	std::memcpy(&header, file.data(), sizeof(FileHeader));
+	std::memcpy(&vulkan_header, file.data() + sizeof(FileHeader), sizeof(VkPipelineCacheHeaderVersionOne));
+	const char *data = file.data() + sizeof(FileHeader);
+	size_t data_size = file.size() - sizeof(FileHeader);
+
+	const char *reason = nullptr;
+	if (std::memcmp(header.magic, FILE_MAGIC, sizeof(FILE_MAGIC)) != 0 || header.version != FILE_VERSION) {
+		reason = "not a pipeline cache written by this engine version";
+	} else if (header.data_size != data_size || header.checksum != hash_bytes(data, data_size)) {
+		reason = "size or checksum mismatch";
+	} else if (vulkan_header.headerSize < sizeof(VkPipelineCacheHeaderVersionOne) || vulkan_header.headerSize > data_size ||
+	           vulkan_header.headerVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE) {
+		reason = "unknown Vulkan cache header";
+	} else if (vulkan_header.vendorID != properties.vendorID || vulkan_header.deviceID != properties.deviceID) {
+		reason = "written for a different GPU";
+	} else if (std::memcmp(vulkan_header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) != 0 ||
+	           header.driver_version != properties.driverVersion) {
+		reason = "written by a different driver";
+	}
+	if (reason != nullptr) {
+		MAGE_WARN(pipeline) << "Discarding pipeline cache " << path << ": " << reason;
+		return false;
+	}
+	return true;
+}
+
+// Written to a temporary file and renamed over the old one, so a crash mid-save never leaves a torn cache
+bool PipelineCacheHandling::save() {
+	if (path.empty()) {
+		return false;
+	}
+	size_t data_size = 0;
+	if (vkGetPipelineCacheData(device, cache, &data_size, nullptr) != VK_SUCCESS || data_size == 0) {
+		MAGE_WARN(pipeline) << "Failed to query pipeline cache size";
+		return false;
+	}
+	std::vector<char> file(sizeof(FileHeader) + data_size);
+	if (vkGetPipelineCacheData(device, cache, &data_size, file.data() + sizeof(FileHeader)) != VK_SUCCESS) {
+		MAGE_WARN(pipeline) << "Failed to read pipeline cache data";
+		return false;
+	}
+	file.resize(sizeof(FileHeader) + data_size);
+
+	FileHeader header{};
+	std::memcpy(header.magic, FILE_MAGIC, sizeof(FILE_MAGIC));
+	header.version = FILE_VERSION;
+	header.driver_version = properties.driverVersion;
+	header.data_size = data_size;
+	header.checksum = hash_bytes(file.data() + sizeof(FileHeader), data_size);
+	if (header.checksum == saved_checksum) {
+		MAGE_DEBUG(pipeline) << " - pipeline cache unchanged, skipping save";
+		return true;
+	}
+	std::memcpy(file.data(), &header, sizeof(FileHeader));
+
+	std::string temporary_path = path + ".tmp";
+	{
+		std::ofstream output(temporary_path, std::ios::binary | std::ios::trunc);
+		output.write(file.data(), static_cast<std::streamsize>(file.size()));
+		output.flush();
+		if (!output) {
+			MAGE_WARN(pipeline) << "Failed to write pipeline cache " << temporary_path;
+			std::error_code ignored;
+			std::filesystem::remove(temporary_path, ignored);
+			return false;
+		}
+	}
+	std::error_code error;
+	std::filesystem::rename(temporary_path, path, error);
+	if (error) {
+		MAGE_WARN(pipeline) << "Failed to replace pipeline cache " << path << ": " << error.message();
+		std::filesystem::remove(temporary_path, error);
+		return false;
+	}
+	saved_checksum = header.checksum;
+	MAGE_INFO(pipeline) << " - saved " << data_size << " byte(s) of pipeline cache to " << path;
+	return true;
+}
+
+VkResult PipelineCacheHandling::create_graphics_pipeline(const VkGraphicsPipelineCreateInfo &info, const char *name, VkPipeline &pipeline) {
+	VkPipelineCreationFeedbackEXT feedback{};
+	uint64_t nanoseconds = 0;
+	VkResult result = create_with_feedback(info, info.stageCount, creation_feedback, [&](const VkGraphicsPipelineCreateInfo &chained) {
+		return vkCreateGraphicsPipelines(device, cache, 1, &chained, nullptr, &pipeline);
+	}, feedback, nanoseconds);
+	if (result == VK_SUCCESS) {
+		record(name, nanoseconds, creation_feedback ? &feedback : nullptr);
+	}
+	return result;
+}
+
+VkResult PipelineCacheHandling::create_compute_pipeline(const VkComputePipelineCreateInfo &info, const char *name, VkPipeline &pipeline) {
+	VkPipelineCreationFeedbackEXT feedback{};
+	uint64_t nanoseconds = 0;
+	VkResult result = create_with_feedback(info, 1, creation_feedback, [&](const VkComputePipelineCreateInfo &chained) {
+		return vkCreateComputePipelines(device, cache, 1, &chained, nullptr, &pipeline);
+	}, feedback, nanoseconds);
+	if (result == VK_SUCCESS) {
+		record(name, nanoseconds, creation_feedback ? &feedback : nullptr);
+	}
+	return result;
+}
+
+void PipelineCacheHandling::record(const char *name, uint64_t nanoseconds, const VkPipelineCreationFeedbackEXT *feedback) {
+	const char *outcome = "unknown";
+	{
+		std::lock_guard<std::mutex> lock{statistics_mutex};
+		statistics.pipelines_created++;
+		statistics.total_nanoseconds += nanoseconds;
+		statistics.max_nanoseconds = std::max(statistics.max_nanoseconds, nanoseconds);
+		if (feedback == nullptr || !(feedback->flags & VK_PIPELINE_CREATION_FEEDBACK_VALID_BIT_EXT)) {
+			statistics.cache_unknown++;
+		} else if (feedback->flags & VK_PIPELINE_CREATION_FEEDBACK_APPLICATION_PIPELINE_CACHE_HIT_BIT_EXT) {
+			statistics.cache_hits++;
+			outcome = "hit";
+		} else {
+			statistics.cache_misses++;
+			outcome = "miss";
+		}
+	}
+	MAGE_INFO(pipeline) << " - pipeline '" << name << "' created in " << nanoseconds / 1e6 << " ms (cache " << outcome << ")";
+}
+
+PipelineCacheStatistics PipelineCacheHandling::get_statistics() {
+	std::lock_guard<std::mutex> lock{statistics_mutex};
+	return statistics;
+}
+
+void PipelineCacheHandling::log_statistics() {
+	PipelineCacheStatistics snapshot = get_statistics();
+	if (snapshot.pipelines_created == 0) {
+		return;
+	}
+	MAGE_INFO(pipeline) << "Pipeline cache: " << snapshot.pipelines_created << " pipeline(s), "
+	                    << snapshot.cache_hits << " hit(s), " << snapshot.cache_misses << " miss(es), "
+	                    << snapshot.cache_unknown << " unknown, "
+	                    << snapshot.total_nanoseconds / 1e6 << " ms total, "
+	                    << snapshot.max_nanoseconds / 1e6 << " ms worst";
+}
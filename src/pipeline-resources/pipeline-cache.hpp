@@ -0,0 +1,60 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace mage {
+
+	struct PipelineCacheStatistics {
+		uint32_t pipelines_created = 0;
+		uint32_t cache_hits = 0;
+		uint32_t cache_misses = 0;
+		// Creations the driver gave no feedback for, either hit or miss
+		uint32_t cache_unknown = 0;
+		uint64_t total_nanoseconds = 0;
+		uint64_t max_nanoseconds = 0;
+	};
+
+	// One VkPipelineCache shared by every pipeline on the device, loaded from disk at startup and written back
+	// at shutdown. A file written by another GPU or driver is rejected up front instead of handed to the driver.
+	class PipelineCacheHandling {
+	private:
+		static constexpr char FILE_MAGIC[8] = {'M', 'A', 'G', 'E', 'P', 'S', 'O', 'C'};
+		static constexpr uint32_t FILE_VERSION = 1;
+		// Our own prefix in front of the driver's blob, the driver version is not part of the Vulkan header
+		struct FileHeader {
+			char magic[8];
+			uint32_t version;
+			uint32_t driver_version;
+			uint64_t data_size;
+			uint64_t checksum;
+		};
+		VkDevice device;
+		VkPhysicalDeviceProperties properties;
+		VkPipelineCache cache = VK_NULL_HANDLE;
+		std::string path;
+		bool creation_feedback;
+		uint64_t saved_checksum = 0;
+		PipelineCacheStatistics statistics{};
+		std::mutex statistics_mutex;
+		std::vector<char> load_file() const;
+		bool validate(const std::vector<char> &file) const;
+		void record(const char *name, uint64_t nanoseconds, const VkPipelineCreationFeedbackEXT *feedback);
+	public:
+		PipelineCacheHandling(VkDevice device_pass, VkPhysicalDevice card, std::string path_pass, bool creation_feedback_pass);
+		~PipelineCacheHandling();
+		PipelineCacheHandling(const PipelineCacheHandling&) = delete;
+		PipelineCacheHandling &operator=(const PipelineCacheHandling&) = delete;
+		VkResult create_graphics_pipeline(const VkGraphicsPipelineCreateInfo &info, const char *name, VkPipeline &pipeline);
+		VkResult create_compute_pipeline(const VkComputePipelineCreateInfo &info, const char *name, VkPipeline &pipeline);
+		bool save();
+		void log_statistics();
+
+		VkPipelineCache get_cache() const {return cache;}
+		const std::string &get_path() const {return path;}
+		PipelineCacheStatistics get_statistics();
+	};
+
+}
@@ -20,24 +20,43 @@ namespace mage {
 		VkRenderPass render_pass = nullptr;
 		VkRect2D scissor;
 		uint32_t subpass = 0;
+		std::vector<VkVertexInputBindingDescription> binding_descriptions;
+		std::vector<VkVertexInputAttributeDescription> attribute_descriptions;
+		// Relative to the device's shader asset root
+		std::string vertex_shader_path = "src/shaders/vert.spv";
+		std::string fragment_shader_path = "src/shaders/frag.spv";
+		// Reported in pipeline cache telemetry
+		std::string name = "graphics";
 	};
 	
 	class GraphicsPipeline {
 		private:
-			VkShaderModule vertex_module;
-			VkShaderModule fragment_module;
 			DeviceHandling &device;
 			VkPipeline graphics_pipeline;
 		public:
 			GraphicsPipeline(DeviceHandling& device_pass, PipelineInfo& config_info);
 			~GraphicsPipeline();	
 			void create_pipeline(const PipelineInfo config_info);
-			static std::vector<char> read_file(const std::string& file_name);
-			VkShaderModule create_module(const std::vector<char>& data);
 			static void default_pipeline_info(PipelineInfo &configInfo);
 			void bind(VkCommandBuffer command_buffer);
 
 			VkPipeline get_pipeline(){return graphics_pipeline;}
 	};
 
+	// Single compute shader stage, created through the same pipeline cache and shader registry as GraphicsPipeline
+	class ComputePipeline {
+		private:
+			DeviceHandling &device;
+			VkPipeline compute_pipeline;
+		public:
+			// shader_path is relative to the device's shader asset root
+			ComputePipeline(DeviceHandling &device_pass, const std::string &shader_path, VkPipelineLayout layout, const char *name);
+			~ComputePipeline();
+			ComputePipeline(const ComputePipeline&) = delete;
+			ComputePipeline &operator=(const ComputePipeline&) = delete;
+			void bind(VkCommandBuffer command_buffer);
+
+			VkPipeline get_pipeline(){return compute_pipeline;}
+	};
+
 }
@@ -0,0 +1,175 @@
+#include "recorder.hpp"
+#include "../debug-resources/log.hpp"
+#include "../debug-resources/cpu-profiler.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <string>
+
+using namespace mage;
+
+ParallelRecorder::ParallelRecorder(DeviceHandling &device_pass, uint32_t frames_in_flight, uint32_t thread_count_pass)
+	: device{device_pass}, thread_count{std::max(thread_count_pass, 1u)} {
+	MAGE_INFO(frame) << "Attempting to create parallel recorder with " << thread_count << " thread(s)...";
+	// Pools are reset wholesale every frame, so their buffers never need resetting one by one
+	VkCommandPoolCreateInfo pool_info{};
+	pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	pool_info.queueFamilyIndex = device.get_queue_families().graphics_family;
+	pool_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+	frames.resize(frames_in_flight);
+	for (auto &frame_pools : frames) {
+		frame_pools.resize(thread_count);
+		for (auto &thread_frame : frame_pools) {
+			if (vkCreateCommandPool(device.get_device(), &pool_info, nullptr, &thread_frame.pool) != VK_SUCCESS) {
+				MAGE_ERROR(frame) << "Failed to create recording command pool";
+				exit(EXIT_FAILURE);
+			}
+		}
+	}
+	for (uint32_t thread = 1; thread < thread_count; thread++) {
+		workers.emplace_back(&ParallelRecorder::worker_loop, this, thread);
+	}
+	MAGE_INFO(frame) << " - parallel recorder creation successful!";
+}
+
+void ParallelRecorder::begin_frame(uint32_t frame_index) {
+	MAGE_PROFILE_ZONE("ParallelRecorder::begin_frame");
+	current_frame = frame_index;
+	for (auto &thread_frame : frames[current_frame]) {
+		vkResetCommandPool(device.get_device(), thread_frame.pool, 0);
+		thread_frame.used = 0;
+	}
+}
+
+void ParallelRecorder::begin_render_pass(VkRenderPass render_pass_pass, VkFramebuffer framebuffer_pass, VkExtent2D extent_pass) {
+	render_pass = render_pass_pass;
+	framebuffer = framebuffer_pass;
+	extent = extent_pass;
+}
+
+// Buffers stay allocated across frames, a pool reset hands them back in the initial state
+VkCommandBuffer ParallelRecorder::next_buffer(uint32_t thread) {
+	ThreadFrame &thread_frame = frames[current_frame][thread];
+	if (thread_frame.used == thread_frame.buffers.size()) {
+		VkCommandBufferAllocateInfo allocate_info{};
+		allocate_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocate_info.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+		allocate_info.commandPool = thread_frame.pool;
+		allocate_info.commandBufferCount = 1;
+		VkCommandBuffer buffer;
+		if (vkAllocateCommandBuffers(device.get_device(), &allocate_info, &buffer) != VK_SUCCESS) {
+			MAGE_ERROR(frame) << "Failed to allocate secondary command buffer";
+			exit(EXIT_FAILURE);
+		}
+		thread_frame.buffers.push_back(buffer);
+	}
+	return thread_frame.buffers[thread_frame.used++];
+}
+
+// Dynamic state is not inherited from the primary, every secondary sets its own viewport and scissor
+void ParallelRecorder::record_slice(uint32_t thread, uint32_t slice) {
+	MAGE_PROFILE_ZONE("ParallelRecorder::record_slice");
+	VkCommandBuffer buffer = next_buffer(thread);
+
+	VkCommandBufferInheritanceInfo inheritance{};
+	inheritance.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+	inheritance.renderPass = render_pass;
+	inheritance.subpass = 0;
+	inheritance.framebuffer = framebuffer;
+	VkCommandBufferBeginInfo begin_info{};
+	begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	begin_info.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	begin_info.pInheritanceInfo = &inheritance;
+	if (vkBeginCommandBuffer(buffer, &begin_info) != VK_SUCCESS) {
+		MAGE_ERROR(frame) << "Failed to begin secondary command buffer";
+	}
+
+	VkViewport viewport{};
+	viewport.width = static_cast<float>(extent.width);
+	viewport.height = static_cast<float>(extent.height);
+	viewport.minDepth = 0.0f;
+	viewport.maxDepth = 1.0f;
+	VkRect2D scissor{{0, 0}, extent};
+	vkCmdSetViewport(buffer, 0, 1, &viewport);
+	vkCmdSetScissor(buffer, 0, 1, &scissor);
+
+	// Even split, the first slices take the remainder
+	uint32_t base = item_count / slice_count;
+	uint32_t extra = item_count % slice_count;
+	uint32_t begin = slice * base + std::min(slice, extra);
+	uint32_t end = begin + base + (slice < extra ? 1 : 0);
+	(*slice_function)(buffer, begin, end);
+
+	if (vkEndCommandBuffer(buffer) != VK_SUCCESS) {
+		MAGE_ERROR(frame) << "Failed to end secondary command buffer";
+	}
+	slice_buffers[slice] = buffer;
+}
+
+// Thread t always records slice t, so a thread only ever touches its own pool
+void ParallelRecorder::worker_loop(uint32_t thread) {
+	CpuProfiler::get().set_thread_name("record " + std::to_string(thread));
+	uint64_t seen = 0;
+	std::unique_lock<std::mutex> lock{mutex};
+	while (true) {
+		work_ready.wait(lock, [&] {return stopping || dispatch_number != seen;});
+		if (stopping) {
+			return;
+		}
+		seen = dispatch_number;
+		if (thread >= slice_count) {
+			continue;
+		}
+		lock.unlock();
+		record_slice(thread, thread);
+		lock.lock();
+		if (--pending_slices == 0) {
+			work_done.notify_one();
+		}
+	}
+}
+
+void ParallelRecorder::record(VkCommandBuffer primary, uint32_t count, const SliceFunction &record_slice_pass) {
+	MAGE_PROFILE_ZONE("ParallelRecorder::record");
+	uint32_t slices = std::max(1u, std::min(thread_count, (count + MIN_SLICE - 1) / MIN_SLICE));
+	slice_buffers.assign(slices, VK_NULL_HANDLE);
+	{
+		// Idle workers may still be waking from the previous dispatch and reading these
+		std::lock_guard<std::mutex> lock{mutex};
+		slice_count = slices;
+		slice_function = &record_slice_pass;
+		item_count = count;
+		if (slices > 1) {
+			pending_slices = slices - 1;
+			dispatch_number++;
+		}
+	}
+	if (slices > 1) {
+		work_ready.notify_all();
+	}
+
+	record_slice(0, 0);
+	if (slices > 1) {
+		MAGE_PROFILE_ZONE("wait record slices");
+		std::unique_lock<std::mutex> lock{mutex};
+		work_done.wait(lock, [&] {return pending_slices == 0;});
+	}
+	vkCmdExecuteCommands(primary, slices, slice_buffers.data());
+}
+
+ParallelRecorder::~ParallelRecorder() {
+	{
+		std::lock_guard<std::mutex> lock{mutex};
+		stopping = true;
+	}
+	work_ready.notify_all();
+	for (auto &worker : workers) {
+		worker.join();
+	}
+	// Destroying a pool frees every buffer allocated from it
+	for (auto &frame_pools : frames) {
+		for (auto &thread_frame : frame_pools) {
+			vkDestroyCommandPool(device.get_device(), thread_frame.pool, nullptr);
+		}
+	}
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "device.hpp"
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace mage {
+
+	// Records one render pass worth of draws on several threads at once. Every thread owns a command pool per frame in
+	// flight and fills a secondary command buffer that continues the render pass DrawHandling began, the primary then
+	// runs them in slice order with vkCmdExecuteCommands. The calling thread records the first slice itself.
+	class ParallelRecorder {
+	public:
+		// record_slice(secondary, begin, end) records items [begin, end), it may run on any of the recording threads
+		using SliceFunction = std::function<void(VkCommandBuffer, uint32_t, uint32_t)>;
+	private:
+		// Fewer draws than this per thread cost more in hand-off than they save
+		static constexpr uint32_t MIN_SLICE = 64;
+		struct ThreadFrame {
+			VkCommandPool pool = VK_NULL_HANDLE;
+			std::vector<VkCommandBuffer> buffers;
+			uint32_t used = 0;
+		};
+		DeviceHandling &device;
+		uint32_t thread_count;
+		uint32_t current_frame = 0;
+		// frames[frame][thread]
+		std::vector<std::vector<ThreadFrame>> frames;
+		VkRenderPass render_pass = VK_NULL_HANDLE;
+		VkFramebuffer framebuffer = VK_NULL_HANDLE;
+		VkExtent2D extent{};
+
+		std::vector<std::thread> workers;
+		std::mutex mutex;
+		std::condition_variable work_ready;
+		std::condition_variable work_done;
+		const SliceFunction *slice_function = nullptr;
+		uint32_t item_count = 0;
+		uint32_t slice_count = 0;
+		uint64_t dispatch_number = 0;
+		uint32_t pending_slices = 0;
+		bool stopping = false;
+		std::vector<VkCommandBuffer> slice_buffers;
+
+		void worker_loop(uint32_t thread);
+		void record_slice(uint32_t thread, uint32_t slice);
+		VkCommandBuffer next_buffer(uint32_t thread);
+	public:
+		ParallelRecorder(DeviceHandling &device_pass, uint32_t frames_in_flight, uint32_t thread_count_pass);
+		~ParallelRecorder();
+		ParallelRecorder(const ParallelRecorder &) = delete;
+		ParallelRecorder &operator=(const ParallelRecorder &) = delete;
+
+		// Called by DrawHandling once the frame's fence has been waited on, so the frame's pools can be reset
+		void begin_frame(uint32_t frame_index);
+		// The render pass instance secondaries inherit, set by DrawHandling::swapchain_render_start
+		void begin_render_pass(VkRenderPass render_pass_pass, VkFramebuffer framebuffer_pass, VkExtent2D extent_pass);
+		// Splits [0, count) across the threads and executes the results in order on primary. May run several times per render pass.
+		void record(VkCommandBuffer primary, uint32_t count, const SliceFunction &record_slice);
+
+		uint32_t get_thread_count() const {return thread_count;}
+		// Secondaries executed by the last record call
+		uint32_t get_slice_count() const {return slice_count;}
+	};
+
+}
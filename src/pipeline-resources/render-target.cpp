@@ -0,0 +1,90 @@
+#include "render-target.hpp"
+#include "../debug-resources/log.hpp"
+
+#include <array>
+#include <cstdlib>
+
+using namespace mage;
+
+// Shared color + depth render pass. Only the color attachment's final layout differs between targets,
+// which keeps swapchain and offscreen render passes compatible with the same pipelines.
+VkRenderPass RenderTarget::create_render_pass(DeviceHandling &device, VkFormat color_format, VkFormat depth_format, VkImageLayout color_final_layout){
+	MAGE_INFO(swapchain) << "Attempting to create render pass...";
+
+	MAGE_INFO(swapchain) << " - creating info for depth_attachment...";
+  VkAttachmentDescription depth_attachment{};
+  depth_attachment.format = depth_format;
+  depth_attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+  depth_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+  depth_attachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+  depth_attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+  depth_attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+  depth_attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  depth_attachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+  MAGE_INFO(swapchain) << "   - referencing depth_reference...";
+  VkAttachmentReference depth_reference{};
+  depth_reference.attachment = 1;
+  depth_reference.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+	MAGE_INFO(swapchain) << " - creating info for color_attachment...";
+	VkAttachmentDescription color_attachment = {};
+	color_attachment.format = color_format;
+	color_attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+	color_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+	color_attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+	color_attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+  color_attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+	color_attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	color_attachment.finalLayout = color_final_layout;
+
+	MAGE_INFO(swapchain) << "   - referencing color_reference...";
+	VkAttachmentReference color_reference = {};
+	color_reference.attachment = 0;
+	color_reference.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+	MAGE_INFO(swapchain) << " - creating info for subpass...";
+	VkSubpassDescription subpass = {};
+	subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+	subpass.colorAttachmentCount = 1;
+	subpass.pColorAttachments = &color_reference;
+	subpass.pDepthStencilAttachment = &depth_reference;
+
+	MAGE_INFO(swapchain) << " - creating info for subpass_dependency...";
+	std::array<VkSubpassDependency, 2> subpass_dependencies = {};
+	subpass_dependencies[0].dstSubpass = 0;
+	subpass_dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+	subpass_dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+	subpass_dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+	subpass_dependencies[0].srcAccessMask = 0;
+	subpass_dependencies[0].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+
+	// Makes color writes visible to a copy recorded after the pass (offscreen readback)
+	subpass_dependencies[1].srcSubpass = 0;
+	subpass_dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+	subpass_dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+	subpass_dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+	subpass_dependencies[1].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+	subpass_dependencies[1].dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+
+	std::array<VkAttachmentDescription, 2> attachments = {color_attachment, depth_attachment};
+
+	MAGE_INFO(swapchain) << " - creating info for render_pass...";
+	VkRenderPassCreateInfo render_info = {};
+  render_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+  render_info.attachmentCount = static_cast<uint32_t>(attachments.size());
+  render_info.pAttachments = attachments.data();
+  render_info.subpassCount = 1;
+  render_info.pSubpasses = &subpass;
+  render_info.dependencyCount = static_cast<uint32_t>(subpass_dependencies.size());
+  render_info.pDependencies = subpass_dependencies.data();
+
+  MAGE_INFO(swapchain) << " - creating render pass...";
+  VkRenderPass render_pass;
+	if (vkCreateRenderPass(device.get_device(), &render_info, nullptr, &render_pass) != VK_SUCCESS){
+		MAGE_ERROR(swapchain) << "Failed to create render pass";
+		exit(EXIT_FAILURE);
+	}
+	MAGE_INFO(swapchain) << " - render pass creation successful!";
+	return render_pass;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "device.hpp"
+#include "frame-pacing.hpp"
+
+namespace mage {
+
+	// What DrawHandling renders into: either the window's swapchain or a set of offscreen images.
+	// Both hand out the same render pass layout so pipelines don't care which one is active.
+	class RenderTarget {
+	protected:
+		uint64_t fence_wait_nanoseconds = 0;
+	public:
+		virtual ~RenderTarget() = default;
+		virtual VkResult acquire_next_image(uint32_t *image_index) = 0;
+		virtual VkResult submit_command_buffers(const VkCommandBuffer *buffers, uint32_t *image_index) = 0;
+		// Recorded after the render pass ends, e.g. to copy the frame out for readback
+		virtual void record_after_render(VkCommandBuffer command_buffer, uint32_t image_index) {}
+		virtual int get_max_frames() = 0;
+		virtual VkExtent2D get_swap_extent() = 0;
+		virtual VkRenderPass get_render_pass() = 0;
+		virtual VkFramebuffer get_framebuffers(int index) = 0;
+		virtual size_t get_image_count() = 0;
+		// What the target actually runs with, after clamping and present mode fallback
+		virtual FramePacing get_frame_pacing() = 0;
+		// Running total of CPU time spent blocked on frame fences, callers diff it per frame
+		uint64_t get_fence_wait_nanoseconds() const {return fence_wait_nanoseconds;}
+
+		static VkRenderPass create_render_pass(DeviceHandling &device, VkFormat color_format, VkFormat depth_format, VkImageLayout color_final_layout);
+	};
+
+}
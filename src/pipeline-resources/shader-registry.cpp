@@ -0,0 +1,237 @@
+#include "shader-registry.hpp"
+#include "hash.hpp"
+#include "../debug-resources/log.hpp"
+
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <utility>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace mage;
+
+namespace {
+
+	const uint32_t SPIRV_MAGIC = 0x07230203;
+
+}
+
+// --- MappedFile ---
+
+MappedFile::MappedFile(const std::string &path) {
+#ifdef _WIN32
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE) {
+		return;
+	}
+	LARGE_INTEGER file_size;
+	if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0) {
+		CloseHandle(file);
+		return;
+	}
+	HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mapping == nullptr) {
+		CloseHandle(file);
+		return;
+	}
+	data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (data == nullptr) {
+		CloseHandle(mapping);
+		CloseHandle(file);
+		return;
+	}
+	size = static_cast<size_t>(file_size.QuadPart);
+	file_handle = file;
+	mapping_handle = mapping;
+#else
+	int file = open(path.c_str(), O_RDONLY);
+	if (file < 0) {
+		return;
+	}
+	struct stat status;
+	if (fstat(file, &status) != 0 || status.st_size == 0) {
+		::close(file);
+		return;
+	}
+	void *mapping = mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+	// The mapping keeps its own reference to the file
+	::close(file);
+	if (mapping == MAP_FAILED) {
+		return;
+	}
+	data = mapping;
+	size = static_cast<size_t>(status.st_size);
+#endif
+}
+
+MappedFile::~MappedFile() {
+	close();
+}
+
+MappedFile::MappedFile(MappedFile &&other) noexcept {
+	*this = std::move(other);
+}
+
+MappedFile &MappedFile::operator=(MappedFile &&other) noexcept {
+	if (this != &other) {
+		close();
+		std::swap(data, other.data);
+		std::swap(size, other.size);
+#ifdef _WIN32
+		std::swap(file_handle, other.file_handle);
+		std::swap(mapping_handle, other.mapping_handle);
+#endif
+	}
+	return *this;
+}
+
+void MappedFile::close() {
+	if (data == nullptr) {
+		return;
+	}
+#ifdef _WIN32
+	UnmapViewOfFile(data);
+	CloseHandle(mapping_handle);
+	CloseHandle(file_handle);
+	file_handle = nullptr;
+	mapping_handle = nullptr;
+#else
+	munmap(const_cast<void*>(data), size);
+#endif
+	data = nullptr;
+	size = 0;
+}
+
+// --- ShaderModule ---
+
+ShaderModule::ShaderModule(ShaderRegistry *registry_pass, uint64_t key_pass, VkShaderModule module_pass)
+	: registry{registry_pass}, key{key_pass}, module{module_pass} {
+}
+
+ShaderModule::~ShaderModule() {
+	release();
+}
+
+ShaderModule::ShaderModule(ShaderModule &&other) noexcept {
+	*this = std::move(other);
+}
+
+ShaderModule &ShaderModule::operator=(ShaderModule &&other) noexcept {
+	if (this != &other) {
+		release();
+		registry = std::exchange(other.registry, nullptr);
+		key = other.key;
+		module = std::exchange(other.module, VK_NULL_HANDLE);
+	}
+	return *this;
+}
+
+void ShaderModule::release() {
+	if (registry != nullptr) {
+		registry->release(key);
+		registry = nullptr;
+		module = VK_NULL_HANDLE;
+	}
+}
+
+// --- ShaderRegistry ---
+
+ShaderRegistry::ShaderRegistry(VkDevice device_pass, std::string asset_root_pass)
+	: device{device_pass}, asset_root{std::move(asset_root_pass)} {
+	MAGE_INFO(pipeline) << "Shader asset root: " << (asset_root.empty() ? "." : asset_root);
+}
+
+ShaderRegistry::~ShaderRegistry() {
+	if (!modules.empty()) {
+		MAGE_WARN(pipeline) << modules.size() << " shader module(s) still referenced at shutdown";
+		for (auto &entry : modules) {
+			vkDestroyShaderModule(device, entry.second.module, nullptr);
+		}
+	}
+	MAGE_INFO(pipeline) << "Shader registry: " << statistics.modules_created << " module(s) created, "
+	                    << statistics.modules_reused << " reused, " << statistics.bytes_mapped << " byte(s) mapped";
+}
+
+// Absolute paths are used as given, relative ones are looked up under the asset root
+std::string ShaderRegistry::resolve(const std::string &path) const {
+	std::filesystem::path file{path};
+	if (asset_root.empty() || file.is_absolute()) {
+		return path;
+	}
+	return (std::filesystem::path{asset_root} / file).string();
+}
+
+// The driver reads SPIR-V straight out of the mapping, the file is never copied into our own memory
+ShaderModule ShaderRegistry::acquire(const std::string &path) {
+	std::string resolved = resolve(path);
+	MappedFile file{resolved};
+	if (!file.is_open()) {
+		MAGE_ERROR(pipeline) << "Failed to open shader " << resolved;
+		exit(EXIT_FAILURE);
+	}
+	uint32_t magic = 0;
+	if (file.get_size() >= sizeof(magic)) {
+		std::memcpy(&magic, file.get_data(), sizeof(magic));
+	}
+	if (file.get_size() % sizeof(uint32_t) != 0 || magic != SPIRV_MAGIC) {
+		MAGE_ERROR(pipeline) << "Shader " << resolved << " is not SPIR-V";
+		exit(EXIT_FAILURE);
+	}
+	uint64_t key = hash_bytes(file.get_data(), file.get_size());
+
+	std::lock_guard<std::mutex> lock{registry_mutex};
+	statistics.bytes_mapped += file.get_size();
+	auto found = modules.find(key);
+	if (found != modules.end() && found->second.size == file.get_size()) {
+		found->second.references++;
+		statistics.modules_reused++;
+		MAGE_DEBUG(pipeline) << "   - reusing shader module for " << resolved;
+		return ShaderModule{this, key, found->second.module};
+	}
+	if (found != modules.end()) {
+		MAGE_ERROR(pipeline) << "Shader hash collision on " << resolved;
+		exit(EXIT_FAILURE);
+	}
+
+	MAGE_INFO(pipeline) << "   - creating shader module for " << resolved << "...";
+	VkShaderModuleCreateInfo create_info{};
+	create_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+	create_info.codeSize = file.get_size();
+	create_info.pCode = static_cast<const uint32_t*>(file.get_data());
+	VkShaderModule module;
+	if (vkCreateShaderModule(device, &create_info, nullptr, &module) != VK_SUCCESS) {
+		MAGE_ERROR(pipeline) << "Failed to create shader module";
+		exit(EXIT_FAILURE);
+	}
+	modules.emplace(key, Entry{module, 1, file.get_size()});
+	statistics.modules_created++;
+	return ShaderModule{this, key, module};
+}
+
+// Pipelines keep their own copy of the compiled code, so a module can go as soon as the last creation using it is done
+void ShaderRegistry::release(uint64_t key) {
+	std::lock_guard<std::mutex> lock{registry_mutex};
+	auto found = modules.find(key);
+	if (found == modules.end()) {
+		return;
+	}
+	if (--found->second.references == 0) {
+		vkDestroyShaderModule(device, found->second.module, nullptr);
+		modules.erase(found);
+		statistics.modules_destroyed++;
+	}
+}
+
+ShaderStatistics ShaderRegistry::get_statistics() {
+	std::lock_guard<std::mutex> lock{registry_mutex};
+	return statistics;
+}
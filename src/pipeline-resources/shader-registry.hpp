@@ -0,0 +1,92 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace mage {
+
+	class ShaderRegistry;
+
+	// Read-only memory mapping of a whole file, the pages are only touched when the driver reads them
+	class MappedFile {
+	private:
+		const void *data = nullptr;
+		size_t size = 0;
+#ifdef _WIN32
+		void *file_handle = nullptr;
+		void *mapping_handle = nullptr;
+#endif
+		void close();
+	public:
+		MappedFile() = default;
+		explicit MappedFile(const std::string &path);
+		~MappedFile();
+		MappedFile(MappedFile &&other) noexcept;
+		MappedFile &operator=(MappedFile &&other) noexcept;
+		MappedFile(const MappedFile&) = delete;
+		MappedFile &operator=(const MappedFile&) = delete;
+
+		bool is_open() const {return data != nullptr;}
+		const void *get_data() const {return data;}
+		size_t get_size() const {return size;}
+	};
+
+	// Reference to a registry module, released when it goes out of scope
+	class ShaderModule {
+	private:
+		ShaderRegistry *registry = nullptr;
+		uint64_t key = 0;
+		VkShaderModule module = VK_NULL_HANDLE;
+	public:
+		ShaderModule() = default;
+		ShaderModule(ShaderRegistry *registry_pass, uint64_t key_pass, VkShaderModule module_pass);
+		~ShaderModule();
+		ShaderModule(ShaderModule &&other) noexcept;
+		ShaderModule &operator=(ShaderModule &&other) noexcept;
+		ShaderModule(const ShaderModule&) = delete;
+		ShaderModule &operator=(const ShaderModule&) = delete;
+		void release();
+
+		VkShaderModule get() const {return module;}
+	};
+
+	struct ShaderStatistics {
+		uint32_t modules_created = 0;
+		uint32_t modules_reused = 0;
+		uint32_t modules_destroyed = 0;
+		uint64_t bytes_mapped = 0;
+	};
+
+	// Shader modules keyed by SPIR-V content hash, so identical bytecode under any path is one VkShaderModule.
+	// A module lives only while some pipeline creation holds a reference to it.
+	class ShaderRegistry {
+	private:
+		struct Entry {
+			VkShaderModule module;
+			uint32_t references;
+			size_t size;
+		};
+		VkDevice device;
+		std::string asset_root;
+		std::unordered_map<uint64_t, Entry> modules;
+		ShaderStatistics statistics{};
+		std::mutex registry_mutex;
+		friend class ShaderModule;
+		void release(uint64_t key);
+	public:
+		ShaderRegistry(VkDevice device_pass, std::string asset_root_pass);
+		~ShaderRegistry();
+		ShaderRegistry(const ShaderRegistry&) = delete;
+		ShaderRegistry &operator=(const ShaderRegistry&) = delete;
+		ShaderModule acquire(const std::string &path);
+		std::string resolve(const std::string &path) const;
+
+		void set_asset_root(std::string root) {asset_root = std::move(root);}
+		const std::string &get_asset_root() const {return asset_root;}
+		ShaderStatistics get_statistics();
+	};
+
+}
@@ -1,10 +1,10 @@
 #include "swapchain.hpp"
-#include <iostream>
+#include "../debug-resources/log.hpp"
+#include "../debug-resources/cpu-profiler.hpp"
 
 #include <array>
 #include <cstdlib>
 #include <cstring>
-#include <iostream>
 #include <limits>
 #include <set>
 #include <stdexcept>
@@ -15,46 +15,50 @@
 using namespace mage;
 
 
-SwapChainHandling::SwapChainHandling(DeviceHandling &device_pass, VkExtent2D extent_pass) : device{device_pass}, window_extent{extent_pass} {
-	std::cout << std::endl << "=== SWAP CHAIN HANDLING ===" << std::endl;
+SwapChainHandling::SwapChainHandling(DeviceHandling &device_pass, VkExtent2D extent_pass, FramePacing pacing_pass) : device{device_pass}, requested{pacing_pass}, window_extent{extent_pass} {
+	MAGE_INFO(swapchain) << "=== SWAP CHAIN HANDLING ===";
 	create_swap_chain();
 	create_image_views();
 	create_render_pass();
 	create_depth_resources();
 	create_framebuffers();
 	create_sync_objects();	
-	std:: cout << "=== SWAP CHAIN HANDLING SUCCESSFUL ===" << std::endl;
+	MAGE_INFO(swapchain) << "=== SWAP CHAIN HANDLING SUCCESSFUL ===";
 }
 
-SwapChainHandling::SwapChainHandling(DeviceHandling &device_pass, VkExtent2D extent_pass, std::shared_ptr<SwapChainHandling> previous) : device{device_pass}, window_extent{extent_pass} {
-	std::cout << std::endl << "=== SWAP CHAIN HANDLING ===" << std::endl;
-	create_swap_chain();
+SwapChainHandling::SwapChainHandling(DeviceHandling &device_pass, VkExtent2D extent_pass, std::shared_ptr<SwapChainHandling> previous, FramePacing pacing_pass) : device{device_pass}, requested{pacing_pass}, window_extent{extent_pass} {
+	MAGE_INFO(swapchain) << "=== SWAP CHAIN RECREATION ===";
+	create_swap_chain(previous->swap_chain);
 	create_image_views();
-	create_render_pass();
+	if (previous->swap_image_format == swap_image_format && previous->swap_depth_format == find_depth_format()) {
+		MAGE_INFO(swapchain) << " - formats unchanged, reusing render pass...";
+		render_pass = previous->render_pass;
+		previous->render_pass = VK_NULL_HANDLE;
+	} else {
+		create_render_pass();
+	}
 	create_depth_resources();
 	create_framebuffers();
-	create_sync_objects();	
-	std:: cout << "=== SWAP CHAIN HANDLING SUCCESSFUL ===" << std::endl;
+	adopt_sync_objects(*previous);
+	MAGE_INFO(swapchain) << "=== SWAP CHAIN RECREATION SUCCESSFUL ===";
 }
 
 
 // Fully create swap chain
-void SwapChainHandling::create_swap_chain() {
-	std::cout << "Attempting to create swap chain..." << std::endl;
+void SwapChainHandling::create_swap_chain(VkSwapchainKHR old_chain) {
+	MAGE_INFO(swapchain) << "Attempting to create swap chain...";
 
-	std::cout << " - choosing format, mode, and extent..." << std::endl;
+	MAGE_INFO(swapchain) << " - choosing format, mode, and extent...";
 	SwapChainSupport swap_support = device.get_swap_chain_support();
 	VkSurfaceFormatKHR surface_format = choose_swap_format(swap_support.formats);
+	pacing.frames_in_flight = std::min(std::max(requested.frames_in_flight, FramePacing::MIN_FRAMES_IN_FLIGHT), FramePacing::MAX_FRAMES_IN_FLIGHT);
 	VkPresentModeKHR present_mode = choose_swap_mode(swap_support.present_modes);
 	VkExtent2D present_extent = choose_swap_extent(swap_support.capabilities);
 
-	std::cout << " - getting image count..." << std::endl;
-	uint32_t image_count = swap_support.capabilities.minImageCount+1;
-	if (swap_support.capabilities.maxImageCount > 0 && image_count > swap_support.capabilities.maxImageCount) {
-		image_count = swap_support.capabilities.maxImageCount;
-	}
+	MAGE_INFO(swapchain) << " - getting image count...";
+	uint32_t image_count = choose_image_count(swap_support.capabilities);
 
-	std::cout << " - creating swap chain info..." << std::endl;
+	MAGE_INFO(swapchain) << " - creating swap chain info...";
 	VkSwapchainCreateInfoKHR create_info{};
 	create_info.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
 	create_info.surface = device.get_surface();
@@ -65,7 +69,7 @@ void SwapChainHandling::create_swap_chain() {
 	create_info.imageArrayLayers = 1;
 	create_info.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
 
-	std::cout << " - getting queue indices..." << std::endl;
+	MAGE_INFO(swapchain) << " - getting queue indices...";
 	QueueIndices indices = device.get_queue_families();
 	uint32_t queue_indices[] = {indices.graphics_family, indices.present_family};
 	if (indices.graphics_family != indices.present_family) {
@@ -82,11 +86,12 @@ void SwapChainHandling::create_swap_chain() {
 	create_info.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
 	create_info.presentMode = present_mode;
 	create_info.clipped = VK_TRUE;
-	create_info.oldSwapchain = VK_NULL_HANDLE;
+	// Lets the driver hand resources over from the swapchain being replaced, which is retired but stays valid until destroyed
+	create_info.oldSwapchain = old_chain;
 
-	std::cout << " - creating swap chain..." << std::endl;
+	MAGE_INFO(swapchain) << " - creating swap chain...";
 	if (vkCreateSwapchainKHR(device.get_device(), &create_info, nullptr, &swap_chain) != VK_SUCCESS) {
-		std::cerr << "failed to create swap chain";
+		MAGE_ERROR(swapchain) << "failed to create swap chain";
 	    	exit(EXIT_FAILURE);		
 	}
 
@@ -95,14 +100,18 @@ void SwapChainHandling::create_swap_chain() {
 	vkGetSwapchainImagesKHR(device.get_device(), swap_chain, &image_count, swap_images.data());
 	swap_image_format = surface_format.format;
 	swap_extent = present_extent;
+	// The driver may hand out more images than asked for, report what it made
+	pacing.image_count = image_count;
+	MAGE_INFO(swapchain) << " - frame pacing: " << pacing.frames_in_flight << " frame(s) in flight, " << pacing.image_count
+	                     << " image(s), " << present_mode_name(pacing.present_mode);
 
-	std::cout << " - swap chain creation successful!" << std::endl;
+	MAGE_INFO(swapchain) << " - swap chain creation successful!";
 
 }
 
 
 VkSurfaceFormatKHR SwapChainHandling::choose_swap_format(const std::vector<VkSurfaceFormatKHR>& formats) {
-	std::cout << "   - choosing swap format..." << std::endl;
+	MAGE_INFO(swapchain) << "   - choosing swap format...";
   for (const auto &avilable_format : formats) {
     if (avilable_format.format == VK_FORMAT_B8G8R8A8_UNORM &&
         avilable_format.colorSpace == VK_COLOR_SPACE_SRGB_NONLINEAR_KHR) {
@@ -113,21 +122,31 @@ VkSurfaceFormatKHR SwapChainHandling::choose_swap_format(const std::vector<VkSur
 }
 
 
-// Choose swapping conditions under presentation mode
+// Choose swapping conditions under presentation mode, falling back from the requested one when the surface lacks it
 VkPresentModeKHR SwapChainHandling::choose_swap_mode(const std::vector<VkPresentModeKHR>& modes) {
-	std::cout << "   - choosing swap mode..." << std::endl;
- 	for (const auto &available_present_modes : modes) {
-    if (available_present_modes == VK_PRESENT_MODE_MAILBOX_KHR) {
-      return available_present_modes;
-    }
-  }
-  return VK_PRESENT_MODE_FIFO_KHR;
+	MAGE_INFO(swapchain) << "   - choosing swap mode...";
+	pacing.present_mode = choose_present_mode(requested.present_mode, modes);
+	if (pacing.present_mode != requested.present_mode) {
+		MAGE_WARN(swapchain) << "Present mode " << present_mode_name(requested.present_mode) << " is not supported, using "
+		                     << present_mode_name(pacing.present_mode);
+	}
+	return to_vulkan(pacing.present_mode);
+}
+
+
+// A requested count of 0 keeps one image beyond the minimum, so acquiring never has to wait on the presentation engine
+uint32_t SwapChainHandling::choose_image_count(const VkSurfaceCapabilitiesKHR& capabilities) {
+	uint32_t image_count = requested.image_count == 0 ? capabilities.minImageCount + 1 : std::max(requested.image_count, capabilities.minImageCount);
+	if (capabilities.maxImageCount > 0 && image_count > capabilities.maxImageCount) {
+		image_count = capabilities.maxImageCount;
+	}
+	return image_count;
 }
 
 
 // Choose extent of swap, setting resolution of images in swap)
 VkExtent2D SwapChainHandling::choose_swap_extent(const VkSurfaceCapabilitiesKHR& capabilities) {
-	std::cout << "   - choosing swap extent..." << std::endl;
+	MAGE_INFO(swapchain) << "   - choosing swap extent...";
 	if (capabilities.currentExtent.width != std::numeric_limits<uint32_t>::max()) {
 		return capabilities.currentExtent;
 	} else {
@@ -141,11 +160,11 @@ VkExtent2D SwapChainHandling::choose_swap_extent(const VkSurfaceCapabilitiesKHR&
 
 // Create a view onto the image for VkImage
 void SwapChainHandling::create_image_views() {
-	std::cout << "Attempting to create image views..." << std::endl;
+	MAGE_INFO(swapchain) << "Attempting to create image views...";
 	swap_image_views.resize(swap_images.size());
 
 	for (size_t i = 0; i < swap_images.size(); i++) {
-		std::cout << " - creating info for image view..." << std::endl;
+		MAGE_INFO(swapchain) << " - creating info for image view...";
 		VkImageViewCreateInfo create_info{};
     create_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
     create_info.image = swap_images[i];
@@ -157,87 +176,20 @@ void SwapChainHandling::create_image_views() {
     create_info.subresourceRange.baseArrayLayer = 0;
     create_info.subresourceRange.layerCount = 1;
 
-    std::cout << " - attempting to create image view..." << std::endl;
+    MAGE_INFO(swapchain) << " - attempting to create image view...";
 		if (vkCreateImageView(device.get_device(), &create_info, nullptr, &swap_image_views[i]) != VK_SUCCESS) {	
-			std::cerr << "failed to create swap chain";
+			MAGE_ERROR(swapchain) << "failed to create swap chain";
 	    exit(EXIT_FAILURE);		
 		}
 	}
 
-	std::cout << " - image view creation successful!" << std::endl;
+	MAGE_INFO(swapchain) << " - image view creation successful!";
 
 }
 
 
 void SwapChainHandling::create_render_pass(){
-	std::cout << "Attempting to create render pass..." << std::endl;
-
-	std::cout << " - creating info for depth_attachment..." << std::endl;
-  VkAttachmentDescription depth_attachment{};
-  depth_attachment.format = find_depth_format();
-  depth_attachment.samples = VK_SAMPLE_COUNT_1_BIT;
-  depth_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-  depth_attachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-  depth_attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-  depth_attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-  depth_attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-  depth_attachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-
-  std::cout << "   - referencing depth_reference..." << std::endl;
-  VkAttachmentReference depth_reference{};
-  depth_reference.attachment = 1;
-  depth_reference.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-
-	std::cout << " - creating info for color_attachment..." << std::endl;
-	VkAttachmentDescription color_attachment = {};
-	color_attachment.format = swap_image_format;
-	color_attachment.samples = VK_SAMPLE_COUNT_1_BIT;
-	color_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-	color_attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-	color_attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-  color_attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-	color_attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-	color_attachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
-
-	std::cout << "   - referencing color_reference..." << std::endl;
-	VkAttachmentReference color_reference = {};
-	color_reference.attachment = 0;
-	color_reference.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-
-	std::cout << " - creating info for subpass..." << std::endl;
-	VkSubpassDescription subpass = {};
-	subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-	subpass.colorAttachmentCount = 1;
-	subpass.pColorAttachments = &color_reference;
-	subpass.pDepthStencilAttachment = &depth_reference;
-
-	std::cout << " - creating info for subpass_dependency..." << std::endl;
-	VkSubpassDependency subpass_dependency = {};
-	subpass_dependency.dstSubpass = 0;
-	subpass_dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-	subpass_dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-	subpass_dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-	subpass_dependency.srcAccessMask = 0;
-	subpass_dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-
-	std::array<VkAttachmentDescription, 2> attachments = {color_attachment, depth_attachment};
-
-	std::cout << " - creating info for render_pass..." << std::endl;
-	VkRenderPassCreateInfo render_info = {};
-  render_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-  render_info.attachmentCount = static_cast<uint32_t>(attachments.size());
-  render_info.pAttachments = attachments.data();
-  render_info.subpassCount = 1;
-  render_info.pSubpasses = &subpass;
-  render_info.dependencyCount = 1;
-  render_info.pDependencies = &subpass_dependency;
-
-  std::cout << " - creating render pass..." << std::endl;
-	if (vkCreateRenderPass(device.get_device(), &render_info, nullptr, &render_pass) != VK_SUCCESS){
-		std::cerr << "Failed to create render pass";
-		exit(EXIT_FAILURE);
-	}
-	std::cout << " - render pass creation successful!" << std::endl;
+  render_pass = RenderTarget::create_render_pass(device, swap_image_format, find_depth_format(), VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
 }
 
 
@@ -249,17 +201,17 @@ VkFormat SwapChainHandling::find_depth_format(){
 
 
 void SwapChainHandling::create_depth_resources(){
-	std::cout << "Attempting to create depth resources..." << std::endl;
+	MAGE_INFO(swapchain) << "Attempting to create depth resources...";
 
-	std::cout << " - addressing depth format..." << std::endl;
+	MAGE_INFO(swapchain) << " - addressing depth format...";
 	VkFormat depth_format = find_depth_format();
 	swap_depth_format = depth_format;
   depth_images.resize(swap_images.size());
-  depth_images_memories.resize(swap_images.size());
+  depth_images_allocations.resize(swap_images.size());
   depth_images_views.resize(swap_images.size());
 
   for (int i = 0; i < depth_images.size(); i++) {
-  	std::cout << " - creating info for image_info..." << std::endl;
+  	MAGE_INFO(swapchain) << " - creating info for image_info...";
     VkImageCreateInfo image_info{};
     image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
     image_info.imageType = VK_IMAGE_TYPE_2D;
@@ -275,9 +227,9 @@ void SwapChainHandling::create_depth_resources(){
     image_info.samples = VK_SAMPLE_COUNT_1_BIT;
     image_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
     image_info.flags = 0;
-    create_image(image_info, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, depth_images[i], depth_images_memories[i]);
+    create_image(image_info, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, depth_images[i], depth_images_allocations[i]);
 
-    std::cout << " - creating info for view_info..." << std::endl;
+    MAGE_INFO(swapchain) << " - creating info for view_info...";
     VkImageViewCreateInfo view_info{};
     view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
     view_info.image = depth_images[i];
@@ -289,68 +241,34 @@ void SwapChainHandling::create_depth_resources(){
     view_info.subresourceRange.baseArrayLayer = 0;
     view_info.subresourceRange.layerCount = 1;
 
-    std::cout << " - creating image view..." << std::endl;
+    MAGE_INFO(swapchain) << " - creating image view...";
     if (vkCreateImageView(device.get_device(), &view_info, nullptr, &depth_images_views[i]) != VK_SUCCESS) {
       throw std::runtime_error("failed to create texture image view!");
     }
-    std::cout << " - depth resource creation successful!" << std::endl;
+    MAGE_INFO(swapchain) << " - depth resource creation successful!";
   }
 }
 
 
-void SwapChainHandling::create_image(const VkImageCreateInfo &image_info, VkMemoryPropertyFlags properties, VkImage &image, VkDeviceMemory &image_memory) {
-  std::cout << "   - creating image...." << std::endl;
-  if (vkCreateImage(device.get_device(), &image_info, nullptr, &image) != VK_SUCCESS) {
-    std::cerr << "Failed to create image" << std::endl;
-  	exit(EXIT_FAILURE);
-  }
-
-  std::cout << "   - finding memory requirements and allocating space..." << std::endl;
-  VkMemoryRequirements memory_requirements;
-  vkGetImageMemoryRequirements(device.get_device(), image, &memory_requirements);
-  VkMemoryAllocateInfo allocate_info{};
-  allocate_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-  allocate_info.allocationSize = memory_requirements.size;
-  allocate_info.memoryTypeIndex = find_memory_type(memory_requirements.memoryTypeBits, properties);
-
-	if (vkAllocateMemory(device.get_device(), &allocate_info, nullptr, &image_memory) != VK_SUCCESS) {
-  	std::cerr << "Failed to allocate image memory" << std::endl;
-  	exit(EXIT_FAILURE);
-  } 
-
-  if (vkBindImageMemory(device.get_device(), image, image_memory, 0) != VK_SUCCESS) {
-    std::cerr << "Failed to bind image memory" << std::endl;
-  	exit(EXIT_FAILURE);
-  }
-
-  std::cout << "   - image creation and memory allocation successful!" << std::endl;
+void SwapChainHandling::create_image(const VkImageCreateInfo &image_info, VkMemoryPropertyFlags properties, VkImage &image, MemoryAllocation &image_allocation) {
+  device.create_image(image_info, properties, image, image_allocation);
 }
 
 
 uint32_t SwapChainHandling::find_memory_type(uint32_t type_filter, VkMemoryPropertyFlags properties) {
-	std::cout << "     - finding memory type..." << std::endl;
-  VkPhysicalDeviceMemoryProperties memory_properties;
-  vkGetPhysicalDeviceMemoryProperties(device.get_card(), &memory_properties);
-  for (uint32_t i = 0; i < memory_properties.memoryTypeCount; i++) {
-    if ((type_filter & (1 << i)) &&
-        (memory_properties.memoryTypes[i].propertyFlags & properties) == properties) {
-      return i;
-    }
-  }
-	std::cerr << "Failed to find memory type" << std::endl;
-  exit(EXIT_FAILURE);
+  return device.find_memory_type(type_filter, properties);
 }
 
 
 void SwapChainHandling::create_framebuffers(){
-	std::cout << "Attempting to create framebuffer..." << std::endl;
+	MAGE_INFO(swapchain) << "Attempting to create framebuffer...";
 	swap_chain_framebuffers.resize(swap_images.size());
 
 	for (size_t i = 0; i < swap_images.size(); i++){
-		std::cout << "   - grabbing framebuffer attachments..." << std::endl;
+		MAGE_INFO(swapchain) << "   - grabbing framebuffer attachments...";
 		std::array<VkImageView, 2> attachments = {swap_image_views[i], depth_images_views[i]};
 		
-		std::cout << "   - creating framebuffer info..." << std::endl;
+		MAGE_INFO(swapchain) << "   - creating framebuffer info...";
     VkFramebufferCreateInfo framebuffer_info = {};
     framebuffer_info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
     framebuffer_info.renderPass = render_pass;
@@ -360,51 +278,73 @@ void SwapChainHandling::create_framebuffers(){
     framebuffer_info.height = swap_extent.height;
     framebuffer_info.layers = 1;
 
-		std::cout << "   - creating framebuffer..." << std::endl;
+		MAGE_INFO(swapchain) << "   - creating framebuffer...";
 		if (vkCreateFramebuffer(device.get_device(), &framebuffer_info, nullptr, &swap_chain_framebuffers[i]) != VK_SUCCESS) {
-			std::cerr << "Failed to create framebuffer" << std::endl;
+			MAGE_ERROR(swapchain) << "Failed to create framebuffer";
 			exit(EXIT_FAILURE);
 		}
-		std::cout << "   - individual framebuffer creation successful!" << std::endl;
+		MAGE_INFO(swapchain) << "   - individual framebuffer creation successful!";
 	}
-	std::cout << " - total framebuffer creation successful!" << std::endl;
+	MAGE_INFO(swapchain) << " - total framebuffer creation successful!";
 }
 
 
 void SwapChainHandling::create_sync_objects(){
-	std::cout << "Attempting to sync objects..." << std::endl;
+	MAGE_INFO(swapchain) << "Attempting to sync objects...";
 
-	std::cout << " - resizing semaphores and flight-related objects..." << std::endl;
-	image_available_semaphores.resize(MAX_FRAMES);
- 	render_available_semaphores.resize(MAX_FRAMES);
-  in_flight_fences.resize(MAX_FRAMES);
+	MAGE_INFO(swapchain) << " - resizing semaphores and flight-related objects...";
+	image_available_semaphores.resize(pacing.frames_in_flight);
+ 	render_available_semaphores.resize(pacing.frames_in_flight);
+  in_flight_fences.resize(pacing.frames_in_flight);
   images_in_flight.resize(swap_images.size(), VK_NULL_HANDLE);
 
-  std::cout << " - creating info for semaphore_info and fence_info..." << std::endl;
+  MAGE_INFO(swapchain) << " - creating info for semaphore_info and fence_info...";
   VkSemaphoreCreateInfo semaphore_info = {};
   semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
   VkFenceCreateInfo fence_info = {};
   fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
   fence_info.flags = VK_FENCE_CREATE_SIGNALED_BIT;
 
-  std::cout << " - attempting to create semaphores and fences..." << std::endl;
-  for (size_t i = 0; i < MAX_FRAMES; i++) {
+  MAGE_INFO(swapchain) << " - attempting to create semaphores and fences...";
+  for (size_t i = 0; i < pacing.frames_in_flight; i++) {
     if (vkCreateSemaphore(device.get_device(), &semaphore_info, nullptr, &image_available_semaphores[i]) != VK_SUCCESS ||
         vkCreateSemaphore(device.get_device(), &semaphore_info, nullptr, &render_available_semaphores[i]) != VK_SUCCESS ||
         vkCreateFence(device.get_device(), &fence_info, nullptr, &in_flight_fences[i]) != VK_SUCCESS) {
-      		std::cerr << "Failed to sync objects" << std::endl;
+      		MAGE_ERROR(swapchain) << "Failed to sync objects";
       		exit(EXIT_FAILURE);
     }
   }
-  std::cout << " - semaphore and fence creation successful!" << std::endl;
+  MAGE_INFO(swapchain) << " - semaphore and fence creation successful!";
+}
+
+
+void SwapChainHandling::adopt_sync_objects(SwapChainHandling &previous){
+	MAGE_INFO(swapchain) << "Attempting to adopt sync objects...";
+	image_available_semaphores = std::move(previous.image_available_semaphores);
+	render_available_semaphores = std::move(previous.render_available_semaphores);
+	in_flight_fences = std::move(previous.in_flight_fences);
+	previous.image_available_semaphores.clear();
+	previous.render_available_semaphores.clear();
+	previous.in_flight_fences.clear();
+	// Fences of the old images stay with the frame slots they belong to, the new images start out unclaimed
+	images_in_flight.assign(swap_images.size(), VK_NULL_HANDLE);
+	current_frame = previous.current_frame;
+	fence_wait_nanoseconds = previous.fence_wait_nanoseconds;
+	MAGE_INFO(swapchain) << " - sync object adoption successful!";
 }
 
 
 VkResult SwapChainHandling::acquire_next_image(uint32_t *image_index) {
-	std::cout << "     - waiting for fences..." << std::endl;
-  vkWaitForFences(device.get_device(), 1, &in_flight_fences[current_frame], VK_TRUE, std::numeric_limits<uint64_t>::max());
+  MAGE_PROFILE_ZONE("SwapChainHandling::acquire_next_image");
+	MAGE_TRACE(frame) << "     - waiting for fences...";
+  {
+    MAGE_PROFILE_ZONE("wait in_flight_fences");
+    uint64_t wait_start = CpuProfiler::now();
+    vkWaitForFences(device.get_device(), 1, &in_flight_fences[current_frame], VK_TRUE, std::numeric_limits<uint64_t>::max());
+    fence_wait_nanoseconds += CpuProfiler::now() - wait_start;
+  }
 
-  std::cout << "     - acquiring next image..." << std::endl;
+  MAGE_TRACE(frame) << "     - acquiring next image...";
   VkResult result = vkAcquireNextImageKHR(device.get_device(), swap_chain,
   																				std::numeric_limits<uint64_t>::max(), image_available_semaphores[current_frame],
       																		VK_NULL_HANDLE, image_index);
@@ -414,17 +354,21 @@ VkResult SwapChainHandling::acquire_next_image(uint32_t *image_index) {
 
 
 VkResult SwapChainHandling::submit_command_buffers(const VkCommandBuffer *buffers, uint32_t *image_index) {
-  std::cout << "Attempting to submit command buffers..." << std::endl;
+  MAGE_PROFILE_ZONE("SwapChainHandling::submit_command_buffers");
+  MAGE_TRACE(frame) << "Attempting to submit command buffers...";
 
-  std::cout << " - waiting for fences if images in flight..." << std::endl;
+  MAGE_TRACE(frame) << " - waiting for fences if images in flight...";
   if (images_in_flight[*image_index] != VK_NULL_HANDLE) {
+    MAGE_PROFILE_ZONE("wait images_in_flight");
+    uint64_t wait_start = CpuProfiler::now();
     vkWaitForFences(device.get_device(), 1, &images_in_flight[*image_index], VK_TRUE, UINT64_MAX);
+    fence_wait_nanoseconds += CpuProfiler::now() - wait_start;
   }
 
-  std::cout << " - setting image in flight to current_frame flight fence..." << std::endl;
+  MAGE_TRACE(frame) << " - setting image in flight to current_frame flight fence...";
   images_in_flight[*image_index] = in_flight_fences[current_frame];
 
-  std::cout << " - creating info for submit_info..." << std::endl;
+  MAGE_TRACE(frame) << " - creating info for submit_info...";
   VkSubmitInfo submit_info = {};
   submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
@@ -441,14 +385,17 @@ VkResult SwapChainHandling::submit_command_buffers(const VkCommandBuffer *buffer
   submit_info.signalSemaphoreCount = 1;
   submit_info.pSignalSemaphores = signal_semaphores;
 
-  std::cout << " - reseting fences and suibmiting graphics queue..." << std::endl;
+  MAGE_TRACE(frame) << " - reseting fences and suibmiting graphics queue...";
   vkResetFences(device.get_device(), 1, &in_flight_fences[current_frame]);
-  if (vkQueueSubmit(device.get_graphics_queue(), 1, &submit_info, in_flight_fences[current_frame]) != VK_SUCCESS) {
-  	std::cerr << "Failed to submit graphics queue" << std::endl;
-  	exit(EXIT_FAILURE);
+  {
+    MAGE_PROFILE_ZONE("vkQueueSubmit");
+    if (vkQueueSubmit(device.get_graphics_queue(), 1, &submit_info, in_flight_fences[current_frame]) != VK_SUCCESS) {
+    	MAGE_ERROR(frame) << "Failed to submit graphics queue";
+    	exit(EXIT_FAILURE);
+    }
   }
 
-  std::cout << " - creating info for present_info..." << std::endl;
+  MAGE_TRACE(frame) << " - creating info for present_info...";
   VkPresentInfoKHR present_info = {};
   present_info.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
   present_info.waitSemaphoreCount = 1;
@@ -457,10 +404,14 @@ VkResult SwapChainHandling::submit_command_buffers(const VkCommandBuffer *buffer
   present_info.swapchainCount = 1;
   present_info.pSwapchains = swap_chains;
   present_info.pImageIndices = image_index;
-  auto result = vkQueuePresentKHR(device.get_present_queue(), &present_info);
-  current_frame = (current_frame + 1) % MAX_FRAMES;
+  VkResult result;
+  {
+    MAGE_PROFILE_ZONE("vkQueuePresentKHR");
+    result = vkQueuePresentKHR(device.get_present_queue(), &present_info);
+  }
+  current_frame = (current_frame + 1) % pacing.frames_in_flight;
 
-  std::cout << " - command buffer submission successful!" << std::endl;
+  MAGE_TRACE(frame) << " - command buffer submission successful!";
 
   return result;
 }
@@ -476,13 +427,12 @@ SwapChainHandling::~SwapChainHandling() {
   }
   for (int i = 0; i < depth_images.size(); i++) {
     vkDestroyImageView(device.get_device(), depth_images_views[i], nullptr);
-    vkDestroyImage(device.get_device(), depth_images[i], nullptr);
-    vkFreeMemory(device.get_device(), depth_images_memories[i], nullptr);
+    device.destroy_image(depth_images[i], depth_images_allocations[i]);
   }
   for (auto framebuffer : swap_chain_framebuffers) {
     vkDestroyFramebuffer(device.get_device(), framebuffer, nullptr);
   }
-  for (size_t i = 0; i < MAX_FRAMES; i++) {
+  for (size_t i = 0; i < in_flight_fences.size(); i++) {
     vkDestroySemaphore(device.get_device(), render_available_semaphores[i], nullptr);
     vkDestroySemaphore(device.get_device(), image_available_semaphores[i], nullptr);
     vkDestroyFence(device.get_device(), in_flight_fences[i], nullptr);
@@ -3,16 +3,20 @@
 #include "../window-resources/window.hpp"
 #include "pipeline.hpp"
 #include "device.hpp"
+#include "render-target.hpp"
+#include "frame-pacing.hpp"
 #include <vector>
 #include <memory>
 
 namespace mage {
 
-	class SwapChainHandling {
+	class SwapChainHandling : public RenderTarget {
 	private:	
-		static const int MAX_FRAMES = 2;
 		size_t current_frame = 0;
 		DeviceHandling &device;
+		// requested is what the application asked for, pacing what the surface allowed
+		FramePacing requested;
+		FramePacing pacing;
 		VkExtent2D window_extent;
 		VkFormat swap_image_format;
 		VkFormat swap_depth_format;
@@ -21,7 +25,7 @@ namespace mage {
   		std::vector<VkFramebuffer> swap_chain_framebuffers;
   		VkRenderPass render_pass;
   		std::vector<VkImage> depth_images;
-  		std::vector<VkDeviceMemory> depth_images_memories;
+  		std::vector<MemoryAllocation> depth_images_allocations;
   		std::vector<VkImageView> depth_images_views;
   		std::vector<VkImage> swap_images;
   		std::vector<VkImageView> swap_image_views;
@@ -29,12 +33,16 @@ namespace mage {
   		std::vector<VkSemaphore> render_available_semaphores;
   		std::vector<VkFence> in_flight_fences;
   		std::vector<VkFence> images_in_flight;
-  		std::shared_ptr<SwapChainHandling> old_swapchain;
+  		// Frame slots carry on from the swapchain being replaced, its fences still guard work in flight
+  		void adopt_sync_objects(SwapChainHandling &previous);
 	public:
-		SwapChainHandling(DeviceHandling &device_pass, VkExtent2D window_extent);
-		SwapChainHandling(DeviceHandling &device_pass, VkExtent2D window_extent, std::shared_ptr<SwapChainHandling> previous);
+		SwapChainHandling(DeviceHandling &device_pass, VkExtent2D window_extent, FramePacing pacing_pass = {});
+		// Replaces previous without waiting on the device: previous becomes the old swapchain for the driver, and its
+		// render pass (when the formats match), frame fences and semaphores move over. previous keeps its images and
+		// framebuffers, the caller destroys it once the frames that used them are done.
+		SwapChainHandling(DeviceHandling &device_pass, VkExtent2D window_extent, std::shared_ptr<SwapChainHandling> previous, FramePacing pacing_pass = {});
 		~SwapChainHandling();
-		void create_swap_chain();
+		void create_swap_chain(VkSwapchainKHR old_chain = VK_NULL_HANDLE);
 		void create_image_views();
 		void create_render_pass();
 		void create_depth_resources();
@@ -42,18 +50,20 @@ namespace mage {
 		void create_sync_objects();
 		VkSurfaceFormatKHR choose_swap_format(const std::vector<VkSurfaceFormatKHR>& formats);
 		VkPresentModeKHR choose_swap_mode(const std::vector<VkPresentModeKHR>& modes);
+		uint32_t choose_image_count(const VkSurfaceCapabilitiesKHR& capabilities);
 		VkExtent2D choose_swap_extent(const VkSurfaceCapabilitiesKHR& capabilities);
 		VkFormat find_depth_format();
-		void create_image(const VkImageCreateInfo &image_info, VkMemoryPropertyFlags properties, VkImage &image, VkDeviceMemory &image_memory);
+		void create_image(const VkImageCreateInfo &image_info, VkMemoryPropertyFlags properties, VkImage &image, MemoryAllocation &image_allocation);
 		uint32_t find_memory_type(uint32_t type_filter, VkMemoryPropertyFlags properties);
-		VkResult acquire_next_image(uint32_t *image_index);
-		VkResult submit_command_buffers(const VkCommandBuffer *buffers, uint32_t *image_index);
+		VkResult acquire_next_image(uint32_t *image_index) override;
+		VkResult submit_command_buffers(const VkCommandBuffer *buffers, uint32_t *image_index) override;
 
-		int get_max_frames(){return MAX_FRAMES;}
-		VkExtent2D get_swap_extent(){return swap_extent;}
-		VkRenderPass get_render_pass(){return render_pass;}
-		VkFramebuffer get_framebuffers(int index) {return swap_chain_framebuffers[index];}
-		size_t get_image_count(){return swap_images.size();}
+		int get_max_frames() override {return static_cast<int>(pacing.frames_in_flight);}
+		FramePacing get_frame_pacing() override {return pacing;}
+		VkExtent2D get_swap_extent() override {return swap_extent;}
+		VkRenderPass get_render_pass() override {return render_pass;}
+		VkFramebuffer get_framebuffers(int index) override {return swap_chain_framebuffers[index];}
+		size_t get_image_count() override {return swap_images.size();}
 		bool compare_swap_formats(const SwapChainHandling &swapchain) const {
     		return swapchain.swap_depth_format == swap_depth_format && swapchain.swap_image_format == swap_image_format;
   		}
@@ -0,0 +1,92 @@
+#include "uniform-ring.hpp"
+#include "../debug-resources/log.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+using namespace mage;
+
+UniformRing::UniformRing(DeviceHandling &device_pass, uint32_t frames_in_flight) : device{device_pass} {
+	MAGE_INFO(pipeline) << "Attempting to create uniform ring...";
+	VkDescriptorSetLayoutBinding binding{};
+	binding.binding = 0;
+	binding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	binding.descriptorCount = 1;
+	binding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+	VkDescriptorSetLayoutCreateInfo layout_info{};
+	layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layout_info.bindingCount = 1;
+	layout_info.pBindings = &binding;
+	if (vkCreateDescriptorSetLayout(device.get_device(), &layout_info, nullptr, &set_layout) != VK_SUCCESS) {
+		MAGE_ERROR(pipeline) << "Failed to create uniform descriptor set layout";
+		exit(EXIT_FAILURE);
+	}
+
+	VkDescriptorPoolSize pool_size{};
+	pool_size.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	pool_size.descriptorCount = frames_in_flight;
+	VkDescriptorPoolCreateInfo pool_info{};
+	pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	pool_info.maxSets = frames_in_flight;
+	pool_info.poolSizeCount = 1;
+	pool_info.pPoolSizes = &pool_size;
+	if (vkCreateDescriptorPool(device.get_device(), &pool_info, nullptr, &descriptor_pool) != VK_SUCCESS) {
+		MAGE_ERROR(pipeline) << "Failed to create uniform descriptor pool";
+		exit(EXIT_FAILURE);
+	}
+
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(device.get_card(), &properties);
+	VkDeviceSize alignment = std::max<VkDeviceSize>(properties.limits.minUniformBufferOffsetAlignment, 1);
+	slot_size = (sizeof(GlobalUniforms) + alignment - 1) / alignment * alignment;
+	device.create_buffer(
+	  slot_size * frames_in_flight,
+	  VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+	  VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+	  buffer,
+	  allocation);
+
+	std::vector<VkDescriptorSetLayout> layouts(frames_in_flight, set_layout);
+	descriptor_sets.resize(frames_in_flight);
+	VkDescriptorSetAllocateInfo allocate_info{};
+	allocate_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocate_info.descriptorPool = descriptor_pool;
+	allocate_info.descriptorSetCount = frames_in_flight;
+	allocate_info.pSetLayouts = layouts.data();
+	if (vkAllocateDescriptorSets(device.get_device(), &allocate_info, descriptor_sets.data()) != VK_SUCCESS) {
+		MAGE_ERROR(pipeline) << "Failed to allocate uniform descriptor sets";
+		exit(EXIT_FAILURE);
+	}
+	// Slots never move, so every set is written once here
+	for (uint32_t frame = 0; frame < frames_in_flight; frame++) {
+		VkDescriptorBufferInfo buffer_info{};
+		buffer_info.buffer = buffer;
+		buffer_info.offset = slot_size * frame;
+		buffer_info.range = sizeof(GlobalUniforms);
+		VkWriteDescriptorSet write{};
+		write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write.dstSet = descriptor_sets[frame];
+		write.dstBinding = 0;
+		write.descriptorCount = 1;
+		write.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+		write.pBufferInfo = &buffer_info;
+		vkUpdateDescriptorSets(device.get_device(), 1, &write, 0, nullptr);
+	}
+	MAGE_INFO(pipeline) << " - uniform ring creation successful, " << frames_in_flight << " slot(s) of " << slot_size << " bytes";
+}
+
+// Coherent memory, the write is visible to the frame's submission without a flush
+void UniformRing::write(uint32_t frame_index, const GlobalUniforms &uniforms){
+	std::memcpy(static_cast<char*>(allocation.mapped) + slot_size * frame_index, &uniforms, sizeof(GlobalUniforms));
+}
+
+void UniformRing::bind(VkCommandBuffer command_buffer, VkPipelineLayout layout, uint32_t frame_index){
+	vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, layout, 0, 1, &descriptor_sets[frame_index], 0, nullptr);
+}
+
+UniformRing::~UniformRing() {
+	device.destroy_buffer(buffer, allocation);
+	vkDestroyDescriptorPool(device.get_device(), descriptor_pool, nullptr);
+	vkDestroyDescriptorSetLayout(device.get_device(), set_layout, nullptr);
+}
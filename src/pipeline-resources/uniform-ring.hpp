@@ -0,0 +1,43 @@
+#pragma once
+
+#include "device.hpp"
+#include <glm/glm.hpp>
+#include <vector>
+
+namespace mage {
+
+	// Set 0 binding 0 of every scene pipeline, std140. Per-frame data shared by all draws goes here rather than into
+	// each draw's push constants, lighting included once there is some.
+	struct GlobalUniforms {
+		glm::mat4 projection{1.f};
+		glm::mat4 view{1.f};
+		glm::mat4 projection_view{1.f};
+		// w is 1
+		glm::vec4 camera_position{0.f, 0.f, 0.f, 1.f};
+	};
+
+	// One persistently mapped, host-coherent uniform buffer split into a slot per frame in flight, each slot with its
+	// own descriptor set. A frame only writes its own slot, after its fence, so nothing is overwritten while read.
+	class UniformRing {
+	private:
+		DeviceHandling &device;
+		VkDescriptorSetLayout set_layout;
+		VkDescriptorPool descriptor_pool;
+		std::vector<VkDescriptorSet> descriptor_sets;
+		VkBuffer buffer = VK_NULL_HANDLE;
+		MemoryAllocation allocation;
+		// sizeof(GlobalUniforms) rounded up to minUniformBufferOffsetAlignment
+		VkDeviceSize slot_size = 0;
+	public:
+		UniformRing(DeviceHandling &device_pass, uint32_t frames_in_flight);
+		~UniformRing();
+		UniformRing(const UniformRing&) = delete;
+		UniformRing &operator=(const UniformRing&) = delete;
+		void write(uint32_t frame_index, const GlobalUniforms &uniforms);
+		void bind(VkCommandBuffer command_buffer, VkPipelineLayout layout, uint32_t frame_index);
+
+		// For pipeline layouts, as set 0
+		VkDescriptorSetLayout get_set_layout() const {return set_layout;}
+	};
+
+}
@@ -0,0 +1,23 @@
+#version 450
+
+layout(location = 0) in vec3 position;
+layout(location = 1) in vec3 color;
+
+// Per-instance, one location per matrix column
+layout(location = 2) in mat4 instanceTransform;
+layout(location = 6) in vec3 instanceColor;
+
+layout(location = 0) out vec3 fragColor;
+
+// GlobalUniforms, written once per frame
+layout(set = 0, binding = 0) uniform Global {
+    mat4 projection;
+    mat4 view;
+    mat4 projectionView;
+    vec4 cameraPosition;
+} global;
+
+void main() {
+    gl_Position = global.projectionView * instanceTransform * vec4(position, 1.0);
+    fragColor = color + instanceColor;
+}
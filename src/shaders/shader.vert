@@ -1,20 +1,25 @@
 #version 450
 
+layout(location = 0) in vec3 position;
+layout(location = 1) in vec3 color;
+
 layout(location = 0) out vec3 fragColor;
 
-vec2 positions[3] = vec2[](
-    vec2(0.0, -0.5),
-    vec2(0.5, 0.5),
-    vec2(-0.5, 0.5)
-);
+// GlobalUniforms, written once per frame
+layout(set = 0, binding = 0) uniform Global {
+    mat4 projection;
+    mat4 view;
+    mat4 projectionView;
+    vec4 cameraPosition;
+} global;
 
-vec3 colors[3] = vec3[](
-    vec3(1.0, 0.0, 0.0),
-    vec3(0.0, 1.0, 0.0),
-    vec3(0.0, 0.0, 1.0)
-);
+layout(push_constant) uniform Push {
+    mat4 model;
+    vec3 color;
+} push;
 
 void main() {
-    gl_Position = vec4(positions[gl_VertexIndex], 0.0, 1.0);
-    fragColor = colors[gl_VertexIndex];
-}
\ No newline at end of file
+    gl_Position = global.projectionView * push.model * vec4(position, 1.0);
+    // An object color of zero leaves the vertex colors untouched
+    fragColor = color + push.color;
+}
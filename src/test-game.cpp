@@ -1,123 +1,283 @@
 #include "test-game.hpp"
 #include "object-resources/transport.hpp"
+#include "object-resources/primitives.hpp"
+#include "object-resources/mesh-import.hpp"
+#include "object-resources/mesh-cooked.hpp"
+#include "debug-resources/log.hpp"
+#include "debug-resources/cpu-profiler.hpp"
+#include "job-resources/jobs.hpp"
 
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #include <glm/glm.hpp>
 #include <glm/gtc/constants.hpp>
 
-#include <iostream>
+#include <algorithm>
 #include <array>
 #include <cstdlib>
 #include <cstring>
-#include <iostream>
 #include <limits>
 #include <set>
 #include <stdexcept>
 #include <chrono>
+#include <thread>
 
 using namespace mage;
 
-TestGame::TestGame() {
-  std::cout << std::endl << "=== LOADING GAME OBJECTS ===" << std::endl; 
+// --headless                render offscreen without a window or surface (software ICDs work)
+// --frames <n>              stop after n frames (headless defaults to 300)
+// --pacing <profile>        low-latency or max-throughput, later switches override parts of it
+// --frames-in-flight <n>    frames the CPU may run ahead of the GPU, 1 to 4
+// --swap-images <n>         swapchain images, clamped to what the surface allows
+// --present-mode <mode>     fifo, fifo-relaxed, mailbox or immediate, unsupported modes fall back
+// --readback <file.ppm>     headless only, read frames back and dump the last one
+// --record-threads <n>      record draws into secondary command buffers on n threads, 0 uses every hardware thread
+// --job-threads <n>         job system workers besides the main thread, 0 keeps every job on the main thread
+// --mesh <file>             show a cooked .mesh, .obj, .gltf or .glb instead of the cube
+GameOptions GameOptions::parse(int argc, char **argv) {
+  GameOptions options{};
+  options.job_threads = std::max(1u, std::thread::hardware_concurrency()) - 1;
+  for (int i = 1; i < argc; i++) {
+    std::string argument = argv[i];
+    bool has_value = i + 1 < argc;
+    if (argument == "--headless") {
+      options.headless = true;
+    } else if (argument == "--frames" && has_value) {
+      options.frames = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+    } else if (argument == "--pacing" && has_value) {
+      std::string profile = argv[++i];
+      if (!FramePacing::from_profile(profile, options.pacing)) {
+        MAGE_WARN(game) << "Ignoring unknown pacing profile " << profile;
+      }
+    } else if (argument == "--frames-in-flight" && has_value) {
+      uint32_t frames = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+      options.pacing.frames_in_flight = std::min(std::max(frames, FramePacing::MIN_FRAMES_IN_FLIGHT), FramePacing::MAX_FRAMES_IN_FLIGHT);
+    } else if (argument == "--swap-images" && has_value) {
+      options.pacing.image_count = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+    } else if (argument == "--present-mode" && has_value) {
+      std::string mode = argv[++i];
+      if (!parse_present_mode(mode, options.pacing.present_mode)) {
+        MAGE_WARN(game) << "Ignoring unknown present mode " << mode;
+      }
+    } else if (argument == "--record-threads" && has_value) {
+      options.record_threads = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+      if (options.record_threads == 0) {
+        options.record_threads = std::max(1u, std::thread::hardware_concurrency());
+      }
+    } else if (argument == "--job-threads" && has_value) {
+      options.job_threads = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+    } else if (argument == "--mesh" && has_value) {
+      options.mesh_path = argv[++i];
+    } else if (argument == "--readback" && has_value) {
+      options.readback_path = argv[++i];
+    } else {
+      MAGE_WARN(game) << "Ignoring unknown argument " << argument;
+    }
+  }
+  if (options.headless && options.frames == 0) {
+    options.frames = HEADLESS_DEFAULT_FRAMES;
+  }
+  return options;
+}
+
+// The constructing thread becomes the job system's main thread, it has to be the one that created the window
+TestGame::TestGame(const GameOptions &options_pass) : options{options_pass} {
+  JobSystem::get().start(options.job_threads);
+  if (options.headless) {
+    OffscreenInfo offscreen_info{};
+    offscreen_info.frames_in_flight = options.pacing.frames_in_flight;
+    offscreen_info.readback = !options.readback_path.empty();
+    test_device = std::make_unique<DeviceHandling>(nullptr);
+    test_artist = std::make_unique<DrawHandling>(*test_device, VkExtent2D{WIDTH, HEIGHT}, offscreen_info);
+  } else {
+    test_game = std::make_unique<Window>(WIDTH, HEIGHT, TITLE);
+    test_device = std::make_unique<DeviceHandling>(*test_game);
+    test_artist = std::make_unique<DrawHandling>(*test_game, *test_device, options.pacing);
+  }
+  test_artist->set_record_threads(options.record_threads);
+  test_uploads = std::make_unique<UploadService>(*test_device);
+
+  MAGE_INFO(game) << "=== LOADING GAME OBJECTS ==="; 
 	load_game_objects();
-  std::cout << "=== LOADING GAME SUCCESSFUL ===" << std::endl;
+  MAGE_INFO(game) << "=== LOADING GAME SUCCESSFUL ===";
 }
 
 // Run window until user wants to close it
 void TestGame::run() {
-  std::cout << "Attempting to begin running game..." << std::endl;
+  MAGE_INFO(game) << "Attempting to begin running game...";
+
+  MAGE_INFO(game) << " - handling pipeline creation to transport...";
+  TransportPass test_transport{*test_device, test_artist->get_swapchain_render_pass(), static_cast<uint32_t>(test_artist->get_render_target()->get_max_frames())};
+  // Save as soon as every pipeline exists so a crash later in the session still leaves a warm cache behind
+  test_device->get_pipeline_cache().save();
+  test_transport.set_recorder(test_artist->get_recorder());
 
-  std::cout << " - handling pipeline creation to transport..." << std::endl;
-  TransportPass test_transport{test_device, test_artist.get_swapchain_render_pass()};
-  std::cout << " - initializing camera..." << std::endl;
+  // MAGE_GPU_PROFILE=<file.csv> turns on per-draw GPU timings and writes every resolved frame to a rolling CSV
+  if (const char *gpu_profile_path = std::getenv("MAGE_GPU_PROFILE")) {
+    test_artist->get_gpu_profiler()->open_csv(gpu_profile_path);
+    test_transport.set_gpu_profiler(test_artist->get_gpu_profiler());
+  }
+  MAGE_INFO(game) << " - initializing camera...";
   test_camera.set_view_target(glm::vec3(-1.f, -2.f, -2.f), glm::vec3(0.f, 0.f, 2.5f), glm::vec3{0.f, -1.f, 0.f});
 
-	while(!test_game.close_window()){
-		glfwPollEvents();
-    float aspect_ratio = test_artist.get_aspect_ratio();
-    test_camera.set_perspective_projection(glm::radians(50.f), aspect_ratio, 0.1f, 10.f);
-    if (auto command_buffer = test_artist.draw_start()){
-      test_artist.swapchain_render_start(command_buffer);
-      test_transport.render_game_objects(command_buffer, game_objects, test_camera);
-      test_artist.swapchain_render_end(command_buffer);
-      test_artist.draw_end();
-    }
+  // MAGE_CPU_PROFILE=<frames> captures a CPU trace from the first frame, F12 captures one at any time
+  CpuProfiler::get().set_thread_name("main");
+  if (const char *capture_frames = std::getenv("MAGE_CPU_PROFILE")) {
+    CpuProfiler::get().request_capture(static_cast<uint32_t>(std::strtoul(capture_frames, nullptr, 10)), CPU_TRACE_PATH);
+  }
+
+  test_clock.reset();
+  uint64_t frame = 0;
+	while(keep_running(frame)){
+    run_frame(test_transport);
+    MAGE_PROFILE_FRAME();
+    test_clock.wait_for_frame();
+    frame++;
 	}
-	vkDeviceWaitIdle(test_device.get_device());
+	vkDeviceWaitIdle(test_device->get_device());
+
+  if (auto offscreen = test_artist->get_offscreen()) {
+    MAGE_INFO(game) << " - rendered " << frame << " headless frame(s)";
+    if (!options.readback_path.empty()) {
+      offscreen->wait_idle();
+      offscreen->write_ppm(options.readback_path);
+    }
+  }
 }
 
-// The specific values for this test cube are provided by https://github.com/blurrypiano
-std::unique_ptr<GameModel> create_cube_model(DeviceHandling &device, glm::vec3 offset) {
-  std::vector<GameModel::Vertex> vertices{
-
-      // left face (white)
-      {{-.5f, -.5f, -.5f}, {.9f, .9f, .9f}},
-      {{-.5f, .5f, .5f}, {.9f, .9f, .9f}},
-      {{-.5f, -.5f, .5f}, {.9f, .9f, .9f}},
-      {{-.5f, -.5f, -.5f}, {.9f, .9f, .9f}},
-      {{-.5f, .5f, -.5f}, {.9f, .9f, .9f}},
-      {{-.5f, .5f, .5f}, {.9f, .9f, .9f}},
-
-      // right face (yellow)
-      {{.5f, -.5f, -.5f}, {.8f, .8f, .1f}},
-      {{.5f, .5f, .5f}, {.8f, .8f, .1f}},
-      {{.5f, -.5f, .5f}, {.8f, .8f, .1f}},
-      {{.5f, -.5f, -.5f}, {.8f, .8f, .1f}},
-      {{.5f, .5f, -.5f}, {.8f, .8f, .1f}},
-      {{.5f, .5f, .5f}, {.8f, .8f, .1f}},
-
-      // top face (orange, remember y axis points down)
-      {{-.5f, -.5f, -.5f}, {.9f, .6f, .1f}},
-      {{.5f, -.5f, .5f}, {.9f, .6f, .1f}},
-      {{-.5f, -.5f, .5f}, {.9f, .6f, .1f}},
-      {{-.5f, -.5f, -.5f}, {.9f, .6f, .1f}},
-      {{.5f, -.5f, -.5f}, {.9f, .6f, .1f}},
-      {{.5f, -.5f, .5f}, {.9f, .6f, .1f}},
-
-      // bottom face (red)
-      {{-.5f, .5f, -.5f}, {.8f, .1f, .1f}},
-      {{.5f, .5f, .5f}, {.8f, .1f, .1f}},
-      {{-.5f, .5f, .5f}, {.8f, .1f, .1f}},
-      {{-.5f, .5f, -.5f}, {.8f, .1f, .1f}},
-      {{.5f, .5f, -.5f}, {.8f, .1f, .1f}},
-      {{.5f, .5f, .5f}, {.8f, .1f, .1f}},
-
-      // nose face (blue)
-      {{-.5f, -.5f, 0.5f}, {.1f, .1f, .8f}},
-      {{.5f, .5f, 0.5f}, {.1f, .1f, .8f}},
-      {{-.5f, .5f, 0.5f}, {.1f, .1f, .8f}},
-      {{-.5f, -.5f, 0.5f}, {.1f, .1f, .8f}},
-      {{.5f, -.5f, 0.5f}, {.1f, .1f, .8f}},
-      {{.5f, .5f, 0.5f}, {.1f, .1f, .8f}},
-
-      // tail face (green)
-      {{-.5f, -.5f, -0.5f}, {.1f, .8f, .1f}},
-      {{.5f, .5f, -0.5f}, {.1f, .8f, .1f}},
-      {{-.5f, .5f, -0.5f}, {.1f, .8f, .1f}},
-      {{-.5f, -.5f, -0.5f}, {.1f, .8f, .1f}},
-      {{.5f, -.5f, -0.5f}, {.1f, .8f, .1f}},
-      {{.5f, .5f, -0.5f}, {.1f, .8f, .1f}},
-
-  };
-  for (auto& v : vertices) {
-    v.position += offset;
+// Windowed runs last until the window closes, --frames caps either mode
+bool TestGame::keep_running(uint64_t frame) {
+  if (options.frames > 0 && frame >= options.frames) {
+    return false;
   }
-  return std::make_unique<GameModel>(device, vertices);
+  return test_game == nullptr || !test_game->close_window();
 }
 
+// One pass of the game loop: input, fixed simulation steps, then a single rendered frame
+void TestGame::run_frame(TransportPass &transport) {
+  MAGE_PROFILE_ZONE("TestGame::run_frame");
+  if (test_game != nullptr) {
+	  glfwPollEvents();
+    poll_profiler_capture();
+    poll_fullscreen_toggle();
+  }
+  // Jobs that need GLFW or the window are queued for here
+  JobSystem::get().run_main_thread_jobs();
+  test_uploads->update();
+  spawn_streamed_objects();
+
+  // Simulation runs in fixed steps, rendering runs at whatever rate the swapchain (or frame limit) allows
+  uint32_t steps = test_clock.advance();
+  {
+    MAGE_PROFILE_ZONE("TestGame::update");
+    for (uint32_t i = 0; i < steps; i++) {
+      update(test_clock.get_fixed_step());
+      test_clock.consume_step();
+    }
+  }
+
+  MAGE_PROFILE_ZONE("TestGame::render");
+  float aspect_ratio = test_artist->get_aspect_ratio();
+  test_camera.set_perspective_projection(glm::radians(50.f), aspect_ratio, 0.1f, 10.f);
+  if (auto command_buffer = test_artist->draw_start()){
+    test_artist->swapchain_render_start(command_buffer);
+    {
+      // Nothing but vkCmdExecuteCommands may go into the primary while secondaries are in use
+      GpuScope transport_scope{test_artist->get_recorder() == nullptr ? test_artist->get_gpu_profiler() : nullptr, command_buffer, "transport"};
+      transport.render_game_objects(command_buffer, static_cast<uint32_t>(test_artist->get_frame_index()), registry, test_camera, test_clock.get_alpha());
+    }
+    test_artist->swapchain_render_end(command_buffer);
+    test_artist->draw_end();
+  }
+}
+
+// Edge-triggered so holding F12 only starts a single capture
+void TestGame::poll_profiler_capture() {
+  bool held = test_game->key_pressed(GLFW_KEY_F12);
+  if (held && !capture_key_held) {
+    CpuProfiler::get().request_capture(CPU_CAPTURE_FRAMES, CPU_TRACE_PATH);
+  }
+  capture_key_held = held;
+}
+
+// F11 switches fullscreen, the artist picks up the new size on the next draw_start
+void TestGame::poll_fullscreen_toggle() {
+  bool held = test_game->key_pressed(GLFW_KEY_F11);
+  if (held && !fullscreen_key_held) {
+    test_game->toggle_fullscreen();
+  }
+  fullscreen_key_held = held;
+}
+
+// Advance the scene by one fixed simulation step, keeping the previous state around for interpolation
+void TestGame::update(float step) {
+  registry.view<Transform, Spin>().each([&](Entity, Transform &transform, Spin &spin) {
+    transform.previous = transform.current;
+    transform.current.rotation = glm::mod(transform.current.rotation + spin.speed * step, glm::two_pi<float>());
+  });
+}
+
+// Decoding runs on the job system and hands the mesh straight to the upload service, the cube appears a few frames
+// later once its buffers have arrived. Only the main thread touches the streaming list.
+// A mesh that fails to load is logged and replaced by the cube
 void TestGame::load_game_objects() {
-  std::cout << "Attempting to create cube..." << std::endl;
-  std::shared_ptr<GameModel> model = create_cube_model(test_device, {.0f, .0f, .0f});
-  auto cube = GameObject::create_game_object();
-  cube.model = model;
-  cube.transform.translation = {.0f, .0f, 2.5f};
-  cube.transform.scale = {.5f, .5f, .5f};
-  game_objects.push_back(std::move(cube));
-  std::cout << " - cube creation successful!" << std::endl;
+  MAGE_INFO(game) << "Attempting to stream " << (options.mesh_path.empty() ? std::string{"cube"} : options.mesh_path) << "...";
+  JobSystem::get().run([this] {
+    ModelUploadHandle upload;
+    const std::string &path = options.mesh_path;
+    if (path.size() > 5 && path.compare(path.size() - 5, 5, ".mesh") == 0) {
+      if (auto cooked = CookedMesh::load(path)) {
+        upload = test_uploads->upload_model(std::move(cooked));
+      }
+    } else if (!path.empty()) {
+      MeshData mesh;
+      if (import_mesh(path, mesh)) {
+        upload = test_uploads->upload_model(std::move(mesh.vertices), std::move(mesh.indices));
+      }
+    }
+    if (!upload) {
+      std::vector<GameModel::Vertex> vertices;
+      std::vector<uint32_t> indices;
+      decode_cube_mesh({.0f, .0f, .0f}, vertices, indices);
+      upload = test_uploads->upload_model(std::move(vertices), std::move(indices));
+    }
+    JobSystem::get().run_on_main([this, upload] {
+      Transform transform{};
+      transform.current.translation = {.0f, .0f, 2.5f};
+      transform.current.scale = {.5f, .5f, .5f};
+      transform.previous = transform.current;
+      streaming.push_back({upload, transform, Spin{{ROTATION_SPEED_X, ROTATION_SPEED_Y, 0.f}}});
+    });
+  }, &loading);
+}
+
+void TestGame::spawn_streamed_objects() {
+  if (streaming.empty()) {
+    return;
+  }
+  EntityCommands commands{registry};
+  auto ready = std::partition(streaming.begin(), streaming.end(), [](const StreamedObject &object) {return !object.upload->is_ready();});
+  for (auto object = ready; object != streaming.end(); object++) {
+    std::shared_ptr<GameModel> model = object->upload->get();
+    models.push_back(model);
+    commands.create(object->transform, Renderable{model.get(), {}}, object->spin);
+  }
+  streaming.erase(ready, streaming.end());
+  if (!commands.empty()) {
+    commands.apply();
+    test_device->get_memory().log_statistics();
+    registry.log_statistics();
+    MAGE_INFO(game) << " - streamed object(s) spawned";
+  }
 }
 
 
+// Models must go before the device they were allocated from
 TestGame::~TestGame() {
-	
+	JobSystem::get().wait(loading);
+	JobSystem::get().stop();
+	streaming.clear();
+	test_uploads.reset();
+	registry.clear();
+	models.clear();
 }
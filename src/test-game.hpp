@@ -6,26 +6,72 @@
 #include "pipeline-resources/swapchain.hpp"
 #include "camera-resources/camera.hpp"
 #include "object-resources/object.hpp"
+#include "object-resources/registry.hpp"
+#include "object-resources/transport.hpp"
+#include "object-resources/upload-service.hpp"
+#include "time-resources/clock.hpp"
+#include "job-resources/jobs.hpp"
 #include <vector>
 #include <memory>
 
 namespace mage {
 
+	// Command line switches for the test game, see GameOptions::parse
+	struct GameOptions {
+		static const uint32_t HEADLESS_DEFAULT_FRAMES = 300;
+		bool headless = false;
+		uint32_t frames = 0;
+		// Frames in flight also apply headless, swapchain images and present mode only to a window
+		FramePacing pacing;
+		uint32_t record_threads = 1;
+		// Job system workers besides the main thread, defaults to one per remaining hardware thread
+		uint32_t job_threads = 0;
+		std::string readback_path;
+		// Shown instead of the cube: a cooked .mesh is mapped, anything else goes through import_mesh
+		std::string mesh_path;
+		static GameOptions parse(int argc, char **argv);
+	};
+
 	class TestGame {
 	private:	
-		static const int WIDTH = 1520;
-		static const int HEIGHT = 1000;
+		static constexpr int WIDTH = 1520;
+		static constexpr int HEIGHT = 1000;
+		static constexpr float ROTATION_SPEED_Y = 0.5f;
+		static constexpr float ROTATION_SPEED_X = 0.05f;
+		static constexpr uint32_t CPU_CAPTURE_FRAMES = 120;
+		static constexpr const char *CPU_TRACE_PATH = "mage-cpu-trace.json";
 		std::string TITLE = "Mage Testing Window";
-  		std::vector<GameObject> game_objects;
+  		Registry registry;
+  		// The registry only points at models, they are kept alive here
+  		std::vector<std::shared_ptr<GameModel>> models;
+  		// Waiting on the upload service, spawned as entities once their model is ready
+  		struct StreamedObject {
+  			ModelUploadHandle upload;
+  			Transform transform;
+  			Spin spin;
+  		};
+  		std::vector<StreamedObject> streaming;
+  		JobCounter loading;
+  		GameOptions options;
 	public:
-		TestGame();
+		TestGame(const GameOptions &options_pass = {});
 		~TestGame();
-		Window test_game{WIDTH, HEIGHT, TITLE};
-		DeviceHandling test_device{test_game};
-		DrawHandling test_artist{test_game, test_device};
+		std::unique_ptr<Window> test_game;
+		std::unique_ptr<DeviceHandling> test_device;
+		std::unique_ptr<DrawHandling> test_artist;
+		std::unique_ptr<UploadService> test_uploads;
 		CameraHandling test_camera{};
+		ClockHandling test_clock{};
+		bool capture_key_held = false;
+		bool fullscreen_key_held = false;
 		void run();
+		bool keep_running(uint64_t frame);
+		void run_frame(TransportPass &transport);
+		void update(float step);
+		void poll_profiler_capture();
+		void poll_fullscreen_toggle();
 		void load_game_objects();
+		void spawn_streamed_objects();
 	};
 
 }
@@ -0,0 +1,66 @@
+#include "clock.hpp"
+
+#include <algorithm>
+#include <thread>
+
+using namespace mage;
+
+ClockHandling::ClockHandling(double step_seconds, uint32_t max_catch_up_steps) : fixed_step{step_seconds}, max_steps{max_catch_up_steps} {
+	reset();
+}
+
+// Restart timing from now, e.g. after loading so the first frame does not try to catch up on load time
+void ClockHandling::reset(){
+	accumulator = 0.0;
+	delta_time = 0.0;
+	last_frame = clock::now();
+	next_render = last_frame;
+}
+
+// Measure the frame and return how many fixed steps the caller should simulate before rendering.
+// Anything beyond max_steps is thrown away so a long stall can't spiral into ever longer catch-ups.
+uint32_t ClockHandling::advance(){
+	auto now = clock::now();
+	delta_time = std::chrono::duration<double>(now - last_frame).count();
+	last_frame = now;
+	accumulator += delta_time;
+
+	uint32_t steps = static_cast<uint32_t>(accumulator / fixed_step);
+	if (steps > max_steps) {
+		dropped_steps += steps - max_steps;
+		accumulator -= (steps - max_steps) * fixed_step;
+		steps = max_steps;
+	}
+	return steps;
+}
+
+// Called once per simulated step so the accumulator and simulation time stay in lockstep
+void ClockHandling::consume_step(){
+	accumulator = std::max(0.0, accumulator - fixed_step);
+	simulation_time += fixed_step;
+	simulation_steps++;
+}
+
+// Cap the render rate, 0 renders as fast as the swapchain allows
+void ClockHandling::set_frame_limit(double frames_per_second){
+	frame_interval = frames_per_second > 0.0 ? 1.0 / frames_per_second : 0.0;
+	next_render = clock::now();
+}
+
+// Sleep off whatever is left of this frame's slot when a frame limit is set
+void ClockHandling::wait_for_frame(){
+	if (frame_interval <= 0.0) {
+		return;
+	}
+	next_render += std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(frame_interval));
+	auto now = clock::now();
+	if (next_render > now) {
+		std::this_thread::sleep_until(next_render);
+	} else {
+		next_render = now;
+	}
+}
+
+ClockHandling::~ClockHandling(){
+	// placeholder deconstructor
+}
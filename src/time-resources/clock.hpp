@@ -0,0 +1,41 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+namespace mage {
+
+	// Fixed-timestep simulation clock. Each frame, advance() measures real time, adds it to an accumulator
+	// and reports how many fixed simulation steps to run. Whatever is left over becomes the interpolation
+	// factor the render phase uses to blend between the last two simulation states.
+	class ClockHandling {
+	private:
+		using clock = std::chrono::steady_clock;
+		double fixed_step;
+		uint32_t max_steps;
+		double accumulator = 0.0;
+		double delta_time = 0.0;
+		double simulation_time = 0.0;
+		double frame_interval = 0.0;
+		uint64_t simulation_steps = 0;
+		uint64_t dropped_steps = 0;
+		clock::time_point last_frame;
+		clock::time_point next_render;
+	public:
+		ClockHandling(double step_seconds = 1.0 / 60.0, uint32_t max_catch_up_steps = 5);
+		~ClockHandling();
+		void reset();
+		uint32_t advance();
+		void consume_step();
+		void set_frame_limit(double frames_per_second);
+		void wait_for_frame();
+
+		float get_alpha() const {return static_cast<float>(accumulator / fixed_step);}
+		float get_delta_time() const {return static_cast<float>(delta_time);}
+		float get_fixed_step() const {return static_cast<float>(fixed_step);}
+		double get_simulation_time() const {return simulation_time;}
+		uint64_t get_simulation_steps() const {return simulation_steps;}
+		uint64_t get_dropped_steps() const {return dropped_steps;}
+	};
+
+}
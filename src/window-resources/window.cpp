@@ -26,8 +26,36 @@ Window::Window(int w, int h, std::string title){
 void Window::init_window(){
 	glfwInit();
 	glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-	glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
+	glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE);
 	window = glfwCreateWindow(window_width, window_height, window_title.c_str(), nullptr, nullptr);
+	glfwSetWindowUserPointer(window, this);
+	glfwSetFramebufferSizeCallback(window, framebuffer_resize_callback);
+	// High DPI screens can give a framebuffer larger than the window size asked for
+	glfwGetFramebufferSize(window, &window_width, &window_height);
+}
+
+// Extent is in pixels, 0x0 while minimized
+void Window::framebuffer_resize_callback(GLFWwindow *glfw_window, int width, int height){
+	auto owner = reinterpret_cast<Window*>(glfwGetWindowUserPointer(glfw_window));
+	owner->framebuffer_resized = true;
+	owner->window_width = width;
+	owner->window_height = height;
+}
+
+void Window::toggle_fullscreen(){
+	if (fullscreen) {
+		glfwSetWindowMonitor(window, nullptr, windowed_x, windowed_y, windowed_width, windowed_height, GLFW_DONT_CARE);
+	} else {
+		GLFWmonitor *monitor = glfwGetPrimaryMonitor();
+		if (monitor == nullptr) {
+			return;
+		}
+		glfwGetWindowPos(window, &windowed_x, &windowed_y);
+		glfwGetWindowSize(window, &windowed_width, &windowed_height);
+		const GLFWvidmode *mode = glfwGetVideoMode(monitor);
+		glfwSetWindowMonitor(window, monitor, 0, 0, mode->width, mode->height, mode->refreshRate);
+	}
+	fullscreen = !fullscreen;
 }
 
 // Attempts to create surface to connect Vulkan to window
@@ -44,6 +72,12 @@ bool Window::close_window(){
 }
 
 
+// Polls current state of a GLFW key (e.g. GLFW_KEY_F12)
+bool Window::key_pressed(int key){
+	return glfwGetKey(window, key) == GLFW_PRESS;
+}
+
+
 // Free resources after closed window
 Window::~Window(){
 	glfwDestroyWindow(window);
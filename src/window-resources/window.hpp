@@ -15,12 +15,27 @@ namespace mage {
 		int window_height;
 		std::string window_title;
 		GLFWwindow* window;
+		// Set by the framebuffer size callback, DrawHandling clears it once the swapchain matches again
+		bool framebuffer_resized = false;
+		bool fullscreen = false;
+		// Windowed placement to return to when leaving fullscreen
+		int windowed_x = 0;
+		int windowed_y = 0;
+		int windowed_width = 0;
+		int windowed_height = 0;
+		static void framebuffer_resize_callback(GLFWwindow *glfw_window, int width, int height);
 	public:
 		Window(int w, int h, std::string title);
 		~Window();
 		void init_window();
 		bool close_window();
+		bool key_pressed(int key);
 		void create_surface(VkInstance instance, VkSurfaceKHR *surface);
+		// Switches between windowed and fullscreen on the primary monitor, the swapchain follows through the resize callback
+		void toggle_fullscreen();
+		bool is_fullscreen() const {return fullscreen;}
+		bool was_resized() const {return framebuffer_resized;}
+		void reset_resized_flag() {framebuffer_resized = false;}
 		VkExtent2D get_extent() {return {static_cast<uint32_t>(window_width), static_cast<uint32_t>(window_height)}; 
 }
 	};
@@ -0,0 +1,64 @@
+#include "object-resources/mesh-import.hpp"
+#include "object-resources/mesh-cooked.hpp"
+#include "object-resources/mesh-lod.hpp"
+#include "debug-resources/log.hpp"
+
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+using namespace mage;
+
+// Imports a mesh once, offline, and writes it in the cooked format the game maps at runtime.
+//
+//   mage-mesh-cook [--lods N] <input.obj|input.gltf|input.glb> [output.mesh]
+//
+// Without an output path the input's extension is replaced by .mesh. --lods sets how many levels of detail, the full
+// mesh included, are simplified down for it (4 by default, 1 cooks the mesh alone). The written file is loaded back and
+// checksummed before the tool reports success.
+
+namespace {
+
+  std::string default_output(const std::string &input) {
+    size_t dot = input.find_last_of('.');
+    size_t slash = input.find_last_of("/\\");
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) {
+      return input + ".mesh";
+    }
+    return input.substr(0, dot) + ".mesh";
+  }
+
+}
+
+int main(int argc, char **argv) {
+  LodSettings lod_settings{};
+  std::vector<std::string> paths;
+  for (int i = 1; i < argc; i++) {
+    std::string argument = argv[i];
+    if (argument == "--lods" && i + 1 < argc) {
+      lod_settings.max_lods = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+    } else {
+      paths.push_back(argument);
+    }
+  }
+  if (paths.empty() || paths.size() > 2) {
+    MAGE_ERROR(game) << "Usage: mage-mesh-cook [--lods N] <input.obj|input.gltf|input.glb> [output.mesh]";
+    Logger::get().flush();
+    return EXIT_FAILURE;
+  }
+  std::string input = paths[0];
+  std::string output = paths.size() == 2 ? paths[1] : default_output(input);
+
+  MeshData mesh;
+  bool cooked = import_mesh(input, mesh);
+  if (cooked) {
+    generate_lods(mesh, lod_settings);
+    cooked = CookedMesh::cook(mesh, output);
+  }
+  if (cooked) {
+    auto loaded = CookedMesh::load(output);
+    cooked = loaded != nullptr && loaded->verify();
+  }
+  Logger::get().flush();
+  return cooked ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -1,3 +1,6 @@
 C:/VulkanSDK/x.x.x.x/Bin32/glslc.exe src/shaders/shader.vert -o src/shaders/vert.spv
 C:/VulkanSDK/x.x.x.x/Bin32/glslc.exe src/shaders/shader.frag -o src/shaders/frag.spv
+C:/VulkanSDK/x.x.x.x/Bin32/glslc.exe src/shaders/instanced.vert -o src/shaders/instanced-vert.spv
+C:/VulkanSDK/x.x.x.x/Bin32/glslc.exe src/shaders/gpu-cull.comp -o src/shaders/gpu-cull-comp.spv
+C:/VulkanSDK/x.x.x.x/Bin32/glslc.exe src/shaders/gpu-compact.comp -o src/shaders/gpu-compact-comp.spv
 pause